@@ -101,6 +101,7 @@ void App::loop() {
 
     _server->loop();
     _face->loop();
+    _settings->loop();
 
     delay(50);
 }
@@ -124,7 +125,7 @@ void App::_onTapCenter() {
  */
 void App::_onButtonA() {
     M5.Speaker.tone(1000, 100);
-    if (_settings->getOpenAiApiKey() == nullptr) {
+    if (_settings->getOpenAiApiKey().isEmpty()) {
         _chat->speakCurrentTime();
     } else {
         _chat->toggleRandomSpeakMode();
@@ -1,6 +1,9 @@
+#include <algorithm>
+#include <climits>
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <HTTPClient.h>
+#include <SPIFFS.h>
 #include <WiFiClientSecure.h>
 
 #include "app/AppChat.h"
@@ -8,9 +11,34 @@
 #include "app/AppVoice.h"
 #include "app/lang.h"
 #include "lib/ChatGptClient.h"
+#include "lib/SentenceSegmenter.h"
+#include "lib/spiffs.h"
 #include "lib/utils.h"
 
+/// file path of the chat history journal
+static const char *CHAT_JOURNAL_PATH = "/chat.bin";
+
+/// question to summarize the history (the history is sent without roles)
+static const char *CHAT_SUMMARY_REQUEST =
+        "Summarize the conversation so far, including the previous summary if any, in the language of the conversation "
+        "within 200 words. Keep facts about the user and topics that may be referred to later.";
+
+/// prefix of the memo sent as a system message
+static const char *CHAT_SUMMARY_PREFIX = "Summary of the earlier conversation: ";
+
 void AppChat::setup() {
+    // wake up to handle the next request or timer
+    _voice->setOnFinished([this] { _notify(); });
+
+    // continue the conversation before reboot
+    if (_settings->getChatHistorySaveEnabled() && spiffsBegin()) {
+        _journal = std::make_unique<ChatJournal>(SPIFFS, CHAT_JOURNAL_PATH);
+        auto maxHistory = (size_t) std::max(_settings->getMaxHistory(), 0);
+        _chatHistory.setMemo(_journal->loadMemo());
+        _journal->load(maxHistory, [this, maxHistory](const String &question, const String &answer) {
+            _chatHistory.add(question, answer, maxHistory);
+        });
+    }
 }
 
 void AppChat::start() {
@@ -39,38 +67,31 @@ void AppChat::toggleRandomSpeakMode() {
     if (!_randomSpeakMode) {
         _randomSpeakMode = true;
         _randomSpeakNextTime = _getRandomSpeakNextTime();
-        message = String(t(_settings->getLang().c_str(), "chat_random_started"));
+        message = String(_settings->getLanguage().t("chat_random_started"));
     } else {
         _randomSpeakMode = false;
-        message = String(t(_settings->getLang().c_str(), "chat_random_stopped"));
+        message = String(_settings->getLanguage().t("chat_random_stopped"));
     }
     xSemaphoreGive(_lock);
     _voice->stopSpeak();
-    _voice->speak(message, "");
+    _voice->speakPhrase({message}, "");
     _setFace(Expression::Happy, "", 3000);
+    _notify();
 }
 
 /**
  * Speak current time
  */
 void AppChat::speakCurrentTime() {
-    String message;
+    std::vector<String> segments;
     struct tm tm{};
     if (getLocalTime(&tm)) {
-        const char *format;
-        if (tm.tm_min == 0) {
-            format = t(_settings->getLang().c_str(), "clock_now_noon");
-        } else {
-            format = t(_settings->getLang().c_str(), "clock_now");
-        }
-        char messageBuf[strlen(format) + 1];
-        snprintf(messageBuf, sizeof(messageBuf), format, tm.tm_hour, tm.tm_min);
-        message = String(messageBuf);
+        segments = clockSpeechSegments(_settings->getLanguage(), tm.tm_hour, tm.tm_min);
     } else {
-        t(_settings->getLang().c_str(), "clock_not_set");
+        segments.emplace_back(_settings->getLanguage().t("clock_not_set"));
     }
     _voice->stopSpeak();
-    _voice->speak(message, "");
+    _voice->speakPhrase(segments, "");
 }
 
 /**
@@ -84,6 +105,86 @@ void AppChat::talk(const String &text, const String &voiceName, bool useHistory,
     xSemaphoreTake(_lock, portMAX_DELAY);
     _chatRequests.push_back(std::make_unique<ChatRequest>(text, voiceName, onReceiveAnswer));
     xSemaphoreGive(_lock);
+    _notify();
+}
+
+/**
+ * Get statistics
+ *
+ * @return statistics
+ */
+ChatStats AppChat::getStats() {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto stats = _stats;
+    xSemaphoreGive(_lock);
+    return stats;
+}
+
+/**
+ * Wake up the chat task
+ */
+void AppChat::_notify() {
+    if (_taskHandle != nullptr) {
+        xTaskNotifyGive(_taskHandle);
+    }
+}
+
+/**
+ * Get time to wait for the next timer
+ *
+ * @param now current time
+ * @return ticks to wait (portMAX_DELAY: no timer)
+ */
+TickType_t AppChat::_getWaitTicks(unsigned long now) {
+    auto wait = ULONG_MAX;
+    if (_hideBalloon != (unsigned long) -1) {
+        wait = std::min(wait, _hideBalloon > now ? _hideBalloon - now : 0);
+    }
+    // speech timers are checked again when the voice is finished
+    if (!_voice->isSpeaking()) {
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        auto randomSpeakMode = _randomSpeakMode;
+        auto randomSpeakNextTime = _randomSpeakNextTime;
+        xSemaphoreGive(_lock);
+        if (randomSpeakMode) {
+            wait = std::min(wait, randomSpeakNextTime > now ? randomSpeakNextTime - now : 0);
+        }
+        struct tm tm{};
+        if (_settings->isClockSpeakEnabled() && getLocalTime(&tm, 0)) {
+            // next o'clock
+            wait = std::min(wait, (unsigned long) (3600 - tm.tm_min * 60 - tm.tm_sec) * 1000);
+        }
+        if (_needsSummary()) {
+            // end of idle period and retry interval
+            auto idle = now - _lastActiveTime;
+            auto summaryWait = idle < CHAT_SUMMARY_IDLE_DELAY ? CHAT_SUMMARY_IDLE_DELAY - idle : 0;
+            if ((long) (_summaryRetryTime - now) > 0) {
+                summaryWait = std::max(summaryWait, _summaryRetryTime - now);
+            }
+            wait = std::min(wait, summaryWait);
+        }
+    }
+    return wait == ULONG_MAX ? portMAX_DELAY : pdMS_TO_TICKS(wait);
+}
+
+/**
+ * Record latency from enqueue to first token
+ *
+ * @param enqueueTime time when the request was enqueued
+ */
+void AppChat::_recordFirstToken(unsigned long enqueueTime) {
+    auto elapsed = (uint32_t) (millis() - enqueueTime);
+    size_t bucket = 0;
+    while (bucket < CHAT_LATENCY_BUCKETS_NUM - 1 && elapsed > CHAT_LATENCY_BUCKETS[bucket]) {
+        bucket++;
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _stats.firstTokenCount++;
+    _stats.firstTokenTimeTotal += elapsed;
+    _stats.firstTokenTimeMax = std::max(_stats.firstTokenTimeMax, elapsed);
+    _stats.firstTokenHistogram[bucket]++;
+    xSemaphoreGive(_lock);
+    Serial.printf("chat time to first token: %d ms\n", (int) elapsed);
 }
 
 unsigned long AppChat::_getRandomSpeakNextTime() {
@@ -99,21 +200,34 @@ String AppChat::_getRandomSpeakQuestion() {
 }
 
 bool AppChat::_isRandomSpeakTimeNow(unsigned long now) {
-    if (now > _randomSpeakNextTime) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto result = _randomSpeakMode && now >= _randomSpeakNextTime;
+    if (result) {
         _randomSpeakNextTime = _getRandomSpeakNextTime();
-        return true;
     }
-    return false;
+    xSemaphoreGive(_lock);
+    return result;
 }
 
+/**
+ * Check if it is time to speak the clock (once in the first minute of the hour)
+ *
+ * @return true: speak now
+ */
 bool AppChat::_isClockSpeakTimeNow() {
     struct tm tm{};
-    if (getLocalTime(&tm) && tm.tm_min == 0 && tm.tm_sec == 0) {
-        auto hours = _settings->getChatClockHours();
-        for (auto hour: hours) {
-            if (hour == tm.tm_hour) {
-                return true;
-            }
+    if (!getLocalTime(&tm, 0) || tm.tm_min != 0) {
+        _clockSpokenHour = -1;
+        return false;
+    }
+    if (tm.tm_hour == _clockSpokenHour) {
+        return false;
+    }
+    auto hours = _settings->getChatClockHours();
+    for (auto hour: hours) {
+        if (hour == tm.tm_hour) {
+            _clockSpokenHour = tm.tm_hour;
+            return true;
         }
     }
     return false;
@@ -141,59 +255,61 @@ void AppChat::_setFace(Expression expression, const String &text, int duration)
  * @param useHistory use chat history
  * @return answer (nullptr: error)
  */
-String AppChat::_talk(const String &text, const String &voiceName, bool useHistory) {
+String AppChat::_talk(const String &text, const String &voiceName, bool useHistory, unsigned long enqueueTime) {
+    auto lang = _settings->getLanguage();
     auto apiKey = _settings->getOpenAiApiKey();
-    if (apiKey == nullptr) {
-        String message = t(_settings->getLang().c_str(), "apikey_not_set");
-        _voice->speak(message, voiceName);
+    if (apiKey.isEmpty()) {
+        String message = lang.t("apikey_not_set");
+        _voice->speakPhrase({message}, voiceName);
         return message;
     }
 
-    ChatGptClient client{apiKey, _settings->getChatGptModel()};
-    _setFace(Expression::Doubt, t(_settings->getLang().c_str(), "chat_thinking..."));
+    ChatGptClient client{apiKey, _settings->getChatGptModel(), _settings->getChatGptUrl(), _pool};
+    _setFace(Expression::Doubt, lang.t("chat_thinking..."));
 
     // call ChatGPT
     try {
-        std::deque<String> noHistory;
+        ChatHistory noHistory;
         String response;
         if (_settings->useChatGptStream()) {
-            std::stringstream ss;
-            int index = 0;
+            // speak each sentence as soon as it is completed
+            SentenceSegmenter segmenter(VOICE_SENTENCE_MAX_LENGTH);
+            auto firstSentence = true;
+            auto firstToken = true;
+            auto onSentence = [&](const String &sentence) {
+                if (firstSentence) {
+                    _setFace(Expression::Neutral, "");
+                    Serial.printf("chat time to first sentence: %d ms\n", (int) (millis() - enqueueTime));
+                }
+                _voice->speak(sentence, voiceName, firstSentence ? enqueueTime : 0);
+                firstSentence = false;
+            };
             response = client.chat(
                     text, _settings->getChatRoles(), useHistory ? _chatHistory : noHistory,
                     [&](const String &body) {
                         //Serial.printf("%s", body.c_str());
-                        ss << body.c_str();
-                        auto sentences = splitSentence(ss.str());
-                        if (sentences.size() > (index + 1)) {
-                            _setFace(Expression::Neutral, "");
-                            for (int i = index; i < sentences.size() - 1; i++) {
-                                _voice->speak(sentences[i].c_str(), voiceName);
-                                index++;
-                            }
+                        if (firstToken) {
+                            _recordFirstToken(enqueueTime);
+                            firstToken = false;
                         }
+                        segmenter.feed(body.c_str(), body.length(), onSentence);
                     });
+            segmenter.flush(onSentence);
             _setFace(Expression::Neutral, "");
-            auto sentences = splitSentence(response.c_str());
-            for (int i = index; i < sentences.size(); i++) {
-                _voice->speak(sentences[i].c_str(), voiceName);
-            }
         } else {
             response = client.chat(text, _settings->getChatRoles(), useHistory ? _chatHistory : noHistory, nullptr);
             //Serial.printf("%s\n", response.c_str());
+            _recordFirstToken(enqueueTime);
             _setFace(Expression::Neutral, "");
-            _voice->speak(response, voiceName);
+            _voice->speak(response, voiceName, enqueueTime);
         }
 
         if (useHistory) {
-            // チャット履歴が最大数を超えた場合、古い質問と回答を削除
-            if (_chatHistory.size() > _settings->getMaxHistory() * 2) {
-                _chatHistory.pop_front();
-                _chatHistory.pop_front();
+            // 質問と回答をチャット履歴に追加 (最大数、サイズ、トークン数を超えた場合、古い質問と回答を削除)
+            if (_chatHistory.add(text, response, (size_t) std::max(_settings->getMaxHistory(), 0))
+                && _journal != nullptr) {
+                _journal->append(text, response);
             }
-            // 質問と回答をチャット履歴に追加
-            _chatHistory.push_back(text);
-            _chatHistory.push_back(response);
         }
         return response;
     } catch (ChatGptClientError &e) {
@@ -207,28 +323,110 @@ String AppChat::_talk(const String &text, const String &voiceName, bool useHisto
             errorMessage = "Error";
         }
         _setFace(Expression::Sad, errorMessage, 3000);
-        _voice->speak(t(_settings->getLang().c_str(), "chat_i_dont_understand"), voiceName);
+        _voice->speakPhrase({lang.t("chat_i_dont_understand")}, voiceName);
         return errorMessage;
     }
 }
 
+/**
+ * Check if the history should be summarized (near the limit)
+ *
+ * @return true: needed, false: not needed
+ */
+bool AppChat::_needsSummary() {
+    auto maxHistory = (size_t) std::max(_settings->getMaxHistory(), 0);
+    return _settings->getChatHistorySummaryEnabled() && !_settings->getOpenAiApiKey().isEmpty()
+           && _chatHistory.size() >= 2 && _chatHistory.isNearLimit(maxHistory, CHAT_SUMMARY_THRESHOLD);
+}
+
+/**
+ * Check if a chat request is waiting
+ *
+ * @return true: waiting, false: not waiting
+ */
+bool AppChat::_hasRequest() {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto result = !_chatRequests.empty();
+    xSemaphoreGive(_lock);
+    return result;
+}
+
+/**
+ * Summarize the oldest half of the history into a memo when the history is near the limit (called when idle)
+ *
+ * The summary replaces the previous memo, so the request size stays about the same over long conversation.
+ * The summary is received as stream and aborted when a chat request arrives before sending or while receiving
+ * (checked at least every 100 ms). While waiting for the response headers it is not aborted,
+ * so a chat request may wait up to the HTTP timeout in the worst case.
+ *
+ * @return true: tried to summarize, false: not needed
+ */
+bool AppChat::_summarizeHistory() {
+    if (!_needsSummary() || (long) (millis() - _summaryRetryTime) < 0 || _hasRequest()) {
+        return false;
+    }
+    auto apiKey = _settings->getOpenAiApiKey();
+    auto turns = _chatHistory.size() / 2;
+    auto oldest = _chatHistory.oldest(turns);
+    auto success = false;
+    auto aborted = false;
+    if (oldest.size() == turns) {
+        ChatGptClient client{apiKey, _settings->getChatGptModel(), _settings->getChatGptUrl(), _pool};
+        client.setShouldAbort([&]() {
+            aborted = _hasRequest();
+            return aborted;
+        });
+        try {
+            auto summary = client.chat(CHAT_SUMMARY_REQUEST, {}, oldest, [](const String &) {});
+            auto memo = String(CHAT_SUMMARY_PREFIX) + summary;
+            success = !summary.isEmpty() && _chatHistory.summarize(turns, memo);
+            if (success && _journal != nullptr && !_journal->summarize(memo, _chatHistory.size())) {
+                // the journal keeps the previous memo and all turns, replaced on the next summary
+                Serial.println("ERROR: Failed to save chat memo");
+            }
+        } catch (ChatGptClientError &e) {
+            Serial.printf("ERROR: %s\n", e.what());
+        }
+    }
+    if (aborted) {
+        // try again after the next idle period
+        _lastActiveTime = millis();
+        return true;
+    }
+    Serial.printf("chat history summary: %s (%d turns, %d tokens)\n", success ? "done" : "failed",
+                  (int) _chatHistory.size(), (int) _chatHistory.tokens());
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    if (success) {
+        _stats.summaryCount++;
+    } else {
+        _stats.summaryErrorCount++;
+    }
+    xSemaphoreGive(_lock);
+    _summaryRetryTime = success ? 0 : millis() + CHAT_SUMMARY_RETRY_INTERVAL;
+    return true;
+}
+
 void AppChat::_loop() {
     auto now = millis();
 
     // reset balloon and face
-    if (_hideBalloon >= 0 && now > _hideBalloon) {
+    if (_hideBalloon != (unsigned long) -1 && now >= _hideBalloon) {
         _face->setExpression(Expression::Neutral);
         _face->setText("");
         _hideBalloon = -1;
     }
 
-    if (!_voice->isPlaying()) {
+    if (_voice->isSpeaking()) {
+        _lastActiveTime = now;
+    } else {
         if (_settings->isClockSpeakEnabled() && _isClockSpeakTimeNow()) {
             // clock speak mode
             speakCurrentTime();
-        } else if (_randomSpeakMode && _isRandomSpeakTimeNow(now)) {
+            _lastActiveTime = millis();
+        } else if (_isRandomSpeakTimeNow(now)) {
             // random speak mode
-            _talk(_getRandomSpeakQuestion(), "", false);
+            _talk(_getRandomSpeakQuestion(), "", false, now);
+            _lastActiveTime = millis();
         } else {
             xSemaphoreTake(_lock, portMAX_DELAY);
             std::unique_ptr<ChatRequest> request = nullptr;
@@ -239,10 +437,17 @@ void AppChat::_loop() {
             xSemaphoreGive(_lock);
             if (request != nullptr) {
                 // handle request
-                auto answer = _talk(request->text, request->voice, true);
+                auto answer = _talk(request->text, request->voice, true, request->enqueueTime);
                 request->onReceiveAnswer(answer.c_str());
+                _lastActiveTime = millis();
+                return; // check the next request
+            }
+            if (now - _lastActiveTime >= CHAT_SUMMARY_IDLE_DELAY && _summarizeHistory()) {
+                return; // check requests received while summarizing
             }
         }
     }
-    delay(500);
-}
+
+    // Sleep until a request, end of speech or the next timer
+    ulTaskNotifyTake(pdTRUE, _getWaitTicks(millis()));
+}
\ No newline at end of file
@@ -9,14 +9,54 @@
 #include "app/AppFace.h"
 #include "app/AppSettings.h"
 #include "app/AppVoice.h"
+#include "lib/ChatHistory.h"
+#include "lib/ChatJournal.h"
+#include "lib/ConnectionPool.h"
+
+/// upper bounds of latency histogram buckets (ms), the last bucket is for larger latency
+static const uint32_t CHAT_LATENCY_BUCKETS[] = {100, 200, 500, 1000, 2000, 5000, 10000};
+
+static const size_t CHAT_LATENCY_BUCKETS_NUM = sizeof(CHAT_LATENCY_BUCKETS) / sizeof(CHAT_LATENCY_BUCKETS[0]) + 1;
+
+/// summarize old history when its size or tokens exceeds this (% of the limit) or the number of turns reaches the max
+#if !defined(CHAT_SUMMARY_THRESHOLD)
+#define CHAT_SUMMARY_THRESHOLD 75
+#endif
+
+/// idle time to summarize history after the last chat or speech (ms)
+#if !defined(CHAT_SUMMARY_IDLE_DELAY)
+#define CHAT_SUMMARY_IDLE_DELAY 30000
+#endif
+
+/// time to retry failed summary (ms)
+static const unsigned long CHAT_SUMMARY_RETRY_INTERVAL = 60000;
 
 class ChatRequest {
 public:
     ChatRequest(String text, String voice, const std::function<void(const char *)> &onReceiveAnswer)
-            : text(std::move(text)), voice(std::move(voice)), onReceiveAnswer(onReceiveAnswer) {};
+            : text(std::move(text)), voice(std::move(voice)), onReceiveAnswer(onReceiveAnswer),
+              enqueueTime(millis()) {};
     String text;
     String voice;
     std::function<void(const char *)> onReceiveAnswer;
+    /// time when the request was enqueued
+    unsigned long enqueueTime;
+};
+
+class ChatStats {
+public:
+    /// number of requests received first token
+    uint32_t firstTokenCount = 0;
+    /// total time from enqueue to first token (ms)
+    uint32_t firstTokenTimeTotal = 0;
+    /// max time from enqueue to first token (ms)
+    uint32_t firstTokenTimeMax = 0;
+    /// histogram of time from enqueue to first token (see CHAT_LATENCY_BUCKETS)
+    uint32_t firstTokenHistogram[CHAT_LATENCY_BUCKETS_NUM] = {};
+    /// number of times old history was summarized
+    uint32_t summaryCount = 0;
+    /// number of failed summaries
+    uint32_t summaryErrorCount = 0;
 };
 
 class AppChat {
@@ -24,10 +64,12 @@ public:
     explicit AppChat(
             std::shared_ptr<AppSettings> settings,
             std::shared_ptr<AppVoice> voice,
-            std::shared_ptr<AppFace> face
+            std::shared_ptr<AppFace> face,
+            std::shared_ptr<ConnectionPool> pool
     ) : _settings(std::move(settings)),
         _voice(std::move(voice)),
-        _face(std::move(face)) {};
+        _face(std::move(face)),
+        _pool(std::move(pool)) {};
 
     void setup();
 
@@ -45,12 +87,15 @@ public:
     void talk(const String &text, const String &voiceName, bool useHistory,
               const std::function<void(const char *)> &onReceiveAnswer);
 
+    ChatStats getStats();
+
 private:
     std::shared_ptr<AppSettings> _settings;
     std::shared_ptr<AppVoice> _voice;
     std::shared_ptr<AppFace> _face;
+    std::shared_ptr<ConnectionPool> _pool;
 
-    TaskHandle_t _taskHandle;
+    TaskHandle_t _taskHandle{};
 
     SemaphoreHandle_t _lock = xSemaphoreCreateMutex();
 
@@ -70,7 +115,28 @@ private:
     std::deque<std::unique_ptr<ChatRequest>> _chatRequests;
 
     /// chat history (questions and answers)
-    std::deque<String> _chatHistory;
+    ChatHistory _chatHistory{CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS};
+
+    /// chat history saved on the file system (nullptr: not saved)
+    std::unique_ptr<ChatJournal> _journal;
+
+    /// time to retry summary after failure
+    unsigned long _summaryRetryTime = 0;
+
+    /// time of the last chat or speech (start of idle period)
+    unsigned long _lastActiveTime = 0;
+
+    /// hour spoken by clock speak mode (-1: none)
+    int _clockSpokenHour = -1;
+
+    /// statistics
+    ChatStats _stats;
+
+    void _notify();
+
+    TickType_t _getWaitTicks(unsigned long now);
+
+    void _recordFirstToken(unsigned long enqueueTime);
 
     unsigned long _getRandomSpeakNextTime();
 
@@ -86,7 +152,13 @@ private:
 
     void _setFace(Expression expression, const String &text, int duration);
 
-    String _talk(const String &text, const String &voiceName, bool useHistory);
+    String _talk(const String &text, const String &voiceName, bool useHistory, unsigned long enqueueTime);
+
+    bool _needsSummary();
+
+    bool _hasRequest();
+
+    bool _summarizeHistory();
 
     void _loop();
 };
@@ -89,7 +89,7 @@ void AppFace::lipSync(void *args) {
     if (((m5avatar::DriveContext *) args)->getAvatar() != &_avatar) return;
 
     while (true) {
-        _avatar.setMouthOpenRatio(_voice->getAudioLevel());
+        _avatar.setMouthOpenRatio(_voice->getMouthOpenRatio());
         delay(50);
     }
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <Arduino.h>
 #include <ESP32WebServer.h>
 
@@ -5,6 +6,7 @@
 #include "app/AppFace.h"
 #include "app/AppServer.h"
 #include "app/AppVoice.h"
+#include "lib/arena.h"
 #include "lib/utils.h"
 
 void AppServer::setup() {
@@ -14,20 +16,20 @@ void AppServer::setup() {
     _httpServer.on("/speech", [&] { _onSpeech(); });
     _httpServer.on("/face", [&] { _onFace(); });
     _httpServer.on("/chat", [&] { _onChat(); });
+    _httpServer.on("/chat_result", HTTP_GET, [&] { _onChatResult(); });
     _httpServer.on("/apikey", HTTP_GET, [&] { _onApikey(); });
     _httpServer.on("/apikey_set", HTTP_POST, [&] { _onApikeySet(); });
     _httpServer.on("/role_get", HTTP_GET, [&] { _onRoleGet(); });
     _httpServer.on("/role_set", HTTP_POST, [&] { _onRoleSet(); });
     _httpServer.on("/setting", [&] { _onSetting(); });
     _httpServer.on("/settings", [&] { _onSettings(); });
+    _httpServer.on("/stats", HTTP_GET, [&] { _onStats(); });
     _httpServer.onNotFound([&] { _onNotFound(); });
     _httpServer.begin();
 }
 
 void AppServer::loop() {
-    if (!_busy) {
-        _httpServer.handleClient();
-    }
+    _httpServer.handleClient();
 }
 
 void AppServer::_onRoot() {
@@ -54,15 +56,95 @@ void AppServer::_onFace() {
     _httpServer.send(200, "text/plain", "OK");
 }
 
+/**
+ * Request chat and respond the job id without waiting for the answer
+ */
 void AppServer::_onChat() {
     auto text = _httpServer.arg("text");
     auto voiceName = _httpServer.arg("voice");
+    auto id = _addChatJob();
+    if (id == 0) {
+        _httpServer.send(503, "text/plain", "Too many chats");
+        return;
+    }
     _voice->stopSpeak();
-    _chat->talk(text, voiceName, true, [&](const char *answer) {
-        _httpServer.send(200, "text/plain", answer);
-        _busy = false;
+    // called on the chat task
+    _chat->talk(text, voiceName, true, [this, id](const char *answer) {
+        _finishChatJob(id, answer);
     });
-    _busy = true;
+    DynamicJsonDocument result(64);
+    result["id"] = id;
+    _httpServer.send(202, "application/json", jsonEncode(result));
+}
+
+/**
+ * Respond the answer of the chat job (202: not answered yet)
+ */
+void AppServer::_onChatResult() {
+    auto id = (uint32_t) _httpServer.arg("id").toInt();
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto it = std::find_if(_chatJobs.begin(), _chatJobs.end(), [id](const ChatJob &job) { return job.id == id; });
+    if (it == _chatJobs.end()) {
+        xSemaphoreGive(_lock);
+        _httpServer.send(404);
+        return;
+    }
+    if (!it->done) {
+        xSemaphoreGive(_lock);
+        _httpServer.send(202, "text/plain", "Thinking");
+        return;
+    }
+    auto answer = std::move(it->answer);
+    _chatJobs.erase(it);
+    xSemaphoreGive(_lock);
+    _httpServer.send(200, "text/plain", answer);
+}
+
+/**
+ * Add chat job
+ *
+ * Answers not fetched are dropped on expiration or when jobs are full.
+ *
+ * @return job id (0: too many pending jobs)
+ */
+uint32_t AppServer::_addChatJob() {
+    auto now = millis();
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto expired = [now](const ChatJob &job) { return job.done && now - job.doneTime > CHAT_JOB_EXPIRE; };
+    _chatJobs.erase(std::remove_if(_chatJobs.begin(), _chatJobs.end(), expired), _chatJobs.end());
+    if (_chatJobs.size() >= CHAT_JOB_MAX) {
+        auto it = std::find_if(_chatJobs.begin(), _chatJobs.end(), [](const ChatJob &job) { return job.done; });
+        if (it != _chatJobs.end()) {
+            _chatJobs.erase(it);
+        }
+    }
+    uint32_t id = 0;
+    if (_chatJobs.size() < CHAT_JOB_MAX) {
+        id = _nextChatJobId++;
+        if (_nextChatJobId == 0) {
+            _nextChatJobId = 1;
+        }
+        _chatJobs.emplace_back(id);
+    }
+    xSemaphoreGive(_lock);
+    return id;
+}
+
+/**
+ * Store the answer of the chat job
+ *
+ * @param id job id
+ * @param answer answer
+ */
+void AppServer::_finishChatJob(uint32_t id, const char *answer) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto it = std::find_if(_chatJobs.begin(), _chatJobs.end(), [id](const ChatJob &job) { return job.id == id; });
+    if (it != _chatJobs.end()) {
+        it->done = true;
+        it->answer = answer;
+        it->doneTime = millis();
+    }
+    xSemaphoreGive(_lock);
 }
 
 void AppServer::_onApikey() {
@@ -73,6 +155,7 @@ void AppServer::_onApikeySet() {
     auto openAiApiKey = _httpServer.arg("openai");
     auto voiceTextApiKey = _httpServer.arg("voicetext");
     auto voicevoxApiKey = _httpServer.arg("voicevox");
+    _settings->begin();
     _settings->setOpenAiApiKey(openAiApiKey);
     _settings->setVoiceTextApiKey(voiceTextApiKey);
     _settings->setTtsQuestVoicevoxApiKey(voicevoxApiKey);
@@ -83,6 +166,10 @@ void AppServer::_onApikeySet() {
     } else {
         _settings->setVoiceService(VOICE_SERVICE_GOOGLE_TRANSLATE_TTS);
     }
+    if (!_settings->commit()) {
+        _httpServer.send(500);
+        return;
+    }
     _httpServer.send(200, "text/plain", "OK");
 }
 
@@ -134,6 +221,8 @@ void AppServer::_onSettings() {
             result = _settings->load(_httpServer.arg("plain"),
                                      _httpServer.method() == HTTPMethod::HTTP_PUT);
         } else {
+            // write all settings at once
+            _settings->begin();
             for (int i = 0; i < _httpServer.args(); i++) {
                 auto name = _httpServer.argName(i);
                 auto val = _httpServer.arg(i);
@@ -149,6 +238,7 @@ void AppServer::_onSettings() {
                     _settings->set(name, val);
                 }
             }
+            result = _settings->commit();
         }
     }
     auto settings = jsonEncode(_settings->get(""));
@@ -159,6 +249,62 @@ void AppServer::_onSettings() {
     }
 }
 
+void AppServer::_onStats() {
+    DynamicJsonDocument result(2048);
+    auto poolStats = _pool->getStats();
+    auto pool = result.createNestedObject("connectionPool");
+    pool["size"] = poolStats.size;
+    pool["hits"] = poolStats.hits;
+    pool["misses"] = poolStats.misses;
+    pool["evictions"] = poolStats.evictions;
+    pool["connectTimeTotal"] = poolStats.connectTimeTotal;
+    pool["connectTimeMax"] = poolStats.connectTimeMax;
+    auto voiceStats = _voice->getStats();
+    auto voice = result.createNestedObject("voice");
+    voice["gapCount"] = voiceStats.gapCount;
+    voice["gapTimeTotal"] = voiceStats.gapTimeTotal;
+    voice["gapTimeMax"] = voiceStats.gapTimeMax;
+    voice["prefetchHits"] = voiceStats.prefetchHits;
+    voice["firstAudioCount"] = voiceStats.firstAudioCount;
+    voice["firstAudioTimeTotal"] = voiceStats.firstAudioTimeTotal;
+    voice["firstAudioTimeMax"] = voiceStats.firstAudioTimeMax;
+    voice["idleStartCount"] = voiceStats.idleStartCount;
+    voice["idleStartTimeTotal"] = voiceStats.idleStartTimeTotal;
+    voice["idleStartTimeMax"] = voiceStats.idleStartTimeMax;
+    voice["underrunCount"] = voiceStats.underrunCount;
+    voice["overrunCount"] = voiceStats.overrunCount;
+    auto chatStats = _chat->getStats();
+    auto chat = result.createNestedObject("chat");
+    chat["firstTokenCount"] = chatStats.firstTokenCount;
+    chat["firstTokenTimeTotal"] = chatStats.firstTokenTimeTotal;
+    chat["firstTokenTimeMax"] = chatStats.firstTokenTimeMax;
+    auto histogram = chat.createNestedObject("firstTokenHistogram");
+    for (size_t i = 0; i < CHAT_LATENCY_BUCKETS_NUM; i++) {
+        auto bucket = i < CHAT_LATENCY_BUCKETS_NUM - 1 ? String(CHAT_LATENCY_BUCKETS[i]) : String("inf");
+        histogram[bucket] = chatStats.firstTokenHistogram[i];
+    }
+    chat["summaryCount"] = chatStats.summaryCount;
+    chat["summaryErrorCount"] = chatStats.summaryErrorCount;
+    auto cacheStats = _voice->getCacheStats();
+    auto cache = result.createNestedObject("voiceCache");
+    cache["count"] = cacheStats.count;
+    cache["size"] = cacheStats.size;
+    cache["hits"] = cacheStats.hits;
+    cache["misses"] = cacheStats.misses;
+    cache["stores"] = cacheStats.stores;
+    cache["evictions"] = cacheStats.evictions;
+    auto memory = result.createNestedObject("memory");
+    const char *arenaNames[ARENA_NUM] = {"internal", "large"};
+    for (size_t i = 0; i < ARENA_NUM; i++) {
+        auto arenaStats = getArenaStats((Arena) i);
+        auto arena = memory.createNestedObject(arenaNames[i]);
+        arena["used"] = arenaStats.used;
+        arena["highWater"] = arenaStats.highWater;
+        arena["failures"] = arenaStats.failures;
+    }
+    _httpServer.send(200, "application/json", jsonEncode(result));
+}
+
 void AppServer::_onNotFound() {
     _httpServer.send(404);
 }
@@ -3,12 +3,34 @@
 
 #include <ESP32WebServer.h>
 
+#include <deque>
 #include <utility>
 
 #include "app/AppChat.h"
 #include "app/AppFace.h"
 #include "app/AppSettings.h"
 #include "app/AppVoice.h"
+#include "lib/ConnectionPool.h"
+
+/// max number of chat jobs kept (pending or answer not fetched)
+static const size_t CHAT_JOB_MAX = 8;
+
+/// time to keep the answer not fetched (ms)
+static const unsigned long CHAT_JOB_EXPIRE = 5 * 60 * 1000;
+
+/**
+ * Chat requested by /chat, the answer is fetched by /chat_result
+ */
+class ChatJob {
+public:
+    explicit ChatJob(uint32_t id) : id(id) {};
+    uint32_t id;
+    /// true: answer received
+    bool done = false;
+    String answer;
+    /// time when the answer was received
+    unsigned long doneTime = 0;
+};
 
 class AppServer {
 public:
@@ -16,11 +38,13 @@ public:
             std::shared_ptr<AppSettings> settings,
             std::shared_ptr<AppVoice> voice,
             std::shared_ptr<AppFace> face,
-            std::shared_ptr<AppChat> chat
+            std::shared_ptr<AppChat> chat,
+            std::shared_ptr<ConnectionPool> pool
     ) : _settings(std::move(settings)),
         _voice(std::move(voice)),
         _face(std::move(face)),
-        _chat(std::move(chat)) {};
+        _chat(std::move(chat)),
+        _pool(std::move(pool)) {};
 
     void setup();
 
@@ -31,11 +55,17 @@ private:
     std::shared_ptr<AppVoice> _voice;
     std::shared_ptr<AppFace> _face;
     std::shared_ptr<AppChat> _chat;
+    std::shared_ptr<ConnectionPool> _pool;
 
     ESP32WebServer _httpServer{80};
 
-    /// Busy flag
-    bool _busy = false;
+    SemaphoreHandle_t _lock = xSemaphoreCreateMutex();
+
+    /// chat jobs (oldest first)
+    std::deque<ChatJob> _chatJobs;
+
+    /// id of the next chat job
+    uint32_t _nextChatJobId = 1;
 
     void _onRoot();
 
@@ -45,6 +75,12 @@ private:
 
     void _onChat();
 
+    void _onChatResult();
+
+    uint32_t _addChatJob();
+
+    void _finishChatJob(uint32_t id, const char *answer);
+
     void _onApikey();
 
     void _onApikeySet();
@@ -57,6 +93,8 @@ private:
 
     void _onSettings();
 
+    void _onStats();
+
     void _onNotFound();
 };
 
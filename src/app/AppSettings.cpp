@@ -17,44 +17,54 @@ static const char *TIME_NTP_SERVER_DEFAULT = "ntp.nict.jp";
 static const char *SERVO_KEY = "servo";
 static const char *SERVO_PIN_X_KEY = "servo.pin.x";
 static const char *SERVO_PIN_Y_KEY = "servo.pin.y";
-static const char *SWING_HOME_X_KEY = "swing.home.x";
-static const char *SWING_ENABLE_KEY = "swing.enable";
+static const SettingsKey SWING_HOME_X_KEY{"swing.home.x"};
+static const SettingsKey SWING_ENABLE_KEY{"swing.enable"};
 static const int SWING_ENABLE_DEFAULT = true;
 static const int SWING_HOME_X_DEFAULT = 90;
-static const char *SWING_HOME_Y_KEY = "swing.home.y";
+static const SettingsKey SWING_HOME_Y_KEY{"swing.home.y"};
 static const int SWING_HOME_Y_DEFAULT = 80;
-static const char *SWING_RANGE_X_KEY = "swing.range.x";
+static const SettingsKey SWING_RANGE_X_KEY{"swing.range.x"};
 static const int SWING_RANGE_X_DEFAULT = 30;
-static const char *SWING_RANGE_Y_KEY = "swing.range.y";
+static const SettingsKey SWING_RANGE_Y_KEY{"swing.range.y"};
 static const int SWING_RANGE_Y_DEFAULT = 20;
 
-static const char *VOICE_LANG_KEY = "voice.lang";
+static const SettingsKey VOICE_LANG_KEY{"voice.lang"};
 static const char *VOICE_LANG_DEFAULT = "ja";
-static const char *VOICE_VOLUME_KEY = "voice.volume";
+static const SettingsKey VOICE_VOLUME_KEY{"voice.volume"};
 static const int VOICE_VOLUME_DEFAULT = 200;
-static const char *VOICE_SERVICE_KEY = "voice.service";
+static const SettingsKey VOICE_SERVICE_KEY{"voice.service"};
 static const char *VOICE_SERVICE_DEFAULT = VOICE_SERVICE_GOOGLE_TRANSLATE_TTS;
-static const char *VOICE_VOICETEXT_APIKEY_KEY = "voice.voicetext.apiKey";
-static const char *VOICE_VOICETEXT_PARAMS_KEY = "voice.voicetext.params";
+static const SettingsKey VOICE_VOICETEXT_APIKEY_KEY{"voice.voicetext.apiKey"};
+static const SettingsKey VOICE_VOICETEXT_PARAMS_KEY{"voice.voicetext.params"};
 static const char *VOICE_VOICETEXT_PARAMS_DEFAULT = "speaker=hikari&speed=120&pitch=130&emotion=happiness";
-static const char *VOICE_TTS_QUEST_VOICEVOX_APIKEY_KEY = "voice.tts-quest-voicevox.apiKey";
-static const char *VOICE_TTS_QUEST_VOICEVOX_PARAMS_KEY = "voice.tts-quest-voicevox.params";
+static const SettingsKey VOICE_TTS_QUEST_VOICEVOX_APIKEY_KEY{"voice.tts-quest-voicevox.apiKey"};
+static const SettingsKey VOICE_TTS_QUEST_VOICEVOX_PARAMS_KEY{"voice.tts-quest-voicevox.params"};
 static const char *VOICE_TTS_QUEST_VOICEVOX_PARAMS_DEFAULT = "";
+static const SettingsKey VOICE_CACHE_SIZE_KEY{"voice.cache.size"};
+static const int VOICE_CACHE_SIZE_DEFAULT = 512 * 1024;
+static const SettingsKey VOICE_BUNDLE_ENABLE_KEY{"voice.bundle.enable"};
+static const bool VOICE_BUNDLE_ENABLE_DEFAULT = true;
 
-static const char *CHAT_OPENAI_APIKEY_KEY = "chat.openai.apiKey";
-static const char *CHAT_OPENAI_CHATGPT_MODEL_KEY = "chat.openai.model";
+static const SettingsKey CHAT_OPENAI_APIKEY_KEY{"chat.openai.apiKey"};
+static const SettingsKey CHAT_OPENAI_CHATGPT_MODEL_KEY{"chat.openai.model"};
 static const char *CHAT_OPENAI_CHATGPT_MODEL_DEFAULT = "gpt-3.5-turbo";
-static const char *CHAT_OPENAI_STREAM_KEY = "chat.openai.stream";
+static const SettingsKey CHAT_OPENAI_URL_KEY{"chat.openai.url"};
+static const char *CHAT_OPENAI_URL_DEFAULT = "https://api.openai.com/v1/chat/completions";
+static const SettingsKey CHAT_OPENAI_STREAM_KEY{"chat.openai.stream"};
 static const bool CHAT_OPENAI_STREAM_DEFAULT = false;
 static const char *CHAT_OPENAI_ROLES_KEY = "chat.openai.roles";
-static const char *CHAT_OPENAI_MAX_HISTORY_KEY = "chat.openai.maxHistory";
+static const SettingsKey CHAT_OPENAI_MAX_HISTORY_KEY{"chat.openai.maxHistory"};
 static const int CHAT_OPENAI_MAX_HISTORY_DEFAULT = 10;
-static const char *CHAT_RANDOM_INTERVAL_MIN_KEY = "chat.random.interval.min";
+static const SettingsKey CHAT_OPENAI_SAVE_HISTORY_KEY{"chat.openai.saveHistory"};
+static const bool CHAT_OPENAI_SAVE_HISTORY_DEFAULT = true;
+static const SettingsKey CHAT_OPENAI_SUMMARIZE_HISTORY_KEY{"chat.openai.summarizeHistory"};
+static const bool CHAT_OPENAI_SUMMARIZE_HISTORY_DEFAULT = true;
+static const SettingsKey CHAT_RANDOM_INTERVAL_MIN_KEY{"chat.random.interval.min"};
 static const int CHAT_RANDOM_INTERVAL_MIN_DEFAULT = 60;
-static const char *CHAT_RANDOM_INTERVAL_MAX_KEY = "chat.random.interval.min";
+static const SettingsKey CHAT_RANDOM_INTERVAL_MAX_KEY{"chat.random.interval.min"};
 static const int CHAT_RANDOM_INTERVAL_MAX_DEFAULT = 120;
-static const char *CHAT_RANDOM_QUESTIONS_KEY = "chat.random.questions";
-static const char *CHAT_CLOCK_HOURS_KEY = "chat.clock.hours";
+static const SettingsKey CHAT_RANDOM_QUESTIONS_KEY{"chat.random.questions"};
+static const SettingsKey CHAT_CLOCK_HOURS_KEY{"chat.clock.hours"};
 
 bool AppSettings::init() {
     auto settings = sdLoadString(APP_SETTINGS_SD_PATH);
@@ -99,100 +109,111 @@ std::pair<int, int> AppSettings::getServoPin() {
 }
 
 bool AppSettings::getSwingEnabled() {
-    return has(SWING_ENABLE_KEY) ? get(SWING_ENABLE_KEY) : SWING_ENABLE_DEFAULT;
+    return _getResolved(&ResolvedSettings::swingEnabled);
 }
 
 std::pair<int, int> AppSettings::getSwingHome() {
-    int homeX = get(SWING_HOME_X_KEY) | SWING_HOME_X_DEFAULT;
-    int homeY = get(SWING_HOME_Y_KEY) | SWING_HOME_Y_DEFAULT;
-    return std::make_pair(homeX, homeY);
+    return _getResolved(&ResolvedSettings::swingHome);
 }
 
 std::pair<int, int> AppSettings::getSwingRange() {
-    int homeX = get(SWING_RANGE_X_KEY) | SWING_RANGE_X_DEFAULT;
-    int homeY = get(SWING_RANGE_Y_KEY) | SWING_RANGE_Y_DEFAULT;
-    return std::make_pair(homeX, homeY);
+    return _getResolved(&ResolvedSettings::swingRange);
 }
 
 String AppSettings::getLang() {
-    String lang = get(VOICE_LANG_KEY) | VOICE_LANG_DEFAULT;
-    return lang.substring(0, 2); // en-US -> en
+    return _getResolved(&ResolvedSettings::lang);
+}
+
+Lang AppSettings::getLanguage() {
+    return _getResolved(&ResolvedSettings::language);
 }
 
 uint8_t AppSettings::getVoiceVolume() {
-    return get(VOICE_VOLUME_KEY) | VOICE_VOLUME_DEFAULT;
+    return _getResolved(&ResolvedSettings::voiceVolume);
 }
 
 bool AppSettings::setVoiceVolume(uint8_t volume) {
-    return set(VOICE_VOLUME_KEY, (int) volume);
+    return set(VOICE_VOLUME_KEY.c_str(), (int) volume);
 }
 
-const char *AppSettings::getVoiceService() {
-    return get(VOICE_SERVICE_KEY) | VOICE_SERVICE_DEFAULT;
+String AppSettings::getVoiceService() {
+    return _getResolved(&ResolvedSettings::voiceService);
 }
 
 bool AppSettings::setVoiceService(const String &service) {
-    return set(VOICE_SERVICE_KEY, service);
+    return set(VOICE_SERVICE_KEY.c_str(), service);
 }
 
-const char *AppSettings::getVoiceTextApiKey() {
-    return get(VOICE_VOICETEXT_APIKEY_KEY);
+String AppSettings::getVoiceTextApiKey() {
+    return _getResolved(&ResolvedSettings::voiceTextApiKey);
 }
 
 bool AppSettings::setVoiceTextApiKey(const String &apiKey) {
     if (apiKey.isEmpty()) {
-        return remove(VOICE_VOICETEXT_APIKEY_KEY);
+        return remove(VOICE_VOICETEXT_APIKEY_KEY.c_str());
     } else {
-        return set(VOICE_VOICETEXT_APIKEY_KEY, apiKey);
+        return set(VOICE_VOICETEXT_APIKEY_KEY.c_str(), apiKey);
     }
 }
 
-const char *AppSettings::getVoiceTextParams() {
-    return get(VOICE_VOICETEXT_PARAMS_KEY) | VOICE_VOICETEXT_PARAMS_DEFAULT;
+String AppSettings::getVoiceTextParams() {
+    return _getResolved(&ResolvedSettings::voiceTextParams);
 }
 
 bool AppSettings::setVoiceTextParams(const String &params) {
-    return set(VOICE_VOICETEXT_PARAMS_KEY, params);
+    return set(VOICE_VOICETEXT_PARAMS_KEY.c_str(), params);
 }
 
-const char *AppSettings::getTtsQuestVoicevoxApiKey() {
-    return get(VOICE_TTS_QUEST_VOICEVOX_APIKEY_KEY);
+String AppSettings::getTtsQuestVoicevoxApiKey() {
+    return _getResolved(&ResolvedSettings::ttsQuestVoicevoxApiKey);
 }
 
 bool AppSettings::setTtsQuestVoicevoxApiKey(const String &apiKey) {
     if (apiKey.isEmpty()) {
-        return remove(VOICE_TTS_QUEST_VOICEVOX_APIKEY_KEY);
+        return remove(VOICE_TTS_QUEST_VOICEVOX_APIKEY_KEY.c_str());
     } else {
-        return set(VOICE_TTS_QUEST_VOICEVOX_APIKEY_KEY, apiKey);
+        return set(VOICE_TTS_QUEST_VOICEVOX_APIKEY_KEY.c_str(), apiKey);
     }
 }
 
-const char *AppSettings::getTtsQuestVoicevoxParams() {
-    return get(VOICE_TTS_QUEST_VOICEVOX_PARAMS_KEY) | VOICE_TTS_QUEST_VOICEVOX_PARAMS_DEFAULT;
+String AppSettings::getTtsQuestVoicevoxParams() {
+    return _getResolved(&ResolvedSettings::ttsQuestVoicevoxParams);
 }
 
 bool AppSettings::setTtsQuestVoicevoxParams(const String &params) {
-    return set(VOICE_TTS_QUEST_VOICEVOX_PARAMS_KEY, params);
+    return set(VOICE_TTS_QUEST_VOICEVOX_PARAMS_KEY.c_str(), params);
+}
+
+size_t AppSettings::getVoiceCacheSize() {
+    return get(VOICE_CACHE_SIZE_KEY) | VOICE_CACHE_SIZE_DEFAULT;
+}
+
+bool AppSettings::getVoiceBundleEnabled() {
+    return has(VOICE_BUNDLE_ENABLE_KEY) ? get(VOICE_BUNDLE_ENABLE_KEY) : VOICE_BUNDLE_ENABLE_DEFAULT;
 }
 
-const char *AppSettings::getOpenAiApiKey() {
-    return get(CHAT_OPENAI_APIKEY_KEY);
+String AppSettings::getOpenAiApiKey() {
+    return _getResolved(&ResolvedSettings::openAiApiKey);
 }
 
 bool AppSettings::setOpenAiApiKey(const String &apiKey) {
     if (apiKey.isEmpty()) {
-        return remove(CHAT_OPENAI_APIKEY_KEY);
+        return remove(CHAT_OPENAI_APIKEY_KEY.c_str());
     } else {
-        return set(CHAT_OPENAI_APIKEY_KEY, apiKey);
+        return set(CHAT_OPENAI_APIKEY_KEY.c_str(), apiKey);
     }
 }
 
-const char *AppSettings::getChatGptModel() {
-    return get(CHAT_OPENAI_CHATGPT_MODEL_KEY) | CHAT_OPENAI_CHATGPT_MODEL_DEFAULT;
+String AppSettings::getChatGptModel() {
+    return _getResolved(&ResolvedSettings::chatGptModel);
+}
+
+String AppSettings::getChatGptUrl() {
+    return _getResolved(&ResolvedSettings::chatGptUrl);
 }
 
 bool AppSettings::useChatGptStream() {
-    return get(CHAT_OPENAI_STREAM_KEY) | CHAT_OPENAI_STREAM_DEFAULT;
+    return _getResolved(&ResolvedSettings::chatGptStream);
 }
 
 std::vector<String> AppSettings::getChatRoles() {
@@ -208,27 +229,65 @@ bool AppSettings::clearRoles() {
 }
 
 int AppSettings::getMaxHistory() {
-    return get(CHAT_OPENAI_MAX_HISTORY_KEY) | CHAT_OPENAI_MAX_HISTORY_DEFAULT;
+    return _getResolved(&ResolvedSettings::maxHistory);
+}
+
+bool AppSettings::getChatHistorySaveEnabled() {
+    return has(CHAT_OPENAI_SAVE_HISTORY_KEY) ? get(CHAT_OPENAI_SAVE_HISTORY_KEY) : CHAT_OPENAI_SAVE_HISTORY_DEFAULT;
+}
+
+bool AppSettings::getChatHistorySummaryEnabled() {
+    return has(CHAT_OPENAI_SUMMARIZE_HISTORY_KEY) ? get(CHAT_OPENAI_SUMMARIZE_HISTORY_KEY)
+                                                   : CHAT_OPENAI_SUMMARIZE_HISTORY_DEFAULT;
 }
 
 bool AppSettings::isRandomSpeakEnabled() {
-    return has(CHAT_RANDOM_QUESTIONS_KEY);
+    return _getResolved(&ResolvedSettings::randomSpeakEnabled);
 }
 
 std::pair<int, int> AppSettings::getChatRandomInterval() {
-    int min = get(CHAT_RANDOM_INTERVAL_MIN_KEY) | CHAT_RANDOM_INTERVAL_MIN_DEFAULT;
-    int max = get(CHAT_RANDOM_INTERVAL_MAX_KEY) | CHAT_RANDOM_INTERVAL_MAX_DEFAULT;
-    return std::make_pair(min, max);
+    return _getResolved(&ResolvedSettings::chatRandomInterval);
 }
 
 std::vector<String> AppSettings::getChatRandomQuestions() {
-    return getArray<String>(CHAT_RANDOM_QUESTIONS_KEY);
+    return getArray<String>(CHAT_RANDOM_QUESTIONS_KEY.c_str());
 }
 
 bool AppSettings::isClockSpeakEnabled() {
-    return has(CHAT_CLOCK_HOURS_KEY);
+    return _getResolved(&ResolvedSettings::clockSpeakEnabled);
 }
 
 std::vector<int> AppSettings::getChatClockHours() {
-    return getArray<int>(CHAT_CLOCK_HOURS_KEY);
+    return getArray<int>(CHAT_CLOCK_HOURS_KEY.c_str());
+}
+
+/**
+ * Resolve frequently used settings from the json document (called with _resolvedLock)
+ *
+ * Strings are copied, so the values stay valid when the document is replaced.
+ */
+void AppSettings::_resolve() {
+    _resolved.swingEnabled = has(SWING_ENABLE_KEY) ? get(SWING_ENABLE_KEY) : SWING_ENABLE_DEFAULT;
+    _resolved.swingHome = std::make_pair(get(SWING_HOME_X_KEY) | SWING_HOME_X_DEFAULT,
+                                         get(SWING_HOME_Y_KEY) | SWING_HOME_Y_DEFAULT);
+    _resolved.swingRange = std::make_pair(get(SWING_RANGE_X_KEY) | SWING_RANGE_X_DEFAULT,
+                                          get(SWING_RANGE_Y_KEY) | SWING_RANGE_Y_DEFAULT);
+    String lang = get(VOICE_LANG_KEY) | VOICE_LANG_DEFAULT;
+    _resolved.lang = lang.substring(0, 2); // en-US -> en
+    _resolved.language = Lang::of(_resolved.lang.c_str());
+    _resolved.voiceVolume = get(VOICE_VOLUME_KEY) | VOICE_VOLUME_DEFAULT;
+    _resolved.voiceService = get(VOICE_SERVICE_KEY) | VOICE_SERVICE_DEFAULT;
+    _resolved.voiceTextApiKey = get(VOICE_VOICETEXT_APIKEY_KEY) | "";
+    _resolved.voiceTextParams = get(VOICE_VOICETEXT_PARAMS_KEY) | VOICE_VOICETEXT_PARAMS_DEFAULT;
+    _resolved.ttsQuestVoicevoxApiKey = get(VOICE_TTS_QUEST_VOICEVOX_APIKEY_KEY) | "";
+    _resolved.ttsQuestVoicevoxParams = get(VOICE_TTS_QUEST_VOICEVOX_PARAMS_KEY) | VOICE_TTS_QUEST_VOICEVOX_PARAMS_DEFAULT;
+    _resolved.openAiApiKey = get(CHAT_OPENAI_APIKEY_KEY) | "";
+    _resolved.chatGptModel = get(CHAT_OPENAI_CHATGPT_MODEL_KEY) | CHAT_OPENAI_CHATGPT_MODEL_DEFAULT;
+    _resolved.chatGptUrl = get(CHAT_OPENAI_URL_KEY) | CHAT_OPENAI_URL_DEFAULT;
+    _resolved.chatGptStream = get(CHAT_OPENAI_STREAM_KEY) | CHAT_OPENAI_STREAM_DEFAULT;
+    _resolved.maxHistory = get(CHAT_OPENAI_MAX_HISTORY_KEY) | CHAT_OPENAI_MAX_HISTORY_DEFAULT;
+    _resolved.randomSpeakEnabled = has(CHAT_RANDOM_QUESTIONS_KEY);
+    _resolved.chatRandomInterval = std::make_pair(get(CHAT_RANDOM_INTERVAL_MIN_KEY) | CHAT_RANDOM_INTERVAL_MIN_DEFAULT,
+                                                  get(CHAT_RANDOM_INTERVAL_MAX_KEY) | CHAT_RANDOM_INTERVAL_MAX_DEFAULT);
+    _resolved.clockSpeakEnabled = has(CHAT_CLOCK_HOURS_KEY);
 }
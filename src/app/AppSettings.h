@@ -3,19 +3,56 @@
 
 #include <memory>
 #include <utility>
+#include <Arduino.h>
+
+#include "app/lang.h"
 #include "lib/NvsSettings.h"
 
 #define NVS_NAMESPACE "AIStackchan-hrs"
 #define NVS_SETTINGS_KEY "settings"
 
+/// quiet period to write changed settings to NVS (ms) (0: write on every change)
+#if !defined(SETTINGS_WRITE_BEHIND_DELAY)
+#define SETTINGS_WRITE_BEHIND_DELAY 0
+#endif
+
 #define VOICE_SERVICE_GOOGLE_TRANSLATE_TTS "google-translate-tts"
 #define VOICE_SERVICE_GOOGLE_CLOUD_TTS "google-cloud-tts"
 #define VOICE_SERVICE_VOICETEXT "voicetext"
 #define VOICE_SERVICE_TTS_QUEST_VOICEVOX "tts-quest-voicevox"
 
+/**
+ * Settings resolved from the json document (used frequently)
+ *
+ * Empty string means not set.
+ */
+struct ResolvedSettings {
+    bool swingEnabled;
+    std::pair<int, int> swingHome;
+    std::pair<int, int> swingRange;
+    String lang;
+    Lang language;
+    uint8_t voiceVolume;
+    String voiceService;
+    String voiceTextApiKey;
+    String voiceTextParams;
+    String ttsQuestVoicevoxApiKey;
+    String ttsQuestVoicevoxParams;
+    String openAiApiKey;
+    String chatGptModel;
+    String chatGptUrl;
+    bool chatGptStream;
+    int maxHistory;
+    bool randomSpeakEnabled;
+    std::pair<int, int> chatRandomInterval;
+    bool clockSpeakEnabled;
+};
+
 class AppSettings : public NvsSettings {
 public:
-    explicit AppSettings() : NvsSettings(NVS_NAMESPACE, NVS_SETTINGS_KEY) {}
+    explicit AppSettings() : NvsSettings(NVS_NAMESPACE, NVS_SETTINGS_KEY) {
+        setWriteBehind(SETTINGS_WRITE_BEHIND_DELAY);
+    }
 
     bool init();
 
@@ -41,35 +78,43 @@ public:
 
     String getLang();
 
+    Lang getLanguage();
+
     uint8_t getVoiceVolume();
 
     bool setVoiceVolume(uint8_t volume);
 
-    const char *getVoiceService();
+    String getVoiceService();
 
     bool setVoiceService(const String &service);
 
-    const char *getVoiceTextApiKey();
+    String getVoiceTextApiKey();
 
     bool setVoiceTextApiKey(const String &apiKey);
 
-    const char *getVoiceTextParams();
+    String getVoiceTextParams();
 
     bool setVoiceTextParams(const String &params);
 
-    const char *getTtsQuestVoicevoxApiKey();
+    String getTtsQuestVoicevoxApiKey();
 
     bool setTtsQuestVoicevoxApiKey(const String &apiKey);
 
-    const char *getTtsQuestVoicevoxParams();
+    String getTtsQuestVoicevoxParams();
 
     bool setTtsQuestVoicevoxParams(const String &params);
 
-    const char *getOpenAiApiKey();
+    size_t getVoiceCacheSize();
+
+    bool getVoiceBundleEnabled();
+
+    String getOpenAiApiKey();
 
     bool setOpenAiApiKey(const String &apiKey);
 
-    const char *getChatGptModel();
+    String getChatGptModel();
+
+    String getChatGptUrl();
 
     bool useChatGptStream();
 
@@ -81,6 +126,10 @@ public:
 
     int getMaxHistory();
 
+    bool getChatHistorySaveEnabled();
+
+    bool getChatHistorySummaryEnabled();
+
     bool isRandomSpeakEnabled();
 
     std::pair<int, int> getChatRandomInterval();
@@ -90,6 +139,38 @@ public:
     bool isClockSpeakEnabled();
 
     std::vector<int> getChatClockHours();
+
+private:
+    SemaphoreHandle_t _resolvedLock = xSemaphoreCreateMutex();
+
+    bool _isResolved = false;
+
+    /// revision of the settings resolved
+    uint32_t _resolvedRevision = 0;
+
+    ResolvedSettings _resolved{};
+
+    void _resolve();
+
+    /**
+     * Get resolved value (resolve again if the settings have been changed)
+     *
+     * @param member member of ResolvedSettings
+     * @return value
+     */
+    template<class T>
+    T _getResolved(T ResolvedSettings::*member) {
+        xSemaphoreTake(_resolvedLock, portMAX_DELAY);
+        auto revision = getRevision();
+        if (!_isResolved || _resolvedRevision != revision) {
+            _resolve();
+            _isResolved = true;
+            _resolvedRevision = revision;
+        }
+        T value = _resolved.*member;
+        xSemaphoreGive(_resolvedLock);
+        return value;
+    }
 };
 
 #endif // !defined(APP_SETTINGS_H)
@@ -1,21 +1,43 @@
-#include <deque>
+#include <algorithm>
 #include <memory>
 #include <Arduino.h>
 #include <AudioFileSourceBuffer.h>
 #include <AudioGeneratorMP3.h>
 #include <M5Unified.h>
+#include <SPIFFS.h>
+#include <WiFi.h>
 
 #include "app/AppVoice.h"
+#include "app/lang.h"
+#include "lib/AudioBundle.h"
+#include "lib/AudioCache.h"
 #include "lib/AudioFileSourceGoogleTranslateTts.h"
+#include "lib/AudioFileSourcePrefetch.h"
 #include "lib/AudioFileSourceTtsQuestVoicevox.h"
 #include "lib/AudioFileSourceVoiceText.h"
 #include "lib/AudioOutputM5Speaker.hpp"
+#include "lib/SentenceSegmenter.h"
+#include "lib/VisemeAnalyzer.h"
+#include "lib/arena.h"
+#include "lib/spiffs.h"
 #include "lib/url.h"
 #include "lib/utils.h"
 
 /// size for audio buffer
 static const int BUFFER_SIZE = 16 * 1024;
 
+/// directory to cache synthesized audio
+static const char *VOICE_CACHE_DIR = "/tts";
+
+/// file of canned phrases audio
+static const char *VOICE_BUNDLE_PATH = "/phrases.bin";
+
+/// time for the settings to stay unchanged before building the bundle (ms)
+static const unsigned long VOICE_BUNDLE_SETTLE_TIME = 30000;
+
+/// interval to retry building the bundle after failure (ms)
+static const int VOICE_BUNDLE_RETRY_INTERVAL = 10 * 60 * 1000;
+
 /// parameters for VoiceText
 const static char *VOICETEXT_VOICE_PARAMS[] = {
         "speaker=takeru&speed=100&pitch=130&emotion=happiness&emotion_level=4",
@@ -28,11 +50,34 @@ const static char *VOICETEXT_VOICE_PARAMS[] = {
 bool AppVoice::init() {
     _audioMp3 = std::make_unique<AudioGeneratorMP3>();
 
-    _allocatedBuffer = std::unique_ptr<uint8_t>((uint8_t *) malloc(BUFFER_SIZE));
+    _allocatedBuffer = std::unique_ptr<uint8_t, ArenaDeleter>((uint8_t *) arenaAlloc(Arena::Large, BUFFER_SIZE));
     if (!_allocatedBuffer) {
         M5.Display.printf("FATAL: Unable to allocate buffer");
         return false;
     }
+    if (!_audioOut.init()) {
+        M5.Display.printf("FATAL: Unable to allocate audio output buffer");
+        return false;
+    }
+
+    auto cacheSize = _settings->getVoiceCacheSize();
+    auto bundleEnabled = _settings->getVoiceBundleEnabled();
+    if (cacheSize > 0 || bundleEnabled) {
+        if (spiffsBegin()) {
+            if (cacheSize > 0) {
+                _cache = std::make_unique<AudioCache>(SPIFFS, VOICE_CACHE_DIR, cacheSize);
+                if (!_cache->begin()) {
+                    _cache = nullptr;
+                }
+            }
+            if (bundleEnabled) {
+                _bundle = std::make_unique<AudioBundle>(SPIFFS, VOICE_BUNDLE_PATH);
+                _bundle->begin();
+            }
+        } else {
+            Serial.println("ERROR: Failed to mount SPIFFS, voice cache is disabled");
+        }
+    }
 
     return true;
 }
@@ -63,10 +108,72 @@ void AppVoice::start() {
             &_taskHandle,
             APP_CPU_NUM
     );
+    xTaskCreatePinnedToCore(
+            [](void *arg) {
+                auto *self = (AppVoice *) arg;
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "EndlessLoop"
+                while (true) {
+                    self->_prefetchLoop();
+                }
+#pragma clang diagnostic pop
+            },
+            "AppVoicePrefetch",
+            8192,
+            this,
+            1,
+            &_prefetchTaskHandle,
+            APP_CPU_NUM
+    );
+    xTaskCreatePinnedToCore(
+            [](void *arg) {
+                auto *self = (AppVoice *) arg;
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "EndlessLoop"
+                while (true) {
+                    self->_outputLoop();
+                }
+#pragma clang diagnostic pop
+            },
+            "AppVoiceOutput",
+            4096,
+            this,
+            2,
+            &_outputTaskHandle,
+            APP_CPU_NUM
+    );
+    _audioOut.setTasks(_taskHandle, _outputTaskHandle);
+    if (_bundle != nullptr) {
+        // the bundle is checked again when the settings are changed
+        _settings->setOnChanged([this] {
+            if (_bundleTaskHandle != nullptr) {
+                xTaskNotifyGive(_bundleTaskHandle);
+            }
+        });
+        xTaskCreatePinnedToCore(
+                [](void *arg) {
+                    auto *self = (AppVoice *) arg;
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "EndlessLoop"
+                    while (true) {
+                        self->_bundleLoop();
+                    }
+#pragma clang diagnostic pop
+                },
+                "AppVoiceBundle",
+                8192,
+                this,
+                0,
+                &_bundleTaskHandle,
+                APP_CPU_NUM
+        );
+    }
 }
 
+/// RMS level treated as silence
 static const int LEVEL_MIN = 100;
-static const int LEVEL_MAX = 15000;
+/// RMS level to open mouth fully
+static const int LEVEL_MAX = 10000;
 
 /**
  * Get audio level
@@ -74,9 +181,7 @@ static const int LEVEL_MAX = 15000;
  * @return audio level (0.0-1.0)
  */
 float AppVoice::getAudioLevel() {
-    xSemaphoreTake(_lock, portMAX_DELAY);
-    int level = abs(*_audioOut.getBuffer());
-    xSemaphoreGive(_lock);
+    int level = _audioOut.getLevel();
     if (level < LEVEL_MIN) {
         level = 0;
     } else if (level > LEVEL_MAX) {
@@ -85,16 +190,82 @@ float AppVoice::getAudioLevel() {
     return (float) level / LEVEL_MAX;
 }
 
+/**
+ * Get mouth open ratio for the voice heard now
+ *
+ * @return open ratio (0.0-1.0)
+ */
+float AppVoice::getMouthOpenRatio() {
+    VisemeEvent event{};
+    if (!_audioOut.getViseme(event)) {
+        return 0;
+    }
+    float shape;
+    switch (event.viseme) {
+        case Viseme::Open:
+            shape = 1.0f;
+            break;
+        case Viseme::Round:
+            shape = 0.7f;
+            break;
+        case Viseme::Wide:
+            shape = 0.5f;
+            break;
+        case Viseme::Fricative:
+            shape = 0.2f;
+            break;
+        default:
+            return 0;
+    }
+    int level = event.level << 7;
+    if (level < LEVEL_MIN) {
+        return 0;
+    }
+    return shape * (float) std::min(level, LEVEL_MAX) / LEVEL_MAX;
+}
+
 /**
  * Check if voice is playing
  *
  * @return true: playing, false: not playing
  */
 bool AppVoice::isPlaying() {
+    return _isPlaying;
+}
+
+/**
+ * Check if voice is playing or going to play
+ *
+ * @return true: speaking, false: idle
+ */
+bool AppVoice::isSpeaking() {
+    return _queue.isStarting() || _isPlaying || _queue.size() > 0;
+}
+
+/**
+ * Get statistics
+ *
+ * @return statistics
+ */
+VoiceStats AppVoice::getStats() {
     xSemaphoreTake(_lock, portMAX_DELAY);
-    auto result = _audioMp3->isRunning();
+    auto stats = _stats;
     xSemaphoreGive(_lock);
-    return result;
+    stats.underrunCount = _audioOut.getUnderrunCount();
+    stats.overrunCount = _audioOut.getOverrunCount();
+    return stats;
+}
+
+/**
+ * Get statistics of the voice cache
+ *
+ * @return statistics (all zero if the cache is disabled)
+ */
+AudioCache::Stats AppVoice::getCacheStats() {
+    if (_cache == nullptr) {
+        return {};
+    }
+    return _cache->getStats();
 }
 
 /**
@@ -104,8 +275,8 @@ bool AppVoice::isPlaying() {
  * @return true: success, false: failure
  */
 bool AppVoice::setVoiceName(const String &voiceName) {
-    if (strcasecmp(_settings->getVoiceService(), VOICE_SERVICE_VOICETEXT) == 0) {
-        auto params = qsParse(_settings->getVoiceTextParams());
+    if (strcasecmp(_settings->getVoiceService().c_str(), VOICE_SERVICE_VOICETEXT) == 0) {
+        auto params = qsParse(_settings->getVoiceTextParams().c_str());
         int voiceNum = std::stoi(voiceName.c_str());
         if (voiceNum >= 0 && voiceNum <= 4) {
             for (const auto &item: qsParse(VOICETEXT_VOICE_PARAMS[voiceNum])) {
@@ -115,8 +286,8 @@ bool AppVoice::setVoiceName(const String &voiceName) {
         } else {
             return false;
         }
-    } else if (strcasecmp(_settings->getVoiceService(), VOICE_SERVICE_TTS_QUEST_VOICEVOX) == 0) {
-        auto params = qsParse(_settings->getTtsQuestVoicevoxParams());
+    } else if (strcasecmp(_settings->getVoiceService().c_str(), VOICE_SERVICE_TTS_QUEST_VOICEVOX) == 0) {
+        auto params = qsParse(_settings->getTtsQuestVoicevoxParams().c_str());
         params["speaker"] = voiceName.c_str();
         return _settings->setTtsQuestVoicevoxParams(qsBuild(params).c_str());
     } else {
@@ -128,85 +299,364 @@ bool AppVoice::setVoiceName(const String &voiceName) {
  * Start speaking text
  *
  * @param text text
+ * @param voiceName voice name
+ * @param requestTime time when the speech was requested, to measure time to first audio (0: not measured)
  */
-void AppVoice::speak(const String &text, const String &voiceName) {
-    xSemaphoreTake(_lock, portMAX_DELAY);
-    // add each sentence to message list
-    for (const auto &sentence: splitSentence(text.c_str())) {
-        _speechMessages.push_back(std::make_unique<SpeechMessage>(sentence.c_str(), voiceName));
+void AppVoice::speak(const String &text, const String &voiceName, unsigned long requestTime) {
+    // split into sentences to synthesize each in order
+    std::vector<std::shared_ptr<SpeechMessage>> messages;
+    SentenceSegmenter segmenter(VOICE_SENTENCE_MAX_LENGTH);
+    auto onSentence = [&](const String &sentence) {
+        messages.push_back(std::make_shared<SpeechMessage>(sentence, voiceName));
+    };
+    segmenter.feed(text.c_str(), text.length(), onSentence);
+    segmenter.flush(onSentence);
+    if (messages.empty()) {
+        return;
     }
-    xSemaphoreGive(_lock);
+    messages.front()->requestTime = requestTime;
+    messages.front()->idleStart = !isSpeaking();
+
+    _queue.push(messages);
+    _notify();
+}
+
+/**
+ * Start speaking canned phrase
+ *
+ * The phrase is played from the bundle if all segments are bundled.
+ *
+ * @param segments segments of the phrase
+ * @param voiceName voice name
+ */
+void AppVoice::speakPhrase(const std::vector<String> &segments, const String &voiceName) {
+    String text;
+    for (const auto &segment: segments) {
+        if (!text.isEmpty()) {
+            text += " ";
+        }
+        text += segment;
+    }
+    if (text.isEmpty()) {
+        return;
+    }
+    auto message = std::make_shared<SpeechMessage>(text, voiceName);
+    message->segments = segments;
+    message->idleStart = !isSpeaking();
+    _queue.push({message});
+    _notify();
 }
 
 /**
  * Stop speaking
  */
 void AppVoice::stopSpeak() {
-    xSemaphoreTake(_lock, portMAX_DELAY);
-    _isRunning = false;
-    _speechMessages.clear();
-    xSemaphoreGive(_lock);
+    _queue.stop();
+    _notify();
+}
+
+/**
+ * Wake up the voice and prefetch tasks to handle queued messages
+ */
+void AppVoice::_notify() {
+    if (_taskHandle != nullptr) {
+        xTaskNotifyGive(_taskHandle);
+    }
+    if (_prefetchTaskHandle != nullptr) {
+        xTaskNotifyGive(_prefetchTaskHandle);
+    }
+}
+
+/**
+ * Set callback on finish speaking all messages (called from voice task)
+ *
+ * @param onFinished callback
+ */
+void AppVoice::setOnFinished(const std::function<void()> &onFinished) {
+    _onFinished = onFinished;
+}
+
+/**
+ * Get speech service and parameters from settings
+ *
+ * @param voice voice name (empty: default)
+ * @param params [out] parameters for speech service
+ * @return speech service
+ */
+const char *AppVoice::_getVoiceParams(const String &voice, UrlParams &params) {
+    if (strcasecmp(_settings->getVoiceService().c_str(), VOICE_SERVICE_TTS_QUEST_VOICEVOX) == 0) {
+        // TTS QUEST VOICEVOX API
+        params = qsParse(_settings->getTtsQuestVoicevoxParams().c_str());
+        if (!voice.isEmpty()) {
+            params["speaker"] = voice.c_str();
+        }
+        return VOICE_SERVICE_TTS_QUEST_VOICEVOX;
+    } else if (strcasecmp(_settings->getVoiceService().c_str(), VOICE_SERVICE_VOICETEXT) == 0
+               && !_settings->getVoiceTextApiKey().isEmpty()) {
+        // VoiceText API
+        params = qsParse(_settings->getVoiceTextParams().c_str());
+        if (!voice.isEmpty()) {
+            int voiceNum = std::stoi(voice.c_str());
+            if (voiceNum >= 0 && voiceNum <= 4) {
+                for (const auto &item: qsParse(VOICETEXT_VOICE_PARAMS[voiceNum])) {
+                    params[item.first] = item.second;
+                }
+            }
+        }
+        return VOICE_SERVICE_VOICETEXT;
+    } else {
+        // Google Translate TTS
+        params["tl"] = _settings->getLang().c_str();
+        return VOICE_SERVICE_GOOGLE_TRANSLATE_TTS;
+    }
+}
+
+/**
+ * Get key of the bundle for current settings
+ *
+ * @return key
+ */
+String AppVoice::_getBundleKey() {
+    UrlParams params;
+    auto service = _getVoiceParams("", params);
+    return AudioCache::makeKey(service, params, _settings->getLang().c_str());
+}
+
+/**
+ * Request to the speech service
+ *
+ * @param service speech service
+ * @param params parameters for speech service
+ * @param text text
+ * @return audio source
+ */
+std::unique_ptr<AudioFileSourceHttp> AppVoice::_createHttpSource(
+        const char *service, const UrlParams &params, const String &text) {
+    if (strcmp(service, VOICE_SERVICE_TTS_QUEST_VOICEVOX) == 0) {
+        return std::unique_ptr<AudioFileSourceHttp>(new AudioFileSourceTtsQuestVoicevox(
+                _pool, _settings->getTtsQuestVoicevoxApiKey(), text.c_str(), params));
+    } else if (strcmp(service, VOICE_SERVICE_VOICETEXT) == 0) {
+        return std::unique_ptr<AudioFileSourceHttp>(new AudioFileSourceVoiceText(
+                _pool, _settings->getVoiceTextApiKey(), text.c_str(), params));
+    } else {
+        return std::unique_ptr<AudioFileSourceHttp>(new AudioFileSourceGoogleTranslateTts(
+                _pool, text.c_str(), params));
+    }
+}
+
+/**
+ * Create audio source for the message (from the bundle, the cache or request to the speech service)
+ *
+ * @param message message
+ * @return audio source
+ */
+std::unique_ptr<AudioFileSource> AppVoice::_createAudioSource(const SpeechMessage &message) {
+    if (_bundle != nullptr && !message.segments.empty() && message.voice.isEmpty()
+        && _bundle->getKey() == _getBundleKey()) {
+        auto bundled = _bundle->open(message.segments);
+        if (bundled != nullptr) {
+            return bundled;
+        }
+    }
+
+    UrlParams params;
+    auto service = _getVoiceParams(message.voice, params);
+    String key;
+    if (_cache != nullptr) {
+        key = AudioCache::makeKey(service, params, message.text.c_str());
+        auto cached = _cache->open(key);
+        if (cached != nullptr) {
+            return cached;
+        }
+    }
+
+    auto source = _createHttpSource(service, params, message.text);
+    if (_cache != nullptr) {
+        return _cache->store(key, std::move(source));
+    }
+    return std::move(source);
+}
+
+/**
+ * Move decoded audio to the speaker
+ */
+void AppVoice::_outputLoop() {
+    auto wait = _audioOut.pump();
+    if (wait > 0) {
+        ulTaskNotifyTake(pdTRUE, wait);
+    }
 }
 
 void AppVoice::_loop() {
-    xSemaphoreTake(_lock, portMAX_DELAY);
-    auto isRunning = _isRunning;
-    xSemaphoreGive(_lock);
+    bool isRunning = _queue.isRunning();
 
-    if (_audioMp3->isRunning()) { // playing
+    if (_audioMp3->isRunning()) { // decoding
+        if (isRunning && !_audioOut.isReady()) {
+            // decoded enough ahead, notified when drained to the low watermark
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+            return;
+        }
         if (!isRunning || !_audioMp3->loop()) {
+            // the output task plays the rest
             _audioMp3->stop();
-            Serial.println("voice stop");
+        }
+    } else if (_audioOut.isActive()) { // playing the rest
+        if (!isRunning) {
+            _audioOut.cancel();
+        }
+        // notified when finished
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    } else if (_isPlaying) {
+        _isPlaying = false;
+        if (_bundleTaskHandle != nullptr) {
+            xTaskNotifyGive(_bundleTaskHandle);
+        }
+        auto finished = !isRunning || _queue.size() == 0;
+        _gapStartTime = finished ? 0 : millis();
+        Serial.println("voice stop");
+        if (finished && _onFinished != nullptr) {
+            _onFinished();
         }
     } else {
-        // Get next message and start playing
-        xSemaphoreTake(_lock, portMAX_DELAY);
-        std::unique_ptr<SpeechMessage> message = nullptr;
-        if (!_speechMessages.empty()) {
-            message = std::move(_speechMessages.front());
-            _speechMessages.pop_front();
-        }
-        xSemaphoreGive(_lock);
+        // Get next message and start playing (running until stopped)
+        auto message = _queue.take();
+        if (message != nullptr && _prefetchTaskHandle != nullptr) {
+            // next message can be prefetched
+            xTaskNotifyGive(_prefetchTaskHandle);
+        }
         if (message != nullptr) {
-            xSemaphoreTake(_lock, portMAX_DELAY);
-            _isRunning = true;
-            xSemaphoreGive(_lock);
             M5.Speaker.setVolume(_settings->getVoiceVolume());
             M5.Speaker.setChannelVolume(_speakerChannel, _settings->getVoiceVolume());
-            if (strcasecmp(_settings->getVoiceService(), VOICE_SERVICE_TTS_QUEST_VOICEVOX) == 0) {
-                // TTS QUEST VOICEVOX API
-                auto params = qsParse(_settings->getTtsQuestVoicevoxParams());
-                if (!message->voice.isEmpty()) {
-                    params["speaker"] = message->voice.c_str();
-                }
-                _audioSource = std::make_unique<AudioFileSourceTtsQuestVoicevox>(
-                        _settings->getTtsQuestVoicevoxApiKey(), message->text.c_str(), params);
-            } else if (strcasecmp(_settings->getVoiceService(), VOICE_SERVICE_VOICETEXT) == 0
-                       && _settings->getVoiceTextApiKey() != nullptr) {
-                // VoiceText API
-                auto params = qsParse(_settings->getVoiceTextParams());
-                if (!message->voice.isEmpty()) {
-                    int voiceNum = std::stoi(message->voice.c_str());
-                    if (voiceNum >= 0 && voiceNum <= 4) {
-                        for (const auto &item: qsParse(VOICETEXT_VOICE_PARAMS[voiceNum])) {
-                            params[item.first] = item.second;
-                        }
-                    }
-                }
-                _audioSource = std::unique_ptr<AudioFileSource>(new AudioFileSourceVoiceText(
-                        _settings->getVoiceTextApiKey(), message->text.c_str(), params));
-            } else {
-                // Google Translate TTS
-                UrlParams params;
-                params["tl"] = _settings->getLang().c_str();
-                _audioSource = std::unique_ptr<AudioFileSource>(new AudioFileSourceGoogleTranslateTts(
-                        message->text.c_str(), params));
+
+            // Take over the prefetched source (wait for the request in progress)
+            std::unique_ptr<AudioFileSource> source;
+            while (!_queue.takeSource(*message, source)) {
+                // notified when prefetched
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
             }
+            bool prefetched = source != nullptr;
+            if (!prefetched) {
+                source = _createAudioSource(*message);
+            }
+            _audioSource = std::move(source);
             _audioSourceBuffer = std::make_unique<AudioFileSourceBuffer>(
                     _audioSource.get(), _allocatedBuffer.get(), BUFFER_SIZE);
             _audioMp3->begin(_audioSourceBuffer.get(), &_audioOut);
-            Serial.printf("voice start: %s\n", message->text.c_str());
+            _isPlaying = _audioMp3->isRunning();
+            if (!_isPlaying) {
+                _audioOut.stop();
+            }
+            _queue.finishStart();
+            Serial.printf("voice start: %s%s\n", message->text.c_str(), prefetched ? " (prefetched)" : "");
+            // failed to start the last message
+            auto finished = !_isPlaying && _queue.size() == 0;
+
+            xSemaphoreTake(_lock, portMAX_DELAY);
+            if (prefetched) {
+                _stats.prefetchHits++;
+            }
+            if (message->idleStart) {
+                auto elapsed = (uint32_t) (millis() - message->queuedTime);
+                _stats.idleStartCount++;
+                _stats.idleStartTimeTotal += elapsed;
+                _stats.idleStartTimeMax = std::max(_stats.idleStartTimeMax, elapsed);
+            }
+            if (message->requestTime != 0) {
+                auto elapsed = (uint32_t) (millis() - message->requestTime);
+                _stats.firstAudioCount++;
+                _stats.firstAudioTimeTotal += elapsed;
+                _stats.firstAudioTimeMax = std::max(_stats.firstAudioTimeMax, elapsed);
+                Serial.printf("voice time to first audio: %d ms\n", (int) elapsed);
+            }
+            if (_gapStartTime != 0) {
+                auto gap = (uint32_t) (millis() - _gapStartTime);
+                _stats.gapCount++;
+                _stats.gapTimeTotal += gap;
+                _stats.gapTimeMax = std::max(_stats.gapTimeMax, gap);
+                _gapStartTime = 0;
+            }
+            xSemaphoreGive(_lock);
+            if (finished && _onFinished != nullptr) {
+                _onFinished();
+            }
+        } else {
+            // Sleep until a message is queued
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+    }
+}
+
+/**
+ * Synthesize queued messages in advance while playing
+ */
+void AppVoice::_prefetchLoop() {
+    // Find the message to prefetch
+    auto message = _queue.prefetch(VOICE_PREFETCH_NUM);
+    if (message == nullptr) {
+        // Sleep until a message is queued or taken to play
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        return;
+    }
+
+    auto source = std::make_unique<AudioFileSourcePrefetch>(
+            _createAudioSource(*message), VOICE_PREFETCH_BUFFER_SIZE);
+    // Buffer until full, or until the message is cancelled or wanted to play
+    auto length = source->fill([&] {
+        return _queue.isWanted(*message);
+    });
+    Serial.printf("voice prefetched: %s (%d bytes)\n", message->text.c_str(), (int) length);
+
+    _queue.setPrefetched(*message, std::move(source));
+    if (_taskHandle != nullptr) {
+        // voice task may be waiting for this
+        xTaskNotifyGive(_taskHandle);
+    }
+}
+
+/**
+ * Build the bundle of canned phrases if not built for current settings
+ */
+void AppVoice::_bundleLoop() {
+    auto key = _getBundleKey();
+    if (_bundle->getKey() == key) {
+        // Sleep until the settings are changed
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        return;
+    }
+
+    // Wait until the settings stay unchanged, not to synthesize all phrases again on every change
+    auto revision = _settings->getRevision();
+    auto changedTime = millis();
+    unsigned long elapsed;
+    while ((elapsed = millis() - changedTime) < VOICE_BUNDLE_SETTLE_TIME) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(VOICE_BUNDLE_SETTLE_TIME - elapsed));
+        if (_settings->getRevision() != revision) {
+            revision = _settings->getRevision();
+            changedTime = millis();
+        }
+    }
+    if (WiFi.status() != WL_CONNECTED) {
+        return; // checked again after the settle time
+    }
+    key = _getBundleKey();
+    if (_bundle->getKey() == key) {
+        return;
+    }
+    auto lang = _settings->getLanguage();
+    auto phrases = cannedPhrases(lang);
+    Serial.printf("AudioBundle: building %d phrases (lang=%s)\n", (int) phrases.size(), lang.code());
+    UrlParams params;
+    auto service = _getVoiceParams("", params);
+    auto built = _bundle->build(key, phrases, [&](const String &text) {
+        return _createHttpSource(service, params, text);
+    }, [&] {
+        // stop if settings are changed, wait while speaking (notified when playing is finished)
+        while (isPlaying()) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
         }
-        delay(200);
+        return _getBundleKey() == key;
+    });
+    if (!built) {
+        delay(VOICE_BUNDLE_RETRY_INTERVAL);
     }
 }
@@ -1,27 +1,71 @@
 #if !defined(APP_VOICE_H)
 #define APP_VOICE_H
 
-#include <deque>
+#include <atomic>
+#include <vector>
 #include <utility>
 #include <AudioFileSourceBuffer.h>
 #include <AudioGeneratorMP3.h>
 
 #include "app/AppSettings.h"
+#include "lib/AudioBundle.h"
+#include "lib/AudioCache.h"
 #include "lib/AudioFileSourceVoiceText.h"
 #include "lib/AudioOutputM5Speaker.hpp"
-
-class SpeechMessage {
+#include "lib/ConnectionPool.h"
+#include "lib/SpeechQueue.h"
+#include "lib/arena.h"
+
+/// number of queued messages to synthesize in advance
+#if !defined(VOICE_PREFETCH_NUM)
+#define VOICE_PREFETCH_NUM 1
+#endif
+
+/// size of audio to buffer in advance per message
+#if !defined(VOICE_PREFETCH_BUFFER_SIZE)
+#define VOICE_PREFETCH_BUFFER_SIZE (8 * 1024)
+#endif
+
+/// length to break long sentence (bytes)
+#if !defined(VOICE_SENTENCE_MAX_LENGTH)
+#define VOICE_SENTENCE_MAX_LENGTH 150
+#endif
+
+class VoiceStats {
 public:
-    SpeechMessage(String text, String voice) : text(std::move(text)), voice(std::move(voice)) {};
-    String text;
-    String voice;
+    /// number of gaps between queued sentences
+    uint32_t gapCount = 0;
+    /// total time of gaps (ms)
+    uint32_t gapTimeTotal = 0;
+    /// max time of gaps (ms)
+    uint32_t gapTimeMax = 0;
+    /// number of sentences played from prefetched source
+    uint32_t prefetchHits = 0;
+    /// number of measured requests from request to first audio
+    uint32_t firstAudioCount = 0;
+    /// total time from request to first audio (ms)
+    uint32_t firstAudioTimeTotal = 0;
+    /// max time from request to first audio (ms)
+    uint32_t firstAudioTimeMax = 0;
+    /// number of messages started from idle
+    uint32_t idleStartCount = 0;
+    /// total time from queued while idle to start playing (ms)
+    uint32_t idleStartTimeTotal = 0;
+    /// max time from queued while idle to start playing (ms)
+    uint32_t idleStartTimeMax = 0;
+    /// number of times the speaker ran out of data while playing
+    uint32_t underrunCount = 0;
+    /// number of times decoding paused because enough audio was decoded ahead
+    uint32_t overrunCount = 0;
 };
 
 class AppVoice {
 public:
     explicit AppVoice(
-            std::shared_ptr<AppSettings> settings
-    ) : _settings(std::move(settings)) {};
+            std::shared_ptr<AppSettings> settings,
+            std::shared_ptr<ConnectionPool> pool
+    ) : _settings(std::move(settings)),
+        _pool(std::move(pool)) {};
 
     bool init();
 
@@ -31,28 +75,64 @@ public:
 
     float getAudioLevel();
 
+    float getMouthOpenRatio();
+
     bool isPlaying();
 
+    bool isSpeaking();
+
+    VoiceStats getStats();
+
+    AudioCache::Stats getCacheStats();
+
     bool setVoiceName(const String &voiceName);
 
-    void speak(const String &text, const String &voiceName);
+    void speak(const String &text, const String &voiceName, unsigned long requestTime = 0);
+
+    void speakPhrase(const std::vector<String> &segments, const String &voiceName);
 
     void stopSpeak();
 
+    void setOnFinished(const std::function<void()> &onFinished);
+
 private:
     std::shared_ptr<AppSettings> _settings;
+    std::shared_ptr<ConnectionPool> _pool;
 
     TaskHandle_t _taskHandle{};
 
+    TaskHandle_t _prefetchTaskHandle{};
+
+    TaskHandle_t _outputTaskHandle{};
+
+    TaskHandle_t _bundleTaskHandle{};
+
+    /// guards _stats
     SemaphoreHandle_t _lock = xSemaphoreCreateMutex();
 
-    bool _isRunning{};
+    /// true: decoding or playing the rest (published for other tasks)
+    std::atomic<bool> _isPlaying{false};
 
     /// M5Speaker virtual channel (0-7)
     uint8_t _speakerChannel = 0;
 
-    /// message list to play
-    std::deque<std::unique_ptr<SpeechMessage>> _speechMessages;
+    /// messages to play
+    SpeechQueue _queue;
+
+    /// time when the previous sentence stopped with next one queued (0: none)
+    unsigned long _gapStartTime = 0;
+
+    /// statistics
+    VoiceStats _stats;
+
+    /// cache of synthesized audio (nullptr: disabled)
+    std::unique_ptr<AudioCache> _cache;
+
+    /// audio of canned phrases (nullptr: disabled)
+    std::unique_ptr<AudioBundle> _bundle;
+
+    /// callback on finish speaking all messages
+    std::function<void()> _onFinished;
 
     /// output speaker
     AudioOutputM5Speaker _audioOut{&M5.Speaker, _speakerChannel};
@@ -67,9 +147,26 @@ private:
     std::unique_ptr<AudioFileSourceBuffer> _audioSourceBuffer;
 
     /// buffer area for playing audio
-    std::unique_ptr<uint8_t> _allocatedBuffer;
+    std::unique_ptr<uint8_t, ArenaDeleter> _allocatedBuffer;
+
+    const char *_getVoiceParams(const String &voice, UrlParams &params);
+
+    String _getBundleKey();
+
+    std::unique_ptr<AudioFileSourceHttp> _createHttpSource(
+            const char *service, const UrlParams &params, const String &text);
+
+    std::unique_ptr<AudioFileSource> _createAudioSource(const SpeechMessage &message);
+
+    void _notify();
+
+    void _outputLoop();
 
     void _loop();
+
+    void _prefetchLoop();
+
+    void _bundleLoop();
 };
 
 #endif // !defined(APP_VOICE_H)
@@ -1,47 +1,123 @@
-#include <map>
-
-static const std::map<std::string, std::map<std::string, const char *>> clockSpeechMap = {
-        {
-                "en",
-                {
-                        {"apikey_not_set", "The API Key is not set"},
-                        {"clock_not_set", "The clock is not set"},
-                        {"clock_now", "It's %d %d"},
-                        {"clock_now_noon", "It's %d o'clock"},
-                        {"chat_thinking...", "Thinking..."},
-                        {"chat_i_dont_understand", "I don't understand"},
-                        {"chat_random_started", "The random speak mode started."},
-                        {"chat_random_stopped", "The random speak mode stopped."},
-                }
-        },
-        {
-                "ja",
-                {
-                        {"apikey_not_set", "API キーが設定されていません"},
-                        {"clock_not_set", "時刻が設定されていません"},
-                        {"clock_now", "%d時 %d分です"},
-                        {"clock_now_noon", "%d時 ちょうどです"},
-                        {"chat_thinking...", "考え中..."},
-                        {"chat_i_dont_understand", "わかりません"},
-                        {"chat_random_started", "ひとりごと始めます"},
-                        {"chat_random_stopped", "ひとりごとやめます"},
-                }
-        },
-        {
-                "ro",
-                {
-                        {"apikey_not_set", "Cheia API nu este setată"},
-                        {"clock_not_set", "Ceasul nu este setat"},
-                        {"clock_now", "Este ora %d și %d de minute"},
-                        {"clock_now_noon", "Este exact ora %d"},
-                        {"chat_thinking...", "Mă gândesc..."},
-                        {"chat_i_dont_understand", "Nu înțeleg"},
-                        {"chat_random_started", "Modul de vorbire aleatorie a început."},
-                        {"chat_random_stopped", "Modul de vorbire aleatorie s-a oprit."},
-                }
-        },
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+
+#include "app/lang.h"
+
+/// index of each language in Translation::texts
+enum LangIndex {
+    LANG_EN,
+    LANG_JA,
+    LANG_RO,
+    LANG_NUM,
+};
+
+/// language codes (ISO 639-1) by index
+static constexpr const char *LANG_CODES[LANG_NUM] = {"en", "ja", "ro"};
+
+struct Translation {
+    const char *key;
+    /// text for each language (nullptr: fallback to English)
+    const char *texts[LANG_NUM];
+};
+
+/// translations (must be sorted by key)
+static constexpr Translation TRANSLATIONS[] = {
+        {"apikey_not_set",         {"The API Key is not set",          "API キーが設定されていません", "Cheia API nu este setată"}},
+        {"chat_i_dont_understand", {"I don't understand",              "わかりません",               "Nu înțeleg"}},
+        {"chat_random_started",    {"The random speak mode started.",  "ひとりごと始めます",          "Modul de vorbire aleatorie a început."}},
+        {"chat_random_stopped",    {"The random speak mode stopped.",  "ひとりごとやめます",          "Modul de vorbire aleatorie s-a oprit."}},
+        {"chat_thinking...",       {"Thinking...",                     "考え中...",                 "Mă gândesc..."}},
+        {"clock_not_set",          {"The clock is not set",            "時刻が設定されていません",      "Ceasul nu este setat"}},
+        {"clock_now",              {"It's %d %d",                      "%d時 %d分です",              "Este ora %d și %d de minute"}},
+        {"clock_now_noon",         {"It's %d o'clock",                 "%d時 ちょうどです",           "Este exact ora %d"}},
 };
 
+static constexpr size_t TRANSLATIONS_NUM = sizeof(TRANSLATIONS) / sizeof(TRANSLATIONS[0]);
+
+static constexpr int compareKey(const char *a, const char *b) {
+    while (*a != '\0' && *a == *b) {
+        a++;
+        b++;
+    }
+    return (unsigned char) *a - (unsigned char) *b;
+}
+
+static constexpr bool isSorted() {
+    for (size_t i = 1; i < TRANSLATIONS_NUM; i++) {
+        if (compareKey(TRANSLATIONS[i - 1].key, TRANSLATIONS[i].key) >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(isSorted(), "TRANSLATIONS must be sorted by key");
+
+/**
+ * Find translation by key (binary search)
+ *
+ * @param key text key
+ * @return translation (nullptr: not found)
+ */
+static constexpr const Translation *findTranslation(const char *key) {
+    size_t low = 0;
+    size_t high = TRANSLATIONS_NUM;
+    while (low < high) {
+        auto mid = (low + high) / 2;
+        auto cmp = compareKey(TRANSLATIONS[mid].key, key);
+        if (cmp == 0) {
+            return &TRANSLATIONS[mid];
+        } else if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Get language from language code
+ *
+ * @param code language code (ISO 639-1, "en-US" is also accepted)
+ * @return language (English if not supported)
+ */
+Lang Lang::of(const char *code) {
+    for (int i = 0; i < LANG_NUM; i++) {
+        if (strncmp(code, LANG_CODES[i], 2) == 0) {
+            return Lang(i);
+        }
+    }
+    return Lang(LANG_EN);
+}
+
+/**
+ * Get language code
+ *
+ * @return language code (ISO 639-1)
+ */
+const char *Lang::code() const {
+    return LANG_CODES[_index];
+}
+
+/**
+ * Get text
+ *
+ * @param key text key
+ * @return text
+ */
+const char *Lang::t(const char *key) const {
+    auto translation = findTranslation(key);
+    if (translation == nullptr) {
+        return key; // unexpected
+    }
+    auto text = translation->texts[_index];
+    return text != nullptr ? text : translation->texts[LANG_EN];
+}
+
 /**
  * Get text from language code
  *
@@ -50,15 +126,75 @@ static const std::map<std::string, std::map<std::string, const char *>> clockSpe
  * @return text
  */
 const char *t(const char *lang, const char *key) {
-    if (clockSpeechMap.find(lang) != clockSpeechMap.end()) {
-        auto langMap = clockSpeechMap.at(lang);
-        if (langMap.find(key) != langMap.end()) {
-            return langMap.at(key);
+    return Lang::of(lang).t(key);
+}
+
+/// max length of the text to speak the time
+static const size_t CLOCK_SPEECH_MAX_LENGTH = 64;
+
+/**
+ * Get segments of the text to speak the time
+ *
+ * The text is split after the hour so that the segments can be played from the canned phrases.
+ *
+ * @param lang language
+ * @param hour hour
+ * @param minute minute
+ * @return segments
+ */
+std::vector<String> clockSpeechSegments(Lang lang, int hour, int minute) {
+    std::vector<String> segments;
+    if (minute == 0) {
+        char buf[CLOCK_SPEECH_MAX_LENGTH];
+        snprintf(buf, sizeof(buf), lang.t("clock_now_noon"), hour);
+        segments.push_back(String(buf));
+        return segments;
+    }
+    String format = lang.t("clock_now");
+    auto pos = format.indexOf("%d");
+    auto split = pos < 0 ? -1 : format.indexOf("%d", pos + 2);
+    if (split < 0) {
+        // unexpected
+        char buf[CLOCK_SPEECH_MAX_LENGTH];
+        snprintf(buf, sizeof(buf), format.c_str(), hour, minute);
+        segments.push_back(String(buf));
+        return segments;
+    }
+    auto hourFormat = format.substring(0, split);
+    auto minuteFormat = format.substring(split);
+    hourFormat.trim();
+    char buf[CLOCK_SPEECH_MAX_LENGTH];
+    snprintf(buf, sizeof(buf), hourFormat.c_str(), hour);
+    segments.push_back(String(buf));
+    snprintf(buf, sizeof(buf), minuteFormat.c_str(), minute);
+    segments.push_back(String(buf));
+    return segments;
+}
+
+/**
+ * Get all phrases to be spoken without the chat
+ *
+ * @param lang language
+ * @return phrases
+ */
+std::vector<String> cannedPhrases(Lang lang) {
+    std::vector<String> phrases;
+    std::set<std::string> found;
+    auto add = [&](const String &phrase) {
+        if (found.insert(phrase.c_str()).second) {
+            phrases.push_back(phrase);
         }
+    };
+    for (auto key: {"apikey_not_set", "clock_not_set", "chat_i_dont_understand",
+                    "chat_random_started", "chat_random_stopped"}) {
+        add(lang.t(key));
     }
-    auto defaultLangMap = clockSpeechMap.at("en");
-    if (defaultLangMap.find(key) != defaultLangMap.end()) {
-        return defaultLangMap.at(key);
+    for (int hour = 0; hour < 24; hour++) {
+        for (int minute = 0; minute < 60; minute++) {
+            for (const auto &segment: clockSpeechSegments(lang, hour, minute)) {
+                add(segment);
+            }
+        }
     }
-    return key; // unexpected
+    return phrases;
 }
@@ -1,6 +1,38 @@
-#if !defined(APP_LANG)
+#if !defined(APP_LANG_H)
 #define APP_LANG_H
 
+#include <vector>
+#include <Arduino.h>
+
+/**
+ * Language of texts (resolved from language code once)
+ */
+class Lang {
+public:
+    /// English
+    constexpr Lang() : _index(0) {}
+
+    static Lang of(const char *code);
+
+    const char *code() const;
+
+    const char *t(const char *key) const;
+
+    bool operator==(const Lang &other) const { return _index == other._index; }
+
+    bool operator!=(const Lang &other) const { return _index != other._index; }
+
+private:
+    constexpr explicit Lang(int index) : _index(index) {}
+
+    /// index in the translation table
+    int _index;
+};
+
 const char *t(const char *lang, const char *key);
 
+std::vector<String> clockSpeechSegments(Lang lang, int hour, int minute);
+
+std::vector<String> cannedPhrases(Lang lang);
+
 #endif // !defined(APP_LANG_H)
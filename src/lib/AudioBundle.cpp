@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <utility>
+#include <Arduino.h>
+#include <FS.h>
+
+#include "lib/AudioBundle.h"
+#include "lib/Mp3TagStripper.h"
+#include "lib/arena.h"
+
+/// mark at the end of the bundle file
+static const char BUNDLE_MAGIC[4] = {'A', 'B', 'N', '1'};
+
+/// length of the bundle key
+static const size_t BUNDLE_KEY_LENGTH = 16;
+
+/// size of the footer (key, count, table offset, magic)
+static const size_t BUNDLE_FOOTER_SIZE = BUNDLE_KEY_LENGTH + 4 + 4 + sizeof(BUNDLE_MAGIC);
+
+/// size of an index table entry (hash, offset, length)
+static const size_t BUNDLE_ENTRY_SIZE = 4 + 4 + 4;
+
+/// time to give up reading from the speech service (ms)
+static const unsigned long BUNDLE_READ_TIMEOUT = 10000;
+
+/// size to read at once on build
+static const size_t BUNDLE_READ_SIZE = 1024;
+
+/**
+ * Hash of the phrase (FNV-1a 32bit)
+ *
+ * @param text phrase
+ * @return hash
+ */
+static uint32_t hashText(const String &text) {
+    uint32_t hash = 2166136261UL;
+    for (const char *p = text.c_str(); *p != '\0'; p++) {
+        hash ^= (uint8_t) *p;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+static void writeUint32(File &file, uint32_t value) {
+    uint8_t buf[4] = {(uint8_t) value, (uint8_t) (value >> 8), (uint8_t) (value >> 16), (uint8_t) (value >> 24)};
+    file.write(buf, sizeof(buf));
+}
+
+static uint32_t readUint32(const uint8_t *buf) {
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t) buf[3] << 24);
+}
+
+/**
+ * Load the bundle file
+ *
+ * @return true: loaded, false: not exist or broken
+ */
+bool AudioBundle::begin() {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto result = _load();
+    xSemaphoreGive(_lock);
+    if (result) {
+        Serial.printf("AudioBundle: %d phrases (key=%s)\n", (int) _segments.size(), _key.c_str());
+    }
+    return result;
+}
+
+/**
+ * Get key of the loaded bundle
+ *
+ * @return key (empty: not loaded)
+ */
+String AudioBundle::getKey() {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto key = _key;
+    xSemaphoreGive(_lock);
+    return key;
+}
+
+/**
+ * Open audio of the phrases to play continuously
+ *
+ * @param texts phrases
+ * @return audio source (nullptr: any of phrases is not in the bundle)
+ */
+std::unique_ptr<AudioFileSource> AudioBundle::open(const std::vector<String> &texts) {
+    std::vector<Segment> segments;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    for (const auto &text: texts) {
+        auto it = _segments.find(hashText(text));
+        if (it == _segments.end()) {
+            xSemaphoreGive(_lock);
+            return nullptr;
+        }
+        segments.push_back(it->second);
+    }
+    auto file = segments.empty() ? File() : _fs.open(_path, FILE_READ);
+    if (file) {
+        _readers++;
+    }
+    xSemaphoreGive(_lock);
+    if (!file) {
+        return nullptr;
+    }
+    return std::unique_ptr<AudioFileSource>(new AudioFileSourceBundle(this, file, std::move(segments)));
+}
+
+/**
+ * Synthesize phrases and replace the bundle file
+ *
+ * @param key key of the bundle (speech service and parameters)
+ * @param texts phrases
+ * @param createSource callback to create audio source of the phrase
+ * @param shouldContinue called before each phrase, return false to stop building
+ * @return true: success, false: failure or stopped
+ */
+bool AudioBundle::build(const String &key, const std::vector<String> &texts,
+                        const std::function<std::unique_ptr<AudioFileSourceHttp>(const String &)> &createSource,
+                        const std::function<bool()> &shouldContinue) {
+    auto tmpPath = _path + ".tmp";
+    auto file = _fs.open(tmpPath, FILE_WRITE);
+    if (!file) {
+        Serial.printf("ERROR: Failed to open audio bundle for writing (path=%s)\n", tmpPath.c_str());
+        return false;
+    }
+    // written to flash from internal RAM
+    std::unique_ptr<uint8_t, ArenaDeleter> buf((uint8_t *) arenaAlloc(Arena::Internal, BUNDLE_READ_SIZE));
+    std::vector<std::pair<uint32_t, Segment>> table;
+    uint32_t offset = 0;
+    bool success = buf != nullptr;
+    for (const auto &text: texts) {
+        if (!success || !shouldContinue()) {
+            success = false;
+            break;
+        }
+        auto source = createSource(text);
+        // Phrases are concatenated into one decoder stream, so only MPEG frames are written
+        Mp3TagStripper writer([&file](const uint8_t *data, size_t len) {
+            return file.write(data, len) == len;
+        });
+        bool written = true;
+        auto lastRead = millis();
+        while (source->isOpen()) {
+            auto bytes = source->read(buf.get(), BUNDLE_READ_SIZE);
+            if (bytes > 0) {
+                if (!writer.feed(buf.get(), bytes)) {
+                    written = false;
+                    break; // no space
+                }
+                lastRead = millis();
+            } else if (source->getStatus() != AudioFileSourceHttp::ReadStatus::WouldBlock ||
+                       millis() - lastRead > BUNDLE_READ_TIMEOUT) {
+                break;
+            }
+        }
+        source->close();
+        if (!written || !source->isCompleted() || !writer.finish() || writer.length() == 0) {
+            Serial.printf("ERROR: Failed to synthesize phrase for audio bundle: %s\n", text.c_str());
+            success = false;
+            break;
+        }
+        table.emplace_back(hashText(text), Segment{offset, writer.length()});
+        offset += writer.length();
+    }
+    if (success) {
+        for (const auto &entry: table) {
+            writeUint32(file, entry.first);
+            writeUint32(file, entry.second.offset);
+            writeUint32(file, entry.second.length);
+        }
+        char keyBuf[BUNDLE_KEY_LENGTH]{};
+        memcpy(keyBuf, key.c_str(), std::min(key.length(), BUNDLE_KEY_LENGTH));
+        file.write((const uint8_t *) keyBuf, sizeof(keyBuf));
+        writeUint32(file, table.size());
+        writeUint32(file, offset);
+        success = file.write((const uint8_t *) BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) == sizeof(BUNDLE_MAGIC);
+    }
+    file.close();
+    if (!success) {
+        _fs.remove(tmpPath);
+        return false;
+    }
+
+    // Replace the file after playing audio is closed (notified by the last reader)
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    while (_readers > 0) {
+        _waitingTask = xTaskGetCurrentTaskHandle();
+        xSemaphoreGive(_lock);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        xSemaphoreTake(_lock, portMAX_DELAY);
+    }
+    _waitingTask = nullptr;
+    _fs.remove(_path);
+    success = _fs.rename(tmpPath, _path) && _load();
+    xSemaphoreGive(_lock);
+    if (success) {
+        Serial.printf("AudioBundle: built %d phrases (%d bytes)\n", (int) table.size(), (int) offset);
+    }
+    return success;
+}
+
+/**
+ * Load index table from the bundle file (called with _lock)
+ *
+ * @return true: loaded, false: not exist or broken
+ */
+bool AudioBundle::_load() {
+    _key = "";
+    _segments.clear();
+    if (!_fs.exists(_path)) {
+        return false;
+    }
+    auto file = _fs.open(_path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    auto size = file.size();
+    uint8_t footer[BUNDLE_FOOTER_SIZE];
+    if (size < BUNDLE_FOOTER_SIZE || !file.seek(size - BUNDLE_FOOTER_SIZE)
+        || file.read(footer, sizeof(footer)) != sizeof(footer)
+        || memcmp(footer + BUNDLE_FOOTER_SIZE - sizeof(BUNDLE_MAGIC), BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) != 0) {
+        Serial.printf("ERROR: Invalid audio bundle (path=%s)\n", _path.c_str());
+        return false;
+    }
+    auto count = readUint32(footer + BUNDLE_KEY_LENGTH);
+    auto tableOffset = readUint32(footer + BUNDLE_KEY_LENGTH + 4);
+    if (tableOffset + count * BUNDLE_ENTRY_SIZE + BUNDLE_FOOTER_SIZE != size || !file.seek(tableOffset)) {
+        Serial.printf("ERROR: Invalid audio bundle (path=%s)\n", _path.c_str());
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t entry[BUNDLE_ENTRY_SIZE];
+        if (file.read(entry, sizeof(entry)) != sizeof(entry)) {
+            _segments.clear();
+            return false;
+        }
+        _segments[readUint32(entry)] = {readUint32(entry + 4), readUint32(entry + 8)};
+    }
+    char key[BUNDLE_KEY_LENGTH + 1]{};
+    memcpy(key, footer, BUNDLE_KEY_LENGTH);
+    _key = key;
+    return true;
+}
+
+void AudioBundle::_closeReader() {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _readers--;
+    if (_readers == 0 && _waitingTask != nullptr) {
+        xTaskNotifyGive(_waitingTask);
+    }
+    xSemaphoreGive(_lock);
+}
+
+AudioFileSourceBundle::AudioFileSourceBundle(AudioBundle *bundle, File file, std::vector<AudioBundle::Segment> segments)
+        : _bundle(bundle), _file(std::move(file)), _segments(std::move(segments)) {}
+
+AudioFileSourceBundle::~AudioFileSourceBundle() {
+    close();
+}
+
+uint32_t AudioFileSourceBundle::read(void *data, uint32_t len) {
+    uint32_t total = 0;
+    while (total < len && isOpen()) {
+        const auto &segment = _segments[_index];
+        if (_segmentPos >= segment.length) {
+            // next segment
+            _index++;
+            _segmentPos = 0;
+            continue;
+        }
+        if (_segmentPos == 0 && !_file.seek(segment.offset)) {
+            close();
+            break;
+        }
+        auto bytes = _file.read((uint8_t *) data + total, std::min(len - total, segment.length - _segmentPos));
+        if (bytes == 0) {
+            close();
+            break;
+        }
+        _segmentPos += bytes;
+        _pos += bytes;
+        total += bytes;
+    }
+    if (_index >= _segments.size()) {
+        close();
+    }
+    return total;
+}
+
+bool AudioFileSourceBundle::seek(int32_t pos, int dir) {
+    return false;
+}
+
+bool AudioFileSourceBundle::close() {
+    if (_bundle != nullptr) {
+        _file.close();
+        _bundle->_closeReader();
+        _bundle = nullptr;
+    }
+    return true;
+}
+
+bool AudioFileSourceBundle::isOpen() {
+    return _bundle != nullptr && _index < _segments.size();
+}
+
+uint32_t AudioFileSourceBundle::getSize() {
+    uint32_t size = 0;
+    for (const auto &segment: _segments) {
+        size += segment.length;
+    }
+    return size;
+}
+
+uint32_t AudioFileSourceBundle::getPos() {
+    return _pos;
+}
@@ -0,0 +1,100 @@
+#if !defined(LIB_AUDIO_BUNDLE_H)
+#define LIB_AUDIO_BUNDLE_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include <Arduino.h>
+#include <AudioFileSource.h>
+#include <FS.h>
+
+#include "lib/AudioFileSourceHttp.h"
+
+/**
+ * Packed audio of canned phrases in one file
+ *
+ * File layout: audio data of each phrase, index table (hash, offset, length) and footer.
+ * The footer is written last, so an incomplete file is never loaded.
+ */
+class AudioBundle {
+public:
+    AudioBundle(fs::FS &fs, const char *path) : _fs(fs), _path(path) {};
+
+    bool begin();
+
+    String getKey();
+
+    std::unique_ptr<AudioFileSource> open(const std::vector<String> &texts);
+
+    bool build(const String &key, const std::vector<String> &texts,
+               const std::function<std::unique_ptr<AudioFileSourceHttp>(const String &)> &createSource,
+               const std::function<bool()> &shouldContinue);
+
+private:
+    friend class AudioFileSourceBundle;
+
+    struct Segment {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    fs::FS &_fs;
+    String _path;
+
+    SemaphoreHandle_t _lock = xSemaphoreCreateMutex();
+
+    /// key of the loaded bundle (empty: not loaded)
+    String _key;
+
+    /// segments by hash of text
+    std::map<uint32_t, Segment> _segments;
+
+    /// number of open sources reading the file
+    int _readers = 0;
+
+    /// task waiting for the readers to be closed (nullptr: none)
+    TaskHandle_t _waitingTask = nullptr;
+
+    bool _load();
+
+    void _closeReader();
+};
+
+/**
+ * Audio source to play segments in the bundle continuously
+ */
+class AudioFileSourceBundle : public AudioFileSource {
+public:
+    AudioFileSourceBundle(AudioBundle *bundle, File file, std::vector<AudioBundle::Segment> segments);
+
+    ~AudioFileSourceBundle() override;
+
+    uint32_t read(void *data, uint32_t len) override;
+
+    bool seek(int32_t pos, int dir) override;
+
+    bool close() override;
+
+    bool isOpen() override;
+
+    uint32_t getSize() override;
+
+    uint32_t getPos() override;
+
+private:
+    AudioBundle *_bundle;
+    File _file;
+    std::vector<AudioBundle::Segment> _segments;
+
+    /// index of the segment to read
+    size_t _index = 0;
+
+    /// read position in the segment
+    uint32_t _segmentPos = 0;
+
+    /// read position in total
+    uint32_t _pos = 0;
+};
+
+#endif // !defined(LIB_AUDIO_BUNDLE_H)
@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+#include <Arduino.h>
+#include <AudioFileSourceFS.h>
+#include <FS.h>
+
+#include "lib/AudioCache.h"
+
+/**
+ * Constructor
+ *
+ * @param fs file system
+ * @param dir directory to store audio files
+ * @param maxSize max total size of cached audio (bytes)
+ */
+AudioCache::AudioCache(fs::FS &fs, const char *dir, size_t maxSize) : _fs(fs), _dir(dir), _maxSize(maxSize) {}
+
+/**
+ * Load cached entries from the file system
+ *
+ * @return true: success, false: failure
+ */
+bool AudioCache::begin() {
+    if (!_fs.exists(_dir)) {
+        _fs.mkdir(_dir);  // not supported on SPIFFS (no need)
+    }
+    auto dir = _fs.open(_dir);
+    if (!dir || !dir.isDirectory()) {
+        Serial.printf("ERROR: Failed to open audio cache directory (path=%s)\n", _dir.c_str());
+        return false;
+    }
+
+    struct Found {
+        String key;
+        size_t size;
+        time_t lastWrite;
+    };
+    std::vector<Found> found;
+    std::vector<String> garbage;
+    for (auto file = dir.openNextFile(); file; file = dir.openNextFile()) {
+        String name = file.name();
+        name = name.substring(name.lastIndexOf('/') + 1);
+        if (name.endsWith(".mp3")) {
+            found.push_back({name.substring(0, name.length() - 4), file.size(), file.getLastWrite()});
+        } else {
+            // incomplete file
+            garbage.push_back(_dir + "/" + name);
+        }
+    }
+    dir.close();
+    for (const auto &path: garbage) {
+        _fs.remove(path);
+    }
+
+    // Recently written first
+    std::sort(found.begin(), found.end(), [](const Found &a, const Found &b) {
+        return a.lastWrite > b.lastWrite;
+    });
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _entries.clear();
+    _stats.size = 0;
+    for (const auto &f: found) {
+        _entries.push_back({f.key, f.size, 0});
+        _stats.size += f.size;
+    }
+    xSemaphoreGive(_lock);
+    Serial.printf("AudioCache: %d entries (%d bytes)\n", (int) found.size(), (int) _stats.size);
+    return true;
+}
+
+/**
+ * Make cache key
+ *
+ * @param service speech service
+ * @param params parameters for speech service
+ * @param text text
+ * @return cache key (hex string of FNV-1a 64bit hash)
+ */
+String AudioCache::makeKey(const char *service, const UrlParams &params, const char *text) {
+    uint64_t hash = 14695981039346656037ULL;
+    auto update = [&hash](const char *s) {
+        for (const char *p = s; *p != '\0'; p++) {
+            hash ^= (uint8_t) *p;
+            hash *= 1099511628211ULL;
+        }
+    };
+    update(service);
+    update("\n");
+    // parameters in order of name
+    for (const auto &item: std::map<std::string, std::string>(params.begin(), params.end())) {
+        update(item.first.c_str());
+        update("=");
+        update(item.second.c_str());
+        update("&");
+    }
+    update("\n");
+    update(text);
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%08lx%08lx", (unsigned long) (hash >> 32), (unsigned long) (hash & 0xffffffff));
+    return buf;
+}
+
+/**
+ * Open cached audio
+ *
+ * @param key cache key
+ * @return audio source (nullptr: not cached)
+ */
+std::unique_ptr<AudioFileSource> AudioCache::open(const String &key) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto it = std::find_if(_entries.begin(), _entries.end(), [&key](const Entry &e) { return e.key == key; });
+    bool found = it != _entries.end();
+    if (found) {
+        // pin not to be evicted while reading
+        it->readers++;
+        _entries.splice(_entries.begin(), _entries, it);
+    }
+    xSemaphoreGive(_lock);
+    if (found) {
+        auto source = std::unique_ptr<AudioFileSource>(new AudioFileSourceFS(_fs, _path(key, ".mp3").c_str()));
+        if (source->isOpen()) {
+            xSemaphoreTake(_lock, portMAX_DELAY);
+            _stats.hits++;
+            xSemaphoreGive(_lock);
+            return std::unique_ptr<AudioFileSource>(new AudioFileSourceCacheReader(this, key, std::move(source)));
+        }
+        Serial.printf("ERROR: Failed to open cached audio (key=%s)\n", key.c_str());
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        _entries.remove_if([&key](const Entry &e) { return e.key == key; });
+        xSemaphoreGive(_lock);
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _stats.misses++;
+    xSemaphoreGive(_lock);
+    return nullptr;
+}
+
+/**
+ * Store audio to the cache while reading
+ *
+ * The audio is cached only when the whole audio has been read.
+ *
+ * @param key cache key
+ * @param source audio source to read
+ * @return audio source to read instead
+ */
+std::unique_ptr<AudioFileSource> AudioCache::store(const String &key, std::unique_ptr<AudioFileSourceHttp> source) {
+    if (!source->isOpen()) {
+        return std::move(source);
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    bool writing = !_writing.insert(key.c_str()).second;
+    xSemaphoreGive(_lock);
+    if (writing) {
+        // same audio is being written
+        return std::move(source);
+    }
+    auto file = _fs.open(_path(key, ".tmp"), FILE_WRITE);
+    if (!file) {
+        Serial.printf("ERROR: Failed to open audio cache for writing (key=%s)\n", key.c_str());
+        _abort(key);
+        return std::move(source);
+    }
+    return std::unique_ptr<AudioFileSource>(new AudioFileSourceCacheWriter(this, key, std::move(source), file));
+}
+
+/**
+ * Get statistics
+ *
+ * @return statistics
+ */
+AudioCache::Stats AudioCache::getStats() {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto stats = _stats;
+    stats.count = _entries.size();
+    xSemaphoreGive(_lock);
+    return stats;
+}
+
+String AudioCache::_path(const String &key, const char *ext) {
+    return _dir + "/" + key + ext;
+}
+
+/**
+ * Register written audio and evict old entries
+ *
+ * @param key cache key
+ * @param size size of audio
+ */
+void AudioCache::_commit(const String &key, size_t size) {
+    if (!_fs.rename(_path(key, ".tmp"), _path(key, ".mp3"))) {
+        _abort(key);
+        return;
+    }
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _writing.erase(key.c_str());
+    _entries.push_front({key, size, 0});
+    _stats.size += size;
+    _stats.stores++;
+    // evict from the oldest except the new one, skipping entries being read
+    auto it = _entries.end();
+    while (_stats.size > _maxSize && --it != _entries.begin()) {
+        if (it->readers > 0) {
+            continue;
+        }
+        _fs.remove(_path(it->key, ".mp3"));
+        _stats.size -= it->size;
+        _stats.evictions++;
+        it = _entries.erase(it);
+    }
+    xSemaphoreGive(_lock);
+}
+
+/**
+ * Discard written audio
+ *
+ * @param key cache key
+ */
+void AudioCache::_abort(const String &key) {
+    _fs.remove(_path(key, ".tmp"));
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _writing.erase(key.c_str());
+    xSemaphoreGive(_lock);
+}
+
+/**
+ * Release the pin of the entry
+ *
+ * @param key cache key
+ */
+void AudioCache::_unpin(const String &key) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto it = std::find_if(_entries.begin(), _entries.end(), [&key](const Entry &e) { return e.key == key; });
+    if (it != _entries.end() && it->readers > 0) {
+        it->readers--;
+    }
+    xSemaphoreGive(_lock);
+}
+
+AudioFileSourceCacheReader::AudioFileSourceCacheReader(
+        AudioCache *cache, String key, std::unique_ptr<AudioFileSource> source)
+        : _cache(cache), _key(std::move(key)), _source(std::move(source)) {}
+
+AudioFileSourceCacheReader::~AudioFileSourceCacheReader() {
+    _source->close();
+    _unpin();
+}
+
+uint32_t AudioFileSourceCacheReader::read(void *data, uint32_t len) {
+    return _source->read(data, len);
+}
+
+bool AudioFileSourceCacheReader::seek(int32_t pos, int dir) {
+    return _source->seek(pos, dir);
+}
+
+bool AudioFileSourceCacheReader::close() {
+    auto result = _source->close();
+    _unpin();
+    return result;
+}
+
+bool AudioFileSourceCacheReader::isOpen() {
+    return _source->isOpen();
+}
+
+uint32_t AudioFileSourceCacheReader::getSize() {
+    return _source->getSize();
+}
+
+uint32_t AudioFileSourceCacheReader::getPos() {
+    return _source->getPos();
+}
+
+/**
+ * Unpin the entry after the file is closed
+ */
+void AudioFileSourceCacheReader::_unpin() {
+    if (!_closed) {
+        _closed = true;
+        _cache->_unpin(_key);
+    }
+}
+
+AudioFileSourceCacheWriter::AudioFileSourceCacheWriter(
+        AudioCache *cache, String key, std::unique_ptr<AudioFileSourceHttp> source, File file)
+        : _cache(cache), _key(std::move(key)), _source(std::move(source)), _file(std::move(file)) {}
+
+AudioFileSourceCacheWriter::~AudioFileSourceCacheWriter() {
+    _finish();
+}
+
+uint32_t AudioFileSourceCacheWriter::read(void *data, uint32_t len) {
+    return _write(data, _source->read(data, len));
+}
+
+uint32_t AudioFileSourceCacheWriter::readNonBlock(void *data, uint32_t len) {
+    return _write(data, _source->readNonBlock(data, len));
+}
+
+bool AudioFileSourceCacheWriter::seek(int32_t pos, int dir) {
+    return false;
+}
+
+bool AudioFileSourceCacheWriter::close() {
+    auto result = _source->close();
+    _finish();
+    return result;
+}
+
+bool AudioFileSourceCacheWriter::isOpen() {
+    return _source->isOpen();
+}
+
+uint32_t AudioFileSourceCacheWriter::getSize() {
+    return _source->getSize();
+}
+
+uint32_t AudioFileSourceCacheWriter::getPos() {
+    return _source->getPos();
+}
+
+/**
+ * Write read data to the cache file
+ *
+ * @param data read data
+ * @param len length of read data
+ * @return length of read data
+ */
+uint32_t AudioFileSourceCacheWriter::_write(const void *data, uint32_t len) {
+    if (_writing && len > 0) {
+        if (_written + len > AUDIO_CACHE_MAX_ENTRY_SIZE
+            || _file.write((const uint8_t *) data, len) != len) {
+            // too large or no space
+            _writing = false;
+        } else {
+            _written += len;
+        }
+    }
+    return len;
+}
+
+/**
+ * Commit to the cache if the whole audio has been written
+ */
+void AudioFileSourceCacheWriter::_finish() {
+    if (_finished) {
+        return;
+    }
+    _finished = true;
+    _file.close();
+    if (_writing && _written > 0 && _source->isCompleted()) {
+        _cache->_commit(_key, _written);
+    } else {
+        _cache->_abort(_key);
+    }
+}
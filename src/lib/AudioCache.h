@@ -0,0 +1,160 @@
+#if !defined(LIB_AUDIO_CACHE_H)
+#define LIB_AUDIO_CACHE_H
+
+#include <list>
+#include <memory>
+#include <set>
+#include <Arduino.h>
+#include <AudioFileSource.h>
+#include <FS.h>
+
+#include "lib/AudioFileSourceHttp.h"
+#include "lib/url.h"
+
+/// max size of one cached audio
+#if !defined(AUDIO_CACHE_MAX_ENTRY_SIZE)
+#define AUDIO_CACHE_MAX_ENTRY_SIZE (64 * 1024)
+#endif
+
+/**
+ * Content-addressed cache of synthesized audio on the file system
+ *
+ * Entries are evicted in least recently used order to keep the total size under the limit.
+ * Entries being read are pinned and never evicted.
+ */
+class AudioCache {
+public:
+    struct Stats {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t stores;
+        uint32_t evictions;
+        /// number of cached entries
+        uint32_t count;
+        /// total size of cached entries (bytes)
+        uint32_t size;
+    };
+
+    AudioCache(fs::FS &fs, const char *dir, size_t maxSize);
+
+    bool begin();
+
+    static String makeKey(const char *service, const UrlParams &params, const char *text);
+
+    std::unique_ptr<AudioFileSource> open(const String &key);
+
+    std::unique_ptr<AudioFileSource> store(const String &key, std::unique_ptr<AudioFileSourceHttp> source);
+
+    Stats getStats();
+
+private:
+    friend class AudioFileSourceCacheWriter;
+
+    friend class AudioFileSourceCacheReader;
+
+    struct Entry {
+        String key;
+        size_t size;
+        /// number of open readers (pinned while > 0)
+        int readers;
+    };
+
+    fs::FS &_fs;
+    String _dir;
+    size_t _maxSize;
+
+    SemaphoreHandle_t _lock = xSemaphoreCreateMutex();
+
+    /// cached entries (most recently used first)
+    std::list<Entry> _entries;
+
+    /// keys being written
+    std::set<std::string> _writing;
+
+    Stats _stats{};
+
+    String _path(const String &key, const char *ext);
+
+    void _commit(const String &key, size_t size);
+
+    void _abort(const String &key);
+
+    void _unpin(const String &key);
+};
+
+/**
+ * Audio source to read cached audio (keeps the entry pinned until closed)
+ */
+class AudioFileSourceCacheReader : public AudioFileSource {
+public:
+    AudioFileSourceCacheReader(AudioCache *cache, String key, std::unique_ptr<AudioFileSource> source);
+
+    ~AudioFileSourceCacheReader() override;
+
+    uint32_t read(void *data, uint32_t len) override;
+
+    bool seek(int32_t pos, int dir) override;
+
+    bool close() override;
+
+    bool isOpen() override;
+
+    uint32_t getSize() override;
+
+    uint32_t getPos() override;
+
+private:
+    AudioCache *_cache;
+    String _key;
+    std::unique_ptr<AudioFileSource> _source;
+
+    /// true: unpinned
+    bool _closed = false;
+
+    void _unpin();
+};
+
+/**
+ * Audio source to write the audio to the cache while reading
+ */
+class AudioFileSourceCacheWriter : public AudioFileSource {
+public:
+    AudioFileSourceCacheWriter(AudioCache *cache, String key, std::unique_ptr<AudioFileSourceHttp> source, File file);
+
+    ~AudioFileSourceCacheWriter() override;
+
+    uint32_t read(void *data, uint32_t len) override;
+
+    uint32_t readNonBlock(void *data, uint32_t len) override;
+
+    bool seek(int32_t pos, int dir) override;
+
+    bool close() override;
+
+    bool isOpen() override;
+
+    uint32_t getSize() override;
+
+    uint32_t getPos() override;
+
+private:
+    AudioCache *_cache;
+    String _key;
+    std::unique_ptr<AudioFileSourceHttp> _source;
+    File _file;
+
+    /// written size
+    size_t _written = 0;
+
+    /// false: writing to the cache is given up
+    bool _writing = true;
+
+    /// true: committed or aborted
+    bool _finished = false;
+
+    uint32_t _write(const void *data, uint32_t len);
+
+    void _finish();
+};
+
+#endif // !defined(LIB_AUDIO_CACHE_H)
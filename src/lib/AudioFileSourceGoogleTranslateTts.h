@@ -6,7 +6,10 @@
 
 class AudioFileSourceGoogleTranslateTts : public AudioFileSourceHttp {
 public:
-    explicit AudioFileSourceGoogleTranslateTts(const char *text, UrlParams params);
+    explicit AudioFileSourceGoogleTranslateTts(std::shared_ptr<ConnectionPool> pool, const char *text, UrlParams params);
+
+protected:
+    void _setupSecureClient(WiFiClientSecure *client) override;
 };
 
 #endif // AudioFileSourceGoogleTranslateTts_H
@@ -1,31 +1,33 @@
+#include <algorithm>
+#include <utility>
 #include <Arduino.h>
 #include "AudioFileSourceHttp.h"
 
-AudioFileSourceHttp::AudioFileSourceHttp(const char *url) {
+/// max time to wait for data in blocking read (ms)
+static const unsigned long HTTP_READ_TIMEOUT = 500;
+
+AudioFileSourceHttp::AudioFileSourceHttp(std::shared_ptr<ConnectionPool> pool, const char *url)
+        : _pool(std::move(pool)) {
     open(url);
 }
 
 bool AudioFileSourceHttp::open(const char *url) {
-    _http.setReuse(false);
-    static const char *headerKeys[] = {"Transfer-Encoding"};
-    _http.collectHeaders(headerKeys, 1);
-    if (!_http.begin(String(url).startsWith("https://") ? _secureClient : _client, url)) {
-        Serial.println("ERROR: HTTPClient begin failed.");
+    if (!_begin(url)) {
         return false;
     }
 
     Serial.printf(">>> GET %s\n", url);
-    auto httpCode = _http.GET();
+    auto httpCode = _conn->http().GET();
     if (httpCode != HTTP_CODE_OK) {
         Serial.printf("ERROR: %d\n", httpCode);
-        _http.end();
+        _release(false);
         return false;
     }
     return true;
 }
 
 AudioFileSourceHttp::~AudioFileSourceHttp() {
-    _http.end();
+    close();
 }
 
 uint32_t AudioFileSourceHttp::read(void *data, uint32_t len) {
@@ -42,107 +44,171 @@ bool AudioFileSourceHttp::seek(int32_t pos, int dir) {
 }
 
 bool AudioFileSourceHttp::close() {
-    _http.end();
+    if (_conn != nullptr) {
+        // Keep the connection alive only if the whole body has been read
+        auto size = getSize();
+        _completed = _isChunked() ? _decoder.isDone() : (size > 0 && _pos >= size);
+        _release(_completed);
+    }
     return true;
 }
 
+/**
+ * Check if the whole body has been read
+ *
+ * @return true: completed, false: not completed (reading, aborted or error)
+ */
+bool AudioFileSourceHttp::isCompleted() const {
+    return _completed;
+}
+
+/**
+ * Get result of the last read
+ *
+ * Distinguishes no data yet (WouldBlock) from the end of body (Eof) or failure (Error) when read returned 0.
+ *
+ * @return status
+ */
+AudioFileSourceHttp::ReadStatus AudioFileSourceHttp::getStatus() const {
+    return _status;
+}
+
 bool AudioFileSourceHttp::isOpen() {
-    return _http.connected();
+    return _conn != nullptr && _conn->http().connected();
 }
 
 uint32_t AudioFileSourceHttp::getSize() {
-    return _http.getSize();
+    return _conn != nullptr ? _conn->http().getSize() : 0;
 }
 
 uint32_t AudioFileSourceHttp::getPos() {
     return _pos;
 }
 
+/**
+ * Read body
+ *
+ * Non-blocking read returns only the bytes already received.
+ * Blocking read waits until any bytes are received (not until the buffer is filled) up to HTTP_READ_TIMEOUT.
+ *
+ * @param data buffer
+ * @param len buffer size
+ * @param nonBlock true: non-blocking
+ * @return length of read data (0: see getStatus())
+ */
 uint32_t AudioFileSourceHttp::_read(void *data, uint32_t len, bool nonBlock) {
-    auto size = getSize();
-    if (!_http.connected() || (size > 0 && _pos >= size)) {
-        return 0;
-    }
-
-    auto stream = _http.getStreamPtr();
-    if (!nonBlock) {
-        auto start = millis();
-        while (_http.connected() && stream->available() < (int) len && (millis() - start < 500)) {
-            delay(10);
+    auto start = millis();
+    while (true) {
+        auto bytes = _readAvailable(data, len);
+        auto elapsed = millis() - start;
+        if (bytes > 0 || _status != ReadStatus::WouldBlock || nonBlock || elapsed >= HTTP_READ_TIMEOUT) {
+            return bytes;
         }
+        // Sleep until the socket is readable (the connection is open while waiting for more)
+        _conn->waitReadable(HTTP_READ_TIMEOUT - elapsed);
     }
+}
 
-    auto availBytes = stream->available();
-    if (availBytes == 0) {
+/**
+ * Read bytes already received without waiting
+ *
+ * @param data buffer
+ * @param len buffer size
+ * @return length of read data
+ */
+uint32_t AudioFileSourceHttp::_readAvailable(void *data, uint32_t len) {
+    if (_conn == nullptr) {
+        _status = _completed ? ReadStatus::Eof : ReadStatus::Error;
+        return 0;
+    }
+    auto size = getSize();
+    if (size > 0 && _pos >= size) {
+        close();
+        _status = ReadStatus::Eof;
         return 0;
     }
 
-    if (_isChunked() && _chunkLen == 0) {
-        // Read chunk size
-        char buf[16];
-        int pos = 0;
-        while (true) {
-            auto available = stream->available();
-            if (available == 0) {
-                delay(10);
-                continue;
-            }
-            auto c = stream->read();
-            if (c < 0) {
-                Serial.printf("readChunk: read failed (%d)\n", c);
-                _http.end();
-                return 0;
-            }
-            buf[pos++] = (char) c;
-            if (pos > 8) {  // hex 6 桁まで
-                Serial.println("readChunk: Invalid chunk size (too long)");
-                _http.end();
-                return 0;
-            }
-            if (pos >= 2 && buf[pos - 2] == '\r' && buf[pos - 1] == '\n') {
-                buf[pos - 2] = '\0';
-                //Serial.printf("readChunk: chunkSize=%s\n", buf);
-                char *endp;
-                _chunkLen = strtol((char *) buf, &endp, 16);
-                if (endp != (char *) &buf[pos - 2]) {
-                    Serial.printf("readChunk: Invalid chunk size: %s\n", buf);
-                    _http.end();
-                    return 0;
-                }
-                //Serial.printf("readChunk: chunkSize=%d\n", _chunkLen);
-                break;
-            }
-        }
-        if (_chunkLen == 0) {
-            _http.end();
-            return 0;
+    auto stream = _conn->http().getStreamPtr();
+    if (stream->available() <= 0) {
+        if (!isOpen()) {
+            // end of body without length, or closed before the end of body
+            auto untilClose = !_isChunked() && _conn->http().getSize() < 0;
+            close();
+            // the closed connection is not reused, but the body is complete
+            _completed = untilClose;
+            _status = untilClose ? ReadStatus::Eof : ReadStatus::Error;
+        } else {
+            _status = ReadStatus::WouldBlock;
         }
+        return 0;
     }
 
-    if (_isChunked() && len > _chunkLen) {
-        len = _chunkLen;
+    int readBytes;
+    bool completed;
+    if (_isChunked()) {
+        readBytes = (int) _decoder.read(stream, reinterpret_cast<uint8_t *>(data), len);
+        completed = _decoder.isDone() || _decoder.hasError();
+    } else {
+        readBytes = stream->read(reinterpret_cast<uint8_t *>(data), len);
+        completed = size > 0 && _pos + std::max(readBytes, 0) >= size;
     }
-    int readBytes = stream->read(reinterpret_cast<uint8_t *>(data), len);
-    if (readBytes <= 0) {
-        return 0;
+    if (readBytes > 0) {
+        _pos += readBytes;
+        _status = ReadStatus::Ok;
+    } else if (_decoder.hasError()) {
+        Serial.printf("ERROR: %s\n", ChunkedDecoder::errorToString(_decoder.getError()));
+        _status = ReadStatus::Error;
+    } else if (completed) {
+        _status = ReadStatus::Eof;
+    } else {
+        // only framing of chunked body is received
+        _status = ReadStatus::WouldBlock;
     }
-    _pos += readBytes;
-    if (_isChunked()) {
-        _chunkLen -= readBytes;
-        if (_chunkLen == 0) {
-            // Skip chunk delimiter
-            char buf[2];
-            auto skipLen = stream->readBytes(buf, 2);
-            if (skipLen != 2 || buf[0] != '\r' || buf[1] != '\n') {
-                Serial.println("readChunk: Invalid chunk delimiter");
-                _http.end();
-                return 0;
-            }
-        }
+    if (completed) {
+        // Return the connection to the pool as soon as possible
+        close();
     }
-    return readBytes;
+    return std::max(readBytes, 0);
+}
+
+/**
+ * Get connection from the pool and begin request
+ *
+ * @param url URL
+ * @return true: success, false: failure
+ */
+bool AudioFileSourceHttp::_begin(const char *url) {
+    _release(false);
+    _decoder.reset();
+    _pos = 0;
+    _completed = false;
+    _conn = _pool->acquire(url, [this](WiFiClientSecure *client) { _setupSecureClient(client); });
+    static const char *headerKeys[] = {"Transfer-Encoding"};
+    _conn->http().collectHeaders(headerKeys, 1);
+    if (!_conn->http().begin(*_conn->client(), url)) {
+        Serial.println("ERROR: HTTPClient begin failed.");
+        _release(false);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * End request and return the connection to the pool
+ *
+ * @param reusable true: the response has been read completely
+ */
+void AudioFileSourceHttp::_release(bool reusable) {
+    if (_conn != nullptr) {
+        _conn->http().end();
+        _conn->setReusable(reusable);
+        _conn = nullptr;
+    }
+}
+
+void AudioFileSourceHttp::_setupSecureClient(WiFiClientSecure *client) {
 }
 
 bool AudioFileSourceHttp::_isChunked() {
-    return _http.header("Transfer-Encoding") == "chunked";
+    return _conn != nullptr && _conn->http().header("Transfer-Encoding") == "chunked";
 }
@@ -1,15 +1,31 @@
 #if !defined(AudioFileSourceHttp_H)
 #define AudioFileSourceHttp_H
 
+#include <memory>
 #include <Arduino.h>
 #include <AudioFileSource.h>
 #include <HTTPClient.h>
 
+#include "lib/ChunkedDecoder.h"
+#include "lib/ConnectionPool.h"
+
 class AudioFileSourceHttp : public AudioFileSource {
 public:
-    explicit AudioFileSourceHttp() = default;
-
-    explicit AudioFileSourceHttp(const char *text);
+    /// result of the last read
+    enum class ReadStatus {
+        /// data is read
+        Ok,
+        /// no data is available yet
+        WouldBlock,
+        /// whole body has been read
+        Eof,
+        /// connection failed or closed before the end of body
+        Error,
+    };
+
+    explicit AudioFileSourceHttp(std::shared_ptr<ConnectionPool> pool) : _pool(std::move(pool)) {};
+
+    explicit AudioFileSourceHttp(std::shared_ptr<ConnectionPool> pool, const char *url);
 
     ~AudioFileSourceHttp() override;
 
@@ -29,17 +45,30 @@ public:
 
     uint32_t getPos() override;
 
+    bool isCompleted() const;
+
+    ReadStatus getStatus() const;
+
 protected:
-    WiFiClient _client;
-    WiFiClientSecure _secureClient;
-    HTTPClient _http;
+    std::shared_ptr<ConnectionPool> _pool;
+    std::shared_ptr<PooledConnection> _conn;
 
 protected:
     int _pos = 0;
-    size_t _chunkLen = 0;
+    bool _completed = false;
+    ReadStatus _status = ReadStatus::Ok;
+    ChunkedDecoder _decoder;
 
     uint32_t _read(void *data, uint32_t len, bool nonBlock);
 
+    uint32_t _readAvailable(void *data, uint32_t len);
+
+    bool _begin(const char *url);
+
+    void _release(bool reusable);
+
+    virtual void _setupSecureClient(WiFiClientSecure *client);
+
     bool _isChunked();
 };
 
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <utility>
+#include <Arduino.h>
+
+#include "AudioFileSourcePrefetch.h"
+#include "lib/arena.h"
+
+/// size to read at once on prefetch
+static const uint32_t PREFETCH_READ_SIZE = 1024;
+
+AudioFileSourcePrefetch::AudioFileSourcePrefetch(std::unique_ptr<AudioFileSource> source, uint32_t bufferSize)
+        : _source(std::move(source)), _buffer((uint8_t *) arenaAlloc(Arena::Large, bufferSize)), _bufferSize(bufferSize) {
+    if (!_buffer) {
+        Serial.println("ERROR: Unable to allocate prefetch buffer");
+        _bufferSize = 0;
+    }
+}
+
+/**
+ * Read the head of the source until the buffer is full
+ *
+ * @param shouldContinue called before each read, return false to stop prefetching
+ * @return length of prefetched data
+ */
+uint32_t AudioFileSourcePrefetch::fill(const std::function<bool()> &shouldContinue) {
+    while (_length < _bufferSize && _source->isOpen() && shouldContinue()) {
+        _length += _source->read(_buffer.get() + _length, std::min(_bufferSize - _length, PREFETCH_READ_SIZE));
+    }
+    return _length;
+}
+
+uint32_t AudioFileSourcePrefetch::read(void *data, uint32_t len) {
+    auto bytes = _readBuffer(data, len);
+    if (bytes == 0) {
+        bytes = _source->read(data, len);
+        _pos += bytes;
+    }
+    return bytes;
+}
+
+uint32_t AudioFileSourcePrefetch::readNonBlock(void *data, uint32_t len) {
+    auto bytes = _readBuffer(data, len);
+    if (bytes == 0) {
+        bytes = _source->readNonBlock(data, len);
+        _pos += bytes;
+    }
+    return bytes;
+}
+
+bool AudioFileSourcePrefetch::seek(int32_t pos, int dir) {
+    return false;
+}
+
+bool AudioFileSourcePrefetch::close() {
+    _readPos = _length;
+    return _source->close();
+}
+
+bool AudioFileSourcePrefetch::isOpen() {
+    return _readPos < _length || _source->isOpen();
+}
+
+uint32_t AudioFileSourcePrefetch::getSize() {
+    return _source->getSize();
+}
+
+uint32_t AudioFileSourcePrefetch::getPos() {
+    return _pos;
+}
+
+uint32_t AudioFileSourcePrefetch::_readBuffer(void *data, uint32_t len) {
+    auto bytes = std::min(len, _length - _readPos);
+    if (bytes > 0) {
+        memcpy(data, _buffer.get() + _readPos, bytes);
+        _readPos += bytes;
+        _pos += bytes;
+    }
+    return bytes;
+}
@@ -0,0 +1,57 @@
+#if !defined(AudioFileSourcePrefetch_H)
+#define AudioFileSourcePrefetch_H
+
+#include <functional>
+#include <memory>
+#include <Arduino.h>
+#include <AudioFileSource.h>
+
+#include "lib/arena.h"
+
+/**
+ * Audio source that reads the head of another source in advance
+ *
+ * fill() may be called from another task before the source is handed to the decoder.
+ */
+class AudioFileSourcePrefetch : public AudioFileSource {
+public:
+    AudioFileSourcePrefetch(std::unique_ptr<AudioFileSource> source, uint32_t bufferSize);
+
+    uint32_t fill(const std::function<bool()> &shouldContinue);
+
+    uint32_t read(void *data, uint32_t len) override;
+
+    uint32_t readNonBlock(void *data, uint32_t len) override;
+
+    bool seek(int32_t pos, int dir) override;
+
+    bool close() override;
+
+    bool isOpen() override;
+
+    uint32_t getSize() override;
+
+    uint32_t getPos() override;
+
+private:
+    std::unique_ptr<AudioFileSource> _source;
+
+    /// prefetched data
+    std::unique_ptr<uint8_t, ArenaDeleter> _buffer;
+
+    /// size of the buffer
+    uint32_t _bufferSize;
+
+    /// length of prefetched data
+    uint32_t _length = 0;
+
+    /// read position in prefetched data
+    uint32_t _readPos = 0;
+
+    /// read position in total
+    uint32_t _pos = 0;
+
+    uint32_t _readBuffer(void *data, uint32_t len);
+};
+
+#endif // AudioFileSourcePrefetch_H
@@ -52,19 +52,19 @@ static const char *TTS_QUEST_VOICEVOX_API_URL = "https://api.tts.quest/v3/voicev
 /// size for response
 static const size_t CONTENT_MAX_SIZE = 1024;
 
-AudioFileSourceTtsQuestVoicevox::AudioFileSourceTtsQuestVoicevox(String apiKey, String text, UrlParams params)
-        : _apiKey(std::move(apiKey)), _text(std::move(text)), _params(std::move(params)) {
-    _secureClient.setCACert(caCert);
+AudioFileSourceTtsQuestVoicevox::AudioFileSourceTtsQuestVoicevox(
+        std::shared_ptr<ConnectionPool> pool, String apiKey, String text, UrlParams params)
+        : AudioFileSourceHttp(std::move(pool)),
+          _apiKey(std::move(apiKey)), _text(std::move(text)), _params(std::move(params)) {
     open(TTS_QUEST_VOICEVOX_API_URL);
 }
 
 bool AudioFileSourceTtsQuestVoicevox::open(const char *url) {
-    _http.setReuse(false);
-    if (!_http.begin(_secureClient, url)) {
-        Serial.println("ERROR: HTTPClient begin failed.");
+    if (!_begin(url)) {
         return false;
     }
-    _http.addHeader("Content-Type", "application/x-www-form-urlencoded");
+    auto &http = _conn->http();
+    http.addHeader("Content-Type", "application/x-www-form-urlencoded");
     auto params = _params;
     params["key"] = _apiKey.c_str();
     params["text"] = _text.c_str();
@@ -72,13 +72,14 @@ bool AudioFileSourceTtsQuestVoicevox::open(const char *url) {
 
     Serial.printf(">>> POST %s\n", url);
     Serial.println(request);
-    auto httpCode = _http.POST(request);
+    auto httpCode = http.POST(request);
     if (httpCode != HTTP_CODE_OK) {
         Serial.printf("ERROR: %d\n", httpCode);
-        _http.end();
+        _release(false);
         return false;
     }
-    auto response = _http.getString();
+    auto response = http.getString();
+    _release(true);
     DynamicJsonDocument doc{CONTENT_MAX_SIZE};
     auto error = deserializeJson(doc, response.c_str());
     if (error != DeserializationError::Ok) {
@@ -92,6 +93,9 @@ bool AudioFileSourceTtsQuestVoicevox::open(const char *url) {
         Serial.println("ERROR: Failed to synthesize");
         return false;
     }
-    _http.end();
     return AudioFileSourceHttp::open(mp3Url.c_str());
 }
+
+void AudioFileSourceTtsQuestVoicevox::_setupSecureClient(WiFiClientSecure *client) {
+    client->setCACert(caCert);
+}
@@ -8,10 +8,13 @@
 
 class AudioFileSourceTtsQuestVoicevox : public AudioFileSourceHttp {
 public:
-    AudioFileSourceTtsQuestVoicevox(String apiKey, String text, UrlParams params);
+    AudioFileSourceTtsQuestVoicevox(std::shared_ptr<ConnectionPool> pool, String apiKey, String text, UrlParams params);
 
     bool open(const char *url) override;
 
+protected:
+    void _setupSecureClient(WiFiClientSecure *client) override;
+
 private:
     String _apiKey;
     String _text;
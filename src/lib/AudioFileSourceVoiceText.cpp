@@ -7,24 +7,20 @@
 
 static const char *VOICETEXT_TTS_API_URL = "https://api.voicetext.jp/v1/tts";
 
-AudioFileSourceVoiceText::AudioFileSourceVoiceText(String apiKey, String text, UrlParams params)
-        : _apiKey(std::move(apiKey)), _text(std::move(text)), _params(std::move(params)) {
-#if defined(USE_CA_CERT_BUNDLE)
-    _secureClient.setCACertBundle(rootca_crt_bundle);
-#else
-    _secureClient.setCACert(gsrsaovsslca2018_crt);
-#endif
+AudioFileSourceVoiceText::AudioFileSourceVoiceText(
+        std::shared_ptr<ConnectionPool> pool, String apiKey, String text, UrlParams params)
+        : AudioFileSourceHttp(std::move(pool)),
+          _apiKey(std::move(apiKey)), _text(std::move(text)), _params(std::move(params)) {
     open(VOICETEXT_TTS_API_URL);
 }
 
 bool AudioFileSourceVoiceText::open(const char *url) {
-    _http.setReuse(false);
-    if (!_http.begin(_secureClient, url)) {
-        Serial.println("ERROR: HTTPClient begin failed.");
+    if (!_begin(url)) {
         return false;
     }
-    _http.setAuthorization(_apiKey.c_str(), "");
-    _http.addHeader("Content-Type", "application/x-www-form-urlencoded");
+    auto &http = _conn->http();
+    http.setAuthorization(_apiKey.c_str(), "");
+    http.addHeader("Content-Type", "application/x-www-form-urlencoded");
     auto params = _params;
     params["text"] = _text.c_str();
     params["format"] = "mp3";
@@ -32,11 +28,19 @@ bool AudioFileSourceVoiceText::open(const char *url) {
 
     Serial.printf(">>> POST %s\n", url);
     Serial.println(request);
-    auto httpCode = _http.POST(request);
+    auto httpCode = http.POST(request);
     if (httpCode != HTTP_CODE_OK) {
         Serial.printf("ERROR: %d\n", httpCode);
-        _http.end();
+        _release(false);
         return false;
     }
     return true;
 }
+
+void AudioFileSourceVoiceText::_setupSecureClient(WiFiClientSecure *client) {
+#if defined(USE_CA_CERT_BUNDLE)
+    client->setCACertBundle(rootca_crt_bundle);
+#else
+    client->setCACert(gsrsaovsslca2018_crt);
+#endif
+}
@@ -8,10 +8,13 @@
 
 class AudioFileSourceVoiceText : public AudioFileSourceHttp {
 public:
-    AudioFileSourceVoiceText(String apiKey, String text, UrlParams params);
+    AudioFileSourceVoiceText(std::shared_ptr<ConnectionPool> pool, String apiKey, String text, UrlParams params);
 
     bool open(const char *url) override;
 
+protected:
+    void _setupSecureClient(WiFiClientSecure *client) override;
+
 private:
     String _apiKey;
     String _text;
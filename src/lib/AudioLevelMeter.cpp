@@ -0,0 +1,33 @@
+#include <algorithm>
+#include <cmath>
+
+#include "lib/AudioLevelMeter.h"
+
+/**
+ * Close the current window and publish its level
+ */
+void AudioLevelMeter::update() {
+    if (_count == 0) {
+        return;
+    }
+    auto rms = (int32_t) sqrtf((float) (_sumSquares / _count));
+    auto coef = (rms << 8) > _envelope ? AUDIO_LEVEL_ATTACK : AUDIO_LEVEL_RELEASE;
+    _envelope += (int32_t) (((int64_t) ((rms << 8) - _envelope) * coef) >> 8);
+    _level = (int16_t) std::min(_envelope >> 8, (int32_t) INT16_MAX);
+    _peak = (int16_t) std::min((int32_t) _windowPeak, (int32_t) INT16_MAX);
+    _sumSquares = 0;
+    _windowPeak = 0;
+    _count = 0;
+}
+
+/**
+ * Reset the level to silence
+ */
+void AudioLevelMeter::reset() {
+    _sumSquares = 0;
+    _windowPeak = 0;
+    _count = 0;
+    _envelope = 0;
+    _level = 0;
+    _peak = 0;
+}
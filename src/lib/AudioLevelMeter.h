@@ -0,0 +1,72 @@
+#if !defined(LIB_AUDIO_LEVEL_METER_H)
+#define LIB_AUDIO_LEVEL_METER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+
+/// attack coefficient of the envelope follower (1-256, 256: follow rising level immediately)
+#if !defined(AUDIO_LEVEL_ATTACK)
+#define AUDIO_LEVEL_ATTACK 256
+#endif
+
+/// release coefficient of the envelope follower (1-256, 256: no smoothing)
+#if !defined(AUDIO_LEVEL_RELEASE)
+#define AUDIO_LEVEL_RELEASE 128
+#endif
+
+/**
+ * Audio level meter
+ *
+ * RMS and peak are accumulated per sample and published per window,
+ * so that other tasks can read the level without lock.
+ */
+class AudioLevelMeter {
+public:
+    /**
+     * Add one sample to the current window
+     *
+     * @param sample sample
+     */
+    void add(int16_t sample) {
+        int32_t s = sample;
+        _sumSquares += (uint64_t) (s * s);
+        auto a = (uint16_t) abs(s);
+        if (a > _windowPeak) {
+            _windowPeak = a;
+        }
+        _count++;
+    }
+
+    void update();
+
+    void reset();
+
+    /// smoothed RMS level of the last window (can be called from any task)
+    int16_t getLevel() const {
+        return _level;
+    }
+
+    /// peak level of the last window (can be called from any task)
+    int16_t getPeak() const {
+        return _peak;
+    }
+
+private:
+    /// sum of squares in the current window
+    uint64_t _sumSquares = 0;
+
+    /// peak in the current window
+    uint16_t _windowPeak = 0;
+
+    /// number of samples in the current window
+    uint32_t _count = 0;
+
+    /// envelope (Q8 fixed-point)
+    int32_t _envelope = 0;
+
+    std::atomic<int16_t> _level{0};
+    std::atomic<int16_t> _peak{0};
+};
+
+#endif // !defined(LIB_AUDIO_LEVEL_METER_H)
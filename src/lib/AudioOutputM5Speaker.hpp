@@ -1,59 +1,383 @@
 #if !defined(AudioOutputM5Speaker_H)
 #define AudioOutputM5Speaker_H
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <AudioOutput.h>
 #include <M5Unified.h>
 
-static const int BUF_SIZE = 640;
-static const int BUF_NUM = 3;
+#include "lib/AudioLevelMeter.h"
+#include "lib/PcmRingBuffer.h"
+#include "lib/VisemeAnalyzer.h"
 
+/// max number of samples in one output buffer (mono)
+#if !defined(AUDIO_OUTPUT_BUF_SIZE)
+#define AUDIO_OUTPUT_BUF_SIZE 1024
+#endif
+
+/// number of output buffers (one playing, one queued in the speaker and one being filled at least)
+#if !defined(AUDIO_OUTPUT_BUF_NUM)
+#define AUDIO_OUTPUT_BUF_NUM 3
+#endif
+
+/// duration of one output buffer (ms), the buffer size is calculated from the sample rate
+#if !defined(AUDIO_OUTPUT_BUF_MS)
+#define AUDIO_OUTPUT_BUF_MS 40
+#endif
+
+/// number of samples in the decode-ahead ring (rounded up to power of 2)
+#if !defined(AUDIO_OUTPUT_RING_SIZE)
+#define AUDIO_OUTPUT_RING_SIZE 16384
+#endif
+
+/// duration to decode ahead (ms), decoding pauses above this and resumes below half of this
+#if !defined(AUDIO_OUTPUT_LOOKAHEAD_MS)
+#define AUDIO_OUTPUT_LOOKAHEAD_MS 500
+#endif
+
+static_assert(AUDIO_OUTPUT_BUF_NUM >= 3, "AUDIO_OUTPUT_BUF_NUM must be 3 or more");
+
+/// number of samples staged by the decoder before writing to the ring
+static const size_t AUDIO_OUTPUT_STAGE_SIZE = 128;
+
+/**
+ * Mono audio output to M5 speaker with decode-ahead
+ *
+ * The decoder task writes the left channel into a PCM ring (AudioOutput interface),
+ * and the output task moves it from the ring to the speaker by pump().
+ * Decoding pauses at the high watermark and resumes at the low watermark,
+ * so a stall of the audio source is hidden by the samples decoded ahead.
+ * Buffers are handed to the speaker without copy, so each buffer is reused after the speaker consumed it.
+ */
 class AudioOutputM5Speaker : public AudioOutput {
 public:
     explicit AudioOutputM5Speaker(m5::Speaker_Class *m5Speaker, uint8_t channel = 0)
-            : _m5Speaker(m5Speaker), _channel(channel) {};
+            : _m5Speaker(m5Speaker), _channel(channel) {
+        SetRate(hertz);
+    };
+
+    /**
+     * Allocate the ring
+     *
+     * @return true: success, false: failure
+     */
+    bool init() {
+        _ring = std::make_unique<PcmRingBuffer>(AUDIO_OUTPUT_RING_SIZE);
+        return _ring->isAllocated();
+    }
+
+    /**
+     * Set tasks to notify
+     *
+     * @param decoder task writing to this output
+     * @param output task calling pump()
+     */
+    void setTasks(TaskHandle_t decoder, TaskHandle_t output) {
+        _decoderTask = decoder;
+        _outputTask = output;
+    }
+
+    // decoder side
 
     bool begin() override {
+        _stagePos = 0;
+        _writable = 0;
+        _paused = false;
+        _ended = false;
+        _active = true;
+        // the output task waits without timeout while inactive
+        _notifyOutput();
+        return true;
+    }
+
+    bool SetRate(int hz) override {
+        hertz = hz;
+        _rate = hz;
+        auto highWater = std::min((size_t) hz * AUDIO_OUTPUT_LOOKAHEAD_MS / 1000,
+                                  (size_t) AUDIO_OUTPUT_RING_SIZE - AUDIO_OUTPUT_STAGE_SIZE);
+        _highWater = std::max(highWater, AUDIO_OUTPUT_STAGE_SIZE);
+        _lowWater = _highWater / 2;
         return true;
     }
 
     bool ConsumeSample(int16_t sample[2]) override {
-        if (_pos >= BUF_SIZE) {
-            flush();
+        if (_writable == 0 && !_reserve()) {
             return false;
         }
-        _buf[_index][_pos++] = sample[LEFTCHANNEL];
-        _buf[_index][_pos++] = sample[LEFTCHANNEL];
+        _stage[_stagePos++] = sample[LEFTCHANNEL];
+        _writable--;
+        if (_stagePos >= AUDIO_OUTPUT_STAGE_SIZE) {
+            _writeStage();
+        }
         return true;
     }
 
     void flush() override {
-        if (_pos > 0) {
-            _m5Speaker->playRaw(
-                    _buf[_index], _pos,
-                    hertz, true, 1, _channel);
-            _index = (_index + 1) % BUF_NUM;
-            _pos = 0;
-        }
+        _writeStage();
     }
 
+    /// end of stream, the output task plays the rest
     bool stop() override {
-        flush();
-        _m5Speaker->stop(_channel);
-        memset(_buf, 0, BUF_NUM * BUF_SIZE * sizeof(int16_t));
+        _writeStage();
+        _ended = true;
+        _notifyOutput();
         return true;
     }
 
-    const int16_t *getBuffer() const {
-        return _buf[(_index + BUF_NUM - 1) % BUF_NUM];
+    /// stop playing immediately and discard the rest
+    void cancel() {
+        _cancel = true;
+        _notifyOutput();
+    }
+
+    /**
+     * Check if decoding can continue (called from the decoder task)
+     *
+     * @return true: below the high watermark, false: wait until drained to the low watermark
+     */
+    bool isReady() {
+        if (_paused && _ring->available() <= _lowWater) {
+            _paused = false;
+        }
+        return !_paused;
+    }
+
+    /// true: playing the stream or the rest of it, or stopping (can be called from any task)
+    bool isActive() const {
+        return _active || _cancel;
+    }
+
+    // output side
+
+    /**
+     * Move samples from the ring to the speaker (called from the output task)
+     *
+     * @return ticks to wait for the next call
+     */
+    TickType_t pump() {
+        if (_cancel) {
+            _ring->clear();
+            _m5Speaker->stop(_channel);
+            _cancel = false;
+            _finish();
+            return portMAX_DELAY;
+        }
+        if (!_active) {
+            return portMAX_DELAY;
+        }
+        auto rate = _rate.load();
+        if (rate != _visemeRate) {
+            // filters are used only by the output task
+            _viseme.setRate(rate);
+            _visemeRate = rate;
+        }
+        auto blockSize = std::max((size_t) 1, std::min((size_t) AUDIO_OUTPUT_BUF_SIZE,
+                                                       (size_t) rate * AUDIO_OUTPUT_BUF_MS / 1000));
+        auto blockTicks = std::max((TickType_t) 1, (TickType_t) pdMS_TO_TICKS(AUDIO_OUTPUT_BUF_MS));
+        bool ended = _ended;
+        auto queued = _m5Speaker->isPlaying(_channel);
+
+        if (!_started && !ended && _ring->available() < blockSize) {
+            // start with a full block
+            return _waitForData(blockSize, blockTicks);
+        }
+        if (queued >= 2) {
+            // the playing buffer takes one block time at most
+            return std::max((TickType_t) 1, blockTicks / 2);
+        }
+
+        auto n = _ring->read(_buf[_index] + _pos, blockSize - _pos);
+        for (size_t i = 0; i < n; i++) {
+            _meter.add(_buf[_index][_pos + i]);
+            _viseme.add(_buf[_index][_pos + i]);
+        }
+        _pos += n;
+        if (_paused && _ring->available() <= _lowWater) {
+            _notifyDecoder();
+        }
+        bool drained = ended && _ring->available() == 0;
+
+        if (_pos >= blockSize || (_pos > 0 && (drained || queued == 0))) {
+            // play a full block, the rest of the stream, or what we have not to leave the speaker idle
+            if (_started && queued == 0) {
+                // speaker ran out of data before the next buffer
+                _underrunCount++;
+            }
+            _meter.update();
+            // this buffer is heard after the queued buffers
+            auto queuedDelay = (uint32_t) (queued * blockSize * 1000 / rate);
+            _viseme.update(millis() + queuedDelay, (uint8_t) (_meter.getLevel() >> 7));
+            _m5Speaker->playRaw(_buf[_index], _pos, rate, false, 1, _channel);
+            _started = true;
+            _index = (_index + 1) % AUDIO_OUTPUT_BUF_NUM;
+            _pos = 0;
+            return 0;
+        }
+        if (drained) {
+            if (queued == 0) {
+                _finish();
+                return portMAX_DELAY;
+            }
+            // wait for the speaker to play the rest
+            return 1;
+        }
+        return _waitForData(1, blockTicks);
+    }
+
+    /// smoothed RMS level of the last played buffer (can be called from any task)
+    int16_t getLevel() const {
+        return _meter.getLevel();
+    }
+
+    /// peak level of the last played buffer (can be called from any task)
+    int16_t getPeak() const {
+        return _meter.getPeak();
+    }
+
+    /**
+     * Get viseme heard now (can be called from any task)
+     *
+     * @param event viseme event
+     * @return true: found, false: not playing
+     */
+    bool getViseme(VisemeEvent &event) const {
+        return _viseme.getEvent(millis(), event);
+    }
+
+    /// number of times the speaker ran out of data while playing (can be called from any task)
+    uint32_t getUnderrunCount() const {
+        return _underrunCount;
+    }
+
+    /// number of times decoding paused at the high watermark (can be called from any task)
+    uint32_t getOverrunCount() const {
+        return _overrunCount;
     }
 
 private:
     m5::Speaker_Class *_m5Speaker;
     uint8_t _channel;
 
-    int16_t _buf[BUF_NUM][BUF_SIZE]{};
+    TaskHandle_t _decoderTask{};
+    TaskHandle_t _outputTask{};
+
+    /// decode-ahead ring
+    std::unique_ptr<PcmRingBuffer> _ring;
+
+    /// sample rate of the stream
+    std::atomic<int> _rate{0};
+
+    /// watermarks of the ring (samples)
+    std::atomic<size_t> _highWater{0}, _lowWater{0};
+
+    /// true: decoding is paused at the high watermark
+    std::atomic<bool> _paused{false};
+
+    /// true: end of stream
+    std::atomic<bool> _ended{false};
+
+    /// true: requested to stop playing
+    std::atomic<bool> _cancel{false};
+
+    /// true: playing the stream
+    std::atomic<bool> _active{false};
+
+    /// true: the output task waits for data
+    std::atomic<bool> _outputWaiting{false};
+
+    /// samples staged by the decoder
+    int16_t _stage[AUDIO_OUTPUT_STAGE_SIZE]{};
+    size_t _stagePos = 0;
+
+    /// number of samples the decoder can write until the high watermark
+    size_t _writable = 0;
+
+    /// buffers handed to the speaker
+    int16_t _buf[AUDIO_OUTPUT_BUF_NUM][AUDIO_OUTPUT_BUF_SIZE]{};
     size_t _pos = 0;
     size_t _index = 0;
+
+    /// true: buffer was passed to the speaker since start
+    bool _started = false;
+
+    AudioLevelMeter _meter;
+    VisemeAnalyzer _viseme;
+
+    /// sample rate the viseme filters are set for
+    int _visemeRate = 0;
+    std::atomic<uint32_t> _underrunCount{0};
+    std::atomic<uint32_t> _overrunCount{0};
+
+    /**
+     * Reserve space up to the high watermark (decoder side)
+     *
+     * @return true: reserved, false: paused
+     */
+    bool _reserve() {
+        _writeStage();
+        auto fill = _ring->available();
+        if (fill >= _highWater) {
+            if (!_paused) {
+                _paused = true;
+                _overrunCount++;
+            }
+            return false;
+        }
+        _writable = _highWater - fill;
+        return true;
+    }
+
+    /// write staged samples to the ring (decoder side)
+    void _writeStage() {
+        if (_stagePos > 0) {
+            // never overflows because samples are staged up to the high watermark
+            _ring->write(_stage, _stagePos);
+            _stagePos = 0;
+            if (_outputWaiting && _outputWaiting.exchange(false)) {
+                _notifyOutput();
+            }
+        }
+    }
+
+    /**
+     * Wait for the decoder to write (output side)
+     *
+     * @param needed number of samples needed
+     * @param ticks ticks to wait at most
+     * @return ticks to wait
+     */
+    TickType_t _waitForData(size_t needed, TickType_t ticks) {
+        _outputWaiting = true;
+        // check again not to miss the notification
+        if (_ring->available() >= needed || _ended || _cancel) {
+            _outputWaiting = false;
+            return 0;
+        }
+        return ticks;
+    }
+
+    void _notifyOutput() {
+        if (_outputTask != nullptr) {
+            xTaskNotifyGive(_outputTask);
+        }
+    }
+
+    void _notifyDecoder() {
+        if (_decoderTask != nullptr) {
+            xTaskNotifyGive(_decoderTask);
+        }
+    }
+
+    /// reset the output side after the stream
+    void _finish() {
+        _pos = 0;
+        _started = false;
+        _meter.reset();
+        _viseme.reset();
+        _active = false;
+        _notifyDecoder();
+    }
 };
 
 #endif // !defined(AudioOutputM5Speaker_H)
@@ -6,16 +6,48 @@
 #include <utility>
 
 #include "lib/ChatGptClient.h"
+#include "lib/ChatRequestStream.h"
+#include "lib/ChunkedDecoder.h"
+#include "lib/JsonExtractor.h"
+#include "lib/arena.h"
+#include "lib/SseParser.h"
 #include "lib/ssl.h"
 #include "lib/utils.h"
 
-/// Chat API URL
-static const char *CHAT_URL = "https://api.openai.com/v1/chat/completions";
-
 /// size for request/response
 static const size_t CONTENT_MAX_SIZE = 16 * 1024;
 
-ChatGptClient::ChatGptClient(String apiKey, String model) : _apiKey(std::move(apiKey)), _model(std::move(model)) {}
+/// size for reading stream
+static const size_t READ_BUFFER_SIZE = 512;
+
+/// timeout for HTTP (ms)
+static const unsigned long HTTP_TIMEOUT = 60000;
+
+/// max time to wait for data at once while reading stream (ms)
+static const unsigned long READ_WAIT_INTERVAL = 100;
+
+/**
+ * Constructor
+ *
+ * @param apiKey API key
+ * @param model model name
+ * @param url URL of chat completions API (http:// or https://)
+ * @param pool connection pool
+ */
+ChatGptClient::ChatGptClient(String apiKey, String model, String url, std::shared_ptr<ConnectionPool> pool)
+        : _apiKey(std::move(apiKey)), _model(std::move(model)), _url(std::move(url)), _pool(std::move(pool)) {}
+
+/**
+ * Set callback to abort the request
+ *
+ * Checked before sending, on each event and while waiting for the event stream (at least every READ_WAIT_INTERVAL),
+ * not while waiting for the response headers.
+ *
+ * @param shouldAbort callback, return true to abort (throws ChatGptClientError)
+ */
+void ChatGptClient::setShouldAbort(const std::function<bool()> &shouldAbort) {
+    _shouldAbort = shouldAbort;
+}
 
 /**
  * Ask to the ChatGPT and get answer
@@ -28,54 +60,36 @@ ChatGptClient::ChatGptClient(String apiKey, String model) : _apiKey(std::move(ap
  * @throws ChatGptClientError
  */
 String ChatGptClient::chat(
-        const String &text, const std::vector<String> &roles, const std::deque<String> &history,
+        const String &text, const std::vector<String> &roles, const ChatHistory &history,
         const std::function<void(const String &)> &onReceiveContent) {
-    DynamicJsonDocument requestDoc{CONTENT_MAX_SIZE};
-    DynamicJsonDocument responseDoc{CONTENT_MAX_SIZE};
-    requestDoc["model"] = _model;
-    if (onReceiveContent != nullptr) {
-        requestDoc["stream"] = true;
-    }
-    JsonArray messages = requestDoc.createNestedArray("messages");
-    // Append roles to request parameters
-    for (auto &&role: roles) {
-        JsonObject newMessage = messages.createNestedObject();
-        newMessage["role"] = "system";
-        newMessage["content"] = role;
-    }
-    // Append chat history to request parameters
-    for (int i = 0; i < history.size(); i++) {
-        JsonObject newMessage = messages.createNestedObject();
-        newMessage["role"] = (i % 2 == 0) ? "user" : "assistant";
-        newMessage["content"] = history[i];
-    }
-    // Append question to request parameters
-    JsonObject newMessage = messages.createNestedObject();
-    newMessage["role"] = "user";
-    newMessage["content"] = text;
+    // request body is written from roles, history and question while sending
+    ChatRequestStream request{_model, onReceiveContent != nullptr, roles, history, text};
 
     if (onReceiveContent != nullptr) {
         std::stringstream ss;
-        _httpPost(CHAT_URL, jsonEncode(requestDoc), [&](const String &data) {
+        // extract only the delta content from each event
+        JsonExtractor extractor{"choices.0.delta.content"};
+        String content;
+        _httpPost(_url, request, [&](const char *data, size_t len) {
             // Handle server-sent event
             // https://developer.mozilla.org/en-US/docs/Web/API/Server-sent_events/Using_server-sent_events#event_stream_format
-            if (data == "[DONE]") {
+            if (strcmp(data, "[DONE]") == 0) {
                 return;
             }
-            auto error = deserializeJson(responseDoc, data.c_str());
-            if (error != DeserializationError::Ok) {
-                Serial.printf("ERROR: Failed to deserialize JSON: %s\n", error.c_str());
+            auto result = extractor.extract(data, len, content);
+            if (result == JsonExtractor::Result::Invalid) {
+                Serial.println("ERROR: Failed to parse JSON");
                 throw ChatGptClientError("Failed to deserialize JSON");
             }
-            const char *content = responseDoc["choices"][0]["delta"]["content"];
-            if (content != nullptr) {
+            if (result == JsonExtractor::Result::Found) {
                 onReceiveContent(content);
-                ss << content;
+                ss << content.c_str();
             }
         });
         return String{ss.str().c_str()};
     } else {
-        auto result = _httpPost(CHAT_URL, jsonEncode(requestDoc), nullptr);
+        auto result = _httpPost(_url, request, nullptr);
+        LargeJsonDocument responseDoc{CONTENT_MAX_SIZE};
         auto error = deserializeJson(responseDoc, result.c_str());
         if (error != DeserializationError::Ok) {
             Serial.printf("ERROR: Failed to deserialize JSON: %s\n", error.c_str());
@@ -90,175 +104,136 @@ String ChatGptClient::chat(
 }
 
 /**
- * Read chunk
+ * Read data of Server-Sent Events
  *
- * @param stream WifiClient stream
- * @param onReceiveChunk callback on receive chunk
+ * @param conn connection
+ * @param onReceiveData callback on receive data
+ * @param shouldAbort callback to abort (nullptr: never aborted)
  * @return true: success, false: failure
+ * @throws ChatGptClientError aborted
  */
-static bool readChunk(WiFiClient *stream, const std::function<bool(const char *)> &onReceiveChunk) {
-    char buf[16];
-    while (true) {
-        // Read chunk size
-        int chunkSize;
-        int pos = 0;
-        while (true) {
-            delay(10);
-            auto available = stream->available();
-            if (available == 0) {
-                continue;
-            }
-            auto c = stream->read();
-            if (c < 0) {
-                Serial.printf("readChunk: read failed (%d)\n", c);
-                return false;
-            }
-            buf[pos++] = (char) c;
-            if (pos > 8) {  // hex 6 桁まで
-                Serial.println("readChunk: Invalid chunk size (too long)");
-                return false;
-            }
-            if (pos >= 2 && buf[pos - 2] == '\r' && buf[pos - 1] == '\n') {
-                buf[pos - 2] = '\0';
-                //Serial.printf("readChunk: chunkSize=%s\n", buf);
-                char *endp;
-                chunkSize = strtol((char *) buf, &endp, 16);
-                if (endp != (char *) &buf[pos - 2]) {
-                    Serial.printf("readChunk: Invalid chunk size: %s\n", buf);
-                    return -1;
-                }
-                //Serial.printf("readChunk: chunkSize=%d\n", chunkSize);
-                break;
-            }
+static bool readData(PooledConnection &conn, const std::function<void(const char *, size_t)> &onReceiveData,
+                     const std::function<bool()> &shouldAbort) {
+    auto stream = conn.client();
+    ChunkedDecoder decoder;
+    SseParser parser{CONTENT_MAX_SIZE};
+    char buf[READ_BUFFER_SIZE];
+    auto checkAbort = [&shouldAbort]() {
+        if (shouldAbort != nullptr && shouldAbort()) {
+            throw ChatGptClientError("Request aborted");
         }
-        if (chunkSize == 0) {
-            //Serial.println("readChunk: stream end");
-            break;
-        }
-
-        // Read chunk
-        auto chunkData = std::unique_ptr<char>((char *) malloc(chunkSize + 1));
-        char *p = chunkData.get();
-        int rest = chunkSize;
-        while (rest > 0) {
-            delay(10);
-            auto len = stream->readBytes(p, rest);
-            p += len;
-            rest -= (int) len;
-        }
-        *p = '\0';
-        //Serial.printf("readChunk: chunkData=[[[%s]]]\n", chunkData.get());
-
-        // Skip chunk delimiter
-        auto len = stream->readBytes(buf, 2);
-        if (len != 2 || buf[0] != '\r' || buf[1] != '\n') {
-            Serial.println("readChunk: Invalid chunk delimiter");
+    };
+    auto lastReceived = millis();
+    while (!decoder.isDone()) {
+        auto len = decoder.read(stream, (uint8_t *) buf, sizeof(buf));
+        if (decoder.hasError()) {
+            Serial.printf("readData: %s\n", ChunkedDecoder::errorToString(decoder.getError()));
             return false;
         }
-
-        if (!onReceiveChunk((const char *) chunkData.get())) {
+        if (len > 0) {
+            //Serial.printf("readData: Read %d bytes\n", len);
+            lastReceived = millis();
+            auto result = parser.feed(buf, len, [&](const char *data, size_t dataLen) {
+                //Serial.printf("readData: data=[[[%s]]]\n", data);
+                checkAbort();
+                onReceiveData(data, dataLen);
+                return true;
+            });
+            if (!result) {
+                Serial.println("readData: Event too large");
+                return false;
+            }
+        } else if (!stream->connected()) {
+            Serial.println("readData: Connection closed");
+            return false;
+        } else if (millis() - lastReceived > HTTP_TIMEOUT) {
+            Serial.println("readData: Timeout");
             return false;
+        } else {
+            // Wait for data (wake up periodically to check connection, timeout and abort)
+            checkAbort();
+            conn.waitReadable(READ_WAIT_INTERVAL);
         }
     }
     return true;
 }
 
-/**
- * Read data of Server-Sent Events
- *
- * @param stream WifiClient stream
- * @param onReceiveData callback on receive data
- * @return true: success, false: failure
- */
-static bool readData(WiFiClient *stream, const std::function<void(const std::string &)> &onReceiveData) {
-#define SSE_DATA_PREFIX "data: "
-#define SSE_DATA_DELIMITER "\n\n"  // TODO: or "\r\n\r\n" ?
-    std::stringstream ss;
-    return readChunk(stream, [&](const std::string &chunk) {
-        ss << chunk;
-        //Serial.printf("readData: Read chunk: %d\n", chunk.length());
-
-        while (true) {
-            std::string str = ss.str();
-            //Serial.printf("readData: str=[[[%s]]] ", str.c_str());
-            //for (int i = 0; i < str.length(); i++) {
-            //    Serial.printf("%02x", str[i]);
-            //}
-            //Serial.println();
-
-            auto dataEnd = str.find(SSE_DATA_DELIMITER);
-            //Serial.printf("readData: dataEnd=%d\n", dataEnd);
-            if (dataEnd == std::string::npos) {
-                break;
-            }
-            std::string nextData = str.substr(dataEnd + strlen(SSE_DATA_DELIMITER));
-            std::string oneData = str.substr(strlen(SSE_DATA_PREFIX), dataEnd - strlen(SSE_DATA_PREFIX));
-            //Serial.printf("readData: data=[[[%s]]]\n", data.c_str());
-            //Serial.printf("readData: tail=[[[%s]]]\n", tail.c_str());
-            onReceiveData(oneData);
-            ss.clear();
-            ss.str(nextData);
-        }
-        return true;
-    });
-}
-
 /**
  * HTTP POST
  *
  * @param url URL
- * @param body body
- * @param onReceiveData callback on receive data
- * @return response body
+ * @param body body (read while sending)
+ * @param onReceiveData callback on receive data of event stream
+ * @return response body (empty if received as event stream)
  * @throws ChatGptClientError
  */
 String ChatGptClient::_httpPost(
-        const String &url, const String &body,
-        const std::function<void(const String &)> &onReceiveData) {
-    HTTPClient http;
-    http.setReuse(false);
-    http.setTimeout(60000);
-    static const char *headerKeys[] = {"Content-Type", "Transfer-Encoding"};
-    http.collectHeaders(headerKeys, 2);
-
-    WiFiClientSecure client;
+        const String &url, ChatRequestStream &body,
+        const std::function<void(const char *, size_t)> &onReceiveData) {
+    auto setupSecureClient = [](WiFiClientSecure *client) {
 #if defined(USE_CA_CERT_BUNDLE)
-    client.setCACertBundle(rootca_crt_bundle);
+        client->setCACertBundle(rootca_crt_bundle);
 #else
-    client.setCACert(gts_root_r4_crt);
+        client->setCACert(gts_root_r4_crt);
 #endif
-    if (http.begin(client, url)) {
+    };
+    static const char *headerKeys[] = {"Content-Type", "Transfer-Encoding"};
+    std::shared_ptr<PooledConnection> conn;
+    int httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+    for (auto reuse: {true, false}) {
+        if (_shouldAbort != nullptr && _shouldAbort()) {
+            throw ChatGptClientError("Request aborted");
+        }
+        conn = _pool->acquire(url, setupSecureClient, reuse);
+        auto &http = conn->http();
+        http.setTimeout(HTTP_TIMEOUT);
+        http.collectHeaders(headerKeys, 2);
+        if (!http.begin(*conn->client(), url)) {
+            throw ChatGptClientError("HTTP begin failed");
+        }
         http.addHeader("Content-Type", "application/json");
         http.addHeader("Authorization", String("Bearer ") + _apiKey);
         Serial.printf(">>> POST %s\n", url.c_str());
-        Serial.printf("%s\n", body.c_str());
-        int httpCode = http.POST((uint8_t *) body.c_str(), body.length());
-        if (httpCode != HTTP_CODE_OK) {
-            Serial.println(HTTPClient::errorToString(httpCode).c_str());
-            throw ChatGptHttpError(httpCode, "HTTP client error: " + String(httpCode));
+        Serial.printf("(%d bytes)\n", (int) body.size());
+        body.rewind();
+        httpCode = http.sendRequest("POST", &body, body.size());
+        if (httpCode == HTTP_CODE_OK) {
+            break;
+        }
+        Serial.println(HTTPClient::errorToString(httpCode).c_str());
+        http.end();
+        if (!ConnectionPool::isStaleError(*conn, httpCode)) {
+            break;
         }
+        // the kept-alive connection was closed by the server, retry once on a new connection
+        conn = nullptr;
+    }
+    if (httpCode != HTTP_CODE_OK) {
+        throw ChatGptHttpError(httpCode, "HTTP client error: " + String(httpCode));
+    }
 
-        Serial.printf("<<< %d\n", httpCode);
-        String payload;
-        if (onReceiveData != nullptr
-            && http.header("Content-Type").startsWith("text/event-stream")
-            && http.header("Transfer-Encoding") == "chunked") {
-            // Receive Event Stream
-            std::stringstream ss;
-            auto result = readData(http.getStreamPtr(), [&](const std::string &data) {
-                onReceiveData(data.c_str());
-                ss << data;
-            });
-            if (!result) {
-                throw ChatGptClientError("Failed to receive data");
-            }
-            payload = String(ss.str().c_str());
-        } else {
-            payload = http.getString();
+    auto &http = conn->http();
+    Serial.printf("<<< %d\n", httpCode);
+    String payload;
+    if (onReceiveData != nullptr
+        && http.header("Content-Type").startsWith("text/event-stream")
+        && http.header("Transfer-Encoding") == "chunked") {
+        // Receive Event Stream
+        bool received;
+        try {
+            received = readData(*conn, onReceiveData, _shouldAbort);
+        } catch (...) {
+            http.end();
+            throw;
+        }
+        if (!received) {
+            http.end();
+            throw ChatGptClientError("Failed to receive data");
         }
-        http.end();
-        return payload;
     } else {
-        throw ChatGptClientError("HTTP begin failed");
+        payload = http.getString();
     }
+    http.end();
+    conn->setReusable(true);
+    return payload;
 }
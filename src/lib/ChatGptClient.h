@@ -1,11 +1,16 @@
 #if !defined(LIB_CHATGPT_CLIENT_H)
 #define LIB_CHATGPT_CLIENT_H
 
-#include <deque>
+#include <functional>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <Arduino.h>
 
+#include "lib/ChatHistory.h"
+#include "lib/ChatRequestStream.h"
+#include "lib/ConnectionPool.h"
+
 class ChatGptClientError : public std::exception {
 public:
     explicit ChatGptClientError(String msg) : _msg(std::move(msg)) {};
@@ -28,19 +33,26 @@ private:
 
 class ChatGptClient {
 public:
-    explicit ChatGptClient(String apiKey, String model);
+    explicit ChatGptClient(String apiKey, String model, String url, std::shared_ptr<ConnectionPool> pool);
 
     String chat(
-            const String &data, const std::vector<String> &roles, const std::deque<String> &history,
+            const String &data, const std::vector<String> &roles, const ChatHistory &history,
             const std::function<void(const String &)> &onReceiveContent);
 
+    void setShouldAbort(const std::function<bool()> &shouldAbort);
+
 private:
     String _apiKey;
     String _model;
+    String _url;
+    std::shared_ptr<ConnectionPool> _pool;
+
+    /// called while requesting, return true to abort (nullptr: never aborted)
+    std::function<bool()> _shouldAbort;
 
     String _httpPost(
-            const String &url, const String &body,
-            const std::function<void(const String &)> &onReceiveData);
+            const String &url, ChatRequestStream &body,
+            const std::function<void(const char *, size_t)> &onReceiveData);
 };
 
 #endif // !defined(LIB_CHATGPT_CLIENT_H)
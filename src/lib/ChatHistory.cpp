@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <cstring>
+#include <Arduino.h>
+
+#include "lib/ChatHistory.h"
+#include "lib/utils.h"
+
+static const char *FRAGMENT_USER = "{\"role\":\"user\",\"content\":\"";
+static const char *FRAGMENT_ASSISTANT = "\"},{\"role\":\"assistant\",\"content\":\"";
+static const char *FRAGMENT_END = "\"}";
+
+/// tokens added to each message by the chat format
+static const size_t MESSAGE_TOKENS = 4;
+
+/**
+ * Add a turn
+ *
+ * @param question question
+ * @param answer answer
+ * @param maxTurns max number of turns
+ * @return true: added, false: not added (too large or allocation failure)
+ */
+bool ChatHistory::add(const String &question, const String &answer, size_t maxTurns) {
+    if (maxTurns == 0) {
+        return false;
+    }
+    auto len = strlen(FRAGMENT_USER) + strlen(FRAGMENT_ASSISTANT) + strlen(FRAGMENT_END)
+               + _escapedLength(question.c_str(), question.length())
+               + _escapedLength(answer.c_str(), answer.length());
+    auto turnTokens = MESSAGE_TOKENS * 2
+                  + estimateTokens(question.c_str(), question.length())
+                  + estimateTokens(answer.c_str(), answer.length());
+    if (len > _maxSize || _memoTokens + turnTokens > _maxTokens) {
+        return false;
+    }
+    if (!_buf) {
+        _buf.reset((char *) arenaAlloc(Arena::Large, _maxSize));
+        if (!_buf) {
+            return false;
+        }
+    }
+    while (!_turns.empty()
+           && (_turns.size() >= maxTurns || _len + len > _maxSize || tokens() + turnTokens > _maxTokens)) {
+        _evictOldest();
+    }
+
+    // write the fragment after the last turn
+    _turns.push_back(Turn{_len, len, turnTokens});
+    _append(FRAGMENT_USER, strlen(FRAGMENT_USER), false);
+    _append(question.c_str(), question.length(), true);
+    _append(FRAGMENT_ASSISTANT, strlen(FRAGMENT_ASSISTANT), false);
+    _append(answer.c_str(), answer.length(), true);
+    _append(FRAGMENT_END, strlen(FRAGMENT_END), false);
+    _tokens += turnTokens;
+    return true;
+}
+
+/**
+ * Remove all turns and the memo (the buffer is kept)
+ */
+void ChatHistory::clear() {
+    _turns.clear();
+    _len = 0;
+    _tokens = 0;
+    _memo = "";
+    _memoTokens = 0;
+}
+
+/**
+ * Copy the memo and the oldest turns
+ *
+ * @param turns number of turns to copy
+ * @return history of the oldest turns (empty on allocation failure)
+ */
+ChatHistory ChatHistory::oldest(size_t turns) const {
+    ChatHistory result{_maxSize, _maxTokens};
+    turns = std::min(turns, _turns.size());
+    if (turns == 0 || !_buf) {
+        result.setMemo(_memo);
+        return result;
+    }
+    auto len = _turns[turns - 1].offset + _turns[turns - 1].len;
+    result._buf.reset((char *) arenaAlloc(Arena::Large, len));
+    if (!result._buf) {
+        return result;
+    }
+    result.setMemo(_memo);
+    memcpy(result._buf.get(), _buf.get(), len);
+    result._maxSize = len;
+    result._len = len;
+    result._turns.assign(_turns.begin(), _turns.begin() + (long) turns);
+    for (const auto &turn: result._turns) {
+        result._tokens += turn.tokens;
+    }
+    return result;
+}
+
+/**
+ * Replace the oldest turns with the memo
+ *
+ * @param turns number of turns to remove
+ * @param memo memo of the removed turns (including the previous memo)
+ * @return true: replaced, false: memo is too large
+ */
+bool ChatHistory::summarize(size_t turns, const String &memo) {
+    if (!setMemo(memo)) {
+        return false;
+    }
+    for (size_t i = 0; i < turns && !_turns.empty(); i++) {
+        _evictOldest();
+    }
+    return true;
+}
+
+/**
+ * Check if the history is near the limit
+ *
+ * @param maxTurns max number of turns
+ * @param percent threshold of size and tokens (% of the limit)
+ * @return true: number of turns reached the max, or size or tokens exceeds the threshold
+ */
+bool ChatHistory::isNearLimit(size_t maxTurns, size_t percent) const {
+    return _turns.size() >= maxTurns
+           || _len * 100 > _maxSize * percent
+           || tokens() * 100 > _maxTokens * percent;
+}
+
+/**
+ * Set memo of old turns
+ *
+ * @param memo memo (empty: none)
+ * @return true: success, false: too large (more than half of the tokens)
+ */
+bool ChatHistory::setMemo(const String &memo) {
+    auto tokens = memo.isEmpty() ? 0 : MESSAGE_TOKENS + estimateTokens(memo.c_str(), memo.length());
+    if (tokens * 2 > _maxTokens) {
+        return false;
+    }
+    _memo = memo;
+    _memoTokens = tokens;
+    return true;
+}
+
+/**
+ * Estimate number of tokens
+ *
+ * About 4 ASCII characters per token, and one token per other character (e.g. Japanese).
+ *
+ * @param text UTF-8 text
+ * @param len length of the text
+ * @return number of tokens
+ */
+size_t ChatHistory::estimateTokens(const char *text, size_t len) {
+    size_t ascii = 0;
+    size_t others = 0;
+    for (size_t i = 0; i < len; i++) {
+        auto c = (uint8_t) text[i];
+        if (c < 0x80) {
+            ascii++;
+        } else if ((c & 0xc0) != 0x80) {
+            // lead byte of multibyte character
+            others++;
+        }
+    }
+    return (ascii + 3) / 4 + others;
+}
+
+void ChatHistory::_evictOldest() {
+    auto oldest = _turns.front();
+    _len -= oldest.len;
+    _tokens -= oldest.tokens;
+    memmove(_buf.get(), _buf.get() + oldest.len, _len);
+    _turns.erase(_turns.begin());
+    for (auto &turn: _turns) {
+        turn.offset -= oldest.len;
+    }
+}
+
+/**
+ * Get length of the text escaped as json string
+ *
+ * @param text text
+ * @param len length of the text
+ * @return escaped length
+ */
+size_t ChatHistory::_escapedLength(const char *text, size_t len) {
+    char escaped[7];
+    size_t result = len;
+    for (size_t i = 0; i < len; i++) {
+        auto n = jsonEscapeChar((uint8_t) text[i], escaped);
+        result += n > 0 ? n - 1 : 0;
+    }
+    return result;
+}
+
+/**
+ * Append text to the buffer (the space must be checked in advance)
+ *
+ * @param text text
+ * @param len length of the text
+ * @param escape true: escape as json string
+ */
+void ChatHistory::_append(const char *text, size_t len, bool escape) {
+    if (!escape) {
+        memcpy(_buf.get() + _len, text, len);
+        _len += len;
+        return;
+    }
+    char escaped[7];
+    for (size_t i = 0; i < len; i++) {
+        auto n = jsonEscapeChar((uint8_t) text[i], escaped);
+        if (n > 0) {
+            memcpy(_buf.get() + _len, escaped, n);
+            _len += n;
+        } else {
+            _buf.get()[_len++] = text[i];
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#if !defined(LIB_CHAT_HISTORY_H)
+#define LIB_CHAT_HISTORY_H
+
+#include <memory>
+#include <vector>
+#include <Arduino.h>
+
+#include "lib/arena.h"
+
+/// max size of the chat history in the request body (bytes)
+#if !defined(CHAT_HISTORY_MAX_SIZE)
+#define CHAT_HISTORY_MAX_SIZE 8192
+#endif
+
+/// max number of tokens of the chat history (approximate)
+#if !defined(CHAT_HISTORY_MAX_TOKENS)
+#define CHAT_HISTORY_MAX_TOKENS 2000
+#endif
+
+/**
+ * Chat history evicted by size and token budget
+ *
+ * Each turn (question and answer) is stored as an escaped json fragment of two messages
+ * in one buffer on the large arena, so the request body is assembled by concatenation.
+ * The oldest turns are evicted when the size, tokens or number of turns exceeds the budget.
+ * The buffer is allocated on the first turn, so an empty history costs nothing.
+ * Old turns can be replaced with a memo (e.g. summary) sent as a system message.
+ */
+class ChatHistory {
+public:
+    ChatHistory() = default;
+
+    ChatHistory(size_t maxSize, size_t maxTokens) : _maxSize(maxSize), _maxTokens(maxTokens) {};
+
+    bool add(const String &question, const String &answer, size_t maxTurns);
+
+    void clear();
+
+    ChatHistory oldest(size_t turns) const;
+
+    bool summarize(size_t turns, const String &memo);
+
+    bool isNearLimit(size_t maxTurns, size_t percent) const;
+
+    /// memo of old turns (empty: none)
+    const String &getMemo() const { return _memo; }
+
+    bool setMemo(const String &memo);
+
+    /// number of turns
+    size_t size() const { return _turns.size(); }
+
+    /// total size of the fragments (bytes)
+    size_t bytes() const { return _len; }
+
+    /// total number of tokens including the memo (approximate)
+    size_t tokens() const { return _tokens + _memoTokens; }
+
+    /**
+     * Get json fragment of the turn
+     *
+     * @param index index of the turn (0: oldest)
+     * @param len length of the fragment
+     * @return fragment (not null terminated)
+     */
+    const char *fragment(size_t index, size_t &len) const {
+        len = _turns[index].len;
+        return _buf.get() + _turns[index].offset;
+    }
+
+    static size_t estimateTokens(const char *text, size_t len);
+
+private:
+    struct Turn {
+        size_t offset;
+        size_t len;
+        size_t tokens;
+    };
+
+    size_t _maxSize = 0;
+    size_t _maxTokens = 0;
+
+    std::unique_ptr<char, ArenaDeleter> _buf;
+
+    /// length of the fragments in the buffer
+    size_t _len = 0;
+
+    size_t _tokens = 0;
+
+    std::vector<Turn> _turns;
+
+    String _memo;
+    size_t _memoTokens = 0;
+
+    void _evictOldest();
+
+    static size_t _escapedLength(const char *text, size_t len);
+
+    void _append(const char *text, size_t len, bool escape);
+};
+
+#endif // !defined(LIB_CHAT_HISTORY_H)
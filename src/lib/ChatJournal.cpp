@@ -0,0 +1,403 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <Arduino.h>
+#include <FS.h>
+
+#include "lib/ChatJournal.h"
+#include "lib/arena.h"
+
+/// mark at the end of each record
+static const char JOURNAL_MAGIC[4] = {'C', 'J', 'R', '1'};
+
+/// mark at the end of the memo record
+static const char JOURNAL_MEMO_MAGIC[4] = {'C', 'J', 'M', '1'};
+
+/// size of the record header (question length, answer length)
+static const size_t JOURNAL_HEADER_SIZE = 4 + 4;
+
+/// size of the record footer (record length, magic)
+static const size_t JOURNAL_FOOTER_SIZE = 4 + sizeof(JOURNAL_MAGIC);
+
+/// size to copy at once on compaction
+static const size_t JOURNAL_COPY_SIZE = 512;
+
+static void putUint32(uint8_t *buf, uint32_t value) {
+    buf[0] = (uint8_t) value;
+    buf[1] = (uint8_t) (value >> 8);
+    buf[2] = (uint8_t) (value >> 16);
+    buf[3] = (uint8_t) (value >> 24);
+}
+
+static uint32_t readUint32(const uint8_t *buf) {
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t) buf[3] << 24);
+}
+
+static size_t recordLength(size_t questionLen, size_t answerLen) {
+    return JOURNAL_HEADER_SIZE + questionLen + answerLen + JOURNAL_FOOTER_SIZE;
+}
+
+/**
+ * Write a record
+ *
+ * @param file file at the end of the records
+ * @param question question (empty for the memo)
+ * @param answer answer (or memo)
+ * @param magic mark of the record
+ * @return true: success, false: failure
+ */
+static bool writeRecord(File &file, const String &question, const String &answer, const char *magic) {
+    auto recordLen = recordLength(question.length(), answer.length());
+    uint8_t header[JOURNAL_HEADER_SIZE];
+    putUint32(header, question.length());
+    putUint32(header + 4, answer.length());
+    uint8_t footer[JOURNAL_FOOTER_SIZE];
+    putUint32(footer, recordLen);
+    memcpy(footer + 4, magic, sizeof(JOURNAL_MAGIC));
+    auto written = file.write(header, sizeof(header))
+                   + file.write((const uint8_t *) question.c_str(), question.length())
+                   + file.write((const uint8_t *) answer.c_str(), answer.length())
+                   + file.write(footer, sizeof(footer));
+    return written == recordLen;
+}
+
+/**
+ * Read string of the length
+ *
+ * @param file file at the start of the string
+ * @param len length of the string
+ * @param value string
+ * @return true: success, false: failure
+ */
+static bool readString(File &file, size_t len, String &value) {
+    std::vector<char> buf(len + 1);
+    if (file.read((uint8_t *) buf.data(), len) != len) {
+        return false;
+    }
+    buf[len] = '\0';
+    value = buf.data();
+    return true;
+}
+
+/**
+ * Load the last turns
+ *
+ * @param maxTurns max number of turns to load
+ * @param onTurn callback on each turn (oldest first)
+ * @return number of loaded turns
+ */
+size_t ChatJournal::load(size_t maxTurns, const TurnCallback &onTurn) {
+    _size = 0;
+    auto tmpPath = _path + ".tmp";
+    if (!_fs.exists(_path) && _fs.exists(tmpPath)) {
+        // power loss after removing the file to replace, the new file is complete
+        _fs.rename(tmpPath, _path);
+    }
+    auto file = _fs.open(_path, FILE_READ);
+    if (!file) {
+        // not created yet
+        _loaded = true;
+        return 0;
+    }
+    auto fileSize = file.size();
+    std::vector<size_t> offsets;
+    // the last record is checked even if no turn is needed
+    if (!_findTail(file, fileSize, std::max(maxTurns, (size_t) 1), SIZE_MAX, offsets)) {
+        // broken tail (e.g. power loss while appending), keep records before it
+        auto validEnd = _findValidEnd(file);
+        Serial.printf("ChatJournal: broken record at %d, recovering\n", (int) validEnd);
+        if (!_rewrite(file, "", 0, validEnd)) {
+            return 0;
+        }
+        file = _fs.open(_path, FILE_READ);
+        if (!file) {
+            return 0;
+        }
+        fileSize = file.size();
+        offsets.clear();
+        _findTail(file, fileSize, std::max(maxTurns, (size_t) 1), SIZE_MAX, offsets);
+    }
+    offsets.resize(std::min(offsets.size(), maxTurns));
+    _size = fileSize;
+    _loaded = true;
+
+    // offsets are newest first
+    size_t loaded = 0;
+    for (auto it = offsets.rbegin(); it != offsets.rend(); it++) {
+        uint8_t header[JOURNAL_HEADER_SIZE];
+        String question, answer;
+        if (!file.seek(*it) || file.read(header, sizeof(header)) != sizeof(header)
+            || !readString(file, readUint32(header), question)
+            || !readString(file, readUint32(header + 4), answer)) {
+            break;
+        }
+        onTurn(question, answer);
+        loaded++;
+    }
+    file.close();
+    Serial.printf("ChatJournal: loaded %d turns (%d bytes)\n", (int) loaded, (int) _size);
+    return loaded;
+}
+
+/**
+ * Append a turn
+ *
+ * The file is compacted to half of the max size when it exceeds the max size.
+ *
+ * @param question question
+ * @param answer answer
+ * @return true: success, false: failure
+ */
+bool ChatJournal::append(const String &question, const String &answer) {
+    if (!_ensureLoaded()) {
+        return false;
+    }
+    auto recordLen = recordLength(question.length(), answer.length());
+    if (recordLen > _maxSize) {
+        return false;
+    }
+    auto file = _fs.open(_path, FILE_APPEND);
+    if (!file) {
+        Serial.printf("ERROR: Failed to open chat journal for writing (path=%s)\n", _path.c_str());
+        return false;
+    }
+    auto written = writeRecord(file, question, answer, JOURNAL_MAGIC);
+    file.close();
+    if (!written) {
+        // the broken record is dropped on the next load
+        Serial.printf("ERROR: Failed to write chat journal (path=%s)\n", _path.c_str());
+        _loaded = false;
+        return false;
+    }
+    _size += recordLen;
+    if (_size > _maxSize) {
+        return compact(SIZE_MAX, _maxSize / 2);
+    }
+    return true;
+}
+
+/**
+ * Drop old turns (the memo is kept)
+ *
+ * @param keepTurns max number of the last turns to keep
+ * @param keepSize max size of the last turns to keep (bytes)
+ * @return true: success, false: failure
+ */
+bool ChatJournal::compact(size_t keepTurns, size_t keepSize) {
+    if (!_ensureLoaded()) {
+        return false;
+    }
+    auto file = _fs.open(_path, FILE_READ);
+    if (!file) {
+        return false;
+    }
+    String memo;
+    _readMemo(file, memo);
+    std::vector<size_t> offsets;
+    _findTail(file, _size, keepTurns, keepSize, offsets);
+    auto start = offsets.empty() ? _size : offsets.back();
+    auto end = _size;
+    if (!_rewrite(file, memo, start, end)) {
+        _loaded = false;
+        return false;
+    }
+    _size = (memo.isEmpty() ? 0 : recordLength(0, memo.length())) + end - start;
+    Serial.printf("ChatJournal: compacted to %d turns (%d bytes)\n", (int) offsets.size(), (int) _size);
+    return true;
+}
+
+/**
+ * Load the memo of summarized turns
+ *
+ * @return memo (empty: none)
+ */
+String ChatJournal::loadMemo() {
+    if (!_ensureLoaded()) {
+        return "";
+    }
+    auto file = _fs.open(_path, FILE_READ);
+    if (!file) {
+        return "";
+    }
+    String memo;
+    _readMemo(file, memo);
+    file.close();
+    return memo;
+}
+
+/**
+ * Replace the memo and drop the summarized turns at once
+ *
+ * On failure (or power loss) the previous memo and all turns are kept.
+ *
+ * @param memo memo of the summarized turns (including the previous memo)
+ * @param keepTurns number of the last turns not summarized
+ * @return true: success, false: failure
+ */
+bool ChatJournal::summarize(const String &memo, size_t keepTurns) {
+    if (!_ensureLoaded()) {
+        return false;
+    }
+    auto file = _fs.open(_path, FILE_READ);
+    std::vector<size_t> offsets;
+    if (file) {
+        _findTail(file, _size, keepTurns, SIZE_MAX, offsets);
+    }
+    auto start = offsets.empty() ? _size : offsets.back();
+    auto end = _size;
+    if (!_rewrite(file, memo, start, end)) {
+        _loaded = false;
+        return false;
+    }
+    _size = (memo.isEmpty() ? 0 : recordLength(0, memo.length())) + end - start;
+    return true;
+}
+
+/**
+ * Check the file before writing
+ *
+ * @return true: ready, false: the file is broken and cannot be recovered
+ */
+bool ChatJournal::_ensureLoaded() {
+    if (!_loaded) {
+        load(0, [](const String &, const String &) {});
+    }
+    return _loaded;
+}
+
+/**
+ * Read the memo record at the start of the file
+ *
+ * @param file journal file
+ * @param memo [out] memo
+ * @return true: read, false: no memo
+ */
+bool ChatJournal::_readMemo(File &file, String &memo) {
+    uint8_t header[JOURNAL_HEADER_SIZE];
+    if (!file.seek(0) || file.read(header, sizeof(header)) != sizeof(header) || readUint32(header) != 0) {
+        return false;
+    }
+    auto memoLen = (size_t) readUint32(header + 4);
+    uint8_t footer[JOURNAL_FOOTER_SIZE];
+    if (recordLength(0, memoLen) > file.size() || !file.seek(JOURNAL_HEADER_SIZE + memoLen)
+        || file.read(footer, sizeof(footer)) != sizeof(footer)
+        || memcmp(footer + 4, JOURNAL_MEMO_MAGIC, sizeof(JOURNAL_MEMO_MAGIC)) != 0
+        || !file.seek(JOURNAL_HEADER_SIZE)) {
+        return false;
+    }
+    return readString(file, memoLen, memo);
+}
+
+/**
+ * Find the last records by following record lengths from the end
+ *
+ * @param file journal file
+ * @param end end of the records
+ * @param maxTurns max number of records to find
+ * @param maxBytes max total size of records to find
+ * @param offsets offsets of found records (newest first, without the memo)
+ * @return true: reached the limit, the memo or the start of the file, false: broken record found
+ */
+bool ChatJournal::_findTail(File &file, size_t end, size_t maxTurns, size_t maxBytes,
+                            std::vector<size_t> &offsets) {
+    auto pos = end;
+    while (pos > 0 && offsets.size() < maxTurns) {
+        uint8_t footer[JOURNAL_FOOTER_SIZE];
+        if (pos < JOURNAL_HEADER_SIZE + JOURNAL_FOOTER_SIZE || !file.seek(pos - JOURNAL_FOOTER_SIZE)
+            || file.read(footer, sizeof(footer)) != sizeof(footer)) {
+            return false;
+        }
+        auto isMemo = memcmp(footer + 4, JOURNAL_MEMO_MAGIC, sizeof(JOURNAL_MEMO_MAGIC)) == 0;
+        if (!isMemo && memcmp(footer + 4, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) {
+            return false;
+        }
+        auto recordLen = (size_t) readUint32(footer);
+        uint8_t header[JOURNAL_HEADER_SIZE];
+        if (recordLen < JOURNAL_HEADER_SIZE + JOURNAL_FOOTER_SIZE || recordLen > pos
+            || !file.seek(pos - recordLen) || file.read(header, sizeof(header)) != sizeof(header)
+            || recordLength(readUint32(header), readUint32(header + 4)) != recordLen) {
+            return false;
+        }
+        if (isMemo) {
+            // the memo is only at the start of the file
+            return pos == recordLen;
+        }
+        if (end - (pos - recordLen) > maxBytes) {
+            break;
+        }
+        pos -= recordLen;
+        offsets.push_back(pos);
+    }
+    return true;
+}
+
+/**
+ * Find the end of valid records by reading all records from the start
+ *
+ * @param file journal file
+ * @return end of the valid records
+ */
+size_t ChatJournal::_findValidEnd(File &file) {
+    size_t pos = 0;
+    auto fileSize = file.size();
+    while (pos + JOURNAL_HEADER_SIZE + JOURNAL_FOOTER_SIZE <= fileSize) {
+        uint8_t header[JOURNAL_HEADER_SIZE];
+        if (!file.seek(pos) || file.read(header, sizeof(header)) != sizeof(header)) {
+            break;
+        }
+        auto recordLen = recordLength(readUint32(header), readUint32(header + 4));
+        uint8_t footer[JOURNAL_FOOTER_SIZE];
+        if (recordLen > fileSize - pos || !file.seek(pos + recordLen - JOURNAL_FOOTER_SIZE)
+            || file.read(footer, sizeof(footer)) != sizeof(footer)
+            || readUint32(footer) != recordLen) {
+            break;
+        }
+        // the memo is only at the start of the file
+        auto isMemo = pos == 0 && memcmp(footer + 4, JOURNAL_MEMO_MAGIC, sizeof(JOURNAL_MEMO_MAGIC)) == 0;
+        if (!isMemo && memcmp(footer + 4, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) {
+            break;
+        }
+        pos += recordLen;
+    }
+    return pos;
+}
+
+/**
+ * Replace the file with the memo and the range of it
+ *
+ * The new file is completed before the old one is removed, and renamed on the next load if power is lost between.
+ *
+ * @param file journal file (closed on return, may be closed if no records)
+ * @param memo memo written as the first record (empty: none)
+ * @param start start of the range
+ * @param end end of the range
+ * @return true: success, false: failure
+ */
+bool ChatJournal::_rewrite(File &file, const String &memo, size_t start, size_t end) {
+    auto tmpPath = _path + ".tmp";
+    auto tmp = _fs.open(tmpPath, FILE_WRITE);
+    if (!tmp) {
+        Serial.printf("ERROR: Failed to open chat journal for writing (path=%s)\n", tmpPath.c_str());
+        file.close();
+        return false;
+    }
+    // written to flash from internal RAM
+    std::unique_ptr<uint8_t, ArenaDeleter> buf((uint8_t *) arenaAlloc(Arena::Internal, JOURNAL_COPY_SIZE));
+    bool success = buf != nullptr && (start == end || file.seek(start));
+    if (success && !memo.isEmpty()) {
+        success = writeRecord(tmp, "", memo, JOURNAL_MEMO_MAGIC);
+    }
+    for (auto pos = start; success && pos < end;) {
+        auto len = std::min(end - pos, JOURNAL_COPY_SIZE);
+        success = file.read(buf.get(), len) == len && tmp.write(buf.get(), len) == len;
+        pos += len;
+    }
+    tmp.close();
+    file.close();
+    if (!success) {
+        _fs.remove(tmpPath);
+        return false;
+    }
+    _fs.remove(_path);
+    return _fs.rename(tmpPath, _path);
+}
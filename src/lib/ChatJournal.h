@@ -0,0 +1,66 @@
+#if !defined(LIB_CHAT_JOURNAL_H)
+#define LIB_CHAT_JOURNAL_H
+
+#include <functional>
+#include <vector>
+#include <Arduino.h>
+#include <FS.h>
+
+/// max size of the journal file, compacted to half of this when exceeded
+#if !defined(CHAT_JOURNAL_MAX_SIZE)
+#define CHAT_JOURNAL_MAX_SIZE (64 * 1024)
+#endif
+
+/**
+ * Append-only journal of chat turns on the file system
+ *
+ * Record layout: question length, answer length, question, answer, record length and magic.
+ * The record length at the end of each record links records from the tail,
+ * so the last turns are loaded without reading the whole file.
+ * A record broken by power loss is dropped by rewriting the valid records on load.
+ * The memo of summarized turns is the first record (marked by another magic),
+ * so the memo and the turns it covers are replaced at once by one rewrite.
+ */
+class ChatJournal {
+public:
+    typedef std::function<void(const String &question, const String &answer)> TurnCallback;
+
+    ChatJournal(fs::FS &fs, const char *path, size_t maxSize = CHAT_JOURNAL_MAX_SIZE)
+            : _fs(fs), _path(path), _maxSize(maxSize) {};
+
+    size_t load(size_t maxTurns, const TurnCallback &onTurn);
+
+    bool append(const String &question, const String &answer);
+
+    bool compact(size_t keepTurns, size_t keepSize);
+
+    String loadMemo();
+
+    bool summarize(const String &memo, size_t keepTurns);
+
+    /// size of the valid records (bytes)
+    size_t size() const { return _size; }
+
+private:
+    fs::FS &_fs;
+    String _path;
+    size_t _maxSize;
+
+    /// end of the valid records
+    size_t _size = 0;
+
+    /// false: the file has not been checked yet
+    bool _loaded = false;
+
+    bool _ensureLoaded();
+
+    bool _readMemo(File &file, String &memo);
+
+    bool _findTail(File &file, size_t end, size_t maxTurns, size_t maxBytes, std::vector<size_t> &offsets);
+
+    size_t _findValidEnd(File &file);
+
+    bool _rewrite(File &file, const String &memo, size_t start, size_t end);
+};
+
+#endif // !defined(LIB_CHAT_JOURNAL_H)
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cstring>
+#include <Arduino.h>
+
+#include "lib/ChatRequestStream.h"
+#include "lib/utils.h"
+
+/**
+ * Constructor
+ *
+ * @param model model name
+ * @param stream true: request event stream
+ * @param roles system messages
+ * @param history chat history (memo and turns)
+ * @param text question
+ */
+ChatRequestStream::ChatRequestStream(const String &model, bool stream, const std::vector<String> &roles,
+                                     const ChatHistory &history, const String &text) {
+    // 7 pieces for the model and the end, 7 for each message and 2 for each turn
+    _pieces.reserve(7 + 7 * (roles.size() + 2) + 2 * history.size());
+    _addLiteral("{\"model\":");
+    _addString(model);
+    if (stream) {
+        _addLiteral(",\"stream\":true");
+    }
+    _addLiteral(",\"messages\":[");
+    auto first = true;
+    for (const auto &role: roles) {
+        _addMessage("system", role, first);
+        first = false;
+    }
+    if (!history.getMemo().isEmpty()) {
+        _addMessage("system", history.getMemo(), first);
+        first = false;
+    }
+    for (size_t i = 0; i < history.size(); i++) {
+        size_t len;
+        auto fragment = history.fragment(i, len);
+        if (!first) {
+            _addLiteral(",");
+        }
+        _pieces.push_back(Piece{fragment, len, false});
+        first = false;
+    }
+    _addMessage("user", text, first);
+    _addLiteral("]}");
+
+    // count size with escape
+    char buf[7];
+    for (const auto &piece: _pieces) {
+        _size += piece.len;
+        if (piece.escape) {
+            for (size_t i = 0; i < piece.len; i++) {
+                auto len = jsonEscapeChar((uint8_t) piece.data[i], buf);
+                _size += len > 0 ? len - 1 : 0;
+            }
+        }
+    }
+}
+
+/**
+ * Rewind to read the body again (to resend the request)
+ */
+void ChatRequestStream::rewind() {
+    _readCount = 0;
+    _piece = 0;
+    _pos = 0;
+    _pendingLen = 0;
+    _pendingPos = 0;
+}
+
+int ChatRequestStream::available() {
+    return (int) (_size - _readCount);
+}
+
+int ChatRequestStream::read() {
+    char c;
+    return readBytes(&c, 1) == 1 ? (uint8_t) c : -1;
+}
+
+int ChatRequestStream::peek() {
+    if (_pendingPos < _pendingLen) {
+        return (uint8_t) _pending[_pendingPos];
+    }
+    if (!_skipEmptyPieces()) {
+        return -1;
+    }
+    const auto &piece = _pieces[_piece];
+    char buf[7];
+    if (piece.escape && jsonEscapeChar((uint8_t) piece.data[_pos], buf) > 0) {
+        return (uint8_t) buf[0];
+    }
+    return (uint8_t) piece.data[_pos];
+}
+
+/**
+ * Read the body
+ *
+ * @param buffer buffer
+ * @param length buffer size
+ * @return length of read bytes
+ */
+size_t ChatRequestStream::readBytes(char *buffer, size_t length) {
+    size_t total = 0;
+    while (total < length) {
+        if (_pendingPos < _pendingLen) {
+            auto n = std::min(length - total, _pendingLen - _pendingPos);
+            memcpy(buffer + total, _pending + _pendingPos, n);
+            _pendingPos += n;
+            total += n;
+            continue;
+        }
+        if (!_skipEmptyPieces()) {
+            break;
+        }
+        const auto &piece = _pieces[_piece];
+        // copy bytes not to be escaped at once
+        auto n = std::min(length - total, piece.len - _pos);
+        auto escaped = false;
+        if (piece.escape) {
+            for (size_t i = 0; i < n; i++) {
+                auto len = jsonEscapeChar((uint8_t) piece.data[_pos + i], _pending);
+                if (len > 0) {
+                    n = i;
+                    _pendingLen = len;
+                    _pendingPos = 0;
+                    escaped = true;
+                    break;
+                }
+            }
+        }
+        memcpy(buffer + total, piece.data + _pos, n);
+        total += n;
+        _pos += n;
+        if (escaped) {
+            // the escape sequence is read instead of this byte
+            _pos++;
+        }
+    }
+    _readCount += total;
+    return total;
+}
+
+void ChatRequestStream::_addLiteral(const char *literal) {
+    _pieces.push_back(Piece{literal, strlen(literal), false});
+}
+
+void ChatRequestStream::_addString(const String &value) {
+    _addLiteral("\"");
+    _pieces.push_back(Piece{value.c_str(), value.length(), true});
+    _addLiteral("\"");
+}
+
+void ChatRequestStream::_addMessage(const char *role, const String &content, bool first) {
+    _addLiteral(first ? "{\"role\":\"" : ",{\"role\":\"");
+    _addLiteral(role);
+    _addLiteral("\",\"content\":");
+    _addString(content);
+    _addLiteral("}");
+}
+
+/**
+ * Move to the piece having bytes to read
+ *
+ * @return true: found, false: end of body
+ */
+bool ChatRequestStream::_skipEmptyPieces() {
+    while (_piece < _pieces.size() && _pos >= _pieces[_piece].len) {
+        _piece++;
+        _pos = 0;
+    }
+    return _piece < _pieces.size();
+}
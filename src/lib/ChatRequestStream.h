@@ -0,0 +1,74 @@
+#if !defined(LIB_CHAT_REQUEST_STREAM_H)
+#define LIB_CHAT_REQUEST_STREAM_H
+
+#include <vector>
+#include <Arduino.h>
+
+#include "lib/ChatHistory.h"
+
+/**
+ * Request body of chat completions API generated while being sent
+ *
+ * The json is written from the roles, history and question in place with string escaping
+ * (the history is already escaped),
+ * so the body is never materialized in memory. The size is counted in advance for Content-Length.
+ * The referenced strings must live until the request is sent.
+ */
+class ChatRequestStream : public Stream {
+public:
+    ChatRequestStream(const String &model, bool stream, const std::vector<String> &roles,
+                      const ChatHistory &history, const String &text);
+
+    /// total size of the body
+    size_t size() const { return _size; }
+
+    void rewind();
+
+    int available() override;
+
+    int read() override;
+
+    int peek() override;
+
+    size_t readBytes(char *buffer, size_t length) override;
+
+    size_t write(uint8_t) override { return 0; }
+
+    void flush() override {}
+
+private:
+    struct Piece {
+        const char *data;
+        size_t len;
+        /// true: json string value to be escaped
+        bool escape;
+    };
+
+    std::vector<Piece> _pieces;
+
+    size_t _size = 0;
+
+    /// number of bytes read
+    size_t _readCount = 0;
+
+    /// current piece
+    size_t _piece = 0;
+
+    /// position in the current piece
+    size_t _pos = 0;
+
+    /// escape sequence being read
+    char _pending[7]{};
+    size_t _pendingLen = 0;
+    size_t _pendingPos = 0;
+
+    void _addLiteral(const char *literal);
+
+    void _addString(const String &value);
+
+    void _addMessage(const char *role, const String &content, bool first);
+
+    bool _skipEmptyPieces();
+};
+
+#endif // !defined(LIB_CHAT_REQUEST_STREAM_H)
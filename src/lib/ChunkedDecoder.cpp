@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <Arduino.h>
+
+#include "lib/ChunkedDecoder.h"
+
+/// max number of hex digits of the chunk size
+static const int CHUNK_SIZE_MAX_DIGITS = 6;
+
+/**
+ * Feed one byte of the framing (chunk size line, chunk delimiter or trailer)
+ *
+ * Must not be called while chunk data is remaining (see dataRemaining()).
+ *
+ * @param c byte
+ * @return true: success, false: invalid framing
+ */
+bool ChunkedDecoder::feed(uint8_t c) {
+    switch (_state) {
+        case State::Size:
+            if (isxdigit(c)) {
+                if (++_sizeDigits > CHUNK_SIZE_MAX_DIGITS) {
+                    return _fail(Error::SizeTooLong);
+                }
+                _chunkRemaining = _chunkRemaining * 16 + (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+            } else if (_sizeDigits == 0) {
+                return _fail(Error::InvalidSize);
+            } else if (c == ';') {
+                _state = State::Extension;
+            } else if (c == '\r') {
+                _state = State::SizeLf;
+            } else if (c == ' ' || c == '\t') {
+                _state = State::SizeEnd;
+            } else {
+                return _fail(Error::InvalidSize);
+            }
+            break;
+        case State::SizeEnd:
+            // no more digits after whitespace
+            if (c == ';') {
+                _state = State::Extension;
+            } else if (c == '\r') {
+                _state = State::SizeLf;
+            } else if (c != ' ' && c != '\t') {
+                return _fail(Error::InvalidSize);
+            }
+            break;
+        case State::Extension:
+            if (c == '\r') {
+                _state = State::SizeLf;
+            }
+            break;
+        case State::SizeLf:
+            if (c != '\n') {
+                return _fail(Error::InvalidSize);
+            }
+            _state = _chunkRemaining > 0 ? State::Data : State::TrailerStart;
+            break;
+        case State::DataCr:
+            if (c != '\r') {
+                return _fail(Error::InvalidDelimiter);
+            }
+            _state = State::DataLf;
+            break;
+        case State::DataLf:
+            if (c != '\n') {
+                return _fail(Error::InvalidDelimiter);
+            }
+            _state = State::Size;
+            _sizeDigits = 0;
+            break;
+        case State::TrailerStart:
+            _state = (c == '\r') ? State::EndLf : State::Trailer;
+            break;
+        case State::Trailer:
+            if (c == '\r') {
+                _state = State::TrailerLf;
+            }
+            break;
+        case State::TrailerLf:
+            if (c != '\n') {
+                return _fail(Error::InvalidTrailer);
+            }
+            _state = State::TrailerStart;
+            break;
+        case State::EndLf:
+            if (c != '\n') {
+                return _fail(Error::InvalidTrailer);
+            }
+            _state = State::Done;
+            break;
+        case State::Data:
+        case State::Done:
+        case State::Error:
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Read decoded data from the stream
+ *
+ * Returns 0 when no data is available yet (check isDone() and hasError() to distinguish the end of data).
+ *
+ * @param stream stream of chunked body
+ * @param buf buffer to store data
+ * @param len buffer size
+ * @return length of data stored to the buffer
+ */
+size_t ChunkedDecoder::read(Stream *stream, uint8_t *buf, size_t len) {
+    size_t total = 0;
+    while (total < len && _state != State::Done && _state != State::Error) {
+        auto available = stream->available();
+        if (available <= 0) {
+            break;
+        }
+        if (_state == State::Data) {
+            auto n = std::min(std::min(len - total, _chunkRemaining), (size_t) available);
+            // never waits because n bytes are available
+            auto readBytes = stream->readBytes(buf + total, n);
+            if (readBytes == 0) {
+                break;
+            }
+            total += readBytes;
+            consumeData(readBytes);
+        } else {
+            auto c = stream->read();
+            if (c < 0) {
+                break;
+            }
+            feed((uint8_t) c);
+        }
+    }
+    return total;
+}
+
+/**
+ * Reset to the initial state
+ */
+void ChunkedDecoder::reset() {
+    _state = State::Size;
+    _error = Error::None;
+    _sizeDigits = 0;
+    _chunkRemaining = 0;
+}
+
+/**
+ * Notify that chunk data is consumed
+ *
+ * @param len length of consumed data (<= dataRemaining())
+ */
+void ChunkedDecoder::consumeData(size_t len) {
+    _chunkRemaining -= len;
+    if (_chunkRemaining == 0) {
+        _state = State::DataCr;
+    }
+}
+
+/**
+ * Get description of the error
+ *
+ * @param error error
+ * @return description
+ */
+const char *ChunkedDecoder::errorToString(Error error) {
+    switch (error) {
+        case Error::None:
+            return "No error";
+        case Error::SizeTooLong:
+            return "Invalid chunk size (too long)";
+        case Error::InvalidSize:
+            return "Invalid chunk size";
+        case Error::InvalidDelimiter:
+            return "Invalid chunk delimiter";
+        case Error::InvalidTrailer:
+            return "Invalid trailer";
+    }
+    return "Unknown error";
+}
+
+bool ChunkedDecoder::_fail(Error error) {
+    _state = State::Error;
+    _error = error;
+    return false;
+}
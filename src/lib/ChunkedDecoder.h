@@ -0,0 +1,78 @@
+#if !defined(LIB_CHUNKED_DECODER_H)
+#define LIB_CHUNKED_DECODER_H
+
+#include <Arduino.h>
+
+/**
+ * Decoder for HTTP chunked transfer coding
+ * https://www.rfc-editor.org/rfc/rfc9112#name-chunked-transfer-coding
+ *
+ * Resumable state machine: each read() consumes only the bytes already available on the stream,
+ * never waits, and writes chunk data directly into the caller's buffer.
+ */
+class ChunkedDecoder {
+public:
+    /// reason of the error
+    enum class Error {
+        None,
+        /// chunk size has too many digits
+        SizeTooLong,
+        /// chunk size line is malformed
+        InvalidSize,
+        /// chunk data is not followed by CRLF
+        InvalidDelimiter,
+        /// trailer section is malformed
+        InvalidTrailer,
+    };
+
+    bool feed(uint8_t c);
+
+    size_t read(Stream *stream, uint8_t *buf, size_t len);
+
+    void reset();
+
+    bool isDone() const { return _state == State::Done; }
+
+    bool hasError() const { return _state == State::Error; }
+
+    Error getError() const { return _error; }
+
+    static const char *errorToString(Error error);
+
+    /// remaining bytes of the current chunk data
+    size_t dataRemaining() const { return _state == State::Data ? _chunkRemaining : 0; }
+
+    void consumeData(size_t len);
+
+private:
+    enum class State {
+        Size,
+        /// whitespace after the chunk size
+        SizeEnd,
+        Extension,
+        SizeLf,
+        Data,
+        DataCr,
+        DataLf,
+        TrailerStart,
+        Trailer,
+        TrailerLf,
+        EndLf,
+        Done,
+        Error,
+    };
+
+    State _state = State::Size;
+
+    Error _error = Error::None;
+
+    /// number of digits of the chunk size
+    int _sizeDigits = 0;
+
+    /// remaining bytes of the current chunk
+    size_t _chunkRemaining = 0;
+
+    bool _fail(Error error);
+};
+
+#endif // !defined(LIB_CHUNKED_DECODER_H)
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <memory>
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <lwip/sockets.h>
+
+#include "lib/ConnectionPool.h"
+
+/**
+ * Wait until data arrives on the connection
+ *
+ * Data already decrypted by TLS is reported by available(), so watching the socket is enough
+ * when nothing is available.
+ *
+ * @param timeout max time to wait (ms)
+ */
+void PooledConnection::waitReadable(unsigned long timeout) {
+    auto fd = _secure ? static_cast<WiFiClientSecure *>(_client.get())->fd() : _client->fd();
+    if (fd < 0) {
+        vTaskDelay(1);
+        return;
+    }
+    fd_set readFds;
+    FD_ZERO(&readFds);
+    FD_SET(fd, &readFds);
+    timeval tv{(time_t) (timeout / 1000), (suseconds_t) ((timeout % 1000) * 1000)};
+    select(fd + 1, &readFds, nullptr, nullptr, &tv);
+}
+
+/**
+ * Get connection to the host of URL
+ *
+ * An idle connection to the same host is reused if it is still open.
+ * The connection is returned to the pool when the last reference is released.
+ *
+ * @param url URL (http:// or https://)
+ * @param onCreateSecureClient callback to setup new secure client (set CA certificate, etc.)
+ * @param reuse false: always open a new connection (to retry a request failed on a kept-alive one)
+ * @return connection
+ */
+std::shared_ptr<PooledConnection> ConnectionPool::acquire(
+        const String &url, const std::function<void(WiFiClientSecure *)> &onCreateSecureClient, bool reuse) {
+    // Parse scheme, host and port
+    bool secure = url.startsWith("https://");
+    auto hostStart = url.indexOf("://") + 3;
+    auto hostEnd = url.indexOf('/', hostStart);
+    auto host = url.substring(hostStart, hostEnd < 0 ? url.length() : hostEnd);
+    uint16_t port = secure ? 443 : 80;
+    auto portStart = host.indexOf(':');
+    if (portStart >= 0) {
+        port = host.substring(portStart + 1).toInt();
+        host = host.substring(0, portStart);
+    }
+
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto now = millis();
+    _evict(now);
+    PooledConnection *conn = nullptr;
+    for (const auto &c: _connections) {
+        if (reuse && !c->_inUse && c->_secure == secure && c->_port == port && c->_host == host) {
+            conn = c.get();
+            break;
+        }
+    }
+    if (conn != nullptr && !conn->_client->connected()) {
+        // closed by peer
+        _remove(conn);
+        conn = nullptr;
+    }
+    bool hit = conn != nullptr;
+    if (hit) {
+        _stats.hits++;
+    } else {
+        _stats.misses++;
+        if (_connections.size() >= CONNECTION_POOL_MAX_SIZE) {
+            // Close the least recently used idle connection
+            PooledConnection *lru = nullptr;
+            for (const auto &c: _connections) {
+                if (!c->_inUse && (lru == nullptr || c->_lastUsed < lru->_lastUsed)) {
+                    lru = c.get();
+                }
+            }
+            if (lru != nullptr) {
+                _remove(lru);
+                _stats.evictions++;
+            }
+        }
+        auto newConn = std::make_unique<PooledConnection>();
+        newConn->_host = host;
+        newConn->_port = port;
+        newConn->_secure = secure;
+        if (secure) {
+            auto client = new WiFiClientSecure();
+            if (onCreateSecureClient != nullptr) {
+                onCreateSecureClient(client);
+            }
+            newConn->_client = std::unique_ptr<WiFiClient>(client);
+        } else {
+            newConn->_client = std::make_unique<WiFiClient>();
+        }
+        conn = newConn.get();
+        _connections.push_back(std::move(newConn));
+    }
+    conn->_inUse = true;
+    conn->_reusable = false;
+    conn->_reused = hit;
+    // Reset per-request state left by the previous user
+    conn->_http.setReuse(true);
+    conn->_http.setAuthorization("");
+    conn->_http.setTimeout(HTTPCLIENT_DEFAULT_TCP_TIMEOUT);
+    xSemaphoreGive(_lock);
+
+    if (!hit) {
+        // Connect (and handshake) here to measure the time, HTTPClient uses the connected client as is
+        auto start = millis();
+        if (!conn->_client->connect(host.c_str(), port)) {
+            Serial.printf("ERROR: ConnectionPool: Failed to connect %s:%d\n", host.c_str(), port);
+        } else {
+            auto elapsed = (uint32_t) (millis() - start);
+            xSemaphoreTake(_lock, portMAX_DELAY);
+            _stats.connectTimeTotal += elapsed;
+            _stats.connectTimeMax = std::max(_stats.connectTimeMax, elapsed);
+            xSemaphoreGive(_lock);
+            Serial.printf("ConnectionPool: Connected %s:%d (%d ms)\n", host.c_str(), port, (int) elapsed);
+        }
+    }
+    return {conn, [this](PooledConnection *c) { _release(c); }};
+}
+
+/**
+ * Check if the request failed because the kept-alive connection had been closed by the peer
+ *
+ * Such a request can be sent again on a new connection.
+ *
+ * @param conn connection
+ * @param httpCode result of HTTPClient request
+ * @return true: failed on stale connection, false: other result
+ */
+bool ConnectionPool::isStaleError(const PooledConnection &conn, int httpCode) {
+    return conn.isReused() && (httpCode == HTTPC_ERROR_SEND_HEADER_FAILED ||
+                               httpCode == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+                               httpCode == HTTPC_ERROR_NOT_CONNECTED ||
+                               httpCode == HTTPC_ERROR_CONNECTION_LOST);
+}
+
+/**
+ * Get statistics
+ *
+ * @return statistics
+ */
+ConnectionPool::Stats ConnectionPool::getStats() {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto stats = _stats;
+    stats.size = _connections.size();
+    xSemaphoreGive(_lock);
+    return stats;
+}
+
+/**
+ * Return the connection to the pool
+ *
+ * @param conn connection
+ */
+void ConnectionPool::_release(PooledConnection *conn) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    conn->_inUse = false;
+    conn->_lastUsed = millis();
+    if (!conn->_reusable || !conn->_client->connected()) {
+        _remove(conn);
+    } else if (_connections.size() > CONNECTION_POOL_MAX_SIZE) {
+        _remove(conn);
+        _stats.evictions++;
+    }
+    xSemaphoreGive(_lock);
+}
+
+/**
+ * Close and remove the connection from the pool
+ *
+ * @param conn connection
+ */
+void ConnectionPool::_remove(PooledConnection *conn) {
+    _connections.erase(std::remove_if(_connections.begin(), _connections.end(),
+                                      [conn](const std::unique_ptr<PooledConnection> &c) {
+                                          return c.get() == conn;
+                                      }), _connections.end());
+}
+
+/**
+ * Close idle connections not used for a while
+ *
+ * @param now current time
+ */
+void ConnectionPool::_evict(unsigned long now) {
+    auto size = _connections.size();
+    _connections.erase(std::remove_if(_connections.begin(), _connections.end(),
+                                      [now](const std::unique_ptr<PooledConnection> &c) {
+                                          return !c->_inUse && now - c->_lastUsed > CONNECTION_POOL_IDLE_TIMEOUT;
+                                      }), _connections.end());
+    _stats.evictions += size - _connections.size();
+}
@@ -0,0 +1,98 @@
+#if !defined(LIB_CONNECTION_POOL_H)
+#define LIB_CONNECTION_POOL_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+
+/// max number of connections kept alive
+#if !defined(CONNECTION_POOL_MAX_SIZE)
+#define CONNECTION_POOL_MAX_SIZE 2
+#endif
+
+/// time to close idle connection (ms)
+#if !defined(CONNECTION_POOL_IDLE_TIMEOUT)
+#define CONNECTION_POOL_IDLE_TIMEOUT 30000
+#endif
+
+class PooledConnection {
+public:
+    /// HTTP client bound to this connection (keeps the connection open on end())
+    HTTPClient &http() { return _http; }
+
+    WiFiClient *client() { return _client.get(); }
+
+    /**
+     * Mark whether the connection can be reused
+     *
+     * Set true only after the whole response was read and HTTPClient::end() was called.
+     */
+    void setReusable(bool reusable) { _reusable = reusable; }
+
+    /// true: the connection was kept alive from a previous request
+    bool isReused() const { return _reused; }
+
+    void waitReadable(unsigned long timeout);
+
+private:
+    friend class ConnectionPool;
+
+    String _host;
+    uint16_t _port = 0;
+    bool _secure = false;
+    bool _inUse = false;
+    bool _reusable = false;
+    bool _reused = false;
+    unsigned long _lastUsed = 0;
+
+    /// network client (declared before _http to outlive it)
+    std::unique_ptr<WiFiClient> _client;
+
+    HTTPClient _http;
+};
+
+class ConnectionPool {
+public:
+    struct Stats {
+        /// number of requests served by an open connection
+        uint32_t hits;
+        /// number of requests that required a new connection
+        uint32_t misses;
+        /// number of connections closed by the pool
+        uint32_t evictions;
+        /// total time to connect (including TLS handshake) (ms)
+        uint32_t connectTimeTotal;
+        /// max time to connect (including TLS handshake) (ms)
+        uint32_t connectTimeMax;
+        /// number of connections in the pool
+        uint32_t size;
+    };
+
+    ConnectionPool() = default;
+
+    std::shared_ptr<PooledConnection> acquire(
+            const String &url, const std::function<void(WiFiClientSecure *)> &onCreateSecureClient,
+            bool reuse = true);
+
+    static bool isStaleError(const PooledConnection &conn, int httpCode);
+
+    Stats getStats();
+
+private:
+    SemaphoreHandle_t _lock = xSemaphoreCreateMutex();
+
+    std::vector<std::unique_ptr<PooledConnection>> _connections;
+
+    Stats _stats{};
+
+    void _release(PooledConnection *conn);
+
+    void _remove(PooledConnection *conn);
+
+    void _evict(unsigned long now);
+};
+
+#endif // !defined(LIB_CONNECTION_POOL_H)
@@ -0,0 +1,338 @@
+#include <cstdlib>
+#include <cstring>
+#include <Arduino.h>
+
+#include "lib/JsonExtractor.h"
+
+/// max nesting level of skipped values
+static const int JSON_MAX_DEPTH = 32;
+
+static const char *skipWhitespace(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+    return p;
+}
+
+/**
+ * Skip string
+ *
+ * @param p position of '"'
+ * @param end end of text
+ * @return position after the closing '"' (nullptr: invalid)
+ */
+static const char *skipString(const char *p, const char *end) {
+    for (p++; p < end; p++) {
+        if (*p == '\\') {
+            p++;
+        } else if (*p == '"') {
+            return p + 1;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Skip value of any type
+ *
+ * @param p start of value
+ * @param end end of text
+ * @return position after the value (nullptr: invalid)
+ */
+static const char *skipValue(const char *p, const char *end) {
+    if (p >= end) {
+        return nullptr;
+    }
+    if (*p == '"') {
+        return skipString(p, end);
+    }
+    if (*p != '{' && *p != '[') {
+        // number, true, false or null
+        auto start = p;
+        while (p < end && strchr(",]} \t\r\n", *p) == nullptr) {
+            p++;
+        }
+        auto len = (size_t) (p - start);
+        auto valid = (len > 0 && (*start == '-' || isdigit(*start)))
+                     || (len == 4 && (memcmp(start, "true", 4) == 0 || memcmp(start, "null", 4) == 0))
+                     || (len == 5 && memcmp(start, "false", 5) == 0);
+        return valid ? p : nullptr;
+    }
+    int depth = 0;
+    while (p < end) {
+        if (*p == '"') {
+            p = skipString(p, end);
+            if (p == nullptr) {
+                return nullptr;
+            }
+            continue;
+        }
+        if (*p == '{' || *p == '[') {
+            if (++depth > JSON_MAX_DEPTH) {
+                return nullptr;
+            }
+        } else if (*p == '}' || *p == ']') {
+            if (--depth == 0) {
+                return p + 1;
+            }
+        }
+        p++;
+    }
+    return nullptr;
+}
+
+/**
+ * Find member of object
+ *
+ * @param p position of '{'
+ * @param end end of text
+ * @param key key (without escape)
+ * @param value start of the value
+ * @return result
+ */
+static JsonExtractor::Result findMember(const char *p, const char *end, const std::string &key, const char *&value) {
+    p = skipWhitespace(p + 1, end);
+    if (p < end && *p == '}') {
+        return JsonExtractor::Result::NotFound;
+    }
+    while (p < end) {
+        if (*p != '"') {
+            return JsonExtractor::Result::Invalid;
+        }
+        auto keyEnd = skipString(p, end);
+        if (keyEnd == nullptr) {
+            return JsonExtractor::Result::Invalid;
+        }
+        auto matched = (size_t) (keyEnd - p - 2) == key.size() && memcmp(p + 1, key.data(), key.size()) == 0;
+        p = skipWhitespace(keyEnd, end);
+        if (p >= end || *p != ':') {
+            return JsonExtractor::Result::Invalid;
+        }
+        p = skipWhitespace(p + 1, end);
+        if (matched) {
+            value = p;
+            return JsonExtractor::Result::Found;
+        }
+        p = skipValue(p, end);
+        if (p == nullptr) {
+            return JsonExtractor::Result::Invalid;
+        }
+        p = skipWhitespace(p, end);
+        if (p >= end) {
+            return JsonExtractor::Result::Invalid;
+        }
+        if (*p == '}') {
+            return JsonExtractor::Result::NotFound;
+        }
+        if (*p != ',') {
+            return JsonExtractor::Result::Invalid;
+        }
+        p = skipWhitespace(p + 1, end);
+    }
+    return JsonExtractor::Result::Invalid;
+}
+
+/**
+ * Find element of array
+ *
+ * @param p position of '['
+ * @param end end of text
+ * @param index index
+ * @param value start of the element
+ * @return result
+ */
+static JsonExtractor::Result findElement(const char *p, const char *end, size_t index, const char *&value) {
+    p = skipWhitespace(p + 1, end);
+    if (p < end && *p == ']') {
+        return JsonExtractor::Result::NotFound;
+    }
+    for (size_t i = 0; p < end; i++) {
+        if (i == index) {
+            value = p;
+            return JsonExtractor::Result::Found;
+        }
+        p = skipValue(p, end);
+        if (p == nullptr) {
+            return JsonExtractor::Result::Invalid;
+        }
+        p = skipWhitespace(p, end);
+        if (p >= end) {
+            return JsonExtractor::Result::Invalid;
+        }
+        if (*p == ']') {
+            return JsonExtractor::Result::NotFound;
+        }
+        if (*p != ',') {
+            return JsonExtractor::Result::Invalid;
+        }
+        p = skipWhitespace(p + 1, end);
+    }
+    return JsonExtractor::Result::Invalid;
+}
+
+/**
+ * Constructor
+ *
+ * @param path keys or array indices delimited by "." (e.g. "choices.0.delta.content")
+ */
+JsonExtractor::JsonExtractor(const char *path) {
+    std::string segment;
+    for (auto p = path; *p != '\0'; p++) {
+        if (*p == '.') {
+            _path.push_back(segment);
+            segment.clear();
+        } else {
+            segment += *p;
+        }
+    }
+    _path.push_back(segment);
+}
+
+/**
+ * Extract string value at the path
+ *
+ * The text after the value is not validated.
+ *
+ * @param json json text
+ * @param len length of json text
+ * @param value extracted value
+ * @return result
+ */
+JsonExtractor::Result JsonExtractor::extract(const char *json, size_t len, String &value) {
+    auto end = json + len;
+    auto p = skipWhitespace(json, end);
+    for (const auto &segment: _path) {
+        if (p >= end) {
+            return Result::Invalid;
+        }
+        Result result;
+        if (*p == '{') {
+            result = findMember(p, end, segment, p);
+        } else if (*p == '[' && !segment.empty() && isdigit(segment[0])) {
+            result = findElement(p, end, strtoul(segment.c_str(), nullptr, 10), p);
+        } else {
+            result = skipValue(p, end) != nullptr ? Result::NotFound : Result::Invalid;
+        }
+        if (result != Result::Found) {
+            return result;
+        }
+    }
+    if (p >= end) {
+        return Result::Invalid;
+    }
+    if (*p != '"') {
+        return skipValue(p, end) != nullptr ? Result::NotFound : Result::Invalid;
+    }
+    auto result = _unescape(p, end);
+    if (result == Result::Found) {
+        value = _buf.data();
+    }
+    return result;
+}
+
+/**
+ * Append code point as UTF-8
+ */
+static void appendUtf8(std::vector<char> &buf, uint32_t cp) {
+    if (cp < 0x80) {
+        buf.push_back((char) cp);
+    } else if (cp < 0x800) {
+        buf.push_back((char) (0xc0 | (cp >> 6)));
+        buf.push_back((char) (0x80 | (cp & 0x3f)));
+    } else if (cp < 0x10000) {
+        buf.push_back((char) (0xe0 | (cp >> 12)));
+        buf.push_back((char) (0x80 | ((cp >> 6) & 0x3f)));
+        buf.push_back((char) (0x80 | (cp & 0x3f)));
+    } else {
+        buf.push_back((char) (0xf0 | (cp >> 18)));
+        buf.push_back((char) (0x80 | ((cp >> 12) & 0x3f)));
+        buf.push_back((char) (0x80 | ((cp >> 6) & 0x3f)));
+        buf.push_back((char) (0x80 | (cp & 0x3f)));
+    }
+}
+
+/**
+ * Parse 4 hex digits of \\u escape
+ *
+ * @return code unit (-1: invalid)
+ */
+static int32_t parseHex4(const char *p, const char *end) {
+    if (end - p < 4) {
+        return -1;
+    }
+    int32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        auto c = p[i];
+        if (!isxdigit(c)) {
+            return -1;
+        }
+        value = value * 16 + (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+    }
+    return value;
+}
+
+/**
+ * Unescape string into the buffer (null-terminated)
+ *
+ * @param p position of '"'
+ * @param end end of text
+ * @return result
+ */
+JsonExtractor::Result JsonExtractor::_unescape(const char *p, const char *end) {
+    _buf.clear();
+    for (p++; p < end; p++) {
+        if (*p == '"') {
+            _buf.push_back('\0');
+            return Result::Found;
+        }
+        if (*p != '\\') {
+            _buf.push_back(*p);
+            continue;
+        }
+        if (++p >= end) {
+            break;
+        }
+        switch (*p) {
+            case '"':
+            case '\\':
+            case '/':
+                _buf.push_back(*p);
+                break;
+            case 'b':
+                _buf.push_back('\b');
+                break;
+            case 'f':
+                _buf.push_back('\f');
+                break;
+            case 'n':
+                _buf.push_back('\n');
+                break;
+            case 'r':
+                _buf.push_back('\r');
+                break;
+            case 't':
+                _buf.push_back('\t');
+                break;
+            case 'u': {
+                auto cp = parseHex4(p + 1, end);
+                if (cp < 0) {
+                    return Result::Invalid;
+                }
+                p += 4;
+                if (cp >= 0xd800 && cp < 0xdc00 && end - p > 6 && p[1] == '\\' && p[2] == 'u') {
+                    // surrogate pair
+                    auto low = parseHex4(p + 3, end);
+                    if (low >= 0xdc00 && low < 0xe000) {
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                        p += 6;
+                    }
+                }
+                appendUtf8(_buf, (uint32_t) cp);
+                break;
+            }
+            default:
+                return Result::Invalid;
+        }
+    }
+    return Result::Invalid;
+}
@@ -0,0 +1,39 @@
+#if !defined(LIB_JSON_EXTRACTOR_H)
+#define LIB_JSON_EXTRACTOR_H
+
+#include <string>
+#include <vector>
+#include <Arduino.h>
+
+/**
+ * Extractor of one string value from json text without building DOM
+ *
+ * The text is scanned in place to the value at the path, and other values are skipped.
+ * Only the value is unescaped into a buffer reused across calls, so memory does not depend on the text size.
+ */
+class JsonExtractor {
+public:
+    enum class Result {
+        /// string value is found
+        Found,
+        /// no value at the path, or not a string
+        NotFound,
+        /// invalid json
+        Invalid,
+    };
+
+    explicit JsonExtractor(const char *path);
+
+    Result extract(const char *json, size_t len, String &value);
+
+private:
+    /// keys or array indices
+    std::vector<std::string> _path;
+
+    /// buffer to unescape the value
+    std::vector<char> _buf;
+
+    Result _unescape(const char *p, const char *end);
+};
+
+#endif // !defined(LIB_JSON_EXTRACTOR_H)
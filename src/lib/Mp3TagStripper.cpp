@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cstring>
+
+#include "lib/Mp3TagStripper.h"
+
+/**
+ * Constructor
+ *
+ * @param onWrite callback to write the audio
+ */
+Mp3TagStripper::Mp3TagStripper(const WriteCallback &onWrite) : _onWrite(onWrite) {}
+
+/**
+ * Feed bytes of the MP3 stream
+ *
+ * @param data bytes
+ * @param len length of bytes
+ * @return true: success, false: failed to write
+ */
+bool Mp3TagStripper::feed(const uint8_t *data, size_t len) {
+    if (_state == State::Header) {
+        auto n = std::min(len, ID3V2_HEADER_SIZE - _headerLength);
+        memcpy(_header + _headerLength, data, n);
+        _headerLength += n;
+        data += n;
+        len -= n;
+        if (_headerLength < ID3V2_HEADER_SIZE) {
+            return true;
+        }
+        if (memcmp(_header, "ID3", 3) == 0) {
+            // Tag size is a syncsafe integer excluding the header (and the footer if flagged)
+            _skip = ((uint32_t) (_header[6] & 0x7f) << 21) | ((uint32_t) (_header[7] & 0x7f) << 14) |
+                    ((uint32_t) (_header[8] & 0x7f) << 7) | (uint32_t) (_header[9] & 0x7f);
+            if (_header[5] & 0x10) {
+                _skip += ID3V2_HEADER_SIZE;
+            }
+            _state = State::SkipTag;
+        } else {
+            _state = State::Sync;
+            if (!_feedAudio(_header, _headerLength)) {
+                return false;
+            }
+        }
+    }
+    if (_state == State::SkipTag) {
+        auto n = (size_t) std::min((uint32_t) len, _skip);
+        data += n;
+        len -= n;
+        _skip -= n;
+        if (_skip > 0) {
+            return true;
+        }
+        _state = State::Sync;
+    }
+    return _feedAudio(data, len);
+}
+
+/**
+ * Write the rest of the audio at the end of the stream
+ *
+ * @return true: success, false: failed to write
+ */
+bool Mp3TagStripper::finish() {
+    if (_state == State::Header) {
+        // Too short to have a tag
+        _state = State::Sync;
+        if (!_feedAudio(_header, _headerLength)) {
+            return false;
+        }
+    }
+    if (_tailLength == ID3V1_SIZE && memcmp(_tail, "TAG", 3) == 0) {
+        _tailLength = 0;
+        return true;
+    }
+    auto result = _write(_tail, _tailLength);
+    _tailLength = 0;
+    return result;
+}
+
+/**
+ * Feed bytes after ID3v2 tag
+ *
+ * @param data bytes
+ * @param len length of bytes
+ * @return true: success, false: failed to write
+ */
+bool Mp3TagStripper::_feedAudio(const uint8_t *data, size_t len) {
+    if (_state == State::Sync) {
+        // Search frame sync (11 bits set), which may be split between feeds
+        size_t i = 0;
+        for (; i < len; i++) {
+            if (_lastFF && (data[i] & 0xe0) == 0xe0) {
+                break;
+            }
+            _lastFF = data[i] == 0xff;
+        }
+        if (i == len) {
+            return true;
+        }
+        _state = State::Audio;
+        static const uint8_t SYNC_FIRST = 0xff;
+        if (!_writeAudio(&SYNC_FIRST, 1)) {
+            return false;
+        }
+        data += i;
+        len -= i;
+    }
+    return _writeAudio(data, len);
+}
+
+/**
+ * Write audio holding back last bytes which may be ID3v1 tag
+ *
+ * @param data bytes
+ * @param len length of bytes
+ * @return true: success, false: failed to write
+ */
+bool Mp3TagStripper::_writeAudio(const uint8_t *data, size_t len) {
+    auto total = _tailLength + len;
+    if (total > ID3V1_SIZE) {
+        auto out = total - ID3V1_SIZE;
+        auto fromTail = std::min(out, _tailLength);
+        if (!_write(_tail, fromTail)) {
+            return false;
+        }
+        memmove(_tail, _tail + fromTail, _tailLength - fromTail);
+        _tailLength -= fromTail;
+        auto fromData = out - fromTail;
+        if (!_write(data, fromData)) {
+            return false;
+        }
+        data += fromData;
+        len -= fromData;
+    }
+    memcpy(_tail + _tailLength, data, len);
+    _tailLength += len;
+    return true;
+}
+
+bool Mp3TagStripper::_write(const uint8_t *data, size_t len) {
+    if (len == 0) {
+        return true;
+    }
+    if (!_onWrite(data, len)) {
+        return false;
+    }
+    _length += len;
+    return true;
+}
@@ -0,0 +1,77 @@
+#if !defined(LIB_MP3_TAG_STRIPPER_H)
+#define LIB_MP3_TAG_STRIPPER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+/**
+ * Filter to pass only MPEG audio frames of an MP3 stream
+ *
+ * ID3v2 tag at the start, bytes before the first frame sync and ID3v1 tag at the end are dropped,
+ * so that MP3 streams can be concatenated into one decoder stream.
+ */
+class Mp3TagStripper {
+public:
+    /**
+     * Callback to write the audio
+     *
+     * return: true: success, false: failure
+     */
+    typedef std::function<bool(const uint8_t *data, size_t len)> WriteCallback;
+
+    explicit Mp3TagStripper(const WriteCallback &onWrite);
+
+    bool feed(const uint8_t *data, size_t len);
+
+    bool finish();
+
+    /// length of the written audio
+    uint32_t length() const {
+        return _length;
+    }
+
+private:
+    enum class State {
+        Header,
+        SkipTag,
+        Sync,
+        Audio,
+    };
+
+    /// size of ID3v2 header
+    static const size_t ID3V2_HEADER_SIZE = 10;
+
+    /// size of ID3v1 tag
+    static const size_t ID3V1_SIZE = 128;
+
+    WriteCallback _onWrite;
+
+    State _state = State::Header;
+
+    /// first bytes to check ID3v2 header
+    uint8_t _header[ID3V2_HEADER_SIZE];
+
+    size_t _headerLength = 0;
+
+    /// bytes of ID3v2 tag left to skip
+    uint32_t _skip = 0;
+
+    /// last byte was 0xFF while searching frame sync
+    bool _lastFF = false;
+
+    /// last bytes held back to check ID3v1 tag
+    uint8_t _tail[ID3V1_SIZE];
+
+    size_t _tailLength = 0;
+
+    uint32_t _length = 0;
+
+    bool _feedAudio(const uint8_t *data, size_t len);
+
+    bool _writeAudio(const uint8_t *data, size_t len);
+
+    bool _write(const uint8_t *data, size_t len);
+};
+
+#endif // !defined(LIB_MP3_TAG_STRIPPER_H)
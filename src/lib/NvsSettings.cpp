@@ -7,6 +7,13 @@
 #include "lib/nvs.h"
 #include "lib/utils.h"
 
+/**
+ * Constructor
+ *
+ * @param key key string delimited by "." (must be static)
+ */
+SettingsKey::SettingsKey(const char *key) : _key(key), _path(splitString(key, ".")) {}
+
 NvsSettings::NvsSettings(String nvsNamespace, String nvsKey)
         : _nvsNamespace(std::move(nvsNamespace)), _nvsKey(std::move(nvsKey)) {
 }
@@ -19,7 +26,10 @@ NvsSettings::NvsSettings(String nvsNamespace, String nvsKey)
 bool NvsSettings::load() {
     auto settings = nvsLoadString(_nvsNamespace, _nvsKey, SETTINGS_MAX_SIZE);
     if (settings != nullptr) {
-        return deserializeJson(_settings, settings->c_str()) == DeserializationError::Ok;
+        auto result = deserializeJson(_settings, settings->c_str()) == DeserializationError::Ok;
+        _dirty = false;
+        _incrementRevision();
+        return result;
     }
     return false;
 }
@@ -35,6 +45,98 @@ bool NvsSettings::save() {
     return nvsSaveString(_nvsNamespace, _nvsKey, settings.c_str());
 }
 
+/**
+ * Set write-behind mode
+ *
+ * @param delay quiet period to write changes (ms) (0: write on every change)
+ */
+void NvsSettings::setWriteBehind(unsigned long delay) {
+    _writeBehindDelay = delay;
+}
+
+/**
+ * Begin batch (changes are not written until commit())
+ */
+void NvsSettings::begin() {
+    _batchDepth++;
+}
+
+/**
+ * Commit batch (write changes)
+ *
+ * @return true: success, false: failure
+ */
+bool NvsSettings::commit() {
+    if (_batchDepth > 0) {
+        _batchDepth--;
+    }
+    return _batchDepth > 0 || flush();
+}
+
+/**
+ * Write changes now
+ *
+ * @return true: success, false: failure (kept changed to retry)
+ */
+bool NvsSettings::flush() {
+    if (!_dirty) {
+        return true;
+    }
+    if (!save()) {
+        _writeFailed = true;
+        return false;
+    }
+    _dirty = false;
+    _writeFailed = false;
+    return true;
+}
+
+/**
+ * Write changes after quiet period (for write-behind mode)
+ */
+void NvsSettings::loop() {
+    if (_dirty && _batchDepth == 0 && millis() - _changedTime >= _writeBehindDelay) {
+        if (!flush()) {
+            Serial.printf("ERROR: Failed to write settings to NVS\n");
+            _changedTime = millis(); // retry after quiet period
+        }
+    }
+}
+
+/**
+ * Set callback on every change (called from the task changing the settings)
+ *
+ * @param onChanged callback
+ */
+void NvsSettings::setOnChanged(const std::function<void()> &onChanged) {
+    _onChanged = onChanged;
+}
+
+/**
+ * Increment the revision and notify the change
+ */
+void NvsSettings::_incrementRevision() {
+    _revision++;
+    if (_onChanged != nullptr) {
+        _onChanged();
+    }
+}
+
+/**
+ * Mark changed (and write if not deferred)
+ *
+ * @return true: success, false: failure (including deferred write failed before)
+ */
+bool NvsSettings::_changed() {
+    _incrementRevision();
+    _dirty = true;
+    _changedTime = millis();
+    if (_batchDepth > 0 || _writeBehindDelay > 0) {
+        return !_writeFailed;
+    }
+    return flush();
+}
+
 /**
  * Merge json objects
  * https://arduinojson.org/v6/how-to/merge-json-objects/
@@ -61,7 +163,7 @@ static void mergeJsonObjects(JsonVariant dst, JsonVariantConst src) {
  * @return true: success, false: failure
  */
 bool NvsSettings::load(const String &text, bool merge) {
-    DynamicJsonDocument tmp{SETTINGS_MAX_SIZE};
+    LargeJsonDocument tmp{SETTINGS_MAX_SIZE};
     bool result = deserializeJson(tmp, text) == DeserializationError::Ok;
     if (result) {
         if (merge) {
@@ -70,7 +172,7 @@ bool NvsSettings::load(const String &text, bool merge) {
             _settings = tmp;
         }
     }
-    return result && save();
+    return result && _changed();
 }
 
 /**
@@ -95,6 +197,26 @@ JsonVariant NvsSettings::get(const String &keyStr) {
     return _get(keys);
 }
 
+/**
+ * Check if the key exists
+ *
+ * @param key key split in advance
+ * @return true: exists, false: not exists
+ */
+bool NvsSettings::has(const SettingsKey &key) {
+    return !_get(key.path()).isNull();
+}
+
+/**
+ * Get the value
+ *
+ * @param key key split in advance
+ * @return value (can be cast to any type)
+ */
+JsonVariant NvsSettings::get(const SettingsKey &key) {
+    return _get(key.path());
+}
+
 /**
  * Set the value
  *
@@ -111,7 +233,7 @@ bool NvsSettings::set(const String &keyStr, const T &value) {
     } else {
         _getParentOrCreate(keys)[key].set(value);
     }
-    return save();
+    return _changed();
 }
 
 template bool NvsSettings::set<std::string>(const String &key, const std::string &value);
@@ -136,7 +258,7 @@ bool NvsSettings::remove(const String &keyStr) {
     } else {
         _getParentOrCreate(keys).remove(key);
     }
-    return save();
+    return _changed();
 }
 
 /**
@@ -193,7 +315,7 @@ bool NvsSettings::add(const String &keyStr, const T &value) {
         val = val[key];
     }
     val.add(value);
-    return save();
+    return _changed();
 }
 
 template bool NvsSettings::add<std::string>(const String &keyStr, const std::string &value);
@@ -220,7 +342,7 @@ bool NvsSettings::clear(const String &keyStr) {
         val = val[key];
     }
     val.clear();
-    return save();
+    return _changed();
 }
 
 /**
@@ -229,7 +351,7 @@ bool NvsSettings::clear(const String &keyStr) {
  * @param keys key list
  * @return json element
  */
-JsonVariant NvsSettings::_get(std::vector<std::string> &keys) {
+JsonVariant NvsSettings::_get(const std::vector<std::string> &keys) {
     JsonVariant val = _settings;
     for (const auto &key: keys) {
         if (std::all_of(key.begin(), key.end(), ::isdigit)) {
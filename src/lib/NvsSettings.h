@@ -1,12 +1,41 @@
 #if !defined(LIB_NVS_SETTINGS_H)
 #define LIB_NVS_SETTINGS_H
 
+#include <atomic>
+#include <functional>
 #include <vector>
 #include <ArduinoJson.h>
 
+#include "lib/arena.h"
+
 /// 設定 JSON サイズ
 static const size_t SETTINGS_MAX_SIZE = 4 * 1024;
 
+/**
+ * Key of settings split by "." in advance (for keys read frequently)
+ */
+class SettingsKey {
+public:
+    explicit SettingsKey(const char *key);
+
+    const char *c_str() const { return _key; }
+
+    const std::vector<std::string> &path() const { return _path; }
+
+private:
+    const char *_key;
+
+    std::vector<std::string> _path;
+};
+
+/**
+ * Settings stored as json in NVS
+ *
+ * Changes between begin() and commit() are written at once on commit().
+ * In write-behind mode, changes are written after a quiet period (loop() must be called periodically).
+ * NVS replaces the stored json atomically, so a power loss leaves either the previous or the new settings,
+ * and only changes not written yet are lost.
+ */
 class NvsSettings {
 public:
     explicit NvsSettings(String nvsNamespace, String nvsKey);
@@ -15,12 +44,26 @@ public:
 
     bool save();
 
+    void setWriteBehind(unsigned long delay);
+
+    void begin();
+
+    bool commit();
+
+    bool flush();
+
+    void loop();
+
     bool load(const String &text, bool merge = false);
 
     bool has(const String &keyStr);
 
+    bool has(const SettingsKey &key);
+
     JsonVariant get(const String &keyStr);
 
+    JsonVariant get(const SettingsKey &key);
+
     template<class T>
     bool set(const String &keyStr, const T &value);
 
@@ -36,13 +79,42 @@ public:
 
     bool clear(const String &keyStr);
 
+    /// revision of the settings, incremented on every change
+    uint32_t getRevision() const { return _revision; }
+
+    void setOnChanged(const std::function<void()> &onChanged);
+
 protected:
     String _nvsNamespace;
     String _nvsKey;
 
-    DynamicJsonDocument _settings{SETTINGS_MAX_SIZE};
+    LargeJsonDocument _settings{SETTINGS_MAX_SIZE};
+
+    std::atomic<uint32_t> _revision{0};
+
+    /// callback on every change of the revision
+    std::function<void()> _onChanged;
+
+    /// nesting level of begin()
+    int _batchDepth = 0;
+
+    /// true: changed but not written yet
+    bool _dirty = false;
+
+    /// time of the last change
+    unsigned long _changedTime = 0;
+
+    /// quiet period to write changes (0: write-through)
+    unsigned long _writeBehindDelay = 0;
+
+    /// true: the last write failed
+    bool _writeFailed = false;
+
+    bool _changed();
+
+    void _incrementRevision();
 
-    JsonVariant _get(std::vector<std::string> &keys);
+    JsonVariant _get(const std::vector<std::string> &keys);
 
     JsonVariant _getParentOrCreate(std::vector<std::string> &keys);
 };
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <cstring>
+
+#include "lib/PcmRingBuffer.h"
+#include "lib/arena.h"
+
+/**
+ * Constructor
+ *
+ * The capacity is rounded up to power of 2, so that positions stay continuous when the counters wrap around.
+ *
+ * @param capacity max number of samples
+ */
+PcmRingBuffer::PcmRingBuffer(size_t capacity) : _capacity(1) {
+    while (_capacity < capacity) {
+        _capacity <<= 1;
+    }
+    _buf = (int16_t *) arenaAlloc(Arena::Large, _capacity * sizeof(int16_t));
+}
+
+PcmRingBuffer::~PcmRingBuffer() {
+    arenaFree(_buf);
+}
+
+/**
+ * Write samples (called from the producer)
+ *
+ * @param data samples
+ * @param len number of samples
+ * @return number of written samples
+ */
+size_t PcmRingBuffer::write(const int16_t *data, size_t len) {
+    auto writeCount = _writeCount.load(std::memory_order_relaxed);
+    auto space = _capacity - (writeCount - _readCount.load(std::memory_order_acquire));
+    len = std::min(len, space);
+    auto pos = writeCount & (_capacity - 1);
+    auto first = std::min(len, _capacity - pos);
+    memcpy(_buf + pos, data, first * sizeof(int16_t));
+    memcpy(_buf, data + first, (len - first) * sizeof(int16_t));
+    _writeCount.store(writeCount + len, std::memory_order_release);
+    return len;
+}
+
+/**
+ * Read samples (called from the consumer)
+ *
+ * @param data buffer to read
+ * @param len max number of samples
+ * @return number of read samples
+ */
+size_t PcmRingBuffer::read(int16_t *data, size_t len) {
+    auto readCount = _readCount.load(std::memory_order_relaxed);
+    len = std::min(len, _writeCount.load(std::memory_order_acquire) - readCount);
+    auto pos = readCount & (_capacity - 1);
+    auto first = std::min(len, _capacity - pos);
+    memcpy(data, _buf + pos, first * sizeof(int16_t));
+    memcpy(data + first, _buf, (len - first) * sizeof(int16_t));
+    _readCount.store(readCount + len, std::memory_order_release);
+    return len;
+}
+
+/**
+ * Discard all samples (called from the consumer)
+ */
+void PcmRingBuffer::clear() {
+    _readCount.store(_writeCount.load(std::memory_order_acquire), std::memory_order_release);
+}
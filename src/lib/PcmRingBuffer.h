@@ -0,0 +1,55 @@
+#if !defined(LIB_PCM_RING_BUFFER_H)
+#define LIB_PCM_RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Ring buffer of PCM samples for one producer task and one consumer task
+ *
+ * Read and write positions are published through atomics, so no lock is needed between the two tasks.
+ * The storage is allocated from the large arena (PSRAM if available).
+ */
+class PcmRingBuffer {
+public:
+    explicit PcmRingBuffer(size_t capacity);
+
+    ~PcmRingBuffer();
+
+    PcmRingBuffer(const PcmRingBuffer &) = delete;
+
+    PcmRingBuffer &operator=(const PcmRingBuffer &) = delete;
+
+    /// true: storage is allocated
+    bool isAllocated() const {
+        return _buf != nullptr;
+    }
+
+    size_t capacity() const {
+        return _capacity;
+    }
+
+    /// number of samples to read
+    size_t available() const {
+        return _writeCount.load(std::memory_order_acquire) - _readCount.load(std::memory_order_acquire);
+    }
+
+    size_t write(const int16_t *data, size_t len);
+
+    size_t read(int16_t *data, size_t len);
+
+    void clear();
+
+private:
+    int16_t *_buf;
+    size_t _capacity;
+
+    /// total number of samples written (producer)
+    std::atomic<size_t> _writeCount{0};
+
+    /// total number of samples read (consumer)
+    std::atomic<size_t> _readCount{0};
+};
+
+#endif // !defined(LIB_PCM_RING_BUFFER_H)
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <Arduino.h>
+
+#include "lib/SentenceSegmenter.h"
+
+/**
+ * Get length of UTF-8 character from the first byte
+ *
+ * @param c first byte
+ * @return length (bytes)
+ */
+static size_t utf8CharLength(uint8_t c) {
+    if (c >= 0xf0) {
+        return 4;
+    } else if (c >= 0xe0) {
+        return 3;
+    } else if (c >= 0xc0) {
+        return 2;
+    }
+    return 1;
+}
+
+/**
+ * Constructor
+ *
+ * @param maxLength length to break long sentence (bytes)
+ */
+SentenceSegmenter::SentenceSegmenter(size_t maxLength) : _maxLength(maxLength) {}
+
+/**
+ * Feed received text
+ *
+ * @param text received text (may end in the middle of UTF-8 character)
+ * @param len length of received text
+ * @param onSentence callback on sentence
+ */
+void SentenceSegmenter::feed(const char *text, size_t len, const SentenceCallback &onSentence) {
+    _buf.append(text, len);
+    _process(false, onSentence);
+}
+
+/**
+ * Emit the rest of text as the last sentence
+ *
+ * @param onSentence callback on sentence
+ */
+void SentenceSegmenter::flush(const SentenceCallback &onSentence) {
+    _process(true, onSentence);
+    _emit(_buf.size(), onSentence);
+    reset();
+}
+
+void SentenceSegmenter::reset() {
+    _buf.clear();
+    _scanPos = 0;
+    _softBreak = 0;
+}
+
+void SentenceSegmenter::_process(bool final, const SentenceCallback &onSentence) {
+    while (_scanPos < _buf.size()) {
+        auto pos = _scanPos;
+        auto c = (uint8_t) _buf[pos];
+        auto charLen = utf8CharLength(c);
+        if (pos + charLen > _buf.size()) {
+            break; // wait for the rest of character
+        }
+        auto next = pos + charLen;
+
+        bool terminated = false;
+        bool softBreak = false;
+        if (c == '\r' || c == '\n' || c == '?' || c == '!') {
+            terminated = true;
+        } else if (c == '.') {
+            if (next >= _buf.size() && !final) {
+                break; // wait for the next character
+            }
+            // not terminated: "3.14", "e.g.", "..."
+            terminated = next >= _buf.size() || !(isalnum((uint8_t) _buf[next]) || _buf[next] == '.');
+        } else if (charLen == 3) {
+            terminated = _buf.compare(pos, 3, "。") == 0 || _buf.compare(pos, 3, "？") == 0
+                         || _buf.compare(pos, 3, "！") == 0;
+            softBreak = _buf.compare(pos, 3, "、") == 0 || _buf.compare(pos, 3, "，") == 0;
+        } else if (c == ' ' || c == ',') {
+            softBreak = true;
+        }
+
+        _scanPos = next;
+        if (terminated) {
+            _emit(next, onSentence);
+        } else {
+            if (softBreak) {
+                _softBreak = next;
+            }
+            if (_scanPos >= _maxLength) {
+                _emit(_softBreak > 0 ? _softBreak : _scanPos, onSentence);
+            }
+        }
+    }
+}
+
+/**
+ * Emit the sentence and remove it from the buffer
+ *
+ * @param end end position of the sentence
+ * @param onSentence callback on sentence
+ */
+void SentenceSegmenter::_emit(size_t end, const SentenceCallback &onSentence) {
+    String sentence = _buf.substr(0, end).c_str();
+    _buf.erase(0, end);
+    _scanPos -= std::min(_scanPos, end);
+    _softBreak = 0;
+    sentence.trim();
+    if (!sentence.isEmpty()) {
+        onSentence(sentence);
+    }
+}
@@ -0,0 +1,50 @@
+#if !defined(LIB_SENTENCE_SEGMENTER_H)
+#define LIB_SENTENCE_SEGMENTER_H
+
+#include <functional>
+#include <string>
+#include <Arduino.h>
+
+/**
+ * Incremental sentence segmenter for streamed text
+ *
+ * Only the newly received text is scanned, and each sentence is emitted as soon as its terminator arrives.
+ * Terminators are ".", "?", "!", "。", "？", "！" and line end. "." followed by a letter or digit is not a terminator.
+ * A sentence longer than max length is broken at the last space or comma (or anywhere if none).
+ */
+class SentenceSegmenter {
+public:
+    /**
+     * Callback on sentence
+     *
+     * sentence: sentence (trimmed, not empty)
+     */
+    typedef std::function<void(const String &sentence)> SentenceCallback;
+
+    explicit SentenceSegmenter(size_t maxLength);
+
+    void feed(const char *text, size_t len, const SentenceCallback &onSentence);
+
+    void flush(const SentenceCallback &onSentence);
+
+    void reset();
+
+private:
+    /// length to break long sentence (bytes)
+    size_t _maxLength;
+
+    /// text not emitted yet
+    std::string _buf;
+
+    /// position to resume scanning
+    size_t _scanPos = 0;
+
+    /// position after the last space or comma (0: none)
+    size_t _softBreak = 0;
+
+    void _process(bool final, const SentenceCallback &onSentence);
+
+    void _emit(size_t end, const SentenceCallback &onSentence);
+};
+
+#endif // !defined(LIB_SENTENCE_SEGMENTER_H)
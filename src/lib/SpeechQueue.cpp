@@ -0,0 +1,123 @@
+#include "lib/SpeechQueue.h"
+
+/**
+ * Append messages to play
+ *
+ * @param messages messages in order
+ */
+void SpeechQueue::push(const std::vector<std::shared_ptr<SpeechMessage>> &messages) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _messages.insert(_messages.end(), messages.begin(), messages.end());
+    _size = _messages.size();
+    xSemaphoreGive(_lock);
+}
+
+/**
+ * Take the next message to play
+ *
+ * Starts running until stop() is called. The caller calls finishStart() when the message started playing.
+ *
+ * @return message (nullptr: empty)
+ */
+std::shared_ptr<SpeechMessage> SpeechQueue::take() {
+    std::shared_ptr<SpeechMessage> message = nullptr;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    if (!_messages.empty()) {
+        message = _messages.front();
+        _messages.pop_front();
+        message->_started = true;
+        _isRunning = true;
+        _starting = true;
+        _size = _messages.size();
+    }
+    xSemaphoreGive(_lock);
+    return message;
+}
+
+/**
+ * Mark the message taken by take() as started (or failed to start)
+ */
+void SpeechQueue::finishStart() {
+    _starting = false;
+}
+
+/**
+ * Stop playing and drop the queued messages
+ *
+ * The prefetch in progress for a dropped message is aborted.
+ */
+void SpeechQueue::stop() {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _isRunning = false;
+    for (const auto &message: _messages) {
+        message->_cancelled = true;
+    }
+    _messages.clear();
+    _size = 0;
+    xSemaphoreGive(_lock);
+}
+
+/**
+ * Find the message to prefetch and mark it as prefetching
+ *
+ * @param num number of messages from the head of the queue to prefetch
+ * @return message (nullptr: nothing to prefetch)
+ */
+std::shared_ptr<SpeechMessage> SpeechQueue::prefetch(size_t num) {
+    std::shared_ptr<SpeechMessage> message = nullptr;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    for (size_t i = 0; i < _messages.size() && i < num; i++) {
+        if (_messages[i]->_state == SpeechMessage::State::Queued) {
+            message = _messages[i];
+            message->_state = SpeechMessage::State::Prefetching;
+            break;
+        }
+    }
+    xSemaphoreGive(_lock);
+    return message;
+}
+
+/**
+ * Check if the message being prefetched is still waiting in the queue
+ *
+ * @param message message
+ * @return true: keep prefetching, false: cancelled or taken to play
+ */
+bool SpeechQueue::isWanted(const SpeechMessage &message) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto result = !message._cancelled && !message._started;
+    xSemaphoreGive(_lock);
+    return result;
+}
+
+/**
+ * Finish prefetching the message
+ *
+ * @param message message
+ * @param source prefetched audio source (closed here if the message is cancelled)
+ */
+void SpeechQueue::setPrefetched(SpeechMessage &message, std::unique_ptr<AudioFileSource> source) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    if (!message._cancelled) {
+        message._source = std::move(source);
+    }
+    message._state = SpeechMessage::State::Prefetched;
+    xSemaphoreGive(_lock);
+}
+
+/**
+ * Take over the prefetched source of the message
+ *
+ * @param message message taken by take()
+ * @param source [out] prefetched audio source (nullptr: not prefetched)
+ * @return true: done, false: prefetch in progress (wait and call again)
+ */
+bool SpeechQueue::takeSource(SpeechMessage &message, std::unique_ptr<AudioFileSource> &source) {
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    auto state = message._state;
+    if (state == SpeechMessage::State::Prefetched) {
+        source = std::move(message._source);
+    }
+    xSemaphoreGive(_lock);
+    return state != SpeechMessage::State::Prefetching;
+}
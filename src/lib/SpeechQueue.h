@@ -0,0 +1,99 @@
+#if !defined(LIB_SPEECH_QUEUE_H)
+#define LIB_SPEECH_QUEUE_H
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <Arduino.h>
+#include <AudioFileSource.h>
+
+class SpeechMessage {
+public:
+    enum class State {
+        Queued,
+        Prefetching,
+        Prefetched,
+    };
+
+    SpeechMessage(String text, String voice) : text(std::move(text)), voice(std::move(voice)), queuedTime(millis()) {};
+    String text;
+    String voice;
+
+    /// time when the message was queued
+    unsigned long queuedTime;
+
+    /// true: queued while the voice was idle (measure idle-to-start latency)
+    bool idleStart = false;
+
+    /// segments of canned phrase to play from the bundle (empty: not canned)
+    std::vector<String> segments;
+
+    /// time when the speech was requested (0: not measured)
+    unsigned long requestTime = 0;
+
+private:
+    friend class SpeechQueue;
+
+    // below are guarded by SpeechQueue::_lock
+
+    State _state = State::Queued;
+    /// removed from the queue by stop()
+    bool _cancelled = false;
+    /// taken from the queue to play
+    bool _started = false;
+    /// prefetched audio source
+    std::unique_ptr<AudioFileSource> _source;
+};
+
+/**
+ * Queue of messages to speak, shared by the tasks to play, prefetch and request speech
+ *
+ * The run state is changed together with the queue, so that a stop is never overwritten
+ * by the message taken just before it.
+ */
+class SpeechQueue {
+public:
+    SpeechQueue() = default;
+
+    void push(const std::vector<std::shared_ptr<SpeechMessage>> &messages);
+
+    std::shared_ptr<SpeechMessage> take();
+
+    void finishStart();
+
+    void stop();
+
+    /// false: stop playing (set by stop())
+    bool isRunning() const { return _isRunning; }
+
+    /// true: taken a message from the queue and preparing to play
+    bool isStarting() const { return _starting; }
+
+    /// number of messages in the queue
+    size_t size() const { return _size; }
+
+    std::shared_ptr<SpeechMessage> prefetch(size_t num);
+
+    bool isWanted(const SpeechMessage &message);
+
+    void setPrefetched(SpeechMessage &message, std::unique_ptr<AudioFileSource> source);
+
+    bool takeSource(SpeechMessage &message, std::unique_ptr<AudioFileSource> &source);
+
+private:
+    SemaphoreHandle_t _lock = xSemaphoreCreateMutex();
+
+    std::deque<std::shared_ptr<SpeechMessage>> _messages;
+
+    // below are changed under _lock and published for other tasks
+
+    std::atomic<bool> _isRunning{false};
+
+    std::atomic<bool> _starting{false};
+
+    std::atomic<size_t> _size{0};
+};
+
+#endif // !defined(LIB_SPEECH_QUEUE_H)
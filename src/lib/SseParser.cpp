@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cstring>
+
+#include "lib/SseParser.h"
+
+/// field name of data
+static const char *SSE_FIELD_DATA = "data";
+
+/**
+ * Constructor
+ *
+ * @param maxSize max size of the buffer (must be larger than one event)
+ */
+SseParser::SseParser(size_t maxSize) : _maxSize(maxSize) {}
+
+/**
+ * Feed received bytes
+ *
+ * Both "\n" and "\r\n" are accepted as line end.
+ *
+ * @param data received bytes
+ * @param len length of received bytes
+ * @param onEvent callback on receive event
+ * @return true: success, false: failure (buffer overflow or aborted by callback)
+ */
+bool SseParser::feed(const char *data, size_t len, const EventCallback &onEvent) {
+    // Discard consumed bytes
+    if (_dataStart > 0) {
+        memmove(_buf.data(), _buf.data() + _dataStart, _len - _dataStart);
+        _len -= _dataStart;
+        _lineStart -= _dataStart;
+        _scanPos -= _dataStart;
+        _dataStart = 0;
+    }
+
+    // Append to buffer (+1 for null terminator)
+    if (_len + len + 1 > _maxSize) {
+        return false;
+    }
+    if (_len + len + 1 > _buf.size()) {
+        _buf.resize(std::min(std::max(_len + len + 1, _buf.size() * 2), _maxSize));
+    }
+    memcpy(_buf.data() + _len, data, len);
+    _len += len;
+
+    // Scan only new bytes for line end
+    while (_scanPos < _len) {
+        auto p = (const char *) memchr(_buf.data() + _scanPos, '\n', _len - _scanPos);
+        if (p == nullptr) {
+            _scanPos = _len;
+            break;
+        }
+        auto lineEnd = (size_t) (p - _buf.data());
+        if (!_processLine(lineEnd, onEvent)) {
+            return false;
+        }
+        _lineStart = _scanPos = lineEnd + 1;
+    }
+    return true;
+}
+
+/**
+ * Reset the parser state
+ */
+void SseParser::reset() {
+    _len = 0;
+    _lineStart = 0;
+    _scanPos = 0;
+    _dataStart = 0;
+    _dataLen = 0;
+    _hasData = false;
+}
+
+/**
+ * Process one line
+ *
+ * Values of data fields are joined with "\n" in place from the start of the event,
+ * which never overtakes the current line because each data line has at least "data:" and line end.
+ *
+ * @param lineEnd position of "\n"
+ * @param onEvent callback on receive event
+ * @return true: success, false: aborted by callback
+ */
+bool SseParser::_processLine(size_t lineEnd, const EventCallback &onEvent) {
+    char *buf = _buf.data();
+    auto end = lineEnd;
+    if (end > _lineStart && buf[end - 1] == '\r') {
+        end--;
+    }
+    const char *line = buf + _lineStart;
+    auto lineLen = end - _lineStart;
+
+    if (lineLen == 0) {
+        // Dispatch the event on empty line
+        bool result = true;
+        if (_hasData) {
+            buf[_dataStart + _dataLen] = '\0';
+            result = onEvent(buf + _dataStart, _dataLen);
+        }
+        _hasData = false;
+        _dataLen = 0;
+        _dataStart = lineEnd + 1;
+        return result;
+    }
+
+    // Parse "field: value" (lines starting with ":" are comments)
+    auto colon = (const char *) memchr(line, ':', lineLen);
+    auto nameLen = colon != nullptr ? (size_t) (colon - line) : lineLen;
+    if (nameLen == strlen(SSE_FIELD_DATA) && memcmp(line, SSE_FIELD_DATA, nameLen) == 0) {
+        const char *value = line + lineLen;
+        if (colon != nullptr) {
+            value = colon + 1;
+            if (value < line + lineLen && *value == ' ') {
+                value++;
+            }
+        }
+        auto valueLen = (size_t) (line + lineLen - value);
+        if (_hasData) {
+            buf[_dataStart + _dataLen++] = '\n';
+        }
+        memmove(buf + _dataStart + _dataLen, value, valueLen);
+        _dataLen += valueLen;
+        _hasData = true;
+    }
+    if (!_hasData) {
+        _dataStart = lineEnd + 1;
+    }
+    return true;
+}
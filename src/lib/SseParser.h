@@ -0,0 +1,60 @@
+#if !defined(LIB_SSE_PARSER_H)
+#define LIB_SSE_PARSER_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/**
+ * Incremental parser for Server-Sent Events
+ * https://html.spec.whatwg.org/multipage/server-sent-events.html#event-stream-interpretation
+ *
+ * Bytes are appended to an internal buffer and only the newly received bytes are scanned for line ends.
+ * The data fields of an event are joined in place, so the payload is handed out as a view into the buffer.
+ */
+class SseParser {
+public:
+    /**
+     * Callback on receive event
+     *
+     * data: payload (null-terminated, valid only during the callback)
+     * len: payload length
+     * return: true: continue, false: abort
+     */
+    typedef std::function<bool(const char *data, size_t len)> EventCallback;
+
+    explicit SseParser(size_t maxSize);
+
+    bool feed(const char *data, size_t len, const EventCallback &onEvent);
+
+    void reset();
+
+private:
+    /// max buffer size
+    size_t _maxSize;
+
+    /// buffer
+    std::vector<char> _buf;
+
+    /// length of valid data in the buffer
+    size_t _len = 0;
+
+    /// start position of the current line
+    size_t _lineStart = 0;
+
+    /// position to resume scanning for line end
+    size_t _scanPos = 0;
+
+    /// start position of the payload of the current event
+    size_t _dataStart = 0;
+
+    /// length of the payload of the current event
+    size_t _dataLen = 0;
+
+    /// true: the current event has data field
+    bool _hasData = false;
+
+    bool _processLine(size_t lineEnd, const EventCallback &onEvent);
+};
+
+#endif // !defined(LIB_SSE_PARSER_H)
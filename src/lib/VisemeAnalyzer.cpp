@@ -0,0 +1,116 @@
+#include <cmath>
+
+#include "lib/VisemeAnalyzer.h"
+
+/// bits of time in the packed event (wraps around in about 17 minutes)
+static const uint32_t EVENT_TIME_BITS = 20;
+static const uint32_t EVENT_TIME_MASK = (1u << EVENT_TIME_BITS) - 1;
+
+/**
+ * Pack event into 32 bits: time (20) | valid (1) | viseme (3) | level (8)
+ */
+static uint32_t packEvent(uint32_t time, Viseme viseme, uint8_t level) {
+    return ((time & EVENT_TIME_MASK) << 12) | (1u << 11) | ((uint32_t) viseme << 8) | level;
+}
+
+/**
+ * Get one-pole low-pass coefficient
+ *
+ * @param cutoff cutoff frequency (Hz)
+ * @param hz sample rate (Hz)
+ * @return coefficient (Q14)
+ */
+static int32_t lowPassCoefficient(float cutoff, int hz) {
+    return (int32_t) ((1.0f - expf(-2.0f * (float) M_PI * cutoff / (float) hz)) * (1 << 14));
+}
+
+/**
+ * Set sample rate
+ *
+ * @param hz sample rate (Hz)
+ */
+void VisemeAnalyzer::setRate(int hz) {
+    if (hz <= 0) {
+        return;
+    }
+    _a1 = lowPassCoefficient(800, hz);
+    _a2 = lowPassCoefficient(3000, hz);
+}
+
+/**
+ * Close the current window and publish its viseme
+ *
+ * @param time time when the window is heard (ms)
+ * @param level level of the window (0-255)
+ */
+void VisemeAnalyzer::update(uint32_t time, uint8_t level) {
+    if (_count == 0) {
+        return;
+    }
+    auto viseme = _classify();
+    _events[_writeIndex] = packEvent(time, viseme, viseme == Viseme::Silent ? 0 : level);
+    _writeIndex = (_writeIndex + 1) % VISEME_EVENTS_NUM;
+    _low = _mid = _high = 0;
+    _count = 0;
+}
+
+/**
+ * Reset the state and drop published events
+ */
+void VisemeAnalyzer::reset() {
+    _lp1 = _lp2 = 0;
+    _low = _mid = _high = 0;
+    _count = 0;
+    for (auto &event: _events) {
+        event = 0;
+    }
+}
+
+/**
+ * Get the latest event heard until now (can be called from any task)
+ *
+ * @param now current time (ms)
+ * @param event event
+ * @return true: found, false: no event
+ */
+bool VisemeAnalyzer::getEvent(uint32_t now, VisemeEvent &event) const {
+    auto found = false;
+    uint32_t minAge = 0;
+    for (const auto &e: _events) {
+        uint32_t packed = e;
+        if ((packed & (1u << 11)) == 0) {
+            continue;
+        }
+        auto age = (now - (packed >> 12)) & EVENT_TIME_MASK;
+        if (age > VISEME_EVENT_EXPIRE) {
+            // expired or not heard yet
+            continue;
+        }
+        if (!found || age < minAge) {
+            found = true;
+            minAge = age;
+            event.viseme = (Viseme) ((packed >> 8) & 0x07);
+            event.level = (uint8_t) (packed & 0xff);
+        }
+    }
+    return found;
+}
+
+/**
+ * Classify the current window
+ *
+ * @return viseme
+ */
+Viseme VisemeAnalyzer::_classify() const {
+    uint64_t total = (uint64_t) _low + _mid + _high;
+    if (total / _count < VISEME_SILENCE_LEVEL) {
+        return Viseme::Silent;
+    }
+    if ((uint64_t) _high * 2 > total) {
+        return Viseme::Fricative;
+    }
+    if ((uint64_t) _low * 10 > total * 6) {
+        return _mid * 4 < _low ? Viseme::Round : Viseme::Open;
+    }
+    return Viseme::Wide;
+}
@@ -0,0 +1,98 @@
+#if !defined(LIB_VISEME_ANALYZER_H)
+#define LIB_VISEME_ANALYZER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+
+/// mean absolute sample value treated as silence
+#if !defined(VISEME_SILENCE_LEVEL)
+#define VISEME_SILENCE_LEVEL 150
+#endif
+
+/// number of events kept for the reader (must cover output latency)
+static const size_t VISEME_EVENTS_NUM = 8;
+
+/// events older than this are ignored (ms)
+static const uint32_t VISEME_EVENT_EXPIRE = 500;
+
+/**
+ * Mouth shape
+ */
+enum class Viseme : uint8_t {
+    /// mouth closed
+    Silent = 0,
+    /// wide open (a)
+    Open,
+    /// half open and spread (e, i)
+    Wide,
+    /// rounded (o, u)
+    Round,
+    /// almost closed (s, f, sh)
+    Fricative,
+};
+
+/**
+ * Viseme event
+ */
+struct VisemeEvent {
+    Viseme viseme;
+    /// level (0-255)
+    uint8_t level;
+};
+
+/**
+ * Classify decoded audio into visemes by band energy
+ *
+ * Samples are split into low (<800Hz), mid (800-3000Hz) and high (>3000Hz) bands by two one-pole low-pass filters,
+ * which costs a few integer operations per sample.
+ * Events are stamped with the time when the window is heard, and published to the reader without lock.
+ */
+class VisemeAnalyzer {
+public:
+    void setRate(int hz);
+
+    /**
+     * Add one sample to the current window
+     *
+     * @param sample sample
+     */
+    void add(int16_t sample) {
+        int32_t x = sample;
+        _lp1 += ((x - _lp1) * _a1) >> 14;
+        _lp2 += ((x - _lp2) * _a2) >> 14;
+        _low += (uint32_t) abs(_lp1);
+        _mid += (uint32_t) abs(_lp2 - _lp1);
+        _high += (uint32_t) abs(x - _lp2);
+        _count++;
+    }
+
+    void update(uint32_t time, uint8_t level);
+
+    void reset();
+
+    bool getEvent(uint32_t now, VisemeEvent &event) const;
+
+private:
+    /// filter coefficients (Q14)
+    int32_t _a1 = 0, _a2 = 0;
+
+    /// filter states
+    int32_t _lp1 = 0, _lp2 = 0;
+
+    /// band energy in the current window
+    uint32_t _low = 0, _mid = 0, _high = 0;
+
+    /// number of samples in the current window
+    uint32_t _count = 0;
+
+    /// published events (packed, 0: empty)
+    std::atomic<uint32_t> _events[VISEME_EVENTS_NUM]{};
+
+    /// next index to write
+    size_t _writeIndex = 0;
+
+    Viseme _classify() const;
+};
+
+#endif // !defined(LIB_VISEME_ANALYZER_H)
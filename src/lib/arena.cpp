@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <esp_heap_caps.h>
+
+#include "lib/arena.h"
+
+/**
+ * Header in front of each allocated block to account its size on free
+ */
+struct ArenaHeader {
+    size_t size;
+    size_t arena;
+};
+
+struct ArenaCounters {
+    std::atomic<size_t> used{0};
+    std::atomic<size_t> highWater{0};
+    std::atomic<uint32_t> failures{0};
+};
+
+static ArenaCounters counters[ARENA_NUM];
+
+/**
+ * Allocate memory from the heap of the arena
+ */
+static void *allocFromHeap(Arena arena, size_t size) {
+    void *ptr = nullptr;
+#if ARENA_USE_PSRAM
+    if (arena == Arena::Large) {
+        ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+#endif
+    if (ptr == nullptr) {
+        // no PSRAM, or PSRAM is exhausted
+        ptr = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    return ptr;
+}
+
+/**
+ * Allocate memory
+ *
+ * @param arena arena
+ * @param size size
+ * @return allocated memory (nullptr: failure)
+ */
+void *arenaAlloc(Arena arena, size_t size) {
+    auto &c = counters[(size_t) arena];
+    auto header = (ArenaHeader *) allocFromHeap(arena, sizeof(ArenaHeader) + size);
+    if (header == nullptr) {
+        c.failures++;
+        return nullptr;
+    }
+    header->size = size;
+    header->arena = (size_t) arena;
+    auto used = c.used += size;
+    auto highWater = c.highWater.load();
+    while (used > highWater && !c.highWater.compare_exchange_weak(highWater, used)) {
+    }
+    return header + 1;
+}
+
+/**
+ * Reallocate memory
+ *
+ * @param arena arena
+ * @param ptr memory allocated by arenaAlloc() (nullptr: allocate new)
+ * @param size new size
+ * @return reallocated memory (nullptr: failure, ptr is not freed)
+ */
+void *arenaRealloc(Arena arena, void *ptr, size_t size) {
+    if (ptr == nullptr) {
+        return arenaAlloc(arena, size);
+    }
+    auto newPtr = arenaAlloc(arena, size);
+    if (newPtr != nullptr) {
+        memcpy(newPtr, ptr, std::min(size, ((ArenaHeader *) ptr - 1)->size));
+        arenaFree(ptr);
+    }
+    return newPtr;
+}
+
+/**
+ * Free memory
+ *
+ * @param ptr memory allocated by arenaAlloc() (nullptr: do nothing)
+ */
+void arenaFree(void *ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    auto header = (ArenaHeader *) ptr - 1;
+    counters[header->arena].used -= header->size;
+    heap_caps_free(header);
+}
+
+/**
+ * Get statistics of the arena
+ *
+ * @param arena arena
+ * @return statistics
+ */
+ArenaStats getArenaStats(Arena arena) {
+    auto &c = counters[(size_t) arena];
+    return ArenaStats{c.used, c.highWater, c.failures};
+}
@@ -0,0 +1,75 @@
+#if !defined(LIB_ARENA_H)
+#define LIB_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ArduinoJson.h>
+
+/// true: allocate large buffers from PSRAM
+#if !defined(ARENA_USE_PSRAM)
+#if defined(BOARD_HAS_PSRAM)
+#define ARENA_USE_PSRAM 1
+#else
+#define ARENA_USE_PSRAM 0
+#endif
+#endif
+
+/**
+ * Memory arena selected by the access pattern
+ */
+enum class Arena {
+    /// internal RAM: DMA and hot paths
+    Internal = 0,
+    /// PSRAM if available: large buffers accessed less frequently
+    Large,
+};
+
+static const size_t ARENA_NUM = 2;
+
+struct ArenaStats {
+    /// bytes in use
+    size_t used;
+    /// max bytes in use
+    size_t highWater;
+    /// number of failed allocations
+    uint32_t failures;
+};
+
+void *arenaAlloc(Arena arena, size_t size);
+
+void *arenaRealloc(Arena arena, void *ptr, size_t size);
+
+void arenaFree(void *ptr);
+
+ArenaStats getArenaStats(Arena arena);
+
+/**
+ * Deleter for std::unique_ptr of memory allocated by arenaAlloc()
+ */
+struct ArenaDeleter {
+    void operator()(void *ptr) const {
+        arenaFree(ptr);
+    }
+};
+
+/**
+ * Allocator for ArduinoJson on the large arena
+ */
+struct LargeJsonAllocator {
+    void *allocate(size_t size) {
+        return arenaAlloc(Arena::Large, size);
+    }
+
+    void deallocate(void *ptr) {
+        arenaFree(ptr);
+    }
+
+    void *reallocate(void *ptr, size_t size) {
+        return arenaRealloc(Arena::Large, ptr, size);
+    }
+};
+
+/// json document allocated on the large arena
+typedef BasicJsonDocument<LargeJsonAllocator> LargeJsonDocument;
+
+#endif // !defined(LIB_ARENA_H)
@@ -21,6 +21,9 @@ bool nvsSaveString(const String &name, const String &key, const String &value) {
                       esp_err_to_name(openResult), name.c_str());
     } else {
         auto setResult = nvs_set_str(nvsHandle, key.c_str(), value.c_str());
+        if (setResult == ESP_OK) {
+            setResult = nvs_commit(nvsHandle);
+        }
         if (setResult != ESP_OK) {
             Serial.printf("ERROR: Failed to write string to nvs: %s (key=%s)\n", esp_err_to_name(setResult),
                           key.c_str());
@@ -5,6 +5,21 @@
 
 #include "lib/spiffs.h"
 
+/**
+ * Mount SPIFFS (formatted if not mountable)
+ *
+ * SPIFFS is kept mounted because it is shared by the voice cache and the chat journal.
+ *
+ * @return true: success, false: failure
+ */
+bool spiffsBegin() {
+    if (!SPIFFS.begin(true)) {
+        Serial.println("ERROR: Failed to begin SPIFFS");
+        return false;
+    }
+    return true;
+}
+
 /**
  * Save string to SPIFFS
  *
@@ -14,9 +29,7 @@
  */
 bool spiffsSaveString(const char *path, const String &value) {
     bool result = false;
-    if (!SPIFFS.begin(true)) {
-        Serial.println("ERROR: Failed to begin SPIFFS");
-    } else {
+    if (spiffsBegin()) {
         File f = SPIFFS.open(path, "w");
         if (!f) {
             Serial.printf("ERROR: Failed to open SPIFFS for writing (path=%s)\n", path);
@@ -26,7 +39,6 @@ bool spiffsSaveString(const char *path, const String &value) {
             result = true;
             f.close();
         }
-        SPIFFS.end();
     }
     return result;
 }
@@ -39,9 +51,7 @@ bool spiffsSaveString(const char *path, const String &value) {
  */
 std::unique_ptr<String> spiffsLoadString(const char *path) {
     std::unique_ptr<String> value = nullptr;
-    if (!SPIFFS.begin(true)) {
-        Serial.println("ERROR: Failed to begin SPIFFS");
-    } else {
+    if (spiffsBegin()) {
         File f = SPIFFS.open(path, "r");
         if (!f || f.size() == 0) {
             Serial.printf("ERROR: Failed to open SPIFFS for reading (path=%s)\n", path);
@@ -51,7 +61,6 @@ std::unique_ptr<String> spiffsLoadString(const char *path) {
             value = std::make_unique<String>(tmpValue);
             f.close();
         }
-        SPIFFS.end();
     }
     return value;
 }
@@ -4,6 +4,8 @@
 #include <memory>
 #include <Arduino.h>
 
+bool spiffsBegin();
+
 bool spiffsSaveString(const char *path, const String &value);
 
 std::unique_ptr<String> spiffsLoadString(const char *path);
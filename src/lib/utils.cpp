@@ -3,12 +3,55 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 
-String jsonEncode(const DynamicJsonDocument &jsonDoc) {
+String jsonEncode(const JsonDocument &jsonDoc) {
     String jsonStr;
     serializeJson(jsonDoc, jsonStr);
     return jsonStr;
 }
 
+/**
+ * Get json escape sequence of the byte
+ *
+ * @param c byte
+ * @param out buffer of escape sequence (7 bytes at least)
+ * @return length of escape sequence (0: no need to escape)
+ */
+size_t jsonEscapeChar(uint8_t c, char *out) {
+    char e;
+    switch (c) {
+        case '"':
+            e = '"';
+            break;
+        case '\\':
+            e = '\\';
+            break;
+        case '\b':
+            e = 'b';
+            break;
+        case '\f':
+            e = 'f';
+            break;
+        case '\n':
+            e = 'n';
+            break;
+        case '\r':
+            e = 'r';
+            break;
+        case '\t':
+            e = 't';
+            break;
+        default:
+            if (c >= 0x20) {
+                return 0;
+            }
+            snprintf(out, 7, "\\u%04x", c);
+            return 6;
+    }
+    out[0] = '\\';
+    out[1] = e;
+    return 2;
+}
+
 std::vector<std::string> splitString(
         const std::string &str, const std::string &delimiter, bool includeDelimiter = false) {
     std::vector<std::string> tokens;
@@ -3,9 +3,12 @@
 
 #include <sstream>
 #include <vector>
+#include <Arduino.h>
 #include <ArduinoJson.h>
 
-String jsonEncode(const DynamicJsonDocument &jsonDoc);
+String jsonEncode(const JsonDocument &jsonDoc);
+
+size_t jsonEscapeChar(uint8_t c, char *out);
 
 std::vector<std::string> splitString(
         const std::string &str, const std::string &delimiter, bool includeDelimiter = false);
@@ -0,0 +1,330 @@
+#if !defined(TEST_STUBS_ARDUINO_H)
+#define TEST_STUBS_ARDUINO_H
+
+/**
+ * Minimal Arduino core for the native test environment
+ *
+ * Only the parts used by the library classes under test are provided.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class String : public std::string {
+public:
+    String() = default;
+
+    String(const char *s) : std::string(s != nullptr ? s : "") {}
+
+    String(const char *s, size_t len) : std::string(s, len) {}
+
+    String(const std::string &s) : std::string(s) {}
+
+    explicit String(char c) : std::string(1, c) {}
+
+    explicit String(int value) : std::string(std::to_string(value)) {}
+
+    explicit String(unsigned int value) : std::string(std::to_string(value)) {}
+
+    explicit String(long value) : std::string(std::to_string(value)) {}
+
+    explicit String(unsigned long value) : std::string(std::to_string(value)) {}
+
+    using std::string::append;
+
+    /// std::string::append returning String (ArduinoJson writes to types that look like std::string)
+    String &append(const char *s) {
+        std::string::append(s);
+        return *this;
+    }
+
+    unsigned int length() const { return (unsigned int) size(); }
+
+    bool isEmpty() const { return empty(); }
+
+    bool concat(const String &s) {
+        std::string::append(s);
+        return true;
+    }
+
+    char charAt(unsigned int index) const { return index < size() ? (*this)[index] : '\0'; }
+
+    int indexOf(char c, unsigned int from = 0) const { return _pos(find(c, from)); }
+
+    int indexOf(const char *s, unsigned int from = 0) const { return _pos(find(s, from)); }
+
+    int indexOf(const String &s, unsigned int from = 0) const { return _pos(find(s, from)); }
+
+    int lastIndexOf(char c) const { return _pos(rfind(c)); }
+
+    String substring(unsigned int from) const { return from < size() ? String(substr(from)) : String(); }
+
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) {
+            std::swap(from, to);
+        }
+        return from < size() ? String(substr(from, to - from)) : String();
+    }
+
+    bool startsWith(const String &prefix) const { return compare(0, prefix.size(), prefix) == 0; }
+
+    bool endsWith(const String &suffix) const {
+        return size() >= suffix.size() && compare(size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    void remove(unsigned int index) { erase(std::min((size_t) index, size())); }
+
+    void remove(unsigned int index, unsigned int count) { erase(std::min((size_t) index, size()), count); }
+
+    void trim() {
+        auto start = find_first_not_of(" \t\r\n");
+        if (start == npos) {
+            clear();
+            return;
+        }
+        *this = substr(start, find_last_not_of(" \t\r\n") - start + 1);
+    }
+
+    long toInt() const { return strtol(c_str(), nullptr, 10); }
+
+    String &operator+=(const String &s) {
+        std::string::append(s);
+        return *this;
+    }
+
+    String &operator+=(const char *s) {
+        std::string::append(s);
+        return *this;
+    }
+
+    String &operator+=(char c) {
+        push_back(c);
+        return *this;
+    }
+
+private:
+    static int _pos(size_t pos) { return pos == npos ? -1 : (int) pos; }
+};
+
+/// result of String concatenation (referred by ArduinoJson for Arduino strings)
+class StringSumHelper : public String {
+public:
+    StringSumHelper(const String &s) : String(s) {}
+};
+
+inline String operator+(const String &a, const String &b) {
+    String s(a);
+    s += b;
+    return s;
+}
+
+inline String operator+(const String &a, const char *b) {
+    String s(a);
+    s += b;
+    return s;
+}
+
+inline String operator+(const char *a, const String &b) {
+    String s(a);
+    s += b;
+    return s;
+}
+
+// time
+
+inline unsigned long &stubMillisOffset() {
+    static unsigned long offset = 0;
+    return offset;
+}
+
+/**
+ * Advance millis() without waiting (native tests only)
+ *
+ * @param ms time to advance (ms)
+ */
+inline void stubAdvanceMillis(unsigned long ms) {
+    stubMillisOffset() += ms;
+}
+
+inline unsigned long millis() {
+    static const auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return (unsigned long) std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()
+           + stubMillisOffset();
+}
+
+inline void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void yield() {
+    std::this_thread::yield();
+}
+
+// FreeRTOS
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+/// task notification of a thread
+struct StubTask {
+    std::mutex lock;
+    std::condition_variable cv;
+    uint32_t count = 0;
+};
+
+typedef StubTask *TaskHandle_t;
+typedef std::recursive_mutex *SemaphoreHandle_t;
+
+#define portMAX_DELAY ((TickType_t) 0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
+#define pdTRUE 1
+#define pdFALSE 0
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return new std::recursive_mutex();
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t lock, TickType_t) {
+    lock->lock();
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t lock) {
+    lock->unlock();
+    return pdTRUE;
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    delay(ticks);
+}
+
+/// each thread is a task
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+    thread_local StubTask task;
+    return &task;
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(task->lock);
+    task->count++;
+    task->cv.notify_one();
+    return pdTRUE;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticks) {
+    auto task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->lock);
+    auto notified = [task]() { return task->count > 0; };
+    if (ticks == portMAX_DELAY) {
+        task->cv.wait(lock, notified);
+    } else {
+        task->cv.wait_for(lock, std::chrono::milliseconds(ticks), notified);
+    }
+    auto count = task->count;
+    if (count > 0) {
+        task->count = clearCountOnExit ? 0 : count - 1;
+    }
+    return count;
+}
+
+// streams
+
+class Print {
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t c) = 0;
+
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while (n < size && write(buffer[n]) == 1) {
+            n++;
+        }
+        return n;
+    }
+
+    size_t print(const char *s) { return write((const uint8_t *) s, strlen(s)); }
+
+    size_t print(const String &s) { return write((const uint8_t *) s.c_str(), s.length()); }
+
+    size_t println(const char *s = "") { return print(s) + print("\r\n"); }
+
+    size_t println(const String &s) { return print(s) + print("\r\n"); }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[256];
+        va_list args;
+        va_start(args, format);
+        auto len = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+        return write((const uint8_t *) buf, std::min((size_t) std::max(len, 0), sizeof(buf) - 1));
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+
+    virtual int read() = 0;
+
+    virtual int peek() = 0;
+
+    virtual void flush() = 0;
+
+    /// reads up to length bytes (no timeout in the native tests)
+    virtual size_t readBytes(char *buffer, size_t length) {
+        size_t n = 0;
+        while (n < length) {
+            auto c = read();
+            if (c < 0) {
+                break;
+            }
+            buffer[n++] = (char) c;
+        }
+        return n;
+    }
+
+    size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *) buffer, length); }
+
+    String readString() {
+        String s;
+        int c;
+        while ((c = read()) >= 0) {
+            s += (char) c;
+        }
+        return s;
+    }
+
+    void setTimeout(unsigned long) {}
+};
+
+/// serial port writing to stdout
+class HardwareSerial : public Stream {
+public:
+    size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+
+    size_t write(const uint8_t *buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+
+    int available() override { return 0; }
+
+    int read() override { return -1; }
+
+    int peek() override { return -1; }
+
+    void flush() override { fflush(stdout); }
+};
+
+static HardwareSerial Serial;
+
+#endif // !defined(TEST_STUBS_ARDUINO_H)
@@ -0,0 +1,34 @@
+#if !defined(TEST_STUBS_AUDIO_FILE_SOURCE_H)
+#define TEST_STUBS_AUDIO_FILE_SOURCE_H
+
+#include <Arduino.h>
+
+#define PSTR(s) (s)
+#define printf_P printf
+
+static Print *audioLogger __attribute__((unused)) = &Serial;
+
+class AudioFileSource {
+public:
+    virtual ~AudioFileSource() = default;
+
+    virtual bool open(const char *filename) { return false; }
+
+    virtual uint32_t read(void *data, uint32_t len) { return 0; }
+
+    virtual uint32_t readNonBlock(void *data, uint32_t len) { return read(data, len); }
+
+    virtual bool seek(int32_t pos, int dir) { return false; }
+
+    virtual bool close() { return false; }
+
+    virtual bool isOpen() { return false; }
+
+    virtual uint32_t getSize() { return 0; }
+
+    virtual uint32_t getPos() { return 0; }
+
+    virtual bool loop() { return true; }
+};
+
+#endif // !defined(TEST_STUBS_AUDIO_FILE_SOURCE_H)
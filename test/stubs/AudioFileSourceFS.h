@@ -0,0 +1,38 @@
+#if !defined(TEST_STUBS_AUDIO_FILE_SOURCE_FS_H)
+#define TEST_STUBS_AUDIO_FILE_SOURCE_FS_H
+
+#include <AudioFileSource.h>
+#include <FS.h>
+
+class AudioFileSourceFS : public AudioFileSource {
+public:
+    AudioFileSourceFS(fs::FS &fs, const char *filename) : _fs(&fs) { open(filename); }
+
+    ~AudioFileSourceFS() override { close(); }
+
+    bool open(const char *filename) override {
+        _file = _fs->open(filename, FILE_READ);
+        return (bool) _file;
+    }
+
+    uint32_t read(void *data, uint32_t len) override { return _file.read((uint8_t *) data, len); }
+
+    bool seek(int32_t pos, int dir) override { return _file.seek(pos, (fs::SeekMode) dir); }
+
+    bool close() override {
+        _file.close();
+        return true;
+    }
+
+    bool isOpen() override { return (bool) _file; }
+
+    uint32_t getSize() override { return _file.size(); }
+
+    uint32_t getPos() override { return _file.position(); }
+
+private:
+    fs::FS *_fs;
+    File _file;
+};
+
+#endif // !defined(TEST_STUBS_AUDIO_FILE_SOURCE_FS_H)
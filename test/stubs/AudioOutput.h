@@ -0,0 +1,54 @@
+#if !defined(TEST_STUBS_AUDIO_OUTPUT_H)
+#define TEST_STUBS_AUDIO_OUTPUT_H
+
+#include <Arduino.h>
+
+#define LEFTCHANNEL 0
+#define RIGHTCHANNEL 1
+
+class AudioOutput {
+public:
+    virtual ~AudioOutput() = default;
+
+    virtual bool SetRate(int hz) {
+        hertz = hz;
+        return true;
+    }
+
+    virtual bool SetBitsPerSample(int bits) {
+        bps = bits;
+        return true;
+    }
+
+    virtual bool SetChannels(int chan) {
+        channels = chan;
+        return true;
+    }
+
+    virtual bool begin() { return false; }
+
+    virtual bool ConsumeSample(int16_t sample[2]) = 0;
+
+    virtual uint16_t ConsumeSamples(int16_t *samples, uint16_t count) {
+        for (uint16_t i = 0; i < count; i++) {
+            if (!ConsumeSample(samples)) {
+                return i;
+            }
+            samples += 2;
+        }
+        return count;
+    }
+
+    virtual bool stop() { return false; }
+
+    virtual void flush() {}
+
+    virtual bool loop() { return true; }
+
+protected:
+    uint16_t hertz = 44100;
+    uint8_t bps = 16;
+    uint8_t channels = 2;
+};
+
+#endif // !defined(TEST_STUBS_AUDIO_OUTPUT_H)
@@ -0,0 +1,223 @@
+#if !defined(TEST_STUBS_FS_H)
+#define TEST_STUBS_FS_H
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2,
+};
+
+/**
+ * File on the in-memory file system
+ *
+ * Contents are shared by the file system and open files, so a removed file can still be read while open.
+ */
+class File : public Stream {
+public:
+    File() = default;
+
+    File(std::string path, std::shared_ptr<std::string> data, std::shared_ptr<time_t> lastWrite, bool writable,
+         size_t pos)
+            : _path(std::move(path)), _data(std::move(data)), _lastWrite(std::move(lastWrite)), _writable(writable),
+              _pos(pos) {}
+
+    /// directory
+    File(std::string path, std::vector<File> children)
+            : _path(std::move(path)), _isDirectory(true), _children(std::move(children)) {}
+
+    explicit operator bool() const { return _data != nullptr || _isDirectory; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t *buf, size_t size) override {
+        if (_data == nullptr || !_writable) {
+            return 0;
+        }
+        if (stubWriteLimit() >= 0 && _data->size() + size > (size_t) stubWriteLimit()) {
+            // no space
+            size = (size_t) std::max(stubWriteLimit() - (int) _data->size(), 0);
+        }
+        _data->replace(_pos, std::min(size, _data->size() - _pos), (const char *) buf, size);
+        _pos += size;
+        *_lastWrite = ++stubClock();
+        return size;
+    }
+
+    int available() override { return _data != nullptr ? (int) (_data->size() - _pos) : 0; }
+
+    int read() override { return _data != nullptr && _pos < _data->size() ? (uint8_t) (*_data)[_pos++] : -1; }
+
+    size_t read(uint8_t *buf, size_t size) {
+        if (_data == nullptr) {
+            return 0;
+        }
+        size = std::min(size, _data->size() - _pos);
+        memcpy(buf, _data->data() + _pos, size);
+        _pos += size;
+        return size;
+    }
+
+    int peek() override { return _data != nullptr && _pos < _data->size() ? (uint8_t) (*_data)[_pos] : -1; }
+
+    void flush() override {}
+
+    bool seek(uint32_t pos, SeekMode mode = SeekSet) {
+        if (_data == nullptr) {
+            return false;
+        }
+        size_t base = mode == SeekSet ? 0 : mode == SeekCur ? _pos : _data->size();
+        if (base + pos > _data->size()) {
+            return false;
+        }
+        _pos = base + pos;
+        return true;
+    }
+
+    size_t position() const { return _pos; }
+
+    size_t size() const { return _data != nullptr ? _data->size() : 0; }
+
+    void close() {
+        _data = nullptr;
+        _isDirectory = false;
+        _children.clear();
+    }
+
+    time_t getLastWrite() { return _lastWrite != nullptr ? *_lastWrite : 0; }
+
+    const char *path() const { return _path.c_str(); }
+
+    const char *name() const {
+        auto slash = _path.rfind('/');
+        return _path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+    }
+
+    bool isDirectory() { return _isDirectory; }
+
+    File openNextFile() {
+        return _nextChild < _children.size() ? _children[_nextChild++] : File();
+    }
+
+    /// clock for the last write time
+    static time_t &stubClock() {
+        static time_t clock = 0;
+        return clock;
+    }
+
+    /// max size of a file written (-1: unlimited)
+    static int &stubWriteLimit() {
+        static int limit = -1;
+        return limit;
+    }
+
+private:
+    std::string _path;
+    std::shared_ptr<std::string> _data;
+    std::shared_ptr<time_t> _lastWrite;
+    bool _writable = false;
+    size_t _pos = 0;
+    bool _isDirectory = false;
+    std::vector<File> _children;
+    size_t _nextChild = 0;
+};
+
+/**
+ * In-memory file system
+ */
+class FS {
+public:
+    File open(const String &path, const char *mode = FILE_READ) {
+        std::string m(mode);
+        if (_dirs.count(path) > 0) {
+            std::vector<File> children;
+            for (const auto &item: _files) {
+                auto slash = item.first.rfind('/');
+                if (slash != std::string::npos && item.first.compare(0, slash, path) == 0 && slash == path.size()) {
+                    children.emplace_back(item.first, item.second.data, item.second.lastWrite, false, 0);
+                }
+            }
+            return {path, children};
+        }
+        auto it = _files.find(path);
+        if (m == FILE_READ) {
+            if (it == _files.end()) {
+                return {};
+            }
+            return {path, it->second.data, it->second.lastWrite, false, 0};
+        }
+        if (it == _files.end() || m == FILE_WRITE) {
+            _files[path] = {std::make_shared<std::string>(), std::make_shared<time_t>(++File::stubClock())};
+            it = _files.find(path);
+        }
+        return {path, it->second.data, it->second.lastWrite, true, it->second.data->size()};
+    }
+
+    bool exists(const String &path) { return _files.count(path) > 0 || _dirs.count(path) > 0; }
+
+    bool remove(const String &path) { return _files.erase(path) > 0; }
+
+    bool rename(const String &from, const String &to) {
+        auto it = _files.find(from);
+        if (it == _files.end()) {
+            return false;
+        }
+        auto entry = it->second;
+        _files.erase(it);
+        _files[to] = entry;
+        return true;
+    }
+
+    bool mkdir(const String &path) {
+        _dirs.insert(path);
+        return true;
+    }
+
+    // test controls
+
+    /// contents of the file (empty if not exists)
+    std::string stubRead(const String &path) {
+        auto it = _files.find(path);
+        return it != _files.end() ? *it->second.data : std::string();
+    }
+
+    void stubWrite(const String &path, const std::string &data) {
+        auto file = open(path, FILE_WRITE);
+        file.write((const uint8_t *) data.data(), data.size());
+    }
+
+    /// number of files
+    size_t stubCount() const { return _files.size(); }
+
+private:
+    struct Entry {
+        std::shared_ptr<std::string> data;
+        std::shared_ptr<time_t> lastWrite;
+    };
+
+    std::map<std::string, Entry> _files;
+    std::set<std::string> _dirs;
+};
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif // !defined(TEST_STUBS_FS_H)
@@ -0,0 +1,176 @@
+#if !defined(TEST_STUBS_HTTP_CLIENT_H)
+#define TEST_STUBS_HTTP_CLIENT_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+#define HTTPCLIENT_DEFAULT_TCP_TIMEOUT (5000)
+
+typedef enum {
+    HTTP_CODE_OK = 200,
+    HTTP_CODE_NOT_FOUND = 404,
+    HTTP_CODE_INTERNAL_SERVER_ERROR = 500,
+} t_http_codes;
+
+/**
+ * Response of the fake server
+ */
+struct StubHttpResponse {
+    int code;
+    /// Content-Length (-1: not sent)
+    int size;
+    String transferEncoding;
+    /// body received with the response headers (more can be received by WiFiClient::stubReceive())
+    std::string body;
+    String contentType;
+};
+
+/**
+ * HTTP client talking to the fake server
+ *
+ * Each request takes the next response queued by the test.
+ */
+class HTTPClient {
+public:
+    bool begin(WiFiClient &client, const String &url) {
+        _client = &client;
+        _url = url;
+        _size = -1;
+        _headers.clear();
+        return true;
+    }
+
+    void end() {
+        if (_client != nullptr && !_reuse) {
+            _client->stop();
+        }
+        _client = nullptr;
+    }
+
+    void setReuse(bool reuse) { _reuse = reuse; }
+
+    void setAuthorization(const char *auth) { _authorization = auth; }
+
+    void setTimeout(uint16_t timeout) { _timeout = timeout; }
+
+    void addHeader(const String &name, const String &value) {}
+
+    void collectHeaders(const char *headerKeys[], size_t headerKeysCount) {}
+
+    String header(const char *name) {
+        auto it = _headers.find(name);
+        return it != _headers.end() ? it->second : String();
+    }
+
+    int GET() { return _sendRequest(); }
+
+    int POST(const String &payload) {
+        stubRequestBody() = payload;
+        return _sendRequest();
+    }
+
+    int sendRequest(const char *type, Stream *stream, size_t size) {
+        stubRequestBody().clear();
+        char buf[256];
+        while (stubRequestBody().size() < size) {
+            auto n = stream->readBytes(buf, std::min(sizeof(buf), size - stubRequestBody().size()));
+            if (n == 0) {
+                break;
+            }
+            stubRequestBody().append(buf, n);
+        }
+        return _sendRequest();
+    }
+
+    int getSize() { return _size; }
+
+    String getString() {
+        String payload;
+        while (_client != nullptr && _client->available() > 0) {
+            payload += (char) _client->read();
+        }
+        return payload;
+    }
+
+    static String errorToString(int error) { return String("HTTP error ") + String(error); }
+
+    WiFiClient *getStreamPtr() { return _client; }
+
+    bool connected() { return _client != nullptr && (_client->available() > 0 || _client->connected()); }
+
+    // test controls
+
+    const String &stubUrl() const { return _url; }
+
+    const String &stubAuthorization() const { return _authorization; }
+
+    uint16_t stubTimeout() const { return _timeout; }
+
+    bool stubReuse() const { return _reuse; }
+
+    /// responses for the next requests
+    static std::deque<StubHttpResponse> &stubResponses() {
+        static std::deque<StubHttpResponse> responses;
+        return responses;
+    }
+
+    /// body of the last request
+    static std::string &stubRequestBody() {
+        static std::string body;
+        return body;
+    }
+
+    /// number of requests sent
+    static int &stubRequestCount() {
+        static int count = 0;
+        return count;
+    }
+
+private:
+    WiFiClient *_client = nullptr;
+    String _url;
+    String _authorization;
+    uint16_t _timeout = HTTPCLIENT_DEFAULT_TCP_TIMEOUT;
+    bool _reuse = true;
+    int _size = -1;
+    std::map<std::string, String> _headers;
+
+    int _sendRequest() {
+        if (_client == nullptr || !_client->connected()) {
+            return HTTPC_ERROR_NOT_CONNECTED;
+        }
+        if (_client->stubIsStale()) {
+            _client->stop();
+            return HTTPC_ERROR_SEND_HEADER_FAILED;
+        }
+        stubRequestCount()++;
+        if (stubResponses().empty()) {
+            return HTTPC_ERROR_READ_TIMEOUT;
+        }
+        auto response = stubResponses().front();
+        stubResponses().pop_front();
+        _size = response.size;
+        if (!response.transferEncoding.isEmpty()) {
+            _headers["Transfer-Encoding"] = response.transferEncoding;
+        }
+        if (!response.contentType.isEmpty()) {
+            _headers["Content-Type"] = response.contentType;
+        }
+        _client->stubReceive(response.body);
+        return response.code;
+    }
+};
+
+#endif // !defined(TEST_STUBS_HTTP_CLIENT_H)
@@ -0,0 +1,91 @@
+#if !defined(TEST_STUBS_M5_UNIFIED_H)
+#define TEST_STUBS_M5_UNIFIED_H
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <Arduino.h>
+
+namespace m5 {
+
+/**
+ * Speaker playing buffers in real time (or when the test finishes them)
+ *
+ * Like the real speaker, a channel holds the playing buffer and one queued buffer,
+ * and the buffers are not copied, so their contents are recorded when played.
+ */
+class Speaker_Class {
+public:
+    /// number of buffers playing or queued on the channel
+    size_t isPlaying(uint8_t channel) {
+        std::lock_guard<std::mutex> lock(_lock);
+        _expire();
+        return _queue.size();
+    }
+
+    bool playRaw(const int16_t *data, size_t len, uint32_t rate, bool stereo = false, uint32_t repeat = 1,
+                 int channel = -1, bool stopCurrentSound = false) {
+        std::lock_guard<std::mutex> lock(_lock);
+        _expire();
+        if (_queue.size() >= 2 || stereo || rate == 0) {
+            stubRejected++;
+            return false;
+        }
+        auto now = std::chrono::steady_clock::now();
+        auto start = _queue.empty() ? now : _queue.back();
+        _queue.push_back(start + std::chrono::microseconds((uint64_t) len * 1000000 / rate));
+        stubPlayed.insert(stubPlayed.end(), data, data + len);
+        stubBlocks.push_back(len);
+        stubRate = rate;
+        return true;
+    }
+
+    void stop(uint8_t channel) {
+        std::lock_guard<std::mutex> lock(_lock);
+        _queue.clear();
+        stubStopCount++;
+    }
+
+    // test controls
+
+    /// true: buffers are played in real time, false: until stubFinish()
+    bool stubRealTime = true;
+
+    /// finish the playing buffer (not in real time)
+    void stubFinish() {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (!_queue.empty()) {
+            _queue.pop_front();
+        }
+    }
+
+    /// samples played
+    std::vector<int16_t> stubPlayed;
+
+    /// number of samples of each buffer played
+    std::vector<size_t> stubBlocks;
+
+    uint32_t stubRate = 0;
+
+    /// number of buffers rejected (queue full or stereo)
+    int stubRejected = 0;
+
+    int stubStopCount = 0;
+
+private:
+    std::mutex _lock;
+
+    /// time when each buffer ends
+    std::deque<std::chrono::steady_clock::time_point> _queue;
+
+    void _expire() {
+        auto now = std::chrono::steady_clock::now();
+        while (stubRealTime && !_queue.empty() && _queue.front() <= now) {
+            _queue.pop_front();
+        }
+    }
+};
+
+} // namespace m5
+
+#endif // !defined(TEST_STUBS_M5_UNIFIED_H)
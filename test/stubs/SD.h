@@ -0,0 +1,39 @@
+#if !defined(TEST_STUBS_SD_H)
+#define TEST_STUBS_SD_H
+
+#include <FS.h>
+
+#define GPIO_NUM_4 4
+
+class SPIClass {
+};
+
+static SPIClass SPI __attribute__((unused));
+
+/**
+ * SD card on the in-memory file system
+ */
+class SDFS : public fs::FS {
+public:
+    bool begin(uint8_t ssPin, SPIClass &spi, uint32_t frequency) {
+        return stubMounted();
+    }
+
+    void end() {}
+
+    /// true: card is inserted
+    static bool &stubMounted() {
+        static bool mounted = false;
+        return mounted;
+    }
+
+    /// shared by all translation units
+    static SDFS &stubInstance() {
+        static SDFS sd;
+        return sd;
+    }
+};
+
+static SDFS &SD __attribute__((unused)) = SDFS::stubInstance();
+
+#endif // !defined(TEST_STUBS_SD_H)
@@ -0,0 +1,107 @@
+#if !defined(TEST_STUBS_WIFI_CLIENT_H)
+#define TEST_STUBS_WIFI_CLIENT_H
+
+#include <string>
+#include <Arduino.h>
+
+/**
+ * Network client connected to a fake server
+ *
+ * Received bytes are given by the test with stubReceive().
+ */
+class WiFiClient : public Stream {
+public:
+    WiFiClient() {
+        stubLast() = this;
+    }
+
+    ~WiFiClient() override {
+        if (stubLast() == this) {
+            stubLast() = nullptr;
+        }
+    }
+
+    virtual int connect(const char *host, uint16_t port) {
+        stubConnectCount()++;
+        _connected = stubConnectResult();
+        _closed = false;
+        _stale = false;
+        return _connected ? 1 : 0;
+    }
+
+    virtual uint8_t connected() {
+        return _connected && (!_closed || available() > 0);
+    }
+
+    virtual void stop() {
+        _connected = false;
+        _rx.clear();
+        _rxPos = 0;
+    }
+
+    int fd() const { return -1; }
+
+    int available() override { return (int) (_rx.size() - _rxPos); }
+
+    int read() override { return _rxPos < _rx.size() ? (uint8_t) _rx[_rxPos++] : -1; }
+
+    int read(uint8_t *buf, size_t size) {
+        size = std::min(size, _rx.size() - _rxPos);
+        if (size == 0) {
+            return -1;
+        }
+        memcpy(buf, _rx.data() + _rxPos, size);
+        _rxPos += size;
+        return (int) size;
+    }
+
+    int peek() override { return _rxPos < _rx.size() ? (uint8_t) _rx[_rxPos] : -1; }
+
+    size_t write(uint8_t) override { return _connected ? 1 : 0; }
+
+    void flush() override {}
+
+    // test controls
+
+    /// receive bytes from the server
+    void stubReceive(const std::string &data) {
+        _rx.erase(0, _rxPos);
+        _rxPos = 0;
+        _rx += data;
+    }
+
+    /// close by the server (bytes already received can be read)
+    void stubClose() { _closed = true; }
+
+    /// close by the server without notice (looks connected until the next request is sent)
+    void stubSetStale() { _stale = true; }
+
+    bool stubIsStale() const { return _stale; }
+
+    /// result of the next connect()
+    static bool &stubConnectResult() {
+        static bool result = true;
+        return result;
+    }
+
+    /// number of connect() calls
+    static int &stubConnectCount() {
+        static int count = 0;
+        return count;
+    }
+
+    /// last created client
+    static WiFiClient *&stubLast() {
+        static WiFiClient *last = nullptr;
+        return last;
+    }
+
+private:
+    bool _connected = false;
+    bool _closed = false;
+    bool _stale = false;
+    std::string _rx;
+    size_t _rxPos = 0;
+};
+
+#endif // !defined(TEST_STUBS_WIFI_CLIENT_H)
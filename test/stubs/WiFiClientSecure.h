@@ -0,0 +1,16 @@
+#if !defined(TEST_STUBS_WIFI_CLIENT_SECURE_H)
+#define TEST_STUBS_WIFI_CLIENT_SECURE_H
+
+#include <WiFiClient.h>
+
+class WiFiClientSecure : public WiFiClient {
+public:
+    void setInsecure() { stubInsecure = true; }
+
+    void setCACert(const char *rootCA) { stubCACert = rootCA; }
+
+    bool stubInsecure = false;
+    const char *stubCACert = nullptr;
+};
+
+#endif // !defined(TEST_STUBS_WIFI_CLIENT_SECURE_H)
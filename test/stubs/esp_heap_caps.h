@@ -0,0 +1,24 @@
+#if !defined(TEST_STUBS_ESP_HEAP_CAPS_H)
+#define TEST_STUBS_ESP_HEAP_CAPS_H
+
+#include <cstdint>
+#include <cstdlib>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+/// no PSRAM on the host
+inline void *heap_caps_malloc(size_t size, uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) != 0 ? nullptr : malloc(size);
+}
+
+inline void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps) {
+    return (caps & MALLOC_CAP_SPIRAM) != 0 ? nullptr : realloc(ptr, size);
+}
+
+inline void heap_caps_free(void *ptr) {
+    free(ptr);
+}
+
+#endif // !defined(TEST_STUBS_ESP_HEAP_CAPS_H)
@@ -0,0 +1,13 @@
+#if !defined(TEST_STUBS_LIB_SSL_H)
+#define TEST_STUBS_LIB_SSL_H
+
+#include <cinttypes>
+
+// Certificates are embedded in the firmware, so empty ones are used instead on the host
+
+static const uint8_t rootca_crt_bundle[] __attribute__((unused)) = {0};
+static const char gts_root_r1_crt[] __attribute__((unused)) = "";
+static const char gts_root_r4_crt[] __attribute__((unused)) = "";
+static const char gsrsaovsslca2018_crt[] __attribute__((unused)) = "";
+
+#endif // !defined(TEST_STUBS_LIB_SSL_H)
@@ -0,0 +1,7 @@
+#if !defined(TEST_STUBS_LWIP_SOCKETS_H)
+#define TEST_STUBS_LWIP_SOCKETS_H
+
+#include <sys/select.h>
+#include <sys/time.h>
+
+#endif // !defined(TEST_STUBS_LWIP_SOCKETS_H)
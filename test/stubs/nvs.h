@@ -0,0 +1,108 @@
+#if !defined(TEST_STUBS_NVS_H)
+#define TEST_STUBS_NVS_H
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL (-1)
+#define ESP_ERR_NVS_NOT_FOUND 0x1102
+#define ESP_ERR_NVS_INVALID_HANDLE 0x1107
+#define ESP_ERR_NVS_READ_ONLY 0x1108
+#define ESP_ERR_NVS_INVALID_LENGTH 0x110c
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+/// namespaces of the in-memory NVS
+inline std::map<std::string, std::map<std::string, std::string>> &stubNvs() {
+    static std::map<std::string, std::map<std::string, std::string>> nvs;
+    return nvs;
+}
+
+struct StubNvsHandle {
+    std::string name;
+    nvs_open_mode_t mode;
+};
+
+inline std::vector<StubNvsHandle> &stubNvsHandles() {
+    static std::vector<StubNvsHandle> handles;
+    return handles;
+}
+
+inline esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle) {
+    if (mode == NVS_READONLY && stubNvs().count(name) == 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    stubNvsHandles().push_back({name, mode});
+    *handle = (nvs_handle_t) stubNvsHandles().size();
+    return ESP_OK;
+}
+
+inline void nvs_close(nvs_handle_t) {}
+
+inline esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value) {
+    if (handle == 0 || handle > stubNvsHandles().size()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    auto &h = stubNvsHandles()[handle - 1];
+    if (h.mode == NVS_READONLY) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    stubNvs()[h.name][key] = value;
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *value, size_t *length) {
+    if (handle == 0 || handle > stubNvsHandles().size()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    auto &ns = stubNvs()[stubNvsHandles()[handle - 1].name];
+    auto it = ns.find(key);
+    if (it == ns.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    auto size = it->second.size() + 1;
+    if (value == nullptr) {
+        *length = size;
+        return ESP_OK;
+    }
+    if (*length < size) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(value, it->second.c_str(), size);
+    *length = size;
+    return ESP_OK;
+}
+
+inline esp_err_t nvs_commit(nvs_handle_t) {
+    return ESP_OK;
+}
+
+inline const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:
+            return "ESP_OK";
+        case ESP_ERR_NVS_NOT_FOUND:
+            return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_INVALID_HANDLE:
+            return "ESP_ERR_NVS_INVALID_HANDLE";
+        case ESP_ERR_NVS_READ_ONLY:
+            return "ESP_ERR_NVS_READ_ONLY";
+        case ESP_ERR_NVS_INVALID_LENGTH:
+            return "ESP_ERR_NVS_INVALID_LENGTH";
+        default:
+            return "ESP_FAIL";
+    }
+}
+
+#endif // !defined(TEST_STUBS_NVS_H)
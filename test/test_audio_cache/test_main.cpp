@@ -0,0 +1,221 @@
+#include <memory>
+#include <string>
+#include <Arduino.h>
+#include <FS.h>
+#include <unity.h>
+
+#include "lib/AudioCache.h"
+
+static const char *DIR = "/cache";
+static const char *URL = "http://tts.example.com/speech";
+
+static fs::FS *testFs;
+static std::shared_ptr<ConnectionPool> pool;
+
+static std::string makeAudio(size_t size, char c) {
+    return std::string(size, c);
+}
+
+/**
+ * Open HTTP source receiving the whole audio
+ */
+static std::unique_ptr<AudioFileSourceHttp> openHttp(const std::string &audio) {
+    HTTPClient::stubResponses().push_back({HTTP_CODE_OK, (int) audio.size(), "", audio});
+    return std::unique_ptr<AudioFileSourceHttp>(new AudioFileSourceHttp(pool, URL));
+}
+
+static std::string readAll(AudioFileSource &source) {
+    std::string result;
+    char buf[100];
+    uint32_t n;
+    while ((n = source.read(buf, sizeof(buf))) > 0) {
+        result.append(buf, n);
+    }
+    return result;
+}
+
+/**
+ * Store audio through the cache and read it to the end
+ */
+static void store(AudioCache &cache, const String &key, const std::string &audio) {
+    auto source = cache.store(key, openHttp(audio));
+    TEST_ASSERT_EQUAL_STRING(audio.c_str(), readAll(*source).c_str());
+    source->close();
+}
+
+static String cachePath(const String &key) {
+    return String(DIR) + "/" + key + ".mp3";
+}
+
+void setUp() {
+    testFs = new fs::FS();
+    pool = std::make_shared<ConnectionPool>();
+    HTTPClient::stubResponses().clear();
+    File::stubWriteLimit() = -1;
+}
+
+void tearDown() {
+    pool = nullptr;
+    delete testFs;
+}
+
+void test_make_key() {
+    UrlParams params1{{"speaker", "1"}, {"speed", "1.0"}};
+    UrlParams params2;
+    params2["speed"] = "1.0";
+    params2["speaker"] = "1";
+    auto key = AudioCache::makeKey("VoiceVox", params1, "hello");
+    TEST_ASSERT_EQUAL(16, key.length());
+    TEST_ASSERT_EQUAL_STRING(key.c_str(), AudioCache::makeKey("VoiceVox", params2, "hello").c_str());
+    TEST_ASSERT_NOT_EQUAL(key, AudioCache::makeKey("VoiceVox", params1, "hello!"));
+    TEST_ASSERT_NOT_EQUAL(key, AudioCache::makeKey("VoiceText", params1, "hello"));
+    params2["speaker"] = "2";
+    TEST_ASSERT_NOT_EQUAL(key, AudioCache::makeKey("VoiceVox", params2, "hello"));
+}
+
+void test_store_and_open() {
+    AudioCache cache(*testFs, DIR, 1000);
+    TEST_ASSERT_TRUE(cache.begin());
+    TEST_ASSERT_NULL(cache.open("a").get());
+
+    auto audio = makeAudio(300, 'a');
+    store(cache, "a", audio);
+    TEST_ASSERT_EQUAL_STRING(audio.c_str(), testFs->stubRead(cachePath("a")).c_str());
+
+    auto source = cache.open("a");
+    TEST_ASSERT_NOT_NULL(source.get());
+    TEST_ASSERT_EQUAL(300, source->getSize());
+    TEST_ASSERT_EQUAL_STRING(audio.c_str(), readAll(*source).c_str());
+
+    auto stats = cache.getStats();
+    TEST_ASSERT_EQUAL(1, stats.hits);
+    TEST_ASSERT_EQUAL(1, stats.misses);
+    TEST_ASSERT_EQUAL(1, stats.stores);
+    TEST_ASSERT_EQUAL(1, stats.count);
+    TEST_ASSERT_EQUAL(300, stats.size);
+}
+
+void test_not_store_incomplete() {
+    AudioCache cache(*testFs, DIR, 1000);
+    TEST_ASSERT_TRUE(cache.begin());
+    auto source = cache.store("a", openHttp(makeAudio(300, 'a')));
+    char buf[100];
+    TEST_ASSERT_EQUAL(100, source->read(buf, sizeof(buf)));
+    source->close();
+    TEST_ASSERT_NULL(cache.open("a").get());
+    TEST_ASSERT_EQUAL(0, cache.getStats().stores);
+    TEST_ASSERT_EQUAL(0, testFs->stubCount());
+}
+
+void test_not_store_on_write_failure() {
+    AudioCache cache(*testFs, DIR, 1000);
+    TEST_ASSERT_TRUE(cache.begin());
+    File::stubWriteLimit() = 150;
+    store(cache, "a", makeAudio(300, 'a'));
+    TEST_ASSERT_NULL(cache.open("a").get());
+    TEST_ASSERT_EQUAL(0, testFs->stubCount());
+}
+
+void test_not_store_same_key_twice() {
+    AudioCache cache(*testFs, DIR, 1000);
+    TEST_ASSERT_TRUE(cache.begin());
+    auto audio = makeAudio(100, 'a');
+    auto source1 = cache.store("a", openHttp(audio));
+    auto source2 = cache.store("a", openHttp(audio));
+    TEST_ASSERT_EQUAL_STRING(audio.c_str(), readAll(*source2).c_str());
+    source2->close();
+    TEST_ASSERT_EQUAL(0, cache.getStats().stores);
+    TEST_ASSERT_EQUAL_STRING(audio.c_str(), readAll(*source1).c_str());
+    source1->close();
+    TEST_ASSERT_EQUAL(1, cache.getStats().stores);
+}
+
+void test_evict_least_recently_used() {
+    AudioCache cache(*testFs, DIR, 250);
+    TEST_ASSERT_TRUE(cache.begin());
+    store(cache, "a", makeAudio(100, 'a'));
+    store(cache, "b", makeAudio(100, 'b'));
+    cache.open("a");
+    store(cache, "c", makeAudio(100, 'c'));
+
+    TEST_ASSERT_NOT_NULL(cache.open("a").get());
+    TEST_ASSERT_NULL(cache.open("b").get());
+    TEST_ASSERT_NOT_NULL(cache.open("c").get());
+    TEST_ASSERT_FALSE(testFs->exists(cachePath("b")));
+    auto stats = cache.getStats();
+    TEST_ASSERT_EQUAL(1, stats.evictions);
+    TEST_ASSERT_EQUAL(200, stats.size);
+}
+
+void test_not_evict_entry_being_read() {
+    AudioCache cache(*testFs, DIR, 250);
+    TEST_ASSERT_TRUE(cache.begin());
+    store(cache, "a", makeAudio(100, 'a'));
+    auto reader = cache.open("a");
+    store(cache, "b", makeAudio(100, 'b'));
+    store(cache, "c", makeAudio(100, 'c'));
+    store(cache, "d", makeAudio(100, 'd'));
+
+    // "a" is the oldest but pinned
+    TEST_ASSERT_TRUE(testFs->exists(cachePath("a")));
+    TEST_ASSERT_EQUAL_STRING(makeAudio(100, 'a').c_str(), readAll(*reader).c_str());
+    TEST_ASSERT_FALSE(testFs->exists(cachePath("b")));
+    TEST_ASSERT_FALSE(testFs->exists(cachePath("c")));
+    TEST_ASSERT_TRUE(testFs->exists(cachePath("d")));
+
+    // unpinned on close
+    reader->close();
+    store(cache, "e", makeAudio(100, 'e'));
+    TEST_ASSERT_FALSE(testFs->exists(cachePath("a")));
+    TEST_ASSERT_TRUE(testFs->exists(cachePath("e")));
+}
+
+void test_unpin_on_destroy() {
+    AudioCache cache(*testFs, DIR, 150);
+    TEST_ASSERT_TRUE(cache.begin());
+    store(cache, "a", makeAudio(100, 'a'));
+    {
+        auto reader = cache.open("a");
+        auto reader2 = cache.open("a");
+        reader2->close();
+        store(cache, "b", makeAudio(100, 'b'));
+        TEST_ASSERT_TRUE(testFs->exists(cachePath("a")));
+    }
+    store(cache, "c", makeAudio(100, 'c'));
+    TEST_ASSERT_FALSE(testFs->exists(cachePath("a")));
+}
+
+void test_begin_loads_entries() {
+    testFs->mkdir(DIR);
+    testFs->stubWrite(cachePath("old"), makeAudio(100, 'o'));
+    testFs->stubWrite(cachePath("new"), makeAudio(100, 'n'));
+    testFs->stubWrite(String(DIR) + "/broken.tmp", makeAudio(10, 'x'));
+    testFs->stubWrite("/other.mp3", makeAudio(10, 'x'));
+
+    AudioCache cache(*testFs, DIR, 250);
+    TEST_ASSERT_TRUE(cache.begin());
+    auto stats = cache.getStats();
+    TEST_ASSERT_EQUAL(2, stats.count);
+    TEST_ASSERT_EQUAL(200, stats.size);
+    TEST_ASSERT_FALSE(testFs->exists(String(DIR) + "/broken.tmp"));
+    TEST_ASSERT_TRUE(testFs->exists("/other.mp3"));
+
+    // older one is evicted first
+    store(cache, "a", makeAudio(100, 'a'));
+    TEST_ASSERT_FALSE(testFs->exists(cachePath("old")));
+    TEST_ASSERT_TRUE(testFs->exists(cachePath("new")));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_make_key);
+    RUN_TEST(test_store_and_open);
+    RUN_TEST(test_not_store_incomplete);
+    RUN_TEST(test_not_store_on_write_failure);
+    RUN_TEST(test_not_store_same_key_twice);
+    RUN_TEST(test_evict_least_recently_used);
+    RUN_TEST(test_not_evict_entry_being_read);
+    RUN_TEST(test_unpin_on_destroy);
+    RUN_TEST(test_begin_loads_entries);
+    return UNITY_END();
+}
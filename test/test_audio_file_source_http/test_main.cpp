@@ -0,0 +1,179 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <Arduino.h>
+#include <unity.h>
+
+#include "lib/AudioFileSourceHttp.h"
+
+static const char *URL = "http://tts.example.com/speech";
+
+static std::shared_ptr<ConnectionPool> pool;
+
+typedef AudioFileSourceHttp::ReadStatus ReadStatus;
+
+/**
+ * Open the source with the response headers and the first bytes of body received
+ *
+ * @param size Content-Length (-1: not sent)
+ * @param transferEncoding Transfer-Encoding header
+ * @param body bytes received with the headers
+ */
+static std::unique_ptr<AudioFileSourceHttp> openHttp(int size, const char *transferEncoding, const std::string &body) {
+    HTTPClient::stubResponses().push_back({HTTP_CODE_OK, size, transferEncoding, body});
+    auto source = std::unique_ptr<AudioFileSourceHttp>(new AudioFileSourceHttp(pool, URL));
+    TEST_ASSERT_TRUE(source->isOpen());
+    return source;
+}
+
+/**
+ * Read without blocking until no more bytes are ready
+ */
+static std::string readReady(AudioFileSourceHttp &source) {
+    std::string result;
+    char buf[4];
+    uint32_t n;
+    while ((n = source.readNonBlock(buf, sizeof(buf))) > 0) {
+        TEST_ASSERT_EQUAL((int) ReadStatus::Ok, (int) source.getStatus());
+        result.append(buf, n);
+    }
+    return result;
+}
+
+/**
+ * Check that the next non-blocking read returns nothing with the status
+ */
+static void assertStatus(AudioFileSourceHttp &source, ReadStatus status) {
+    char buf[4];
+    TEST_ASSERT_EQUAL(0, source.readNonBlock(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL((int) status, (int) source.getStatus());
+}
+
+void setUp() {
+    pool = std::make_shared<ConnectionPool>();
+    HTTPClient::stubResponses().clear();
+}
+
+void tearDown() {
+    pool = nullptr;
+}
+
+void test_content_length() {
+    auto source = openHttp(10, "", "012");
+    auto client = WiFiClient::stubLast();
+    TEST_ASSERT_EQUAL(10, source->getSize());
+    TEST_ASSERT_EQUAL_STRING("012", readReady(*source).c_str());
+    assertStatus(*source, ReadStatus::WouldBlock);
+
+    client->stubReceive("3456789");
+    TEST_ASSERT_EQUAL_STRING("3456789", readReady(*source).c_str());
+    TEST_ASSERT_EQUAL(10, source->getPos());
+    TEST_ASSERT_TRUE(source->isCompleted());
+    assertStatus(*source, ReadStatus::Eof);
+
+    // the connection has been returned to the pool for reuse
+    TEST_ASSERT_FALSE(source->isOpen());
+    TEST_ASSERT_TRUE(pool->acquire(URL, nullptr)->isReused());
+}
+
+void test_until_close() {
+    auto source = openHttp(-1, "", "abc");
+    auto client = WiFiClient::stubLast();
+    TEST_ASSERT_EQUAL_STRING("abc", readReady(*source).c_str());
+    assertStatus(*source, ReadStatus::WouldBlock);
+
+    client->stubReceive("def");
+    client->stubClose();
+    TEST_ASSERT_EQUAL_STRING("def", readReady(*source).c_str());
+    TEST_ASSERT_EQUAL((int) ReadStatus::Eof, (int) source->getStatus());
+    TEST_ASSERT_TRUE(source->isCompleted());
+    assertStatus(*source, ReadStatus::Eof);
+}
+
+void test_closed_before_end() {
+    auto source = openHttp(10, "", "0123");
+    auto client = WiFiClient::stubLast();
+    client->stubClose();
+    TEST_ASSERT_EQUAL_STRING("0123", readReady(*source).c_str());
+    TEST_ASSERT_EQUAL((int) ReadStatus::Error, (int) source->getStatus());
+    TEST_ASSERT_FALSE(source->isCompleted());
+    assertStatus(*source, ReadStatus::Error);
+
+    // the broken connection is not reused
+    TEST_ASSERT_FALSE(pool->acquire(URL, nullptr)->isReused());
+}
+
+void test_chunked() {
+    auto source = openHttp(-1, "chunked", "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n");
+    TEST_ASSERT_EQUAL_STRING("hello world", readReady(*source).c_str());
+    TEST_ASSERT_TRUE(source->isCompleted());
+    assertStatus(*source, ReadStatus::Eof);
+}
+
+void test_chunked_split_at_every_byte() {
+    const std::string body = "a\r\n0123456789\r\n1;ext=1\r\n!\r\n0\r\nTrailer: x\r\n\r\n";
+    auto source = openHttp(-1, "chunked", "");
+    auto client = WiFiClient::stubLast();
+    std::string result;
+    auto start = std::chrono::steady_clock::now();
+    // partial chunk-size lines, extensions and trailers are kept across the calls
+    for (size_t i = 0; i < body.size(); i++) {
+        client->stubReceive(body.substr(i, 1));
+        char buf[16];
+        auto n = source->readNonBlock(buf, sizeof(buf));
+        result.append(buf, n);
+        auto expected = n > 0 ? ReadStatus::Ok : i + 1 < body.size() ? ReadStatus::WouldBlock : ReadStatus::Eof;
+        TEST_ASSERT_EQUAL((int) expected, (int) source->getStatus());
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    TEST_ASSERT_EQUAL_STRING("0123456789!", result.c_str());
+    TEST_ASSERT_EQUAL((int) ReadStatus::Eof, (int) source->getStatus());
+    TEST_ASSERT_TRUE(source->isCompleted());
+    // never waits for the rest of the line
+    TEST_ASSERT_TRUE(elapsed < std::chrono::milliseconds(50));
+}
+
+void test_chunked_error() {
+    auto source = openHttp(-1, "chunked", "zz\r\nhello\r\n");
+    assertStatus(*source, ReadStatus::Error);
+    TEST_ASSERT_FALSE(source->isCompleted());
+    assertStatus(*source, ReadStatus::Error);
+}
+
+void test_chunked_closed_before_end() {
+    auto source = openHttp(-1, "chunked", "5\r\nhel");
+    auto client = WiFiClient::stubLast();
+    client->stubClose();
+    TEST_ASSERT_EQUAL_STRING("hel", readReady(*source).c_str());
+    TEST_ASSERT_EQUAL((int) ReadStatus::Error, (int) source->getStatus());
+    TEST_ASSERT_FALSE(source->isCompleted());
+}
+
+void test_blocking_read_timeout() {
+    auto source = openHttp(10, "", "");
+    char buf[4];
+    auto start = millis();
+    TEST_ASSERT_EQUAL(0, source->read(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL((int) ReadStatus::WouldBlock, (int) source->getStatus());
+    TEST_ASSERT_TRUE(millis() - start >= 500);
+
+    // returns at once on the end of body
+    WiFiClient::stubLast()->stubClose();
+    start = millis();
+    TEST_ASSERT_EQUAL(0, source->read(buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL((int) ReadStatus::Error, (int) source->getStatus());
+    TEST_ASSERT_TRUE(millis() - start < 50);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_content_length);
+    RUN_TEST(test_until_close);
+    RUN_TEST(test_closed_before_end);
+    RUN_TEST(test_chunked);
+    RUN_TEST(test_chunked_split_at_every_byte);
+    RUN_TEST(test_chunked_error);
+    RUN_TEST(test_chunked_closed_before_end);
+    RUN_TEST(test_blocking_read_timeout);
+    return UNITY_END();
+}
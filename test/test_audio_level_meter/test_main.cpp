@@ -0,0 +1,140 @@
+#include <cmath>
+#include <vector>
+#include <unity.h>
+
+#include "lib/AudioLevelMeter.h"
+
+static const int RATE = 24000;
+
+/// one output buffer (40 ms)
+static const int WINDOW = 960;
+
+static int16_t sine(int amplitude, int hz, int i) {
+    return (int16_t) lround(amplitude * sin(2 * M_PI * hz * i / RATE));
+}
+
+/**
+ * Add a window of sine samples and publish it
+ */
+static void addSine(AudioLevelMeter &meter, int amplitude, int hz, int &pos) {
+    for (int i = 0; i < WINDOW; i++, pos++) {
+        meter.add(sine(amplitude, hz, pos));
+    }
+    meter.update();
+}
+
+static void addSilence(AudioLevelMeter &meter) {
+    for (int i = 0; i < WINDOW; i++) {
+        meter.add(0);
+    }
+    meter.update();
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_sine() {
+    for (int amplitude: {1000, 15000, 32767}) {
+        AudioLevelMeter meter;
+        int pos = 0;
+        addSine(meter, amplitude, 500, pos);
+        TEST_ASSERT_INT_WITHIN(amplitude / 100 + 1, (int) (amplitude / sqrt(2)), meter.getLevel());
+        TEST_ASSERT_EQUAL(amplitude, meter.getPeak());
+    }
+}
+
+void test_full_scale_square() {
+    AudioLevelMeter meter;
+    for (int i = 0; i < WINDOW; i++) {
+        meter.add(i % 2 == 0 ? INT16_MAX : INT16_MIN);
+    }
+    meter.update();
+    TEST_ASSERT_INT_WITHIN(1, INT16_MAX, meter.getLevel());
+    TEST_ASSERT_EQUAL(INT16_MAX, meter.getPeak());
+}
+
+void test_attack_and_release() {
+    AudioLevelMeter meter;
+    int pos = 0;
+    addSine(meter, 10000, 500, pos);
+    auto level = meter.getLevel();
+
+    // rising level is followed at once
+    addSine(meter, 20000, 500, pos);
+    TEST_ASSERT_INT_WITHIN(20000 / 100, (int) (20000 / sqrt(2)), meter.getLevel());
+    level = meter.getLevel();
+
+    // halved on each silent window, peak follows the window
+    for (int i = 0; i < 8; i++) {
+        addSilence(meter);
+        TEST_ASSERT_INT_WITHIN(1, level / 2, meter.getLevel());
+        TEST_ASSERT_EQUAL(0, meter.getPeak());
+        level = meter.getLevel();
+    }
+    TEST_ASSERT_TRUE(meter.getLevel() < 100);
+}
+
+void test_speech_like_envelope() {
+    // syllables of 160 ms voiced sound and 120 ms gap, with a rising and falling loudness
+    AudioLevelMeter meter;
+    std::vector<int> levels;
+    int pos = 0;
+    for (int syllable = 0; syllable < 4; syllable++) {
+        for (int window = 0; window < 4; window++) {
+            int amplitude = (int) (12000 * sin(M_PI * (window + 0.5) / 4));
+            for (int i = 0; i < WINDOW; i++, pos++) {
+                meter.add((int16_t) (sine(amplitude, 200, pos) / 2 + sine(amplitude, 700, pos) / 2));
+            }
+            meter.update();
+            levels.push_back(meter.getLevel());
+        }
+        for (int window = 0; window < 3; window++) {
+            addSilence(meter);
+            levels.push_back(meter.getLevel());
+        }
+    }
+    for (int syllable = 0; syllable < 4; syllable++) {
+        auto l = levels.begin() + syllable * 7;
+        // rises to the middle of the syllable
+        TEST_ASSERT_TRUE(l[1] > l[0]);
+        TEST_ASSERT_TRUE(l[1] > 4000);
+        // decays in the gap, not dropping to zero at once
+        TEST_ASSERT_TRUE(l[4] < l[3]);
+        TEST_ASSERT_TRUE(l[4] > 0);
+        TEST_ASSERT_TRUE(l[6] < l[5]);
+        TEST_ASSERT_TRUE(l[6] < 1000);
+    }
+}
+
+void test_update_without_samples() {
+    AudioLevelMeter meter;
+    int pos = 0;
+    addSine(meter, 10000, 500, pos);
+    auto level = meter.getLevel();
+    meter.update();
+    TEST_ASSERT_EQUAL(level, meter.getLevel());
+}
+
+void test_reset() {
+    AudioLevelMeter meter;
+    int pos = 0;
+    addSine(meter, 10000, 500, pos);
+    meter.add(30000);
+    meter.reset();
+    TEST_ASSERT_EQUAL(0, meter.getLevel());
+    TEST_ASSERT_EQUAL(0, meter.getPeak());
+    addSilence(meter);
+    TEST_ASSERT_EQUAL(0, meter.getLevel());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_sine);
+    RUN_TEST(test_full_scale_square);
+    RUN_TEST(test_attack_and_release);
+    RUN_TEST(test_speech_like_envelope);
+    RUN_TEST(test_update_without_samples);
+    RUN_TEST(test_reset);
+    return UNITY_END();
+}
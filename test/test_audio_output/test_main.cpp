@@ -0,0 +1,359 @@
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+#include <Arduino.h>
+#include <unity.h>
+
+#include "lib/AudioOutputM5Speaker.hpp"
+
+static m5::Speaker_Class *speaker;
+static AudioOutputM5Speaker *out;
+
+/**
+ * Feed samples numbered from the given number (right channel is dropped)
+ *
+ * @return number of samples consumed
+ */
+static int feed(int from, int count) {
+    for (int i = 0; i < count; i++) {
+        int16_t sample[2] = {(int16_t) (from + i), -1};
+        if (!out->ConsumeSample(sample)) {
+            return i;
+        }
+    }
+    return count;
+}
+
+/**
+ * Pump until the stream is played (the speaker finishes a buffer whenever the output waits)
+ */
+static void playAll() {
+    for (int i = 0; i < 100000 && out->isActive(); i++) {
+        if (out->pump() != 0) {
+            speaker->stubFinish();
+        }
+    }
+    TEST_ASSERT_FALSE(out->isActive());
+}
+
+static void assertPlayed(int count) {
+    TEST_ASSERT_EQUAL(count, speaker->stubPlayed.size());
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL((int16_t) i, speaker->stubPlayed[i]);
+    }
+}
+
+void setUp() {
+    speaker = new m5::Speaker_Class();
+    speaker->stubRealTime = false;
+    out = new AudioOutputM5Speaker(speaker);
+    TEST_ASSERT_TRUE(out->init());
+}
+
+void tearDown() {
+    delete out;
+    delete speaker;
+}
+
+void test_play_mono() {
+    out->begin();
+    out->SetRate(24000);
+    TEST_ASSERT_EQUAL(3000, feed(0, 3000));
+    out->stop();
+    playAll();
+
+    assertPlayed(3000);
+    TEST_ASSERT_EQUAL(24000, speaker->stubRate);
+    TEST_ASSERT_EQUAL(0, speaker->stubRejected);
+    std::vector<size_t> blocks = {960, 960, 960, 120};
+    TEST_ASSERT_TRUE(speaker->stubBlocks == blocks);
+    TEST_ASSERT_EQUAL(0, out->getUnderrunCount());
+}
+
+void test_block_size_from_rate() {
+    out->begin();
+    out->SetRate(16000);
+    feed(0, 1000);
+    out->stop();
+    playAll();
+    TEST_ASSERT_EQUAL(640, speaker->stubBlocks[0]);
+
+    // limited by the buffer size
+    speaker->stubBlocks.clear();
+    out->begin();
+    out->SetRate(48000);
+    feed(0, 3000);
+    out->stop();
+    playAll();
+    TEST_ASSERT_EQUAL(AUDIO_OUTPUT_BUF_SIZE, speaker->stubBlocks[0]);
+}
+
+void test_start_with_full_block() {
+    out->begin();
+    out->SetRate(24000);
+    feed(0, 500);
+    TEST_ASSERT_NOT_EQUAL(0, out->pump());
+    TEST_ASSERT_EQUAL(0, speaker->stubBlocks.size());
+    feed(500, 500);
+    out->flush();
+    TEST_ASSERT_EQUAL(0, out->pump());
+    TEST_ASSERT_EQUAL(1, speaker->stubBlocks.size());
+    TEST_ASSERT_EQUAL(960, speaker->stubBlocks[0]);
+}
+
+void test_count_underrun() {
+    out->begin();
+    out->SetRate(24000);
+    feed(0, 2000);
+    out->flush();
+    while (out->pump() == 0) {
+    }
+    TEST_ASSERT_EQUAL(2, speaker->isPlaying(0));
+    TEST_ASSERT_EQUAL(0, out->getUnderrunCount());
+
+    // the speaker runs dry before the next buffer
+    speaker->stubFinish();
+    speaker->stubFinish();
+    TEST_ASSERT_EQUAL(0, out->pump());
+    TEST_ASSERT_EQUAL(1, out->getUnderrunCount());
+
+    feed(2000, 3000);
+    out->stop();
+    playAll();
+    assertPlayed(5000);
+    TEST_ASSERT_EQUAL(1, out->getUnderrunCount());
+}
+
+void test_next_stream() {
+    out->begin();
+    out->SetRate(24000);
+    feed(0, 100);
+    out->stop();
+    playAll();
+
+    // the first buffer of a stream is not an underrun
+    speaker->stubPlayed.clear();
+    out->begin();
+    feed(0, 2000);
+    out->stop();
+    playAll();
+    assertPlayed(2000);
+    TEST_ASSERT_EQUAL(0, out->getUnderrunCount());
+}
+
+void test_cancel() {
+    out->begin();
+    out->SetRate(24000);
+    feed(0, 3000);
+    TEST_ASSERT_EQUAL(0, out->pump());
+    out->cancel();
+    TEST_ASSERT_TRUE(out->isActive());
+    TEST_ASSERT_EQUAL(portMAX_DELAY, out->pump());
+    TEST_ASSERT_FALSE(out->isActive());
+    TEST_ASSERT_EQUAL(1, speaker->stubStopCount);
+    TEST_ASSERT_EQUAL(960, speaker->stubPlayed.size());
+
+    // nothing left for the next stream
+    out->begin();
+    feed(0, 100);
+    out->stop();
+    playAll();
+    TEST_ASSERT_EQUAL(1060, speaker->stubPlayed.size());
+}
+
+void test_viseme_follows_rate() {
+    out->begin();
+    out->SetRate(24000);
+    for (int i = 0; i < 960; i++) {
+        int16_t sample[2] = {(int16_t) lround(8000 * sin(2 * M_PI * 150 * i / 24000)), 0};
+        out->ConsumeSample(sample);
+    }
+    out->flush();
+    TEST_ASSERT_EQUAL(0, out->pump());
+    VisemeEvent event{};
+    TEST_ASSERT_TRUE(out->getViseme(event));
+    TEST_ASSERT_EQUAL((int) Viseme::Round, (int) event.viseme);
+}
+
+void test_pause_at_high_watermark() {
+    // this thread is both the decoder and the output task
+    out->setTasks(xTaskGetCurrentTaskHandle(), xTaskGetCurrentTaskHandle());
+    out->begin();
+    out->SetRate(24000);
+    auto highWater = 24000 * AUDIO_OUTPUT_LOOKAHEAD_MS / 1000;
+    TEST_ASSERT_EQUAL(highWater, feed(0, highWater * 2));
+    TEST_ASSERT_FALSE(out->isReady());
+    TEST_ASSERT_EQUAL(1, out->getOverrunCount());
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    // resumes and is notified when drained to the low watermark
+    size_t played = 0;
+    while (!out->isReady()) {
+        TEST_ASSERT_EQUAL(0, ulTaskNotifyTake(pdTRUE, 0));
+        played = speaker->stubPlayed.size();
+        if (out->pump() != 0) {
+            speaker->stubFinish();
+        }
+    }
+    TEST_ASSERT_TRUE(played >= (size_t) highWater / 2 - AUDIO_OUTPUT_BUF_SIZE);
+    TEST_ASSERT_TRUE(ulTaskNotifyTake(pdTRUE, 0) > 0);
+
+    TEST_ASSERT_EQUAL(1000, feed(highWater, 1000));
+    out->stop();
+    playAll();
+    assertPlayed(highWater + 1000);
+    TEST_ASSERT_EQUAL(1, out->getOverrunCount());
+}
+
+void test_jittery_source() {
+    // 1 s of audio played in real time, decoded with stalls up to 300 ms
+    speaker->stubRealTime = true;
+    TaskHandle_t decoderTask = xTaskGetCurrentTaskHandle();
+    std::atomic<TaskHandle_t> outputTask{nullptr};
+    std::atomic<bool> quit{false};
+    std::thread output([&]() {
+        outputTask = xTaskGetCurrentTaskHandle();
+        while (!quit) {
+            auto wait = out->pump();
+            if (wait > 0) {
+                ulTaskNotifyTake(pdTRUE, wait);
+            }
+        }
+    });
+    while (outputTask == nullptr) {
+        yield();
+    }
+    out->setTasks(decoderTask, outputTask);
+
+    const int total = 24000;
+    std::mt19937 rng(1);
+    out->begin();
+    out->SetRate(24000);
+    int fed = 0;
+    while (fed < total) {
+        if (!out->isReady()) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+            continue;
+        }
+        if (rng() % 10 == 0) {
+            delay(rng() % 300);
+        }
+        // one MP3 frame
+        fed += feed(fed, std::min(1152, total - fed));
+    }
+    out->stop();
+    while (out->isActive()) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    }
+    quit = true;
+    xTaskNotifyGive(outputTask);
+    output.join();
+
+    assertPlayed(total);
+    TEST_ASSERT_EQUAL(0, speaker->stubRejected);
+    char buf[64];
+    snprintf(buf, sizeof(buf), "underruns %u, overruns %u", out->getUnderrunCount(), out->getOverrunCount());
+    TEST_MESSAGE(buf);
+}
+
+void test_stress_readers_and_stop() {
+    // the voice task plays streams while the face tasks read the state and other tasks request to stop
+    speaker->stubRealTime = true;
+    std::atomic<TaskHandle_t> outputTask{nullptr};
+    std::atomic<bool> quit{false};
+    std::thread output([&]() {
+        outputTask = xTaskGetCurrentTaskHandle();
+        while (!quit) {
+            auto wait = out->pump();
+            if (wait > 0) {
+                ulTaskNotifyTake(pdTRUE, wait);
+            }
+        }
+    });
+    while (outputTask == nullptr) {
+        yield();
+    }
+    out->setTasks(xTaskGetCurrentTaskHandle(), outputTask);
+
+    std::atomic<long> reads{0};
+    std::atomic<int> stopRequests{0};
+    std::vector<std::thread> others;
+    for (int i = 0; i < 2; i++) {
+        others.emplace_back([&]() {
+            VisemeEvent event{};
+            while (!quit) {
+                volatile int level = out->getLevel() + out->getPeak() + (int) out->isActive();
+                (void) level;
+                out->getViseme(event);
+                out->getUnderrunCount();
+                reads++;
+                yield();
+            }
+        });
+        others.emplace_back([&, i]() {
+            std::mt19937 rng(i);
+            while (!quit) {
+                delay(rng() % 60);
+                stopRequests++;
+            }
+        });
+    }
+
+    const int streams = 20;
+    int cancelled = 0;
+    bool ended = true;
+    for (int stream = 0; stream < streams; stream++) {
+        stopRequests = 0;
+        out->begin();
+        out->SetRate(24000);
+        int fed = 0;
+        while (fed < 2400 && stopRequests == 0) {
+            if (!out->isReady()) {
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+                continue;
+            }
+            fed += feed(fed, std::min(480, 2400 - fed));
+            delay(5);
+        }
+        out->stop();
+        if (stopRequests > 0) {
+            out->cancel();
+            cancelled++;
+        }
+        for (int i = 0; i < 50 && out->isActive(); i++) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        }
+        ended = ended && !out->isActive();
+    }
+    quit = true;
+    xTaskNotifyGive(outputTask);
+    output.join();
+    for (auto &thread: others) {
+        thread.join();
+    }
+
+    char buf[96];
+    snprintf(buf, sizeof(buf), "%d streams, %d stopped, %ld reads", streams, cancelled, reads.load());
+    TEST_MESSAGE(buf);
+    TEST_ASSERT_TRUE(ended);
+    TEST_ASSERT_TRUE(cancelled > 0);
+    TEST_ASSERT_TRUE(reads > 1000);
+    TEST_ASSERT_EQUAL(0, speaker->stubRejected);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_play_mono);
+    RUN_TEST(test_block_size_from_rate);
+    RUN_TEST(test_start_with_full_block);
+    RUN_TEST(test_count_underrun);
+    RUN_TEST(test_next_stream);
+    RUN_TEST(test_cancel);
+    RUN_TEST(test_viseme_follows_rate);
+    RUN_TEST(test_pause_at_high_watermark);
+    RUN_TEST(test_jittery_source);
+    RUN_TEST(test_stress_readers_and_stop);
+    return UNITY_END();
+}
@@ -0,0 +1,220 @@
+#include <chrono>
+#include <deque>
+#include <string>
+#include <Arduino.h>
+#include <unity.h>
+
+#include "lib/ChatHistory.h"
+#include "lib/ChatRequestStream.h"
+#include "lib/arena.h"
+#include "lib/utils.h"
+
+static const int BENCHMARK_REPEAT = 200;
+
+static std::string fragment(const ChatHistory &history, size_t index) {
+    size_t len;
+    auto data = history.fragment(index, len);
+    return std::string(data, len);
+}
+
+static std::string turn(const char *question, const char *answer) {
+    return std::string("{\"role\":\"user\",\"content\":\"") + question
+           + "\"},{\"role\":\"assistant\",\"content\":\"" + answer + "\"}";
+}
+
+static String question(int i) {
+    return String("What is the weather like today in Tokyo? (") + String(i) + ")";
+}
+
+static String answer(int i) {
+    return String("It is \"sunny\" with a light breeze,\naround twenty degrees. (") + String(i) + ")";
+}
+
+/**
+ * Append text escaped as json string
+ */
+static void appendEscaped(String &out, const String &text) {
+    char escaped[7];
+    for (auto c: text) {
+        auto n = jsonEscapeChar((uint8_t) c, escaped);
+        if (n > 0) {
+            out += String(escaped, n);
+        } else {
+            out += c;
+        }
+    }
+}
+
+/**
+ * Request body encoded from the messages on every request (as before)
+ */
+static String encodeMessages(const std::deque<String> &messages, const String &text) {
+    String body = "{\"model\":\"gpt-4o-mini\",\"stream\":true,\"messages\":[";
+    for (size_t i = 0; i < messages.size(); i++) {
+        body += i % 2 == 0 ? "{\"role\":\"user\",\"content\":\"" : ",{\"role\":\"assistant\",\"content\":\"";
+        appendEscaped(body, messages[i]);
+        body += i % 2 == 0 ? "\"}" : "\"},";
+    }
+    body += "{\"role\":\"user\",\"content\":\"";
+    appendEscaped(body, text);
+    body += "\"}]}";
+    return body;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_empty_costs_nothing() {
+    auto before = getArenaStats(Arena::Large).used;
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    TEST_ASSERT_EQUAL(before, getArenaStats(Arena::Large).used);
+    TEST_ASSERT_EQUAL(0, history.size());
+    TEST_ASSERT_EQUAL(0, history.bytes());
+    TEST_ASSERT_EQUAL(0, history.tokens());
+
+    // one buffer for all turns
+    history.add("hello", "world", 10);
+    history.add("hello", "world", 10);
+    TEST_ASSERT_EQUAL(before + CHAT_HISTORY_MAX_SIZE, getArenaStats(Arena::Large).used);
+}
+
+void test_escaped_fragment() {
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    TEST_ASSERT_TRUE(history.add("hello\n", "world \"w\"\\", 10));
+    TEST_ASSERT_TRUE(history.add("あいう", "\x01", 10));
+    TEST_ASSERT_EQUAL(2, history.size());
+    TEST_ASSERT_EQUAL_STRING(turn("hello\\n", "world \\\"w\\\"\\\\").c_str(), fragment(history, 0).c_str());
+    TEST_ASSERT_EQUAL_STRING(turn("あいう", "\\u0001").c_str(), fragment(history, 1).c_str());
+    TEST_ASSERT_EQUAL(fragment(history, 0).size() + fragment(history, 1).size(), history.bytes());
+}
+
+void test_estimate_tokens() {
+    TEST_ASSERT_EQUAL(0, ChatHistory::estimateTokens("", 0));
+    TEST_ASSERT_EQUAL(1, ChatHistory::estimateTokens("abcd", 4));
+    TEST_ASSERT_EQUAL(2, ChatHistory::estimateTokens("abcde", 5));
+    TEST_ASSERT_EQUAL(3, ChatHistory::estimateTokens("あいう", strlen("あいう")));
+    TEST_ASSERT_EQUAL(2, ChatHistory::estimateTokens("aあ", strlen("aあ")));
+
+    // 4 tokens of the format for each message
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    history.add("abcde", "あいう", 10);
+    TEST_ASSERT_EQUAL(4 + 2 + 4 + 3, history.tokens());
+}
+
+void test_evict_by_turns() {
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(history.add(question(i), answer(i), 3));
+    }
+    TEST_ASSERT_EQUAL(3, history.size());
+    TEST_ASSERT_TRUE(fragment(history, 0).find("(2)") != std::string::npos);
+    TEST_ASSERT_TRUE(fragment(history, 2).find("(4)") != std::string::npos);
+    TEST_ASSERT_FALSE(history.add("q", "a", 0));
+}
+
+void test_evict_by_size() {
+    ChatHistory history(400, 10000);
+    for (int i = 0; i < 20; i++) {
+        TEST_ASSERT_TRUE(history.add(question(i), answer(i), 100));
+        TEST_ASSERT_TRUE(history.bytes() <= 400);
+    }
+    TEST_ASSERT_EQUAL(2, history.size());
+    TEST_ASSERT_TRUE(fragment(history, 1).find("(19)") != std::string::npos);
+    // fragments are kept contiguous after eviction
+    TEST_ASSERT_EQUAL(fragment(history, 0).size() + fragment(history, 1).size(), history.bytes());
+    TEST_ASSERT_EQUAL_STRING(turn("What is the weather like today in Tokyo? (18)",
+                                  "It is \\\"sunny\\\" with a light breeze,\\naround twenty degrees. (18)").c_str(),
+                             fragment(history, 0).c_str());
+}
+
+void test_evict_by_tokens() {
+    ChatHistory history(10000, 100);
+    for (int i = 0; i < 20; i++) {
+        TEST_ASSERT_TRUE(history.add(question(i), answer(i), 100));
+        TEST_ASSERT_TRUE(history.tokens() <= 100);
+    }
+    TEST_ASSERT_EQUAL(2, history.size());
+    TEST_ASSERT_TRUE(fragment(history, 1).find("(19)") != std::string::npos);
+}
+
+void test_reject_too_large() {
+    ChatHistory history(300, 100);
+    TEST_ASSERT_TRUE(history.add("hello", "world", 10));
+    TEST_ASSERT_FALSE(history.add(String(std::string(400, 'a')), "x", 10));
+    TEST_ASSERT_FALSE(history.add("x", String(std::string(100 * 4, 'a')), 10));
+    // kept as is
+    TEST_ASSERT_EQUAL(1, history.size());
+    TEST_ASSERT_EQUAL_STRING(turn("hello", "world").c_str(), fragment(history, 0).c_str());
+}
+
+void test_clear() {
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    history.add("hello", "world", 10);
+    auto used = getArenaStats(Arena::Large).used;
+    history.clear();
+    TEST_ASSERT_EQUAL(0, history.size());
+    TEST_ASSERT_EQUAL(0, history.bytes());
+    TEST_ASSERT_EQUAL(0, history.tokens());
+    // the buffer is kept for the next turns
+    TEST_ASSERT_EQUAL(used, getArenaStats(Arena::Large).used);
+    history.add("again", "ok", 10);
+    TEST_ASSERT_EQUAL_STRING(turn("again", "ok").c_str(), fragment(history, 0).c_str());
+}
+
+void test_benchmark() {
+    String model = "gpt-4o-mini";
+    String text = "And tomorrow?";
+    std::vector<String> roles;
+    for (int turns: {10, 50, 200}) {
+        ChatHistory history(1 << 20, 1 << 20);
+        std::deque<String> messages;
+        for (int i = 0; i < turns; i++) {
+            history.add(question(i), answer(i), turns);
+            messages.push_back(question(i));
+            messages.push_back(answer(i));
+        }
+
+        // fragments concatenated while sending
+        size_t streamed = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < BENCHMARK_REPEAT; r++) {
+            ChatRequestStream stream(model, true, roles, history, text);
+            char buf[1024];
+            while (stream.available() > 0) {
+                streamed += stream.readBytes(buf, sizeof(buf));
+            }
+        }
+        auto streamUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        // all messages escaped again on each request
+        size_t encoded = 0;
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < BENCHMARK_REPEAT; r++) {
+            encoded += encodeMessages(messages, text).length();
+        }
+        auto encodeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        char buf[160];
+        snprintf(buf, sizeof(buf), "%d turns (%u bytes): fragments %.1f us/request, re-encoding %.1f us/request",
+                 turns, (unsigned) (streamed / BENCHMARK_REPEAT), streamUs / BENCHMARK_REPEAT,
+                 encodeUs / BENCHMARK_REPEAT);
+        TEST_MESSAGE(buf);
+        TEST_ASSERT_EQUAL(encoded, streamed);
+        TEST_ASSERT_TRUE(streamUs < encodeUs);
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_costs_nothing);
+    RUN_TEST(test_escaped_fragment);
+    RUN_TEST(test_estimate_tokens);
+    RUN_TEST(test_evict_by_turns);
+    RUN_TEST(test_evict_by_size);
+    RUN_TEST(test_evict_by_tokens);
+    RUN_TEST(test_reject_too_large);
+    RUN_TEST(test_clear);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
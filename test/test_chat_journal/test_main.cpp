@@ -0,0 +1,289 @@
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <FS.h>
+#include <unity.h>
+
+#include "lib/ChatJournal.h"
+
+static const char *PATH = "/chat.bin";
+
+static fs::FS *testFs;
+
+struct Turn {
+    std::string question;
+    std::string answer;
+};
+
+static std::vector<Turn> load(ChatJournal &journal, size_t maxTurns) {
+    std::vector<Turn> turns;
+    auto count = journal.load(maxTurns, [&turns](const String &question, const String &answer) {
+        turns.push_back({question.c_str(), answer.c_str()});
+    });
+    TEST_ASSERT_EQUAL(turns.size(), count);
+    return turns;
+}
+
+/**
+ * Load the last turns as after reboot
+ */
+static std::vector<Turn> reload(size_t maxTurns, size_t maxSize = CHAT_JOURNAL_MAX_SIZE) {
+    ChatJournal journal(*testFs, PATH, maxSize);
+    return load(journal, maxTurns);
+}
+
+static String question(int i) {
+    return String("q") + String(i);
+}
+
+static void appendTurns(ChatJournal &journal, int from, int count) {
+    for (int i = from; i < from + count; i++) {
+        TEST_ASSERT_TRUE(journal.append(question(i), String("answer ") + String(i)));
+    }
+}
+
+/**
+ * Measure time to load the last turns (us)
+ */
+static double measureLoad(size_t maxTurns, size_t maxSize, size_t &loaded) {
+    auto start = std::chrono::steady_clock::now();
+    ChatJournal journal(*testFs, PATH, maxSize);
+    loaded = journal.load(maxTurns, [](const String &, const String &) {});
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+void setUp() {
+    testFs = new fs::FS();
+    File::stubWriteLimit() = -1;
+}
+
+void tearDown() {
+    File::stubWriteLimit() = -1;
+    delete testFs;
+}
+
+void test_no_file() {
+    ChatJournal journal(*testFs, PATH);
+    TEST_ASSERT_EQUAL(0, load(journal, 10).size());
+    TEST_ASSERT_EQUAL(0, journal.size());
+    TEST_ASSERT_FALSE(testFs->exists(PATH));
+
+    // created on the first append
+    TEST_ASSERT_TRUE(journal.append("hello", "world"));
+    auto turns = reload(10);
+    TEST_ASSERT_EQUAL(1, turns.size());
+    TEST_ASSERT_EQUAL_STRING("hello", turns[0].question.c_str());
+    TEST_ASSERT_EQUAL_STRING("world", turns[0].answer.c_str());
+}
+
+void test_load_last_turns() {
+    ChatJournal journal(*testFs, PATH);
+    appendTurns(journal, 0, 5);
+    TEST_ASSERT_EQUAL(testFs->stubRead(PATH).size(), journal.size());
+
+    // oldest first
+    auto turns = reload(3);
+    TEST_ASSERT_EQUAL(3, turns.size());
+    TEST_ASSERT_EQUAL_STRING("q2", turns[0].question.c_str());
+    TEST_ASSERT_EQUAL_STRING("q4", turns[2].question.c_str());
+    TEST_ASSERT_EQUAL_STRING("answer 4", turns[2].answer.c_str());
+    TEST_ASSERT_EQUAL(5, reload(10).size());
+    TEST_ASSERT_EQUAL(0, reload(0).size());
+}
+
+void test_binary_and_empty_text() {
+    ChatJournal journal(*testFs, PATH);
+    TEST_ASSERT_TRUE(journal.append("", ""));
+    TEST_ASSERT_TRUE(journal.append("こんにちは\n\"CJR1\"", "line1\r\nline2"));
+    auto turns = reload(10);
+    TEST_ASSERT_EQUAL(2, turns.size());
+    TEST_ASSERT_EQUAL_STRING("", turns[0].question.c_str());
+    TEST_ASSERT_EQUAL_STRING("こんにちは\n\"CJR1\"", turns[1].question.c_str());
+    TEST_ASSERT_EQUAL_STRING("line1\r\nline2", turns[1].answer.c_str());
+}
+
+void test_recover_torn_write() {
+    ChatJournal journal(*testFs, PATH);
+    appendTurns(journal, 0, 5);
+    auto valid = testFs->stubRead(PATH);
+
+    // every length of a record cut by power loss
+    ChatJournal next(*testFs, PATH);
+    next.append("torn question", "torn answer");
+    auto record = testFs->stubRead(PATH).substr(valid.size());
+    for (size_t len = 1; len < record.size(); len++) {
+        testFs->stubWrite(PATH, valid + record.substr(0, len));
+        auto turns = reload(10);
+        TEST_ASSERT_EQUAL(5, turns.size());
+        TEST_ASSERT_EQUAL_STRING("q4", turns[4].question.c_str());
+        // the broken record is dropped from the file
+        TEST_ASSERT_EQUAL_STRING_LEN(valid.data(), testFs->stubRead(PATH).data(), valid.size());
+        TEST_ASSERT_EQUAL(valid.size(), testFs->stubRead(PATH).size());
+    }
+
+    // appended after the valid records
+    ChatJournal resumed(*testFs, PATH);
+    TEST_ASSERT_TRUE(resumed.append("q5", "answer 5"));
+    auto turns = reload(1);
+    TEST_ASSERT_EQUAL_STRING("q5", turns[0].question.c_str());
+    TEST_ASSERT_EQUAL(6, reload(10).size());
+}
+
+void test_recover_failed_append() {
+    ChatJournal journal(*testFs, PATH);
+    appendTurns(journal, 0, 3);
+    auto size = testFs->stubRead(PATH).size();
+
+    // no space in the middle of the record
+    File::stubWriteLimit() = (int) size + 10;
+    TEST_ASSERT_FALSE(journal.append("q3", "answer 3"));
+    File::stubWriteLimit() = -1;
+
+    // checked again before the next append
+    TEST_ASSERT_TRUE(journal.append("q4", "answer 4"));
+    auto turns = reload(10);
+    TEST_ASSERT_EQUAL(4, turns.size());
+    TEST_ASSERT_EQUAL_STRING("q2", turns[2].question.c_str());
+    TEST_ASSERT_EQUAL_STRING("q4", turns[3].question.c_str());
+}
+
+void test_bounded_size() {
+    ChatJournal journal(*testFs, PATH, 2000);
+    for (int i = 0; i < 200; i++) {
+        TEST_ASSERT_TRUE(journal.append(question(i), "answer answer"));
+        TEST_ASSERT_TRUE(testFs->stubRead(PATH).size() <= 2000);
+        TEST_ASSERT_EQUAL(testFs->stubRead(PATH).size(), journal.size());
+    }
+    // compacted to half of the max size, keeping the last turns
+    auto turns = reload(1000, 2000);
+    TEST_ASSERT_TRUE(turns.size() > 20);
+    TEST_ASSERT_EQUAL_STRING("q199", turns.back().question.c_str());
+    TEST_ASSERT_FALSE(testFs->exists(String(PATH) + ".tmp"));
+
+    // a turn larger than the file is not saved
+    TEST_ASSERT_FALSE(journal.append(String(std::string(2000, 'a')), ""));
+}
+
+void test_compact() {
+    ChatJournal journal(*testFs, PATH);
+    appendTurns(journal, 0, 10);
+    TEST_ASSERT_TRUE(journal.compact(4, SIZE_MAX));
+    auto turns = reload(10);
+    TEST_ASSERT_EQUAL(4, turns.size());
+    TEST_ASSERT_EQUAL_STRING("q6", turns[0].question.c_str());
+    TEST_ASSERT_EQUAL(testFs->stubRead(PATH).size(), journal.size());
+
+    TEST_ASSERT_TRUE(journal.compact(SIZE_MAX, 0));
+    TEST_ASSERT_EQUAL(0, reload(10).size());
+    appendTurns(journal, 10, 1);
+    TEST_ASSERT_EQUAL_STRING("q10", reload(10)[0].question.c_str());
+}
+
+void test_memo() {
+    ChatJournal journal(*testFs, PATH, 2000);
+    TEST_ASSERT_TRUE(journal.append("", "empty question first"));
+    TEST_ASSERT_EQUAL_STRING("", journal.loadMemo().c_str());
+    appendTurns(journal, 1, 5);
+
+    // replaced with the memo and the last turns
+    TEST_ASSERT_TRUE(journal.summarize("memo 1", 2));
+    TEST_ASSERT_EQUAL(testFs->stubRead(PATH).size(), journal.size());
+    ChatJournal rebooted(*testFs, PATH, 2000);
+    TEST_ASSERT_EQUAL_STRING("memo 1", rebooted.loadMemo().c_str());
+    auto turns = load(rebooted, 10);
+    TEST_ASSERT_EQUAL(2, turns.size());
+    TEST_ASSERT_EQUAL_STRING("q4", turns[0].question.c_str());
+
+    // kept on compaction
+    for (int i = 6; i < 100; i++) {
+        TEST_ASSERT_TRUE(rebooted.append(question(i), "answer answer"));
+    }
+    TEST_ASSERT_TRUE(testFs->stubRead(PATH).size() <= 2000);
+    TEST_ASSERT_EQUAL_STRING("memo 1", ChatJournal(*testFs, PATH).loadMemo().c_str());
+    TEST_ASSERT_EQUAL_STRING("q99", reload(1, 2000)[0].question.c_str());
+    TEST_ASSERT_TRUE(rebooted.compact(SIZE_MAX, 0));
+    TEST_ASSERT_EQUAL(0, reload(10).size());
+    TEST_ASSERT_EQUAL_STRING("memo 1", ChatJournal(*testFs, PATH).loadMemo().c_str());
+
+    // the memo record cut by power loss is dropped with the rest
+    TEST_ASSERT_TRUE(rebooted.summarize("memo 2", 0));
+    auto valid = testFs->stubRead(PATH);
+    testFs->stubWrite(PATH, valid.substr(0, valid.size() - 1));
+    TEST_ASSERT_EQUAL_STRING("", ChatJournal(*testFs, PATH).loadMemo().c_str());
+}
+
+void test_summarize_power_loss() {
+    ChatJournal journal(*testFs, PATH);
+    appendTurns(journal, 0, 3);
+    TEST_ASSERT_TRUE(journal.summarize("old memo", 3));
+    auto before = testFs->stubRead(PATH);
+
+    // no space while writing the new file: the memo and all turns are kept
+    File::stubWriteLimit() = 20;
+    TEST_ASSERT_FALSE(journal.summarize("new memo", 1));
+    File::stubWriteLimit() = -1;
+    TEST_ASSERT_EQUAL_STRING(before.c_str(), testFs->stubRead(PATH).c_str());
+    TEST_ASSERT_FALSE(testFs->exists(String(PATH) + ".tmp"));
+
+    // power loss while writing the new file: the old file is loaded
+    TEST_ASSERT_TRUE(journal.summarize("new memo", 1));
+    auto after = testFs->stubRead(PATH);
+    testFs->stubWrite(PATH, before);
+    testFs->stubWrite(String(PATH) + ".tmp", after.substr(0, after.size() / 2));
+    ChatJournal torn(*testFs, PATH);
+    TEST_ASSERT_EQUAL_STRING("old memo", torn.loadMemo().c_str());
+    TEST_ASSERT_EQUAL(3, load(torn, 10).size());
+
+    // power loss after removing the old file: the new file is completed, so it is loaded
+    testFs->remove(PATH);
+    testFs->stubWrite(String(PATH) + ".tmp", after);
+    ChatJournal replaced(*testFs, PATH);
+    TEST_ASSERT_EQUAL_STRING("new memo", replaced.loadMemo().c_str());
+    auto turns = load(replaced, 10);
+    TEST_ASSERT_EQUAL(1, turns.size());
+    TEST_ASSERT_EQUAL_STRING("q2", turns[0].question.c_str());
+    TEST_ASSERT_FALSE(testFs->exists(String(PATH) + ".tmp"));
+}
+
+void test_benchmark_cold_start() {
+    const size_t maxSize = 1 << 30;
+    for (int count: {1000, 10000}) {
+        delete testFs;
+        testFs = new fs::FS();
+        {
+            ChatJournal journal(*testFs, PATH, maxSize);
+            for (int i = 0; i < count; i++) {
+                journal.append("What is the weather like today in Tokyo?",
+                               "It is sunny with a light breeze, around twenty degrees.");
+            }
+        }
+        size_t lastLoaded;
+        auto lastUs = measureLoad(10, maxSize, lastLoaded);
+        size_t allLoaded;
+        auto allUs = measureLoad(SIZE_MAX, maxSize, allLoaded);
+
+        char buf[160];
+        snprintf(buf, sizeof(buf), "%d turns (%u bytes): last 10 turns %.0f us, all turns %.0f us", count,
+                 (unsigned) testFs->stubRead(PATH).size(), lastUs, allUs);
+        TEST_MESSAGE(buf);
+        TEST_ASSERT_EQUAL(10, lastLoaded);
+        TEST_ASSERT_EQUAL(count, allLoaded);
+        TEST_ASSERT_TRUE(lastUs * 10 < allUs);
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_no_file);
+    RUN_TEST(test_load_last_turns);
+    RUN_TEST(test_binary_and_empty_text);
+    RUN_TEST(test_recover_torn_write);
+    RUN_TEST(test_recover_failed_append);
+    RUN_TEST(test_bounded_size);
+    RUN_TEST(test_compact);
+    RUN_TEST(test_memo);
+    RUN_TEST(test_summarize_power_loss);
+    RUN_TEST(test_benchmark_cold_start);
+    return UNITY_END();
+}
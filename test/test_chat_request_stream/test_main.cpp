@@ -0,0 +1,188 @@
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <Arduino.h>
+#include <unity.h>
+
+#include "lib/ChatRequestStream.h"
+
+static const String MODEL = "gpt-4o-mini";
+
+/// heap allocated through new (bytes)
+static size_t heapUsed = 0;
+static size_t heapPeak = 0;
+
+/// header keeping the size of the allocation (aligned for any type)
+static const size_t HEAP_HEADER = alignof(std::max_align_t);
+
+void *operator new(size_t size) {
+    auto p = static_cast<char *>(malloc(size + HEAP_HEADER));
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<size_t *>(p) = size;
+    heapUsed += size;
+    heapPeak = std::max(heapPeak, heapUsed);
+    return p + HEAP_HEADER;
+}
+
+void operator delete(void *ptr) noexcept {
+    if (ptr != nullptr) {
+        auto p = static_cast<char *>(ptr) - HEAP_HEADER;
+        heapUsed -= *reinterpret_cast<size_t *>(p);
+        free(p);
+    }
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+/**
+ * Read the whole body in chunks of the size
+ */
+static std::string readAll(ChatRequestStream &stream, size_t chunk) {
+    std::string body;
+    char buf[512];
+    while (stream.available() > 0) {
+        auto n = stream.readBytes(buf, std::min(chunk, sizeof(buf)));
+        TEST_ASSERT_TRUE(n > 0);
+        body.append(buf, n);
+    }
+    return body;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_body() {
+    std::vector<String> roles = {"You are \"bot\"", "a\nb\t\x01"};
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    TEST_ASSERT_TRUE(history.setMemo("summary"));
+    TEST_ASSERT_TRUE(history.add("こんにちは", "hi\r\n", 10));
+    String text = "q\\?";
+    ChatRequestStream stream(MODEL, true, roles, history, text);
+
+    auto body = readAll(stream, 512);
+    TEST_ASSERT_EQUAL_STRING(
+            "{\"model\":\"gpt-4o-mini\",\"stream\":true,\"messages\":["
+            "{\"role\":\"system\",\"content\":\"You are \\\"bot\\\"\"},"
+            "{\"role\":\"system\",\"content\":\"a\\nb\\t\\u0001\"},"
+            "{\"role\":\"system\",\"content\":\"summary\"},"
+            "{\"role\":\"user\",\"content\":\"こんにちは\"},"
+            "{\"role\":\"assistant\",\"content\":\"hi\\r\\n\"},"
+            "{\"role\":\"user\",\"content\":\"q\\\\?\"}]}",
+            body.c_str());
+    // Content-Length from the sizing pass
+    TEST_ASSERT_EQUAL(body.size(), stream.size());
+    TEST_ASSERT_EQUAL(-1, stream.read());
+    TEST_ASSERT_EQUAL(-1, stream.peek());
+}
+
+void test_question_only() {
+    std::vector<String> roles;
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    String text = "hello";
+    ChatRequestStream stream(MODEL, false, roles, history, text);
+    TEST_ASSERT_EQUAL_STRING(
+            "{\"model\":\"gpt-4o-mini\",\"messages\":[{\"role\":\"user\",\"content\":\"hello\"}]}",
+            readAll(stream, 512).c_str());
+}
+
+void test_every_chunk_size() {
+    // escape sequences split at every position
+    std::vector<String> roles = {"\"\\\"\n\x1f", "line1\nline2"};
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    history.add("\"quoted\"", "\\", 10);
+    String text = "\b\f\r\t";
+    ChatRequestStream reference(MODEL, true, roles, history, text);
+    auto expected = readAll(reference, 512);
+
+    for (size_t chunk = 1; chunk <= 16; chunk++) {
+        ChatRequestStream stream(MODEL, true, roles, history, text);
+        TEST_ASSERT_EQUAL(expected.size(), stream.available());
+        TEST_ASSERT_EQUAL_STRING(expected.c_str(), readAll(stream, chunk).c_str());
+    }
+
+    // peek() returns the next byte of read() including escape sequences
+    ChatRequestStream stream(MODEL, true, roles, history, text);
+    std::string body;
+    while (stream.available() > 0) {
+        auto c = stream.peek();
+        TEST_ASSERT_EQUAL(c, stream.read());
+        body += (char) c;
+    }
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), body.c_str());
+}
+
+void test_rewind() {
+    std::vector<String> roles = {"role \"1\""};
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    String text = "question\n";
+    ChatRequestStream stream(MODEL, true, roles, history, text);
+    auto body = readAll(stream, 512);
+
+    // resend after a part has been sent
+    stream.rewind();
+    char buf[20];
+    stream.readBytes(buf, sizeof(buf));
+    stream.rewind();
+    TEST_ASSERT_EQUAL(body.size(), stream.available());
+    TEST_ASSERT_EQUAL_STRING(body.c_str(), readAll(stream, 7).c_str());
+}
+
+void test_peak_heap() {
+    std::vector<String> roles = {"You are a helpful assistant. Answer in one or two short sentences."};
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    for (int i = 0; i < 20; i++) {
+        history.add(String("Tell me about \"topic ") + String(i) + "\" in detail, please.",
+                    String("Topic ") + String(i) + " is interesting.\nIt has a long story.", 20);
+    }
+    String text = "And what about the next one?";
+
+    // written to the socket in chunks
+    auto before = heapUsed;
+    heapPeak = heapUsed;
+    size_t sent = 0;
+    {
+        ChatRequestStream stream(MODEL, true, roles, history, text);
+        char buf[256];
+        while (stream.available() > 0) {
+            sent += stream.readBytes(buf, sizeof(buf));
+        }
+    }
+    auto streamPeak = heapPeak - before;
+
+    // materialized into a String (as jsonEncode did after building the document)
+    heapPeak = heapUsed;
+    {
+        ChatRequestStream stream(MODEL, true, roles, history, text);
+        String body;
+        char buf[256];
+        while (stream.available() > 0) {
+            auto n = stream.readBytes(buf, sizeof(buf));
+            body += String(buf, n);
+        }
+    }
+    auto stringPeak = heapPeak - before;
+
+    char message[128];
+    snprintf(message, sizeof(message), "%u turns, body %u bytes: peak heap streamed %u bytes, materialized %u bytes",
+             (unsigned) history.size(), (unsigned) sent, (unsigned) streamPeak, (unsigned) stringPeak);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL(before, heapUsed);
+    TEST_ASSERT_TRUE(streamPeak < sent);
+    TEST_ASSERT_TRUE(streamPeak * 4 < stringPeak);
+    TEST_ASSERT_TRUE(stringPeak > sent);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_body);
+    RUN_TEST(test_question_only);
+    RUN_TEST(test_every_chunk_size);
+    RUN_TEST(test_rewind);
+    RUN_TEST(test_peak_heap);
+    return UNITY_END();
+}
@@ -0,0 +1,304 @@
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <FS.h>
+#include <unity.h>
+
+#include "lib/ChatGptClient.h"
+#include "lib/ChatHistory.h"
+#include "lib/ChatJournal.h"
+
+static const char *URL = "http://localhost:8080/v1/chat/completions";
+
+static const char *SUMMARY_REQUEST = "Summarize the conversation so far.";
+
+static std::shared_ptr<ConnectionPool> pool;
+
+static String question(int i) {
+    return String("What did I tell you about topic ") + String(i) + "?";
+}
+
+static String answer(int i) {
+    return String("You told me that topic ") + String(i) + " is about \"something\" interesting.";
+}
+
+/**
+ * Body of the event stream in chunked encoding
+ *
+ * @param contents delta contents of the events
+ */
+static std::string eventStream(const std::vector<std::string> &contents) {
+    std::vector<std::string> events;
+    events.emplace_back(R"({"choices":[{"index":0,"delta":{"role":"assistant"},"finish_reason":null}]})");
+    for (const auto &content: contents) {
+        events.push_back(R"({"choices":[{"index":0,"delta":{"content":")" + content
+                         + R"("},"finish_reason":null}]})");
+    }
+    events.emplace_back(R"({"choices":[{"index":0,"delta":{},"finish_reason":"stop"}]})");
+    events.emplace_back("[DONE]");
+    std::string body;
+    char size[16];
+    for (const auto &event: events) {
+        auto data = "data: " + event + "\n\n";
+        snprintf(size, sizeof(size), "%x\r\n", (unsigned) data.size());
+        body += size + data + "\r\n";
+    }
+    return body + "0\r\n\r\n";
+}
+
+/**
+ * Queue a response of the mock server
+ */
+static void respond(const std::vector<std::string> &contents) {
+    HTTPClient::stubResponses().push_back(
+            {HTTP_CODE_OK, -1, "chunked", eventStream(contents), "text/event-stream"});
+}
+
+static String chat(const String &text, const ChatHistory &history,
+                   const std::function<void(const String &)> &onReceiveContent = [](const String &) {}) {
+    ChatGptClient client{"sk-test", "gpt-4o-mini", URL, pool};
+    return client.chat(text, {"You are a robot."}, history, onReceiveContent);
+}
+
+static bool contains(const std::string &str, const String &part) {
+    return str.find(part.c_str()) != std::string::npos;
+}
+
+/**
+ * Summarize the oldest half of the history as the chat task does when idle
+ */
+static bool summarize(ChatHistory &history) {
+    auto turns = history.size() / 2;
+    auto oldest = history.oldest(turns);
+    respond({"Memo of ", String(turns).c_str(), " turns."});
+    auto summary = chat(SUMMARY_REQUEST, oldest);
+    return history.summarize(turns, String("Summary: ") + summary);
+}
+
+void setUp() {
+    pool = std::make_shared<ConnectionPool>();
+    HTTPClient::stubResponses().clear();
+    HTTPClient::stubRequestCount() = 0;
+}
+
+void tearDown() {
+    pool = nullptr;
+}
+
+void test_near_limit() {
+    ChatHistory history(1000, 200);
+    TEST_ASSERT_FALSE(history.isNearLimit(6, 75));
+    for (int i = 0; i < 5; i++) {
+        history.add("q", "a", 6);
+    }
+    TEST_ASSERT_FALSE(history.isNearLimit(6, 75));
+    // number of turns
+    history.add("q", "a", 6);
+    TEST_ASSERT_TRUE(history.isNearLimit(6, 75));
+
+    // size
+    ChatHistory bySize(1000, 10000);
+    while (!bySize.isNearLimit(100, 75)) {
+        bySize.add(question(0), answer(0), 100);
+    }
+    TEST_ASSERT_TRUE(bySize.bytes() > 750);
+
+    // tokens including the memo
+    ChatHistory byTokens(10000, 200);
+    byTokens.add(question(0), answer(0), 100);
+    byTokens.add(question(1), answer(1), 100);
+    TEST_ASSERT_FALSE(byTokens.isNearLimit(100, 75));
+    TEST_ASSERT_TRUE(byTokens.setMemo(String(std::string(4 * 90, 'm'))));
+    TEST_ASSERT_TRUE(byTokens.isNearLimit(100, 75));
+}
+
+void test_oldest_and_summarize() {
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    history.setMemo("previous memo");
+    for (int i = 0; i < 6; i++) {
+        history.add(question(i), answer(i), 10);
+    }
+
+    // copy of the memo and the oldest turns to be summarized
+    auto oldest = history.oldest(3);
+    TEST_ASSERT_EQUAL(3, oldest.size());
+    TEST_ASSERT_EQUAL_STRING("previous memo", oldest.getMemo().c_str());
+    size_t len, oldestLen;
+    auto fragment = history.fragment(2, len);
+    TEST_ASSERT_EQUAL_MEMORY(fragment, oldest.fragment(2, oldestLen), len);
+    TEST_ASSERT_EQUAL(len, oldestLen);
+    TEST_ASSERT_EQUAL(6, history.size());
+
+    // replaced with the memo
+    auto tokens = history.tokens();
+    TEST_ASSERT_TRUE(history.summarize(3, "new memo"));
+    TEST_ASSERT_EQUAL(3, history.size());
+    TEST_ASSERT_EQUAL_STRING("new memo", history.getMemo().c_str());
+    TEST_ASSERT_TRUE(history.tokens() < tokens);
+    TEST_ASSERT_TRUE(std::string(history.fragment(0, len), len).find("topic 3") != std::string::npos);
+
+    // memo larger than half of the tokens is rejected, keeping the turns
+    TEST_ASSERT_FALSE(history.summarize(3, String(std::string(4 * CHAT_HISTORY_MAX_TOKENS, 'm'))));
+    TEST_ASSERT_EQUAL(3, history.size());
+    TEST_ASSERT_EQUAL_STRING("new memo", history.getMemo().c_str());
+
+    // cleared with the turns
+    history.clear();
+    TEST_ASSERT_EQUAL_STRING("", history.getMemo().c_str());
+    TEST_ASSERT_EQUAL(0, history.tokens());
+}
+
+void test_summary_request() {
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    for (int i = 0; i < 6; i++) {
+        history.add(question(i), answer(i), 10);
+    }
+    TEST_ASSERT_TRUE(summarize(history));
+    TEST_ASSERT_EQUAL(1, HTTPClient::stubRequestCount());
+
+    // only the oldest turns are sent to be summarized, as stream
+    auto request = HTTPClient::stubRequestBody();
+    TEST_ASSERT_TRUE(contains(request, "\"stream\":true"));
+    TEST_ASSERT_TRUE(contains(request, SUMMARY_REQUEST));
+    TEST_ASSERT_TRUE(contains(request, question(2)));
+    TEST_ASSERT_FALSE(contains(request, question(3)));
+    TEST_ASSERT_EQUAL_STRING("Summary: Memo of 3 turns.", history.getMemo().c_str());
+
+    // the memo is sent as a system message before the turns
+    respond({"OK"});
+    TEST_ASSERT_EQUAL_STRING("OK", chat("next", history).c_str());
+    request = HTTPClient::stubRequestBody();
+    auto memo = request.find(R"({"role":"system","content":"Summary: Memo of 3 turns."})");
+    TEST_ASSERT_TRUE(memo != std::string::npos);
+    TEST_ASSERT_TRUE(memo < request.find(question(3).c_str()));
+    TEST_ASSERT_FALSE(contains(request, question(2)));
+}
+
+/**
+ * Request the summary aborted by the callback
+ *
+ * @return true: aborted
+ */
+static bool summarizeAborted(const ChatHistory &history, const std::function<bool()> &shouldAbort,
+                             const std::function<void(const String &)> &onReceiveContent = [](const String &) {}) {
+    ChatGptClient client{"sk-test", "gpt-4o-mini", URL, pool};
+    client.setShouldAbort(shouldAbort);
+    try {
+        client.chat(SUMMARY_REQUEST, {}, history, onReceiveContent);
+    } catch (ChatGptClientError &e) {
+        return true;
+    }
+    return false;
+}
+
+void test_abort_summary() {
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    for (int i = 0; i < 6; i++) {
+        history.add(question(i), answer(i), 10);
+    }
+    auto oldest = history.oldest(3);
+    respond({"Memo", " of", " turns."});
+    // a chat request arrives while receiving the summary
+    int received = 0;
+    TEST_ASSERT_TRUE(summarizeAborted(oldest, [&received]() { return received == 2; },
+                                      [&received](const String &) { received++; }));
+    TEST_ASSERT_EQUAL(2, received);
+    TEST_ASSERT_EQUAL(6, history.size());
+    TEST_ASSERT_EQUAL_STRING("", history.getMemo().c_str());
+    // the connection with the unread response is not reused
+    TEST_ASSERT_FALSE(pool->acquire(URL, nullptr)->isReused());
+}
+
+void test_abort_before_sending() {
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    history.add(question(0), answer(0), 10);
+    respond({"Memo"});
+    TEST_ASSERT_TRUE(summarizeAborted(history, []() { return true; }));
+    TEST_ASSERT_EQUAL(0, HTTPClient::stubRequestCount());
+}
+
+void test_abort_waiting_first_token() {
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    history.add(question(0), answer(0), 10);
+    // headers received, but no event yet
+    HTTPClient::stubResponses().push_back({HTTP_CODE_OK, -1, "chunked", "", "text/event-stream"});
+    auto start = millis();
+    // a chat request arrives after a while
+    TEST_ASSERT_TRUE(summarizeAborted(history, [start]() { return millis() - start >= 50; }));
+    // not waiting for the HTTP timeout
+    TEST_ASSERT_TRUE(millis() - start < 1000);
+    TEST_ASSERT_EQUAL(1, HTTPClient::stubRequestCount());
+}
+
+void test_server_error() {
+    ChatHistory history(CHAT_HISTORY_MAX_SIZE, CHAT_HISTORY_MAX_TOKENS);
+    HTTPClient::stubResponses().push_back({HTTP_CODE_INTERNAL_SERVER_ERROR, 0, "", "", "application/json"});
+    auto code = 0;
+    try {
+        chat(SUMMARY_REQUEST, history);
+    } catch (ChatGptHttpError &e) {
+        code = e.statusCode();
+    }
+    TEST_ASSERT_EQUAL(HTTP_CODE_INTERNAL_SERVER_ERROR, code);
+}
+
+void test_request_size_stays_bounded() {
+    // long session summarized whenever near the limit
+    const size_t maxTurns = 10;
+    ChatHistory history(2048, 600);
+    size_t maxRequest = 0;
+    int summaries = 0;
+    for (int i = 0; i < 100; i++) {
+        respond({"Answer ", String(i).c_str()});
+        auto reply = chat(question(i), history);
+        maxRequest = std::max(maxRequest, HTTPClient::stubRequestBody().size());
+        TEST_ASSERT_TRUE(history.add(question(i), answer(i), maxTurns));
+        if (history.isNearLimit(maxTurns, 75)) {
+            TEST_ASSERT_TRUE(summarize(history));
+            summaries++;
+        }
+    }
+    char buf[96];
+    snprintf(buf, sizeof(buf), "100 turns, %d summaries, max request %u bytes", summaries, (unsigned) maxRequest);
+    TEST_MESSAGE(buf);
+    TEST_ASSERT_TRUE(summaries > 10);
+    TEST_ASSERT_TRUE(maxRequest < 2048 + 512);
+    TEST_ASSERT_TRUE(history.getMemo().startsWith("Summary: "));
+}
+
+void test_journal_memo() {
+    fs::FS testFs;
+    ChatJournal journal(testFs, "/chat.bin");
+    TEST_ASSERT_EQUAL_STRING("", journal.loadMemo().c_str());
+    for (int i = 0; i < 6; i++) {
+        journal.append(question(i), answer(i));
+    }
+
+    // memo saved and summarized turns dropped
+    TEST_ASSERT_TRUE(journal.summarize("memo \"1\"", 3));
+    ChatJournal rebooted(testFs, "/chat.bin");
+    TEST_ASSERT_EQUAL_STRING("memo \"1\"", rebooted.loadMemo().c_str());
+    std::vector<std::string> questions;
+    rebooted.load(10, [&questions](const String &q, const String &) { questions.emplace_back(q.c_str()); });
+    TEST_ASSERT_EQUAL(3, questions.size());
+    TEST_ASSERT_EQUAL_STRING(question(3).c_str(), questions[0].c_str());
+
+    // replaced by the next summary
+    TEST_ASSERT_TRUE(rebooted.summarize("memo 2", 1));
+    TEST_ASSERT_EQUAL_STRING("memo 2", ChatJournal(testFs, "/chat.bin").loadMemo().c_str());
+    TEST_ASSERT_FALSE(testFs.exists("/chat.bin.tmp"));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_near_limit);
+    RUN_TEST(test_oldest_and_summarize);
+    RUN_TEST(test_summary_request);
+    RUN_TEST(test_abort_summary);
+    RUN_TEST(test_abort_before_sending);
+    RUN_TEST(test_abort_waiting_first_token);
+    RUN_TEST(test_server_error);
+    RUN_TEST(test_request_size_stays_bounded);
+    RUN_TEST(test_journal_memo);
+    return UNITY_END();
+}
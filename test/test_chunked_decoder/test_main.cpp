@@ -0,0 +1,264 @@
+#include <string>
+#include <Arduino.h>
+#include <unity.h>
+
+#include "lib/ChunkedDecoder.h"
+
+/**
+ * Stream returning only the bytes received so far
+ */
+class ScriptedStream : public Stream {
+public:
+    explicit ScriptedStream(std::string data) : _data(std::move(data)) {}
+
+    /// make bytes up to the position available
+    void receive(size_t end) { _received = std::min(end, _data.size()); }
+
+    void receiveAll() { _received = _data.size(); }
+
+    size_t position() const { return _pos; }
+
+    int available() override { return (int) (_received - _pos); }
+
+    int read() override { return _pos < _received ? (uint8_t) _data[_pos++] : -1; }
+
+    int peek() override { return _pos < _received ? (uint8_t) _data[_pos] : -1; }
+
+    size_t write(uint8_t) override { return 0; }
+
+    void flush() override {}
+
+private:
+    std::string _data;
+    size_t _pos = 0;
+    size_t _received = 0;
+};
+
+/**
+ * Read all decoded bytes available now
+ */
+static std::string readAvailable(ChunkedDecoder &decoder, ScriptedStream &stream, size_t bufSize = 64) {
+    std::string out;
+    uint8_t buf[64];
+    size_t n;
+    while ((n = decoder.read(&stream, buf, std::min(bufSize, sizeof(buf)))) > 0) {
+        out.append((const char *) buf, n);
+    }
+    return out;
+}
+
+static std::string decodeAll(ChunkedDecoder &decoder, const std::string &body) {
+    ScriptedStream stream(body);
+    stream.receiveAll();
+    return readAvailable(decoder, stream);
+}
+
+/// body using every part of the framing
+static const std::string FRAMED_BODY =
+        "5\r\nHello\r\n"
+        "1;name=value\r\n,\r\n"
+        "A \t;ext\r\n World! 12\r\n"
+        "0\r\n"
+        "X-Trailer: 1\r\n"
+        "\r\n";
+static const std::string FRAMED_DATA = "Hello, World! 12";
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_decode() {
+    ChunkedDecoder decoder;
+    TEST_ASSERT_EQUAL_STRING("abcdefghijklmnop", decodeAll(decoder, "a\r\nabcdefghij\r\n6\r\nklmnop\r\n0\r\n\r\n").c_str());
+    TEST_ASSERT_TRUE(decoder.isDone());
+    TEST_ASSERT_FALSE(decoder.hasError());
+}
+
+void test_decode_framing() {
+    ChunkedDecoder decoder;
+    TEST_ASSERT_EQUAL_STRING(FRAMED_DATA.c_str(), decodeAll(decoder, FRAMED_BODY).c_str());
+    TEST_ASSERT_TRUE(decoder.isDone());
+}
+
+void test_hex_digits() {
+    ChunkedDecoder decoder;
+    auto data = std::string(0x1f, 'x');
+    TEST_ASSERT_EQUAL_STRING(data.c_str(), decodeAll(decoder, "1F\r\n" + data + "\r\n0\r\n\r\n").c_str());
+    TEST_ASSERT_TRUE(decoder.isDone());
+    decoder.reset();
+    TEST_ASSERT_EQUAL_STRING(data.c_str(), decodeAll(decoder, "01f\r\n" + data + "\r\n0\r\n\r\n").c_str());
+    TEST_ASSERT_TRUE(decoder.isDone());
+}
+
+void test_split_at_every_position() {
+    for (size_t split = 0; split <= FRAMED_BODY.size(); split++) {
+        ChunkedDecoder decoder;
+        ScriptedStream stream(FRAMED_BODY);
+        stream.receive(split);
+        auto out = readAvailable(decoder, stream);
+        TEST_ASSERT_FALSE(decoder.hasError());
+        TEST_ASSERT_EQUAL(split == FRAMED_BODY.size(), decoder.isDone());
+        stream.receiveAll();
+        out += readAvailable(decoder, stream);
+        TEST_ASSERT_EQUAL_STRING(FRAMED_DATA.c_str(), out.c_str());
+        TEST_ASSERT_TRUE(decoder.isDone());
+    }
+}
+
+void test_split_at_every_pair_of_positions() {
+    for (size_t split1 = 0; split1 <= FRAMED_BODY.size(); split1++) {
+        for (size_t split2 = split1; split2 <= FRAMED_BODY.size(); split2++) {
+            ChunkedDecoder decoder;
+            ScriptedStream stream(FRAMED_BODY);
+            stream.receive(split1);
+            auto out = readAvailable(decoder, stream);
+            stream.receive(split2);
+            out += readAvailable(decoder, stream);
+            stream.receiveAll();
+            out += readAvailable(decoder, stream);
+            TEST_ASSERT_EQUAL_STRING(FRAMED_DATA.c_str(), out.c_str());
+            TEST_ASSERT_TRUE(decoder.isDone());
+        }
+    }
+}
+
+void test_one_byte_at_a_time() {
+    for (size_t bufSize = 1; bufSize <= 8; bufSize++) {
+        ChunkedDecoder decoder;
+        ScriptedStream stream(FRAMED_BODY);
+        std::string out;
+        for (size_t end = 0; end <= FRAMED_BODY.size(); end++) {
+            stream.receive(end);
+            out += readAvailable(decoder, stream, bufSize);
+            TEST_ASSERT_FALSE(decoder.hasError());
+        }
+        TEST_ASSERT_EQUAL_STRING(FRAMED_DATA.c_str(), out.c_str());
+        TEST_ASSERT_TRUE(decoder.isDone());
+    }
+}
+
+void test_not_read_after_end() {
+    // next response on the kept-alive connection must be left
+    ChunkedDecoder decoder;
+    std::string next = "HTTP/1.1 200 OK\r\n";
+    ScriptedStream stream(FRAMED_BODY + next);
+    stream.receiveAll();
+    TEST_ASSERT_EQUAL_STRING(FRAMED_DATA.c_str(), readAvailable(decoder, stream).c_str());
+    TEST_ASSERT_TRUE(decoder.isDone());
+    TEST_ASSERT_EQUAL(FRAMED_BODY.size(), stream.position());
+    TEST_ASSERT_EQUAL(next.size(), stream.available());
+}
+
+void test_digit_after_whitespace() {
+    ChunkedDecoder decoder;
+    decodeAll(decoder, "1 2\r\n");
+    TEST_ASSERT_TRUE(decoder.hasError());
+    TEST_ASSERT_EQUAL(ChunkedDecoder::Error::InvalidSize, decoder.getError());
+    decoder.reset();
+    decodeAll(decoder, "1\t2\r\n");
+    TEST_ASSERT_EQUAL(ChunkedDecoder::Error::InvalidSize, decoder.getError());
+}
+
+void test_invalid_size() {
+    for (auto body: {"\r\n", "x\r\n", ";ext\r\n", " 1\r\n", "1\n", "1\rx", "1x\r\n"}) {
+        ChunkedDecoder decoder;
+        decodeAll(decoder, body);
+        TEST_ASSERT_TRUE(decoder.hasError());
+        TEST_ASSERT_EQUAL(ChunkedDecoder::Error::InvalidSize, decoder.getError());
+    }
+}
+
+void test_size_too_long() {
+    ChunkedDecoder decoder;
+    decodeAll(decoder, "1000000\r\n");
+    TEST_ASSERT_TRUE(decoder.hasError());
+    TEST_ASSERT_EQUAL(ChunkedDecoder::Error::SizeTooLong, decoder.getError());
+    decoder.reset();
+    decodeAll(decoder, "0fffff\r\n");
+    TEST_ASSERT_FALSE(decoder.hasError());
+}
+
+void test_invalid_delimiter() {
+    for (auto body: {"3\r\nabcX", "3\r\nabc\rX", "3\r\nabc\n"}) {
+        ChunkedDecoder decoder;
+        decodeAll(decoder, body);
+        TEST_ASSERT_TRUE(decoder.hasError());
+        TEST_ASSERT_EQUAL(ChunkedDecoder::Error::InvalidDelimiter, decoder.getError());
+    }
+}
+
+void test_invalid_trailer() {
+    for (auto body: {"0\r\n\rX", "0\r\nX-Trailer: 1\rX"}) {
+        ChunkedDecoder decoder;
+        decodeAll(decoder, body);
+        TEST_ASSERT_TRUE(decoder.hasError());
+        TEST_ASSERT_EQUAL(ChunkedDecoder::Error::InvalidTrailer, decoder.getError());
+    }
+}
+
+void test_stop_on_error() {
+    ChunkedDecoder decoder;
+    ScriptedStream stream("3\r\nabcX\r\n0\r\n\r\n");
+    stream.receiveAll();
+    TEST_ASSERT_EQUAL_STRING("abc", readAvailable(decoder, stream).c_str());
+    TEST_ASSERT_TRUE(decoder.hasError());
+    TEST_ASSERT_FALSE(decoder.isDone());
+    TEST_ASSERT_EQUAL(7, stream.position());
+}
+
+void test_reset() {
+    ChunkedDecoder decoder;
+    decodeAll(decoder, "x");
+    TEST_ASSERT_TRUE(decoder.hasError());
+    decoder.reset();
+    TEST_ASSERT_FALSE(decoder.hasError());
+    TEST_ASSERT_EQUAL(ChunkedDecoder::Error::None, decoder.getError());
+    TEST_ASSERT_EQUAL_STRING("ok", decodeAll(decoder, "2\r\nok\r\n0\r\n\r\n").c_str());
+    TEST_ASSERT_TRUE(decoder.isDone());
+}
+
+void test_feed_and_consume() {
+    ChunkedDecoder decoder;
+    for (auto c: std::string("4\r\n")) {
+        TEST_ASSERT_TRUE(decoder.feed(c));
+    }
+    TEST_ASSERT_EQUAL(4, decoder.dataRemaining());
+    TEST_ASSERT_FALSE(decoder.feed('x'));
+    decoder.consumeData(3);
+    TEST_ASSERT_EQUAL(1, decoder.dataRemaining());
+    decoder.consumeData(1);
+    TEST_ASSERT_EQUAL(0, decoder.dataRemaining());
+    for (auto c: std::string("\r\n0\r\n\r\n")) {
+        TEST_ASSERT_TRUE(decoder.feed(c));
+    }
+    TEST_ASSERT_TRUE(decoder.isDone());
+}
+
+void test_error_to_string() {
+    for (auto error: {ChunkedDecoder::Error::None, ChunkedDecoder::Error::SizeTooLong,
+                      ChunkedDecoder::Error::InvalidSize, ChunkedDecoder::Error::InvalidDelimiter,
+                      ChunkedDecoder::Error::InvalidTrailer}) {
+        TEST_ASSERT_NOT_NULL(ChunkedDecoder::errorToString(error));
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_decode);
+    RUN_TEST(test_decode_framing);
+    RUN_TEST(test_hex_digits);
+    RUN_TEST(test_split_at_every_position);
+    RUN_TEST(test_split_at_every_pair_of_positions);
+    RUN_TEST(test_one_byte_at_a_time);
+    RUN_TEST(test_not_read_after_end);
+    RUN_TEST(test_digit_after_whitespace);
+    RUN_TEST(test_invalid_size);
+    RUN_TEST(test_size_too_long);
+    RUN_TEST(test_invalid_delimiter);
+    RUN_TEST(test_invalid_trailer);
+    RUN_TEST(test_stop_on_error);
+    RUN_TEST(test_reset);
+    RUN_TEST(test_feed_and_consume);
+    RUN_TEST(test_error_to_string);
+    return UNITY_END();
+}
@@ -0,0 +1,231 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "lib/ConnectionPool.h"
+
+static const char *URL = "https://api.example.com/v1/chat";
+
+static std::shared_ptr<PooledConnection> acquire(ConnectionPool &pool, const String &url, bool reuse = true) {
+    return pool.acquire(url, nullptr, reuse);
+}
+
+/**
+ * Finish the request and return the connection to the pool
+ */
+static void release(std::shared_ptr<PooledConnection> &conn, bool reusable) {
+    conn->http().end();
+    conn->setReusable(reusable);
+    conn = nullptr;
+}
+
+void setUp() {
+    WiFiClient::stubConnectResult() = true;
+    WiFiClient::stubConnectCount() = 0;
+    HTTPClient::stubResponses().clear();
+}
+
+void tearDown() {}
+
+void test_reuse_connection() {
+    ConnectionPool pool;
+    auto conn = acquire(pool, URL);
+    auto client = conn->client();
+    TEST_ASSERT_FALSE(conn->isReused());
+    TEST_ASSERT_TRUE(client->connected());
+    release(conn, true);
+
+    conn = acquire(pool, "https://api.example.com/v1/audio");
+    TEST_ASSERT_TRUE(conn->isReused());
+    TEST_ASSERT_EQUAL_PTR(client, conn->client());
+    release(conn, true);
+
+    auto stats = pool.getStats();
+    TEST_ASSERT_EQUAL(1, stats.hits);
+    TEST_ASSERT_EQUAL(1, stats.misses);
+    TEST_ASSERT_EQUAL(1, stats.size);
+    TEST_ASSERT_EQUAL(1, WiFiClient::stubConnectCount());
+}
+
+void test_separate_hosts() {
+    ConnectionPool pool;
+    for (auto url: {"https://a.example.com/", "https://b.example.com/", "http://a.example.com/",
+                    "https://a.example.com:8443/"}) {
+        auto conn = acquire(pool, url);
+        TEST_ASSERT_FALSE(conn->isReused());
+        release(conn, true);
+    }
+    TEST_ASSERT_EQUAL(4, pool.getStats().misses);
+}
+
+void test_secure_client() {
+    ConnectionPool pool;
+    int created = 0;
+    auto onCreate = [&created](WiFiClientSecure *client) {
+        created++;
+        client->setInsecure();
+    };
+    auto conn = pool.acquire("https://a.example.com/", onCreate);
+    TEST_ASSERT_EQUAL(1, created);
+    TEST_ASSERT_TRUE(static_cast<WiFiClientSecure *>(conn->client())->stubInsecure);
+    release(conn, true);
+    conn = pool.acquire("http://a.example.com/", onCreate);
+    TEST_ASSERT_EQUAL(1, created);
+    release(conn, true);
+}
+
+void test_not_share_connection_in_use() {
+    ConnectionPool pool;
+    auto conn1 = acquire(pool, URL);
+    auto conn2 = acquire(pool, URL);
+    TEST_ASSERT_NOT_EQUAL(conn1->client(), conn2->client());
+    TEST_ASSERT_FALSE(conn2->isReused());
+    release(conn1, true);
+    release(conn2, true);
+    TEST_ASSERT_EQUAL(2, pool.getStats().size);
+}
+
+void test_close_not_reusable() {
+    ConnectionPool pool;
+    auto conn = acquire(pool, URL);
+    release(conn, false);
+    TEST_ASSERT_EQUAL(0, pool.getStats().size);
+    conn = acquire(pool, URL);
+    TEST_ASSERT_FALSE(conn->isReused());
+    TEST_ASSERT_EQUAL(2, WiFiClient::stubConnectCount());
+}
+
+void test_close_by_peer() {
+    ConnectionPool pool;
+    auto conn = acquire(pool, URL);
+    auto client = conn->client();
+    release(conn, true);
+    client->stubClose();
+    conn = acquire(pool, URL);
+    TEST_ASSERT_FALSE(conn->isReused());
+    TEST_ASSERT_EQUAL(2, WiFiClient::stubConnectCount());
+}
+
+void test_no_reuse() {
+    ConnectionPool pool;
+    auto conn = acquire(pool, URL);
+    release(conn, true);
+    conn = acquire(pool, URL, false);
+    TEST_ASSERT_FALSE(conn->isReused());
+    TEST_ASSERT_EQUAL(2, WiFiClient::stubConnectCount());
+}
+
+void test_max_size() {
+    ConnectionPool pool;
+    for (auto url: {"https://a.example.com/", "https://b.example.com/", "https://c.example.com/"}) {
+        auto conn = acquire(pool, url);
+        release(conn, true);
+    }
+    auto stats = pool.getStats();
+    TEST_ASSERT_EQUAL(CONNECTION_POOL_MAX_SIZE, stats.size);
+    TEST_ASSERT_EQUAL(1, stats.evictions);
+
+    // least recently used one has been closed
+    auto conn = acquire(pool, "https://a.example.com/");
+    TEST_ASSERT_FALSE(conn->isReused());
+    release(conn, true);
+    conn = acquire(pool, "https://c.example.com/");
+    TEST_ASSERT_TRUE(conn->isReused());
+    release(conn, true);
+}
+
+void test_idle_timeout() {
+    ConnectionPool pool;
+    auto conn = acquire(pool, URL);
+    release(conn, true);
+    stubAdvanceMillis(CONNECTION_POOL_IDLE_TIMEOUT + 1);
+    conn = acquire(pool, URL);
+    TEST_ASSERT_FALSE(conn->isReused());
+    TEST_ASSERT_EQUAL(1, pool.getStats().evictions);
+}
+
+void test_connect_failure() {
+    ConnectionPool pool;
+    WiFiClient::stubConnectResult() = false;
+    auto conn = acquire(pool, URL);
+    TEST_ASSERT_FALSE(conn->client()->connected());
+    conn->http().begin(*conn->client(), URL);
+    TEST_ASSERT_EQUAL(HTTPC_ERROR_NOT_CONNECTED, conn->http().GET());
+    release(conn, false);
+    TEST_ASSERT_EQUAL(0, pool.getStats().size);
+}
+
+void test_reset_request_state() {
+    ConnectionPool pool;
+    auto conn = acquire(pool, URL);
+    conn->http().setAuthorization("secret");
+    conn->http().setTimeout(30000);
+    release(conn, true);
+
+    conn = acquire(pool, URL);
+    TEST_ASSERT_TRUE(conn->isReused());
+    TEST_ASSERT_EQUAL_STRING("", conn->http().stubAuthorization().c_str());
+    TEST_ASSERT_EQUAL(HTTPCLIENT_DEFAULT_TCP_TIMEOUT, conn->http().stubTimeout());
+    TEST_ASSERT_TRUE(conn->http().stubReuse());
+}
+
+void test_stale_error() {
+    ConnectionPool pool;
+    auto conn = acquire(pool, URL);
+    TEST_ASSERT_FALSE(ConnectionPool::isStaleError(*conn, HTTPC_ERROR_SEND_HEADER_FAILED));
+    release(conn, true);
+    conn = acquire(pool, URL);
+    for (auto code: {HTTPC_ERROR_SEND_HEADER_FAILED, HTTPC_ERROR_SEND_PAYLOAD_FAILED, HTTPC_ERROR_NOT_CONNECTED,
+                     HTTPC_ERROR_CONNECTION_LOST}) {
+        TEST_ASSERT_TRUE(ConnectionPool::isStaleError(*conn, code));
+    }
+    for (auto code: {(int) HTTP_CODE_OK, (int) HTTP_CODE_INTERNAL_SERVER_ERROR, HTTPC_ERROR_READ_TIMEOUT}) {
+        TEST_ASSERT_FALSE(ConnectionPool::isStaleError(*conn, code));
+    }
+}
+
+void test_retry_on_stale_connection() {
+    ConnectionPool pool;
+    auto conn = acquire(pool, URL);
+    release(conn, true);
+    HTTPClient::stubResponses().push_back({HTTP_CODE_OK, 2, "", "ok"});
+
+    // same as the request loop of ChatGptClient
+    int httpCode = 0;
+    for (auto reuse: {true, false}) {
+        conn = acquire(pool, URL, reuse);
+        if (reuse) {
+            TEST_ASSERT_TRUE(conn->isReused());
+            conn->client()->stubSetStale();
+        }
+        conn->http().begin(*conn->client(), URL);
+        httpCode = conn->http().GET();
+        if (httpCode == HTTP_CODE_OK || !ConnectionPool::isStaleError(*conn, httpCode)) {
+            break;
+        }
+        release(conn, false);
+    }
+    TEST_ASSERT_EQUAL(HTTP_CODE_OK, httpCode);
+    TEST_ASSERT_FALSE(conn->isReused());
+    release(conn, true);
+    auto stats = pool.getStats();
+    TEST_ASSERT_EQUAL(1, stats.size);
+    TEST_ASSERT_EQUAL(2, stats.misses);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_reuse_connection);
+    RUN_TEST(test_separate_hosts);
+    RUN_TEST(test_secure_client);
+    RUN_TEST(test_not_share_connection_in_use);
+    RUN_TEST(test_close_not_reusable);
+    RUN_TEST(test_close_by_peer);
+    RUN_TEST(test_no_reuse);
+    RUN_TEST(test_max_size);
+    RUN_TEST(test_idle_timeout);
+    RUN_TEST(test_connect_failure);
+    RUN_TEST(test_reset_request_state);
+    RUN_TEST(test_stale_error);
+    RUN_TEST(test_retry_on_stale_connection);
+    return UNITY_END();
+}
@@ -0,0 +1,213 @@
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "lib/JsonExtractor.h"
+
+typedef JsonExtractor::Result Result;
+
+static const char *CONTENT_PATH = "choices.0.delta.content";
+
+/// size of the document each event was deserialized into before
+static const size_t DOCUMENT_SIZE = 16 * 1024;
+
+static const int BENCHMARK_REPEAT = 200;
+
+/// number of allocations through new
+static size_t heapAllocations = 0;
+
+void *operator new(size_t size) {
+    heapAllocations++;
+    auto p = malloc(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+static Result extract(JsonExtractor &extractor, const char *json, String &value) {
+    value = "?";
+    return extractor.extract(json, strlen(json), value);
+}
+
+static std::string chunkEvent(const std::string &content) {
+    return R"({"id":"chatcmpl-7abc","object":"chat.completion.chunk","created":1690000000,)"
+           R"("model":"gpt-3.5-turbo-0613","choices":[{"index":0,"delta":{"content":")" + content
+           + R"("},"finish_reason":null}]})";
+}
+
+/**
+ * Events of a recorded stream (role, contents and finish)
+ */
+static std::vector<std::string> recordedStream() {
+    std::vector<std::string> events;
+    events.push_back(R"({"id":"chatcmpl-7abc","object":"chat.completion.chunk","created":1690000000,)"
+                     R"("model":"gpt-3.5-turbo-0613","choices":[{"index":0,"delta":{"role":"assistant",)"
+                     R"("content":""},"finish_reason":null}]})");
+    for (auto content: {"こんにちは", "！", "今日", "は", "いい", "天気", "です", "ね", "。", "\\n",
+                        "Today", " is", " a", " \\\"good\\\"", " day", ".", " \\ud83d\\ude00", " How",
+                        " can", " I", " help", " you", "?"}) {
+        events.push_back(chunkEvent(content));
+    }
+    events.push_back(R"({"id":"chatcmpl-7abc","object":"chat.completion.chunk","created":1690000000,)"
+                     R"("model":"gpt-3.5-turbo-0613","choices":[{"index":0,"delta":{},"finish_reason":"stop"}]})");
+    return events;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_content() {
+    JsonExtractor extractor{CONTENT_PATH};
+    String value;
+    TEST_ASSERT_EQUAL((int) Result::Found, (int) extract(extractor, chunkEvent("Hello").c_str(), value));
+    TEST_ASSERT_EQUAL_STRING("Hello", value.c_str());
+    TEST_ASSERT_EQUAL((int) Result::Found, (int) extract(extractor, chunkEvent("").c_str(), value));
+    TEST_ASSERT_EQUAL_STRING("", value.c_str());
+}
+
+void test_unescape() {
+    JsonExtractor extractor{CONTENT_PATH};
+    String value;
+    TEST_ASSERT_EQUAL((int) Result::Found,
+                      (int) extract(extractor, chunkEvent(R"(Hel\"lo\n\\\/\b\f\r\t)").c_str(), value));
+    TEST_ASSERT_EQUAL_STRING("Hel\"lo\n\\/\b\f\r\t", value.c_str());
+
+    // UTF-8 as is, \u escapes and surrogate pairs into UTF-8
+    TEST_ASSERT_EQUAL((int) Result::Found,
+                      (int) extract(extractor, chunkEvent(R"(\u3042\ud83d\ude00\u0041\u00e9あ😀)").c_str(), value));
+    TEST_ASSERT_EQUAL_STRING("あ😀Aéあ😀", value.c_str());
+}
+
+void test_not_found() {
+    JsonExtractor extractor{CONTENT_PATH};
+    String value;
+    for (auto json: {R"({"choices":[{"index":0,"delta":{"role":"assistant"},"finish_reason":null}]})",
+                     R"({"choices":[{"delta":{},"finish_reason":"stop"}]})",
+                     R"({"choices":[]})",
+                     R"({"choices":[{"delta":{"content":null}}]})",
+                     R"({"choices":[{"delta":{"content":123}}]})",
+                     R"({"choices":[{"delta":{"content":["a"]}}]})",
+                     R"({"error":{"message":"rate limited"}})",
+                     R"([])"}) {
+        TEST_ASSERT_EQUAL_MESSAGE((int) Result::NotFound, (int) extract(extractor, json, value), json);
+        TEST_ASSERT_EQUAL_STRING("?", value.c_str());
+    }
+}
+
+void test_skip_other_values() {
+    JsonExtractor extractor{CONTENT_PATH};
+    String value;
+    // brackets and quotes in strings, nested values before the path and whitespace between tokens
+    auto json = R"({"a":[1,{"b":"}]\"{["}],"n":-1.5e3,"t":true,"f":false,"z":null,)"
+                R"( "choices" : [ {"delta":{"content":"first?"},"x":[[]]} , { "delta" : { "content" : "ok" } } ]})";
+    JsonExtractor second{"choices.1.delta.content"};
+    TEST_ASSERT_EQUAL((int) Result::Found, (int) extract(second, json, value));
+    TEST_ASSERT_EQUAL_STRING("ok", value.c_str());
+    TEST_ASSERT_EQUAL((int) Result::Found, (int) extract(extractor, json, value));
+    TEST_ASSERT_EQUAL_STRING("first?", value.c_str());
+}
+
+void test_invalid() {
+    JsonExtractor extractor{CONTENT_PATH};
+    String value;
+    for (auto json: {R"({"choices":[{"delta":{"content":"unterminated)",
+                     R"({"choices":[{"delta":{"content":"bad\x"}}]})",
+                     R"({"choices":[{"delta":{"content":"\u12"}}]})",
+                     R"({"choices":[{"delta"})",
+                     R"({"choices":[{"delta":{"content")",
+                     R"({"choices")",
+                     R"(not json)",
+                     ""}) {
+        TEST_ASSERT_EQUAL_MESSAGE((int) Result::Invalid, (int) extract(extractor, json, value), json);
+    }
+}
+
+void test_length_not_null_terminated() {
+    JsonExtractor extractor{CONTENT_PATH};
+    String value;
+    // the rest of the buffer is not read
+    auto json = chunkEvent("in range") + "garbage\"";
+    TEST_ASSERT_EQUAL((int) Result::Found, (int) extractor.extract(json.c_str(), json.size() - 8, value));
+    TEST_ASSERT_EQUAL_STRING("in range", value.c_str());
+    // ends in the value
+    TEST_ASSERT_EQUAL((int) Result::Invalid, (int) extractor.extract(json.c_str(), json.find("range"), value));
+}
+
+void test_benchmark() {
+    auto events = recordedStream();
+    JsonExtractor extractor{CONTENT_PATH};
+    String value;
+    std::string reply;
+    size_t found = 0;
+    // the buffers grow on the first pass only
+    for (const auto &event: events) {
+        if (extractor.extract(event.c_str(), event.size(), value) == Result::Found) {
+            reply += value.c_str();
+        }
+    }
+    TEST_ASSERT_EQUAL_STRING("こんにちは！今日はいい天気ですね。\nToday is a \"good\" day. 😀 How can I help you?",
+                             reply.c_str());
+
+    auto allocations = heapAllocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+        for (const auto &event: events) {
+            found += extractor.extract(event.c_str(), event.size(), value) == Result::Found ? 1 : 0;
+        }
+    }
+    auto extractorNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    auto extractorAllocations = heapAllocations - allocations;
+
+    // deserializing each event into a document as before
+    DynamicJsonDocument doc(DOCUMENT_SIZE);
+    size_t domFound = 0;
+    size_t domUsage = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_REPEAT; i++) {
+        for (const auto &event: events) {
+            TEST_ASSERT_TRUE(deserializeJson(doc, event.c_str(), event.size()) == DeserializationError::Ok);
+            const char *content = doc["choices"][0]["delta"]["content"];
+            domFound += content != nullptr ? 1 : 0;
+            domUsage = std::max(domUsage, doc.memoryUsage());
+        }
+    }
+    auto domNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    auto count = (double) (events.size() * BENCHMARK_REPEAT);
+    char buf[200];
+    snprintf(buf, sizeof(buf), "%u events: extractor %.0f ns/event, %u allocations; "
+                               "document %.0f ns/event, %u bytes allocated, %u bytes used",
+             (unsigned) events.size(), extractorNs / count, (unsigned) extractorAllocations, domNs / count,
+             (unsigned) doc.capacity(), (unsigned) domUsage);
+    TEST_MESSAGE(buf);
+    TEST_ASSERT_EQUAL((events.size() - 1) * BENCHMARK_REPEAT, found);
+    TEST_ASSERT_EQUAL(found, domFound);
+    TEST_ASSERT_EQUAL(0, extractorAllocations);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_content);
+    RUN_TEST(test_unescape);
+    RUN_TEST(test_not_found);
+    RUN_TEST(test_skip_other_values);
+    RUN_TEST(test_invalid);
+    RUN_TEST(test_length_not_null_terminated);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <Arduino.h>
+#include <unity.h>
+
+#include "app/lang.h"
+
+static const char *KEYS[] = {"apikey_not_set", "chat_i_dont_understand", "chat_random_started",
+                             "chat_random_stopped", "chat_thinking...", "clock_not_set", "clock_now",
+                             "clock_now_noon"};
+
+static const int BENCHMARK_COUNT = 100000;
+
+/// lookup copying the maps as before (for the benchmark, a subset of the old table)
+static const std::map<std::string, std::map<std::string, const char *>> OLD_MAP = {
+        {"en", {{"clock_now", "It's %d %d"}, {"clock_not_set", "The clock is not set"}}},
+        {"ja", {{"clock_now", "%d時 %d分です"}, {"clock_not_set", "時刻が設定されていません"}}},
+};
+
+static const char *oldT(const char *lang, const char *key) {
+    if (OLD_MAP.find(lang) != OLD_MAP.end()) {
+        auto langMap = OLD_MAP.at(lang);
+        if (langMap.find(key) != langMap.end()) {
+            return langMap.at(key);
+        }
+    }
+    auto defaultLangMap = OLD_MAP.at("en");
+    if (defaultLangMap.find(key) != defaultLangMap.end()) {
+        return defaultLangMap.at(key);
+    }
+    return key;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_lang_of() {
+    TEST_ASSERT_EQUAL_STRING("en", Lang::of("en").code());
+    TEST_ASSERT_EQUAL_STRING("ja", Lang::of("ja").code());
+    TEST_ASSERT_EQUAL_STRING("ro", Lang::of("ro").code());
+    TEST_ASSERT_EQUAL_STRING("en", Lang::of("en-US").code());
+    TEST_ASSERT_EQUAL_STRING("en", Lang::of("fr").code());
+    TEST_ASSERT_EQUAL_STRING("en", Lang::of("").code());
+    TEST_ASSERT_TRUE(Lang::of("ja-JP") == Lang::of("ja"));
+    TEST_ASSERT_TRUE(Lang() == Lang::of("en"));
+    TEST_ASSERT_TRUE(Lang::of("ja") != Lang::of("ro"));
+}
+
+void test_translate() {
+    TEST_ASSERT_EQUAL_STRING("I don't understand", Lang::of("en").t("chat_i_dont_understand"));
+    TEST_ASSERT_EQUAL_STRING("わかりません", Lang::of("ja").t("chat_i_dont_understand"));
+    TEST_ASSERT_EQUAL_STRING("Nu înțeleg", Lang::of("ro").t("chat_i_dont_understand"));
+    TEST_ASSERT_EQUAL_STRING("%d時 %d分です", t("ja", "clock_now"));
+    TEST_ASSERT_EQUAL_STRING("It's %d o'clock", t("fr", "clock_now_noon"));
+}
+
+void test_every_key() {
+    for (auto code: {"en", "ja", "ro"}) {
+        auto lang = Lang::of(code);
+        for (auto key: KEYS) {
+            auto text = lang.t(key);
+            TEST_ASSERT_NOT_NULL(text);
+            TEST_ASSERT_TRUE(strcmp(text, key) != 0);
+        }
+    }
+}
+
+void test_unknown_key() {
+    TEST_ASSERT_EQUAL_STRING("no_such_key", Lang::of("ja").t("no_such_key"));
+    TEST_ASSERT_EQUAL_STRING("", Lang::of("en").t(""));
+    TEST_ASSERT_EQUAL_STRING("clock_now_", Lang::of("en").t("clock_now_"));
+}
+
+void test_clock_speech_segments() {
+    auto segments = clockSpeechSegments(Lang::of("ja"), 9, 30);
+    TEST_ASSERT_EQUAL(2, segments.size());
+    TEST_ASSERT_EQUAL_STRING("9時", segments[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("30分です", segments[1].c_str());
+
+    segments = clockSpeechSegments(Lang::of("en"), 12, 0);
+    TEST_ASSERT_EQUAL(1, segments.size());
+    TEST_ASSERT_EQUAL_STRING("It's 12 o'clock", segments[0].c_str());
+}
+
+void test_canned_phrases() {
+    auto phrases = cannedPhrases(Lang::of("ja"));
+    std::set<std::string> unique(phrases.begin(), phrases.end());
+    TEST_ASSERT_EQUAL(phrases.size(), unique.size());
+    // 5 fixed phrases + 24 hours at 0 minutes + 24 hours + 59 minutes
+    TEST_ASSERT_EQUAL(5 + 24 + 24 + 59, phrases.size());
+    TEST_ASSERT_TRUE(unique.count("わかりません") > 0);
+    TEST_ASSERT_TRUE(unique.count("23時") > 0);
+}
+
+void test_benchmark() {
+    volatile size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_COUNT; i++) {
+        sink = sink + strlen(oldT("ja", "clock_now"));
+    }
+    auto oldNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_COUNT; i++) {
+        sink = sink + strlen(t("ja", "clock_now"));
+    }
+    auto codeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    auto lang = Lang::of("ja");
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_COUNT; i++) {
+        sink = sink + strlen(lang.t("clock_now"));
+    }
+    auto langNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    char buf[160];
+    snprintf(buf, sizeof(buf), "t(): copying maps %.1f ns, language code %.1f ns, resolved language %.1f ns",
+             oldNs / BENCHMARK_COUNT, codeNs / BENCHMARK_COUNT, langNs / BENCHMARK_COUNT);
+    TEST_MESSAGE(buf);
+    TEST_ASSERT_TRUE(langNs < oldNs);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lang_of);
+    RUN_TEST(test_translate);
+    RUN_TEST(test_every_key);
+    RUN_TEST(test_unknown_key);
+    RUN_TEST(test_clock_speech_segments);
+    RUN_TEST(test_canned_phrases);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
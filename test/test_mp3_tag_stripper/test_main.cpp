@@ -0,0 +1,127 @@
+#include <vector>
+#include <unity.h>
+
+#include "lib/Mp3TagStripper.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+static Bytes id3v2(size_t bodySize, bool footer = false) {
+    Bytes tag = {'I', 'D', '3', 4, 0, (uint8_t) (footer ? 0x10 : 0),
+                 (uint8_t) ((bodySize >> 21) & 0x7f), (uint8_t) ((bodySize >> 14) & 0x7f),
+                 (uint8_t) ((bodySize >> 7) & 0x7f), (uint8_t) (bodySize & 0x7f)};
+    tag.insert(tag.end(), bodySize + (footer ? 10 : 0), 0xff);
+    return tag;
+}
+
+static Bytes id3v1() {
+    Bytes tag(128, 0);
+    tag[0] = 'T';
+    tag[1] = 'A';
+    tag[2] = 'G';
+    return tag;
+}
+
+/// frames starting with sync (includes 0xFF not followed by sync)
+static Bytes audio(size_t size) {
+    Bytes data = {0xff, 0xfb, 0x90, 0x00, 0xff, 0x00};
+    for (size_t i = data.size(); i < size; i++) {
+        data.push_back((uint8_t) i);
+    }
+    return data;
+}
+
+static Bytes concat(std::initializer_list<Bytes> parts) {
+    Bytes result;
+    for (const auto &part: parts) {
+        result.insert(result.end(), part.begin(), part.end());
+    }
+    return result;
+}
+
+/**
+ * Strip the stream fed in pieces of the given size
+ */
+static bool strip(const Bytes &in, size_t pieceSize, Bytes &out) {
+    out.clear();
+    Mp3TagStripper stripper([&out](const uint8_t *data, size_t len) {
+        out.insert(out.end(), data, data + len);
+        return true;
+    });
+    for (size_t pos = 0; pos < in.size(); pos += pieceSize) {
+        if (!stripper.feed(in.data() + pos, std::min(pieceSize, in.size() - pos))) {
+            return false;
+        }
+    }
+    return stripper.finish() && stripper.length() == out.size();
+}
+
+static void assertStripped(const Bytes &in, const Bytes &expected) {
+    for (size_t pieceSize = 1; pieceSize <= in.size(); pieceSize += (pieceSize < 32 ? 1 : 61)) {
+        Bytes out;
+        TEST_ASSERT_TRUE(strip(in, pieceSize, out));
+        TEST_ASSERT_EQUAL(expected.size(), out.size());
+        TEST_ASSERT_TRUE(out == expected);
+    }
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_no_tags() {
+    assertStripped(audio(300), audio(300));
+}
+
+void test_strip_id3v2() {
+    assertStripped(concat({id3v2(50), audio(300)}), audio(300));
+}
+
+void test_strip_id3v2_with_footer() {
+    assertStripped(concat({id3v2(50, true), audio(300)}), audio(300));
+}
+
+void test_strip_id3v2_large() {
+    assertStripped(concat({id3v2(1000), audio(300)}), audio(300));
+}
+
+void test_strip_id3v1() {
+    assertStripped(concat({audio(300), id3v1()}), audio(300));
+}
+
+void test_strip_both_and_padding() {
+    // padding after the tag is skipped until frame sync
+    assertStripped(concat({id3v2(20), Bytes{0x00, 0xff, 0x00, 0x00}, audio(300), id3v1()}), audio(300));
+}
+
+void test_keep_tail_not_tag() {
+    auto data = audio(500);
+    data[500 - 128] = 'T';
+    assertStripped(data, data);
+}
+
+void test_short_stream() {
+    Bytes data = {0xff, 0xf3, 0x01};
+    assertStripped(data, data);
+}
+
+void test_write_failure() {
+    auto data = concat({id3v2(10), audio(300)});
+    Mp3TagStripper stripper([](const uint8_t *, size_t) { return false; });
+    bool result = stripper.feed(data.data(), data.size());
+    result = stripper.finish() && result;
+    TEST_ASSERT_FALSE(result);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_no_tags);
+    RUN_TEST(test_strip_id3v2);
+    RUN_TEST(test_strip_id3v2_with_footer);
+    RUN_TEST(test_strip_id3v2_large);
+    RUN_TEST(test_strip_id3v1);
+    RUN_TEST(test_strip_both_and_padding);
+    RUN_TEST(test_keep_tail_not_tag);
+    RUN_TEST(test_short_stream);
+    RUN_TEST(test_write_failure);
+    return UNITY_END();
+}
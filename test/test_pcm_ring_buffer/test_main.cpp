@@ -0,0 +1,124 @@
+#include <random>
+#include <thread>
+#include <vector>
+#include <unity.h>
+
+#include "lib/PcmRingBuffer.h"
+#include "lib/arena.h"
+
+static std::vector<int16_t> sequence(int from, int count) {
+    std::vector<int16_t> samples;
+    for (int i = 0; i < count; i++) {
+        samples.push_back((int16_t) (from + i));
+    }
+    return samples;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_capacity() {
+    PcmRingBuffer ring(1000);
+    TEST_ASSERT_TRUE(ring.isAllocated());
+    TEST_ASSERT_EQUAL(1024, ring.capacity());
+    TEST_ASSERT_EQUAL(1024, PcmRingBuffer(1024).capacity());
+    TEST_ASSERT_EQUAL(0, ring.available());
+}
+
+void test_write_and_read() {
+    PcmRingBuffer ring(16);
+    auto data = sequence(0, 10);
+    TEST_ASSERT_EQUAL(10, ring.write(data.data(), data.size()));
+    TEST_ASSERT_EQUAL(10, ring.available());
+
+    int16_t buf[16];
+    TEST_ASSERT_EQUAL(4, ring.read(buf, 4));
+    TEST_ASSERT_EQUAL(6, ring.available());
+    TEST_ASSERT_EQUAL(6, ring.read(buf + 4, 16));
+    TEST_ASSERT_TRUE(std::vector<int16_t>(buf, buf + 10) == data);
+    TEST_ASSERT_EQUAL(0, ring.read(buf, 16));
+}
+
+void test_full() {
+    PcmRingBuffer ring(16);
+    auto data = sequence(0, 20);
+    TEST_ASSERT_EQUAL(16, ring.write(data.data(), data.size()));
+    TEST_ASSERT_EQUAL(0, ring.write(data.data(), 1));
+    int16_t buf[16];
+    TEST_ASSERT_EQUAL(16, ring.read(buf, 16));
+    TEST_ASSERT_TRUE(std::vector<int16_t>(buf, buf + 16) == sequence(0, 16));
+}
+
+void test_wrap_around() {
+    PcmRingBuffer ring(16);
+    int16_t buf[16];
+    int written = 0;
+    int read = 0;
+    // every split of the storage end
+    for (int round = 0; round < 40; round++) {
+        auto data = sequence(written, 5 + round % 7);
+        written += (int) ring.write(data.data(), data.size());
+        auto n = (int) ring.read(buf, 3 + round % 11);
+        TEST_ASSERT_TRUE(std::vector<int16_t>(buf, buf + n) == sequence(read, n));
+        read += n;
+        TEST_ASSERT_EQUAL(written - read, ring.available());
+    }
+}
+
+void test_clear() {
+    PcmRingBuffer ring(16);
+    auto data = sequence(0, 10);
+    ring.write(data.data(), data.size());
+    ring.clear();
+    TEST_ASSERT_EQUAL(0, ring.available());
+    TEST_ASSERT_EQUAL(16, ring.write(data.data(), 16));
+}
+
+void test_large_arena() {
+    auto before = getArenaStats(Arena::Large).used;
+    {
+        PcmRingBuffer ring(4096);
+        TEST_ASSERT_EQUAL(before + 4096 * sizeof(int16_t), getArenaStats(Arena::Large).used);
+    }
+    TEST_ASSERT_EQUAL(before, getArenaStats(Arena::Large).used);
+}
+
+void test_producer_and_consumer_threads() {
+    PcmRingBuffer ring(256);
+    const int total = 1000000;
+    std::thread producer([&ring]() {
+        std::mt19937 rng(1);
+        int written = 0;
+        while (written < total) {
+            auto data = sequence(written, std::min(total - written, (int) (rng() % 100) + 1));
+            written += (int) ring.write(data.data(), data.size());
+        }
+    });
+    std::mt19937 rng(2);
+    int16_t buf[128];
+    int read = 0;
+    bool inOrder = true;
+    while (read < total) {
+        auto n = ring.read(buf, rng() % 128 + 1);
+        for (size_t i = 0; i < n; i++) {
+            inOrder = inOrder && buf[i] == (int16_t) (read + i);
+        }
+        read += (int) n;
+    }
+    producer.join();
+    TEST_ASSERT_TRUE(inOrder);
+    TEST_ASSERT_EQUAL(0, ring.available());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_capacity);
+    RUN_TEST(test_write_and_read);
+    RUN_TEST(test_full);
+    RUN_TEST(test_wrap_around);
+    RUN_TEST(test_clear);
+    RUN_TEST(test_large_arena);
+    RUN_TEST(test_producer_and_consumer_threads);
+    return UNITY_END();
+}
@@ -0,0 +1,126 @@
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <unity.h>
+
+#include "lib/SentenceSegmenter.h"
+
+typedef std::vector<std::string> Sentences;
+
+/**
+ * Segment the text fed in pieces of the given size
+ */
+static Sentences segment(const std::string &text, size_t pieceSize, size_t maxLength = 200) {
+    Sentences sentences;
+    SentenceSegmenter segmenter(maxLength);
+    auto onSentence = [&sentences](const String &sentence) { sentences.push_back(sentence); };
+    for (size_t pos = 0; pos < text.size(); pos += pieceSize) {
+        segmenter.feed(text.data() + pos, std::min(pieceSize, text.size() - pos), onSentence);
+    }
+    segmenter.flush(onSentence);
+    return sentences;
+}
+
+/**
+ * Check the result of every split position and piece size
+ */
+static void assertSegments(const std::string &text, const Sentences &expected, size_t maxLength = 200) {
+    TEST_ASSERT_TRUE(segment(text, text.size(), maxLength) == expected);
+    for (size_t pieceSize = 1; pieceSize < 8; pieceSize++) {
+        TEST_ASSERT_TRUE(segment(text, pieceSize, maxLength) == expected);
+    }
+    for (size_t split = 1; split < text.size(); split++) {
+        Sentences sentences;
+        SentenceSegmenter segmenter(maxLength);
+        auto onSentence = [&sentences](const String &sentence) { sentences.push_back(sentence); };
+        segmenter.feed(text.data(), split, onSentence);
+        segmenter.feed(text.data() + split, text.size() - split, onSentence);
+        segmenter.flush(onSentence);
+        TEST_ASSERT_TRUE(sentences == expected);
+    }
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_sentences() {
+    assertSegments("Hello world. How are you? Fine! Thanks", {"Hello world.", "How are you?", "Fine!", "Thanks"});
+}
+
+void test_full_width_terminators() {
+    assertSegments("こんにちは。元気ですか？はい！ありがとう", {"こんにちは。", "元気ですか？", "はい！", "ありがとう"});
+}
+
+void test_line_end() {
+    assertSegments("first line\r\nsecond line\n\n  \nthird", {"first line", "second line", "third"});
+}
+
+void test_period_in_word() {
+    assertSegments("Pi is 3.14 or so. Visit example.com now... OK",
+                   {"Pi is 3.14 or so.", "Visit example.com now...", "OK"});
+}
+
+void test_emit_on_terminator() {
+    Sentences sentences;
+    SentenceSegmenter segmenter(200);
+    auto onSentence = [&sentences](const String &sentence) { sentences.push_back(sentence); };
+    segmenter.feed("Really?", 7, onSentence);
+    TEST_ASSERT_EQUAL(1, sentences.size());
+    segmenter.feed("はい。", strlen("はい。"), onSentence);
+    TEST_ASSERT_EQUAL(2, sentences.size());
+
+    // "." waits for the next character
+    segmenter.feed("Yes.", 4, onSentence);
+    TEST_ASSERT_EQUAL(2, sentences.size());
+    segmenter.feed(" ", 1, onSentence);
+    TEST_ASSERT_EQUAL(3, sentences.size());
+    TEST_ASSERT_EQUAL_STRING("Yes.", sentences[2].c_str());
+}
+
+void test_utf8_split() {
+    // break of long sentence never splits a character
+    std::string text = "あいうえおかきくけこさしすせそ";
+    auto sentences = segment(text, 1, 10);
+    std::string joined;
+    for (const auto &sentence: sentences) {
+        TEST_ASSERT_EQUAL(0, sentence.size() % 3);
+        joined += sentence;
+    }
+    TEST_ASSERT_EQUAL_STRING(text.c_str(), joined.c_str());
+}
+
+void test_soft_break() {
+    assertSegments("aaaa bbbb cccc dddd eeee ffff.", {"aaaa bbbb cccc dddd", "eeee ffff."}, 20);
+    assertSegments("あいう、えおか、きくけこ。", {"あいう、えおか、", "きくけこ。"}, 26);
+}
+
+void test_hard_break() {
+    assertSegments(std::string(25, 'a'), {std::string(10, 'a'), std::string(10, 'a'), std::string(5, 'a')}, 10);
+}
+
+void test_reset() {
+    Sentences sentences;
+    SentenceSegmenter segmenter(200);
+    auto onSentence = [&sentences](const String &sentence) { sentences.push_back(sentence); };
+    segmenter.feed("discarded", 9, onSentence);
+    segmenter.reset();
+    segmenter.feed("kept", 4, onSentence);
+    segmenter.flush(onSentence);
+    TEST_ASSERT_EQUAL(1, sentences.size());
+    TEST_ASSERT_EQUAL_STRING("kept", sentences[0].c_str());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_sentences);
+    RUN_TEST(test_full_width_terminators);
+    RUN_TEST(test_line_end);
+    RUN_TEST(test_period_in_word);
+    RUN_TEST(test_emit_on_terminator);
+    RUN_TEST(test_utf8_split);
+    RUN_TEST(test_soft_break);
+    RUN_TEST(test_hard_break);
+    RUN_TEST(test_reset);
+    return UNITY_END();
+}
@@ -0,0 +1,151 @@
+#include <chrono>
+#include <string>
+#include <Arduino.h>
+#include <nvs.h>
+#include <unity.h>
+
+#include "app/AppSettings.h"
+
+static const char *SETTINGS_JSON = R"({
+  "voice": {"lang": "en-US", "volume": 120, "service": "voicetext", "voicetext": {"apiKey": "key"}},
+  "chat": {"openai": {"apiKey": "sk-test", "maxHistory": 20, "stream": true}, "clock": {"hours": [7, 12]}},
+  "swing": {"home": {"x": 100}}
+})";
+
+static const int BENCHMARK_COUNT = 100000;
+
+static AppSettings *settings;
+
+static String dump(JsonVariantConst value) {
+    String text;
+    serializeJson(value, text);
+    return text;
+}
+
+/**
+ * Measure time per call (ns)
+ */
+template<class F>
+static double measure(F f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_COUNT; i++) {
+        f();
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+           BENCHMARK_COUNT;
+}
+
+void setUp() {
+    stubNvs().clear();
+    settings = new AppSettings();
+    TEST_ASSERT_TRUE(settings->load(SETTINGS_JSON));
+}
+
+void tearDown() {
+    delete settings;
+}
+
+void test_get_by_settings_key() {
+    for (auto key: {"voice.volume", "voice.voicetext.apiKey", "chat.clock.hours.1", "not.exists"}) {
+        SettingsKey settingsKey(key);
+        TEST_ASSERT_EQUAL_STRING(dump(settings->get(key)).c_str(), dump(settings->get(settingsKey)).c_str());
+        TEST_ASSERT_EQUAL(settings->has(key), settings->has(settingsKey));
+    }
+    TEST_ASSERT_EQUAL(12, settings->get(SettingsKey("chat.clock.hours.1")).as<int>());
+}
+
+void test_resolved_getters() {
+    TEST_ASSERT_EQUAL(120, settings->getVoiceVolume());
+    TEST_ASSERT_EQUAL_STRING("voicetext", settings->getVoiceService().c_str());
+    TEST_ASSERT_EQUAL_STRING("key", settings->getVoiceTextApiKey().c_str());
+    TEST_ASSERT_EQUAL_STRING("en", settings->getLang().c_str());
+    TEST_ASSERT_TRUE(settings->getLanguage() == Lang::of("en"));
+    TEST_ASSERT_EQUAL(20, settings->getMaxHistory());
+    TEST_ASSERT_TRUE(settings->useChatGptStream());
+    TEST_ASSERT_TRUE(settings->isClockSpeakEnabled());
+    TEST_ASSERT_FALSE(settings->isRandomSpeakEnabled());
+    TEST_ASSERT_EQUAL(100, settings->getSwingHome().first);
+}
+
+void test_resolved_defaults() {
+    TEST_ASSERT_TRUE(settings->load("{}"));
+    TEST_ASSERT_EQUAL(200, settings->getVoiceVolume());
+    TEST_ASSERT_EQUAL_STRING(VOICE_SERVICE_GOOGLE_TRANSLATE_TTS, settings->getVoiceService().c_str());
+    TEST_ASSERT_EQUAL_STRING("", settings->getOpenAiApiKey().c_str());
+    TEST_ASSERT_EQUAL(10, settings->getMaxHistory());
+    TEST_ASSERT_FALSE(settings->isClockSpeakEnabled());
+}
+
+void test_resolved_after_change() {
+    auto revision = settings->getRevision();
+    TEST_ASSERT_EQUAL(120, settings->getVoiceVolume());
+    TEST_ASSERT_TRUE(settings->setVoiceVolume(80));
+    TEST_ASSERT_NOT_EQUAL(revision, settings->getRevision());
+    TEST_ASSERT_EQUAL(80, settings->getVoiceVolume());
+
+    TEST_ASSERT_TRUE(settings->set("chat.openai.maxHistory", 5));
+    TEST_ASSERT_EQUAL(5, settings->getMaxHistory());
+
+    TEST_ASSERT_TRUE(settings->load(R"({"voice": {"service": "google-cloud-tts"}})", true));
+    TEST_ASSERT_EQUAL_STRING("google-cloud-tts", settings->getVoiceService().c_str());
+    TEST_ASSERT_EQUAL(80, settings->getVoiceVolume());
+
+    TEST_ASSERT_TRUE(settings->remove("voice.volume"));
+    TEST_ASSERT_EQUAL(200, settings->getVoiceVolume());
+}
+
+void test_on_changed() {
+    int changed = 0;
+    settings->setOnChanged([&changed]() { changed++; });
+    TEST_ASSERT_TRUE(settings->setVoiceVolume(80));
+    TEST_ASSERT_EQUAL(1, changed);
+    TEST_ASSERT_TRUE(settings->load(R"({"voice": {"lang": "ja"}})", true));
+    TEST_ASSERT_TRUE(settings->load());
+    TEST_ASSERT_EQUAL(3, changed);
+    // not called on read
+    settings->getVoiceVolume();
+    TEST_ASSERT_EQUAL(3, changed);
+    settings->setOnChanged(nullptr);
+}
+
+void test_resolved_after_load_from_nvs() {
+    TEST_ASSERT_EQUAL(120, settings->getVoiceVolume());
+    AppSettings other;
+    TEST_ASSERT_TRUE(other.load());
+    TEST_ASSERT_TRUE(other.setVoiceVolume(50));
+    TEST_ASSERT_TRUE(settings->load());
+    TEST_ASSERT_EQUAL(50, settings->getVoiceVolume());
+}
+
+void test_benchmark() {
+    volatile int sink = 0;
+    SettingsKey volumeKey("voice.volume");
+    auto stringKey = measure([&]() { sink = sink + (uint8_t) (settings->get("voice.volume") | 200); });
+    auto settingsKey = measure([&]() { sink = sink + (uint8_t) (settings->get(volumeKey) | 200); });
+    auto resolved = measure([&]() { sink = sink + settings->getVoiceVolume(); });
+    char buf[160];
+    snprintf(buf, sizeof(buf), "voice.volume: string key %.0f ns, SettingsKey %.0f ns, resolved getter %.0f ns",
+             stringKey, settingsKey, resolved);
+    TEST_MESSAGE(buf);
+
+    SettingsKey serviceKey("voice.service");
+    stringKey = measure([&]() { sink = sink + String(settings->get("voice.service") | "").length(); });
+    settingsKey = measure([&]() { sink = sink + String(settings->get(serviceKey) | "").length(); });
+    resolved = measure([&]() { sink = sink + settings->getVoiceService().length(); });
+    snprintf(buf, sizeof(buf), "voice.service: string key %.0f ns, SettingsKey %.0f ns, resolved getter %.0f ns",
+             stringKey, settingsKey, resolved);
+    TEST_MESSAGE(buf);
+    TEST_ASSERT_TRUE(resolved < stringKey);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_get_by_settings_key);
+    RUN_TEST(test_resolved_getters);
+    RUN_TEST(test_resolved_defaults);
+    RUN_TEST(test_resolved_after_change);
+    RUN_TEST(test_on_changed);
+    RUN_TEST(test_resolved_after_load_from_nvs);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
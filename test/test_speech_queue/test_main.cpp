@@ -0,0 +1,198 @@
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include <Arduino.h>
+#include <unity.h>
+
+#include "lib/SpeechQueue.h"
+
+static const int STRESS_ROUNDS = 20000;
+
+static SpeechQueue *queue;
+
+/// number of sources closed
+static std::atomic<int> closedCount{0};
+
+class TestSource : public AudioFileSource {
+public:
+    explicit TestSource(int id) : id(id) {}
+
+    ~TestSource() override { closedCount++; }
+
+    int id;
+};
+
+static std::shared_ptr<SpeechMessage> message(int id) {
+    return std::make_shared<SpeechMessage>(String(id), "");
+}
+
+void setUp() {
+    queue = new SpeechQueue();
+    closedCount = 0;
+}
+
+void tearDown() {
+    delete queue;
+}
+
+void test_take_in_order() {
+    TEST_ASSERT_FALSE(queue->isRunning());
+    TEST_ASSERT_TRUE(queue->take() == nullptr);
+    queue->push({message(1), message(2)});
+    queue->push({message(3)});
+    TEST_ASSERT_EQUAL(3, queue->size());
+
+    auto first = queue->take();
+    TEST_ASSERT_EQUAL_STRING("1", first->text.c_str());
+    TEST_ASSERT_TRUE(queue->isRunning());
+    TEST_ASSERT_TRUE(queue->isStarting());
+    TEST_ASSERT_EQUAL(2, queue->size());
+    queue->finishStart();
+    TEST_ASSERT_FALSE(queue->isStarting());
+    TEST_ASSERT_EQUAL_STRING("2", queue->take()->text.c_str());
+    TEST_ASSERT_EQUAL_STRING("3", queue->take()->text.c_str());
+    TEST_ASSERT_TRUE(queue->take() == nullptr);
+    TEST_ASSERT_TRUE(queue->isRunning());
+}
+
+void test_stop_after_take() {
+    queue->push({message(1), message(2)});
+    auto taken = queue->take();
+    // stopped while the taken message is being prepared
+    queue->stop();
+    TEST_ASSERT_FALSE(queue->isRunning());
+    TEST_ASSERT_EQUAL(0, queue->size());
+    std::unique_ptr<AudioFileSource> source;
+    TEST_ASSERT_TRUE(queue->takeSource(*taken, source));
+    queue->finishStart();
+    TEST_ASSERT_FALSE(queue->isRunning());
+
+    // running again for the next message
+    queue->push({message(3)});
+    TEST_ASSERT_EQUAL_STRING("3", queue->take()->text.c_str());
+    TEST_ASSERT_TRUE(queue->isRunning());
+}
+
+void test_prefetch() {
+    queue->push({message(1), message(2), message(3)});
+    auto prefetching = queue->prefetch(2);
+    TEST_ASSERT_EQUAL_STRING("1", prefetching->text.c_str());
+    TEST_ASSERT_TRUE(queue->isWanted(*prefetching));
+    auto next = queue->prefetch(2);
+    TEST_ASSERT_EQUAL_STRING("2", next->text.c_str());
+    TEST_ASSERT_TRUE(queue->prefetch(2) == nullptr);
+
+    // waits while prefetching, not wanted once taken
+    auto taken = queue->take();
+    TEST_ASSERT_TRUE(taken == prefetching);
+    std::unique_ptr<AudioFileSource> source;
+    TEST_ASSERT_FALSE(queue->takeSource(*taken, source));
+    TEST_ASSERT_FALSE(queue->isWanted(*prefetching));
+    queue->setPrefetched(*prefetching, std::unique_ptr<AudioFileSource>(new TestSource(1)));
+    TEST_ASSERT_TRUE(queue->takeSource(*taken, source));
+    TEST_ASSERT_EQUAL(1, static_cast<TestSource *>(source.get())->id);
+
+    // the source of the message dropped while prefetching is closed
+    queue->stop();
+    TEST_ASSERT_FALSE(queue->isWanted(*next));
+    queue->setPrefetched(*next, std::unique_ptr<AudioFileSource>(new TestSource(2)));
+    TEST_ASSERT_EQUAL(1, closedCount);
+    source = nullptr;
+    TEST_ASSERT_TRUE(queue->takeSource(*next, source));
+    TEST_ASSERT_TRUE(source == nullptr);
+}
+
+void test_stress_speak_and_stop() {
+    // numbered messages, stopped after each round as a chat request does
+    std::atomic<int> stoppedRound{-1};
+    std::atomic<bool> done{false};
+    std::atomic<int> played{0};
+    std::atomic<int> lostStops{0};
+    std::atomic<int> prefetched{0};
+
+    // voice task: take, wait for the prefetch and play while running
+    std::thread player([&] {
+        std::minstd_rand random(1);
+        while (!done || queue->size() > 0) {
+            auto taken = queue->take();
+            if (taken == nullptr) {
+                std::this_thread::yield();
+                continue;
+            }
+            auto round = (int) taken->requestTime;
+            std::unique_ptr<AudioFileSource> source;
+            while (!queue->takeSource(*taken, source)) {
+                std::this_thread::yield();
+            }
+            if (random() % 2 == 0) {
+                std::this_thread::yield();
+            }
+            queue->finishStart();
+            // the round is read before the state, both change only after the message was taken
+            auto stopped = stoppedRound.load();
+            if (queue->isRunning()) {
+                played++;
+                if (stopped >= round) {
+                    lostStops++;
+                }
+            }
+        }
+    });
+
+    // prefetch task: buffer until taken or cancelled (or some time)
+    std::thread prefetcher([&] {
+        std::minstd_rand random(3);
+        while (!done) {
+            auto message = queue->prefetch(2);
+            if (message == nullptr) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (int i = (int) (random() % 4); i > 0 && queue->isWanted(*message); i--) {
+                std::this_thread::yield();
+            }
+            queue->setPrefetched(*message, std::unique_ptr<AudioFileSource>(new TestSource(0)));
+            prefetched++;
+        }
+    });
+
+    // server task: speak and stop
+    std::minstd_rand random(2);
+    for (int round = 0; round < STRESS_ROUNDS; round++) {
+        std::vector<std::shared_ptr<SpeechMessage>> messages;
+        for (int i = 0; i < 3; i++) {
+            auto m = message(i);
+            m->requestTime = round;
+            messages.push_back(m);
+        }
+        queue->push(messages);
+        for (int i = (int) (random() % 4); i > 0; i--) {
+            std::this_thread::yield();
+        }
+        queue->stop();
+        stoppedRound = round;
+    }
+    done = true;
+    player.join();
+    prefetcher.join();
+
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%d rounds: %d played, %d prefetched, %d sources closed", STRESS_ROUNDS,
+             played.load(), prefetched.load(), closedCount.load());
+    TEST_MESSAGE(buf);
+    TEST_ASSERT_EQUAL(0, lostStops);
+    TEST_ASSERT_FALSE(queue->isRunning());
+    TEST_ASSERT_EQUAL(0, queue->size());
+    // every prefetched source is closed, played or dropped
+    TEST_ASSERT_EQUAL(prefetched, closedCount);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_take_in_order);
+    RUN_TEST(test_stop_after_take);
+    RUN_TEST(test_prefetch);
+    RUN_TEST(test_stress_speak_and_stop);
+    return UNITY_END();
+}
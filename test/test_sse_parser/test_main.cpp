@@ -0,0 +1,207 @@
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <unity.h>
+
+#include "lib/SseParser.h"
+
+// Heap usage tracking for the benchmark
+
+static size_t heapUsed = 0;
+static size_t heapPeak = 0;
+
+void *operator new(size_t size) {
+    auto p = static_cast<size_t *>(malloc(size + sizeof(size_t)));
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    *p = size;
+    heapUsed += size;
+    heapPeak = std::max(heapPeak, heapUsed);
+    return p + 1;
+}
+
+void operator delete(void *ptr) noexcept {
+    if (ptr != nullptr) {
+        auto p = static_cast<size_t *>(ptr) - 1;
+        heapUsed -= *p;
+        free(p);
+    }
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+/**
+ * Feed data in pieces of the given size and collect events
+ */
+static bool feedAll(SseParser &parser, const std::string &data, size_t pieceSize, std::vector<std::string> &events) {
+    for (size_t pos = 0; pos < data.size(); pos += pieceSize) {
+        auto len = std::min(pieceSize, data.size() - pos);
+        if (!parser.feed(data.data() + pos, len, [&events](const char *payload, size_t payloadLen) {
+            events.emplace_back(payload, payloadLen);
+            return true;
+        })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Make stream like OpenAI chat completion
+ */
+static std::string makeChatStream(int events, const char *lineEnd) {
+    std::string stream;
+    for (int i = 0; i < events; i++) {
+        stream += std::string("data: {\"id\":\"chatcmpl-7QyqpwdfhqwajicIEznoc6Q47XAyW\",\"object\":\"chat.completion.chunk\","
+                              "\"created\":1677664795,\"model\":\"gpt-3.5-turbo-0613\",\"choices\":[{\"index\":0,"
+                              "\"delta\":{\"content\":\"token") + std::to_string(i) + " \"},\"finish_reason\":null}]}"
+                  + lineEnd + lineEnd;
+    }
+    stream += std::string("data: [DONE]") + lineEnd + lineEnd;
+    return stream;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_single_event() {
+    SseParser parser(1024);
+    std::vector<std::string> events;
+    TEST_ASSERT_TRUE(feedAll(parser, "data: hello\n\n", 1024, events));
+    TEST_ASSERT_EQUAL(1, events.size());
+    TEST_ASSERT_EQUAL_STRING("hello", events[0].c_str());
+}
+
+void test_crlf_line_end() {
+    SseParser parser(1024);
+    std::vector<std::string> events;
+    TEST_ASSERT_TRUE(feedAll(parser, "data: a\r\n\r\ndata: b\r\n\r\n", 1024, events));
+    TEST_ASSERT_EQUAL(2, events.size());
+    TEST_ASSERT_EQUAL_STRING("a", events[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("b", events[1].c_str());
+}
+
+void test_multi_line_data() {
+    SseParser parser(1024);
+    std::vector<std::string> events;
+    TEST_ASSERT_TRUE(feedAll(parser, "data: line1\ndata:line2\ndata\n\n", 1024, events));
+    TEST_ASSERT_EQUAL(1, events.size());
+    TEST_ASSERT_EQUAL_STRING("line1\nline2\n", events[0].c_str());
+}
+
+void test_ignore_other_fields() {
+    SseParser parser(1024);
+    std::vector<std::string> events;
+    TEST_ASSERT_TRUE(feedAll(parser, ": comment\nevent: message\nid: 1\n\nretry: 10\ndata: x\nid: 2\n\n", 1024, events));
+    TEST_ASSERT_EQUAL(1, events.size());
+    TEST_ASSERT_EQUAL_STRING("x", events[0].c_str());
+}
+
+void test_incomplete_event_not_dispatched() {
+    SseParser parser(1024);
+    std::vector<std::string> events;
+    TEST_ASSERT_TRUE(feedAll(parser, "data: a\n", 1024, events));
+    TEST_ASSERT_EQUAL(0, events.size());
+    TEST_ASSERT_TRUE(feedAll(parser, "\n", 1024, events));
+    TEST_ASSERT_EQUAL(1, events.size());
+}
+
+void test_split_at_every_position() {
+    auto stream = makeChatStream(3, "\r\n");
+    std::vector<std::string> expected;
+    SseParser whole(4096);
+    TEST_ASSERT_TRUE(feedAll(whole, stream, stream.size(), expected));
+    TEST_ASSERT_EQUAL(4, expected.size());
+    TEST_ASSERT_EQUAL_STRING("[DONE]", expected[3].c_str());
+
+    for (size_t split = 1; split < stream.size(); split++) {
+        SseParser parser(4096);
+        std::vector<std::string> events;
+        TEST_ASSERT_TRUE(feedAll(parser, stream.substr(0, split), split, events));
+        TEST_ASSERT_TRUE(feedAll(parser, stream.substr(split), stream.size(), events));
+        TEST_ASSERT_TRUE(events == expected);
+    }
+    for (size_t pieceSize = 1; pieceSize < 16; pieceSize++) {
+        SseParser parser(4096);
+        std::vector<std::string> events;
+        TEST_ASSERT_TRUE(feedAll(parser, stream, pieceSize, events));
+        TEST_ASSERT_TRUE(events == expected);
+    }
+}
+
+void test_overflow() {
+    SseParser parser(16);
+    std::vector<std::string> events;
+    TEST_ASSERT_TRUE(feedAll(parser, "data: 0123456\n\n", 1024, events));
+    TEST_ASSERT_FALSE(feedAll(parser, "data: 0123456789\n\n", 1024, events));
+}
+
+void test_abort_by_callback() {
+    SseParser parser(1024);
+    int count = 0;
+    std::string data = "data: a\n\ndata: b\n\n";
+    TEST_ASSERT_FALSE(parser.feed(data.data(), data.size(), [&count](const char *, size_t) {
+        count++;
+        return false;
+    }));
+    TEST_ASSERT_EQUAL(1, count);
+}
+
+void test_reset() {
+    SseParser parser(1024);
+    std::vector<std::string> events;
+    TEST_ASSERT_TRUE(feedAll(parser, "data: broken", 1024, events));
+    parser.reset();
+    TEST_ASSERT_TRUE(feedAll(parser, "data: ok\n\n", 1024, events));
+    TEST_ASSERT_EQUAL(1, events.size());
+    TEST_ASSERT_EQUAL_STRING("ok", events[0].c_str());
+}
+
+void test_benchmark() {
+    auto stream = makeChatStream(200, "\n");
+    for (size_t pieceSize: {64, 512, 1460}) {
+        auto heapBase = heapUsed;
+        heapPeak = heapUsed;
+        size_t total = 0;
+        size_t count = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 100; i++) {
+            SseParser parser(8192);
+            for (size_t pos = 0; pos < stream.size(); pos += pieceSize) {
+                TEST_ASSERT_TRUE(parser.feed(stream.data() + pos, std::min(pieceSize, stream.size() - pos),
+                                             [&count](const char *, size_t) {
+                                                 count++;
+                                                 return true;
+                                             }));
+            }
+            total += stream.size();
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        TEST_ASSERT_EQUAL(201 * 100, count);
+        char buf[128];
+        snprintf(buf, sizeof(buf), "stream %d bytes, piece %d: %.1f MB/s, peak heap %d bytes",
+                 (int) stream.size(), (int) pieceSize, total / elapsed / 1e6, (int) (heapPeak - heapBase));
+        TEST_MESSAGE(buf);
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_single_event);
+    RUN_TEST(test_crlf_line_end);
+    RUN_TEST(test_multi_line_data);
+    RUN_TEST(test_ignore_other_fields);
+    RUN_TEST(test_incomplete_event_not_dispatched);
+    RUN_TEST(test_split_at_every_position);
+    RUN_TEST(test_overflow);
+    RUN_TEST(test_abort_by_callback);
+    RUN_TEST(test_reset);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
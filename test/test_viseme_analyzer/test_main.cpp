@@ -0,0 +1,197 @@
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <unity.h>
+
+#include "lib/VisemeAnalyzer.h"
+
+static const int RATE = 24000;
+
+/// one output buffer (40 ms)
+static const int WINDOW = 960;
+
+static std::vector<int16_t> tone(int hz, int amplitude = 8000) {
+    std::vector<int16_t> samples;
+    for (int i = 0; i < WINDOW; i++) {
+        samples.push_back((int16_t) lround(amplitude * sin(2 * M_PI * hz * i / RATE)));
+    }
+    return samples;
+}
+
+/// white noise through a first-order high-pass filter (like "s" or "sh")
+static std::vector<int16_t> hiss() {
+    std::mt19937 rng(1);
+    std::vector<int16_t> samples;
+    int prev = 0;
+    for (int i = 0; i < WINDOW; i++) {
+        int noise = (int) (rng() % 16001) - 8000;
+        samples.push_back((int16_t) ((noise - prev) / 2));
+        prev = noise;
+    }
+    return samples;
+}
+
+/**
+ * Classify one window
+ */
+static Viseme classify(const std::vector<int16_t> &samples) {
+    VisemeAnalyzer analyzer;
+    analyzer.setRate(RATE);
+    for (auto sample: samples) {
+        analyzer.add(sample);
+    }
+    analyzer.update(1000, 100);
+    VisemeEvent event{};
+    TEST_ASSERT_TRUE(analyzer.getEvent(1000, event));
+    return event.viseme;
+}
+
+static void publish(VisemeAnalyzer &analyzer, const std::vector<int16_t> &samples, uint32_t time, uint8_t level) {
+    for (auto sample: samples) {
+        analyzer.add(sample);
+    }
+    analyzer.update(time, level);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_classify() {
+    TEST_ASSERT_EQUAL((int) Viseme::Silent, (int) classify(tone(300, 0)));
+    TEST_ASSERT_EQUAL((int) Viseme::Silent, (int) classify(tone(300, 100)));
+    TEST_ASSERT_EQUAL((int) Viseme::Round, (int) classify(tone(150)));
+    TEST_ASSERT_EQUAL((int) Viseme::Open, (int) classify(tone(400)));
+    TEST_ASSERT_EQUAL((int) Viseme::Wide, (int) classify(tone(1500)));
+    TEST_ASSERT_EQUAL((int) Viseme::Fricative, (int) classify(tone(8000)));
+    TEST_ASSERT_EQUAL((int) Viseme::Fricative, (int) classify(hiss()));
+}
+
+void test_classify_at_other_rates() {
+    for (int rate: {16000, 44100}) {
+        VisemeAnalyzer analyzer;
+        analyzer.setRate(rate);
+        for (int i = 0; i < rate / 25; i++) {
+            analyzer.add((int16_t) lround(8000 * sin(2 * M_PI * 150 * i / rate)));
+        }
+        analyzer.update(1000, 100);
+        VisemeEvent event{};
+        TEST_ASSERT_TRUE(analyzer.getEvent(1000, event));
+        TEST_ASSERT_EQUAL((int) Viseme::Round, (int) event.viseme);
+    }
+}
+
+void test_level() {
+    VisemeAnalyzer analyzer;
+    analyzer.setRate(RATE);
+    publish(analyzer, tone(400), 1000, 123);
+    VisemeEvent event{};
+    TEST_ASSERT_TRUE(analyzer.getEvent(1000, event));
+    TEST_ASSERT_EQUAL(123, event.level);
+
+    // silent window is published with level 0
+    publish(analyzer, tone(400, 0), 1040, 123);
+    TEST_ASSERT_TRUE(analyzer.getEvent(1040, event));
+    TEST_ASSERT_EQUAL((int) Viseme::Silent, (int) event.viseme);
+    TEST_ASSERT_EQUAL(0, event.level);
+}
+
+void test_event_time() {
+    VisemeAnalyzer analyzer;
+    analyzer.setRate(RATE);
+    publish(analyzer, tone(150), 1000, 100);
+    publish(analyzer, tone(1500), 1040, 100);
+    VisemeEvent event{};
+
+    // not heard yet
+    TEST_ASSERT_FALSE(analyzer.getEvent(999, event));
+    // latest one heard until now
+    TEST_ASSERT_TRUE(analyzer.getEvent(1020, event));
+    TEST_ASSERT_EQUAL((int) Viseme::Round, (int) event.viseme);
+    TEST_ASSERT_TRUE(analyzer.getEvent(1050, event));
+    TEST_ASSERT_EQUAL((int) Viseme::Wide, (int) event.viseme);
+    // expired
+    TEST_ASSERT_FALSE(analyzer.getEvent(1040 + VISEME_EVENT_EXPIRE + 1, event));
+}
+
+void test_time_wraps_around() {
+    VisemeAnalyzer analyzer;
+    analyzer.setRate(RATE);
+    uint32_t time = 0xffffffff - 10;
+    publish(analyzer, tone(400), time, 100);
+    VisemeEvent event{};
+    TEST_ASSERT_TRUE(analyzer.getEvent(time + 20, event));
+    TEST_ASSERT_EQUAL((int) Viseme::Open, (int) event.viseme);
+}
+
+void test_events_overwritten() {
+    VisemeAnalyzer analyzer;
+    analyzer.setRate(RATE);
+    for (uint32_t i = 0; i < VISEME_EVENTS_NUM * 2; i++) {
+        publish(analyzer, i == VISEME_EVENTS_NUM * 2 - 1 ? tone(1500) : tone(400), 1000 + i * 40, 100);
+    }
+    VisemeEvent event{};
+    TEST_ASSERT_TRUE(analyzer.getEvent(1000 + VISEME_EVENTS_NUM * 2 * 40, event));
+    TEST_ASSERT_EQUAL((int) Viseme::Wide, (int) event.viseme);
+    // the oldest events have been dropped
+    TEST_ASSERT_FALSE(analyzer.getEvent(1000, event));
+}
+
+void test_update_without_samples() {
+    VisemeAnalyzer analyzer;
+    analyzer.setRate(RATE);
+    analyzer.update(1000, 100);
+    VisemeEvent event{};
+    TEST_ASSERT_FALSE(analyzer.getEvent(1000, event));
+}
+
+void test_reset() {
+    VisemeAnalyzer analyzer;
+    analyzer.setRate(RATE);
+    publish(analyzer, tone(400), 1000, 100);
+    analyzer.reset();
+    VisemeEvent event{};
+    TEST_ASSERT_FALSE(analyzer.getEvent(1000, event));
+}
+
+void test_benchmark() {
+    std::vector<int16_t> samples;
+    for (int i = 0; i < 25; i++) {
+        auto window = i % 3 == 0 ? tone(150) : i % 3 == 1 ? tone(1500) : hiss();
+        samples.insert(samples.end(), window.begin(), window.end());
+    }
+    VisemeAnalyzer analyzer;
+    analyzer.setRate(RATE);
+    const int repeat = 40;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++) {
+        for (size_t i = 0; i < samples.size(); i++) {
+            analyzer.add(samples[i]);
+            if ((i + 1) % WINDOW == 0) {
+                analyzer.update((uint32_t) i, 100);
+            }
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    auto perSample = elapsed / (samples.size() * repeat);
+    char buf[128];
+    snprintf(buf, sizeof(buf), "analysis: %.2f ns per sample, %.3f%% of a host core at %d Hz", perSample * 1e9,
+             perSample * RATE * 100, RATE);
+    TEST_MESSAGE(buf);
+    TEST_ASSERT_TRUE(perSample * RATE < 0.01);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_classify);
+    RUN_TEST(test_classify_at_other_rates);
+    RUN_TEST(test_level);
+    RUN_TEST(test_event_time);
+    RUN_TEST(test_time_wraps_around);
+    RUN_TEST(test_events_overwritten);
+    RUN_TEST(test_update_without_samples);
+    RUN_TEST(test_reset);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}